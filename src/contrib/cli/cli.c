@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 #include "../lib/libplctag.h"
 #include "./cli.h"
 #include "./getline.h"
@@ -21,8 +26,68 @@ cli_request_t cli_request = {
     500,
     1, // DEBUG_ERROR
     "",
-    false // offline
+    false, // offline
+    NDJSON
 };
+output_t out = {NULL, 0, 0, 0, 0, 0, 0};
+
+/*
+ * Decoders, one per type.  Each tag gets its decoder when its line is
+ * parsed so reading and formatting a value does not switch on the type.
+ */
+
+#define DECODER(NAME, FIELD, GETTER, FMT) \
+    void get_##NAME(int32_t tag_handle, tag_t *tag) \
+    { \
+        tag->val.FIELD = GETTER(tag_handle, tag->offset); \
+    } \
+    int format_##NAME(char *buf, size_t buf_size, const tag_t *tag) \
+    { \
+        return snprintf(buf, buf_size, FMT, tag->val.FIELD); \
+    }
+
+DECODER(uint64, UINT64_val, plc_tag_get_uint64, "%" PRIu64)
+DECODER(int64, INT64_val, plc_tag_get_int64, "%" PRIi64)
+DECODER(uint32, UINT32_val, plc_tag_get_uint32, "%" PRIu32)
+DECODER(int32, INT32_val, plc_tag_get_int32, "%" PRIi32)
+DECODER(uint16, UINT16_val, plc_tag_get_uint16, "%" PRIu16)
+DECODER(int16, INT16_val, plc_tag_get_int16, "%" PRIi16)
+DECODER(uint8, UINT8_val, plc_tag_get_uint8, "%" PRIu8)
+DECODER(int8, INT8_val, plc_tag_get_int8, "%" PRIi8)
+DECODER(float64, FLOAT64_val, plc_tag_get_float64, "%lf")
+DECODER(float32, FLOAT32_val, plc_tag_get_float32, "%f")
+
+void get_bool(int32_t tag_handle, tag_t *tag)
+{
+    tag->val.BOOL_val = (plc_tag_get_uint8(tag_handle, tag->offset) ? true : false);
+}
+
+void get_bool_bit(int32_t tag_handle, tag_t *tag)
+{
+    tag->val.BOOL_val = (plc_tag_get_bit(tag_handle, tag->bit) > 0 ? true : false);
+}
+
+int format_bool(char *buf, size_t buf_size, const tag_t *tag)
+{
+    return snprintf(buf, buf_size, "%s", btoa(tag->val.BOOL_val));
+}
+
+/* indexed by data_type_t */
+const decoder_t decoders[] = {
+    { "uint64", 8, get_uint64, format_uint64 },
+    { "int64", 8, get_int64, format_int64 },
+    { "uint32", 4, get_uint32, format_uint32 },
+    { "int32", 4, get_int32, format_int32 },
+    { "uint16", 2, get_uint16, format_uint16 },
+    { "int16", 2, get_int16, format_int16 },
+    { "uint8", 1, get_uint8, format_uint8 },
+    { "int8", 1, get_int8, format_int8 },
+    { "float64", 8, get_float64, format_float64 },
+    { "float32", 4, get_float32, format_float32 },
+    { "bool", 1, get_bool, format_bool }
+};
+
+const decoder_t bool_bit_decoder = { "bool", 1, get_bool_bit, format_bool };
 
 void usage(void)
 {
@@ -30,7 +95,7 @@ void usage(void)
     fprintf(stdout, "\tLIBPLCTAG CLI.\n");
     fprintf(stdout, "\tThis is a command-line interface to access tags/registers, in PLCs supported by libplctag.\n");
     fprintf(stdout, "\n\tcli {--read | --write | --watch} {-protocol} {-ip} {-path} {-plc}\n");
-    fprintf(stdout, "\t\t[-debug] [-interval] [-attributes] [-offline]\n");
+    fprintf(stdout, "\t\t[-debug] [-interval] [-attributes] [-offline] [-format]\n");
 
     fprintf(stdout, "\n\tCLI Action (Required):\n");
     fprintf(stdout, "\n\t--read\t\t- Perform a one-shot READ operation.\n");
@@ -49,6 +114,7 @@ void usage(void)
     fprintf(stdout, "\t-interval\t- interval in ms for WATCH operation. (default: 500)\n");
     fprintf(stdout, "\t-attributes\t- additional attributes. (default: '')\n");
     fprintf(stdout, "\t-offline\t- operation mode. (default: false)\n");
+    fprintf(stdout, "\t-format\t\t- output format, ndjson or binary. (default: ndjson)\n");
 
     fflush(stdout);
 }
@@ -114,9 +180,20 @@ int parse_args(int argc, char *argv[])
                 fprintf(stderr, "INFO: Supported values 'true' or 'false'.");
                 fflush(stderr);
             }
+        } else if (!strcmp(param, "-format")) {
+            if (val && !strcmp(val, "ndjson")) {
+                cli_request.format = NDJSON;
+            } else if (val && !strcmp(val, "binary")) {
+                cli_request.format = BINARY;
+            } else {
+                fprintf(stderr, "ERROR: invalid parameter value for format.\n");
+                fprintf(stderr, "INFO: Supported values 'ndjson' or 'binary'.\n");
+                fflush(stderr);
+                return -1;
+            }
         } else {
             fprintf(stderr, "ERROR: invalid PLC parameter: %s.\n", param);
-            fprintf(stderr, "INFO: Supported params -protocol, -ip, -path, -plc, -debug, -interval, -attributes, -offline.\n");
+            fprintf(stderr, "INFO: Supported params -protocol, -ip, -path, -plc, -debug, -interval, -attributes, -offline, -format.\n");
             fflush(stderr);
             return -1;
         }
@@ -150,6 +227,7 @@ void print_request()
     pdebug(DEBUG_INFO, "Debug Level: %d", cli_request.debug_level);
     pdebug(DEBUG_INFO, "Additional Attributes: %s", cli_request.attributes);
     pdebug(DEBUG_INFO, "Offline: %s", btoa(cli_request.offline));
+    pdebug(DEBUG_INFO, "Format: %s", (cli_request.format == BINARY ? "binary" : "ndjson"));
 }
 
 int is_comment(const char *line)
@@ -294,44 +372,7 @@ int validate_line(tag_line_parts_t tag_line_parts) {
 void print_tag(tag_t *tag) {
     pdebug(DEBUG_INFO, "Tag created:");
     pdebug(DEBUG_INFO, "Key: %s", tag->key);
-    switch (tag->type) {
-    case t_UINT64:
-        pdebug(DEBUG_INFO, "Type: uint64.");
-        break;
-    case t_INT64:
-        pdebug(DEBUG_INFO, "Type: int64.");
-        break;
-    case t_UINT32:
-        pdebug(DEBUG_INFO, "Type: uint32.");
-        break;
-    case t_INT32:
-        pdebug(DEBUG_INFO, "Type: int32.");
-        break;
-    case t_UINT16:
-        pdebug(DEBUG_INFO, "Type: uint16.");
-        break;
-    case t_INT16:
-        pdebug(DEBUG_INFO, "Type: int16.");
-        break;
-    case t_UINT8:
-        pdebug(DEBUG_INFO, "Type: uint8.");
-        break;
-    case t_INT8:
-        pdebug(DEBUG_INFO, "Type: int8.");
-        break;
-    case t_FLOAT64:
-        pdebug(DEBUG_INFO, "Type: float64.");
-        break;
-    case t_FLOAT32:
-        pdebug(DEBUG_INFO, "Type: float32.");
-        break;
-    case t_BOOL:
-        pdebug(DEBUG_INFO, "Type: bool.");
-        break;
-    default:
-        pdebug(DEBUG_INFO, "Type: INVALID.");
-        break;
-    }
+    pdebug(DEBUG_INFO, "Type: %s.", tag->decoder->name);
     pdebug(DEBUG_INFO, "Path: %s", tag->path);
     pdebug(DEBUG_INFO, "Bit: %d", tag->bit);
     pdebug(DEBUG_INFO, "Offset: %d", tag->offset);
@@ -464,6 +505,17 @@ int process_line(const char *line, tag_t *tag)
         return -1;
     }
 
+    if (tag->type == t_BOOL && tag->bit != -1) {
+        tag->decoder = &bool_bit_decoder;
+    } else {
+        tag->decoder = &decoders[tag->type];
+    }
+
+    if (make_json_key(tag) != 0) {
+        pdebug(DEBUG_ERROR, "Unable to allocate output key for %s!", tag->key);
+        return -1;
+    }
+
     free(tag_line_parts.parts);
     print_tag(tag);
     pdebug(DEBUG_INFO, "Line processed!");
@@ -471,13 +523,39 @@ int process_line(const char *line, tag_t *tag)
     return 0;
 }
 
-void add_tag(int tag_handle, tag_t tag)
+/* precompute the {"key": prefix of the NDJSON output lines. */
+int make_json_key(tag_t *tag)
 {
-    struct tags *t;
+    const char *src = tag->key;
+    char *dest = NULL;
+
+    tag->json_key = malloc((strlen(tag->key) * 2) + 5);
+    if (!tag->json_key) {
+        return -1;
+    }
+
+    dest = tag->json_key;
+    *dest++ = '{';
+    *dest++ = '"';
+
+    for (; *src; src++) {
+        if (*src == '"' || *src == '\\') {
+            *dest++ = '\\';
+        }
+        *dest++ = *src;
+    }
+
+    *dest++ = '"';
+    *dest++ = ':';
+    *dest = 0;
+
+    tag->json_key_len = (int)(dest - tag->json_key);
 
-    t = malloc(sizeof(struct tags));
-    t->tag_handle = tag_handle;
-    t->tag = tag;
+    return 0;
+}
+
+void add_tag(struct tags *t)
+{
     HASH_ADD_INT(tags, tag_handle, t);
 }
 
@@ -503,6 +581,7 @@ int process_tags()
     char *line = NULL;
     size_t line_len = 0;
     char *tag_path = (char *) malloc(1024);
+    int count = 0;
 
     while (getline(&line, &line_len, stdin) > 0) {
         if (is_comment(line)) {
@@ -514,6 +593,7 @@ int process_tags()
         }
 
         tag_t tag;
+        struct tags *t;
         trim_line(line);
         pdebug(DEBUG_INFO, "Trimmed Line: %s", line);
         /* ignore lines that can't be processed */
@@ -521,6 +601,27 @@ int process_tags()
             continue;
         }
 
+        if (count >= MAX_TAGS) {
+            pdebug(DEBUG_ERROR, "Too many tags, at most %d are supported!", MAX_TAGS);
+            free(tag_path);
+            free(line);
+            return -1;
+        }
+
+        tag.index = (uint16_t)count;
+        tag.changes = 0;
+        tag.changes_seen = 0;
+
+        t = malloc(sizeof(struct tags));
+        if (!t) {
+            pdebug(DEBUG_ERROR, "Unable to allocate tag entry for %s!", tag.key);
+            free(tag_path);
+            free(line);
+            return -1;
+        }
+
+        t->tag = tag;
+
         switch (cli_request.operation) {
         case WATCH:
             sprintf(tag_path, TAG_PATH_AUTO_READ_SYNC, cli_request.protocol,
@@ -536,15 +637,19 @@ int process_tags()
         }
 
         pdebug(DEBUG_INFO, "%s", tag_path);
-        int tag_handle = plc_tag_create(tag_path, 0);
+        /* the callback finds its tag through the user data, it can run before the tag is in the table. */
+        int tag_handle = plc_tag_create_ex(tag_path, tag_callback, t, 0);
         if (tag_handle < 0) {
             pdebug(DEBUG_ERROR, "Error, %s, creating tag %s with string %s!", plc_tag_decode_error(tag_handle), tag.key, tag_path);
+            free(t);
             free(tag_path);
             free(line);
             return -1;
         }
 
-        add_tag(tag_handle, tag);
+        t->tag_handle = tag_handle;
+        add_tag(t);
+        count++;
     }
 
     free(tag_path);
@@ -553,169 +658,252 @@ int process_tags()
     return 0;
 }
 
-int get_tag(int32_t tag_handle, tag_t *tag) {
-    switch (tag->type) {
-    case t_UINT64:
-        tag->val.UINT64_val = plc_tag_get_uint64(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.UINT64_val = tag->val.UINT64_val;
-            fprintf(stdout, "{\"%s\":%" PRIu64"}\n", tag->key, tag->val.UINT64_val);
-            fflush(stdout);
-            break;
-        }
-        if (tag->val.UINT64_val != tag->last_val.UINT64_val) {
-            tag->last_val.UINT64_val = tag->val.UINT64_val;
-            fprintf(stdout, "{\"%s\":%" PRIu64"}\n", tag->key, tag->val.UINT64_val);
-            fflush(stdout);
-        }
-        break;
-    case t_INT64:
-        tag->val.INT64_val = plc_tag_get_int64(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.INT64_val = tag->val.INT64_val;
-            fprintf(stdout, "{\"%s\":%" PRIi64"}\n", tag->key, tag->val.INT64_val);
-            fflush(stdout);
-            break;
-        }
-        if (tag->val.INT64_val != tag->last_val.INT64_val) {
-            tag->last_val.INT64_val = tag->val.INT64_val;
-            fprintf(stdout, "{\"%s\":%" PRIi64"}\n", tag->key, tag->val.INT64_val);
-            fflush(stdout);
-        }
-        break;
-    case t_UINT32:
-        tag->val.UINT32_val = plc_tag_get_uint32(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.UINT32_val = tag->val.UINT32_val;
-            fprintf(stdout, "{\"%s\":%" PRIu32"}\n", tag->key, tag->val.UINT32_val);
-            fflush(stdout);
-            break;
-        }
-        if (tag->val.UINT32_val != tag->last_val.UINT32_val) {
-            tag->last_val.UINT32_val = tag->val.UINT32_val;
-            fprintf(stdout, "{\"%s\":%" PRIu32"}\n", tag->key, tag->val.UINT32_val);
-            fflush(stdout);
-        }
-        break;
-    case t_INT32:
-        tag->val.INT32_val = plc_tag_get_int32(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.INT32_val = tag->val.INT32_val;
-            fprintf(stdout, "{\"%s\":%" PRIi32"}\n", tag->key, tag->val.INT32_val);
-            fflush(stdout);
-            break;
-        }
-        if (tag->val.INT32_val != tag->last_val.INT32_val) {
-            tag->last_val.INT32_val = tag->val.INT32_val;
-            fprintf(stdout, "{\"%s\":%" PRIi32"}\n", tag->key, tag->val.INT32_val);
-            fflush(stdout);
-        }
-        break;
-    case t_UINT16:
-        tag->val.UINT16_val = plc_tag_get_uint16(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.UINT16_val = tag->val.UINT16_val;
-            fprintf(stdout, "{\"%s\":%" PRIu16"}\n", tag->key, tag->val.UINT16_val);
-            fflush(stdout);
-            break;
-        }
-        if (tag->val.UINT16_val != tag->last_val.UINT16_val) {
-            tag->last_val.UINT16_val = tag->val.UINT16_val;
-            fprintf(stdout, "{\"%s\":%" PRIu16"}\n", tag->key, tag->val.UINT16_val);
-            fflush(stdout);
-        }
-        break;
-    case t_INT16:
-        tag->val.INT16_val = plc_tag_get_int16(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.INT16_val = tag->val.INT16_val;
-            fprintf(stdout, "{\"%s\":%" PRIi16"}\n", tag->key, tag->val.INT16_val);
-            fflush(stdout);
-            break;
-        }
-        if (tag->val.INT16_val != tag->last_val.INT16_val) {
-            tag->last_val.INT16_val = tag->val.INT16_val;
-            fprintf(stdout, "{\"%s\":%" PRIi16"}\n", tag->key, tag->val.UINT16_val);
-            fflush(stdout);
+/* output buffer helpers. */
+
+int out_reserve(size_t extra)
+{
+    size_t cap = (out.cap ? out.cap : OUTPUT_BUF_MIN);
+    char *data = NULL;
+
+    if (out.len + extra <= out.cap) {
+        return 0;
+    }
+
+    while (cap < out.len + extra) {
+        cap *= 2;
+    }
+
+    data = realloc(out.data, cap);
+    if (!data) {
+        pdebug(DEBUG_ERROR, "Unable to grow the output buffer to %d bytes!", (int)cap);
+        return -1;
+    }
+
+    out.data = data;
+    out.cap = cap;
+
+    return 0;
+}
+
+int out_append(const void *data, size_t len)
+{
+    if (out_reserve(len) != 0) {
+        return -1;
+    }
+
+    memcpy(out.data + out.len, data, len);
+    out.len += len;
+
+    return 0;
+}
+
+/* the space must already be reserved. */
+void out_put_le(size_t pos, uint64_t val, int size)
+{
+    for (int i = 0; i < size; i++) {
+        out.data[pos + (size_t)i] = (char)(uint8_t)(val >> (8 * i));
+    }
+}
+
+int out_append_le(uint64_t val, int size)
+{
+    if (out_reserve((size_t)size) != 0) {
+        return -1;
+    }
+
+    out_put_le(out.len, val, size);
+    out.len += (size_t)size;
+
+    return 0;
+}
+
+/* one write and one flush for everything buffered. */
+int out_flush(void)
+{
+    size_t len = out.len;
+
+    out.len = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (fwrite(out.data, 1, len, stdout) != len || fflush(stdout) != 0) {
+        pdebug(DEBUG_ERROR, "Unable to write %d bytes of output!", (int)len);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Binary frames start with 'P', 'T', the frame kind, a zero byte and the
+ * payload length as a uint32.  The length is filled in by end_frame().
+ */
+int begin_frame(uint8_t kind)
+{
+    if (out_reserve(FRAME_HEADER_SIZE) != 0) {
+        return -1;
+    }
+
+    out.frame_start = out.len;
+    out.data[out.len++] = FRAME_MAGIC_0;
+    out.data[out.len++] = FRAME_MAGIC_1;
+    out.data[out.len++] = (char)kind;
+    out.data[out.len++] = 0;
+    out.len += 4;
+
+    return 0;
+}
+
+void end_frame(void)
+{
+    out_put_le(out.frame_start + 4, (uint64_t)(out.len - out.frame_start - FRAME_HEADER_SIZE), 4);
+}
+
+/* binary only, maps the tag index used in value frames to the key and type. */
+int emit_keys(void)
+{
+    struct tags *t;
+
+    if (cli_request.format != BINARY) {
+        return 0;
+    }
+
+    if (begin_frame(FRAME_KEYS) != 0 || out_append_le(HASH_COUNT(tags), 2) != 0) {
+        return -1;
+    }
+
+    for(t = tags; t != NULL; t = t->hh.next) {
+        size_t key_len = strlen(t->tag.key);
+
+        if (out_append_le(t->tag.index, 2) != 0
+            || out_append_le((uint64_t)t->tag.type, 1) != 0
+            || out_append_le(key_len, 2) != 0
+            || out_append(t->tag.key, key_len) != 0) {
+            return -1;
         }
-        break;
-    case t_UINT8:
-        tag->val.UINT8_val = plc_tag_get_uint8(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.UINT8_val = tag->val.UINT8_val;
-            fprintf(stdout, "{\"%s\":%" PRIu8"}\n", tag->key, tag->val.UINT8_val);
-            fflush(stdout);
+    }
+
+    end_frame();
+
+    return out_flush();
+}
+
+int begin_output(uint32_t cycle, int64_t time_ms)
+{
+    out.values = 0;
+    out.cycle = cycle;
+    out.time_ms = time_ms;
+    out.frame_start = out.len;
+
+    if (cli_request.format != BINARY) {
+        return 0;
+    }
+
+    /* cycle, time, dropped and value count, the last two are filled in by end_output(). */
+    if (begin_frame(FRAME_VALUES) != 0
+        || out_append_le(cycle, 4) != 0
+        || out_append_le((uint64_t)time_ms, 8) != 0
+        || out_append_le(0, 4) != 0
+        || out_append_le(0, 2) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int emit_value(tag_t *tag)
+{
+    char buf[400];
+    uint64_t raw = 0;
+    int len = 0;
+
+    out.values++;
+
+    if (cli_request.format == BINARY) {
+        switch (tag->decoder->size) {
+        case 1:
+            raw = (tag->type == t_BOOL ? (tag->val.BOOL_val ? 1 : 0) : tag->val.UINT8_val);
             break;
-        }
-        if (tag->val.UINT8_val != tag->last_val.UINT8_val) {
-            tag->last_val.UINT8_val = tag->val.UINT8_val;
-            fprintf(stdout, "{\"%s\":%" PRIu8"}\n", tag->key, tag->val.UINT8_val);
-            fflush(stdout);
-        }
-        break;
-    case t_INT8:
-        tag->val.INT8_val = plc_tag_get_int8(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.INT8_val = tag->val.INT8_val;
-            fprintf(stdout, "{\"%s\":%" PRIi8"}\n", tag->key, tag->val.INT8_val);
-            fflush(stdout);
+        case 2:
+            raw = tag->val.UINT16_val;
             break;
-        }
-        if (tag->val.INT8_val != tag->last_val.INT8_val) {
-            tag->last_val.INT8_val = tag->val.INT8_val;
-            fprintf(stdout, "{\"%s\":%" PRIi8"}\n", tag->key, tag->val.INT8_val);
-            fflush(stdout);
-        }
-        break;
-    case t_FLOAT64:
-        tag->val.FLOAT64_val = plc_tag_get_float64(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.FLOAT64_val = tag->val.FLOAT64_val;
-            fprintf(stdout, "{\"%s\":%lf}\n", tag->key, tag->val.FLOAT64_val);
-            fflush(stdout);
+        case 4:
+            raw = tag->val.UINT32_val;
             break;
-        }
-        if (tag->val.FLOAT64_val != tag->last_val.FLOAT64_val) {
-            tag->last_val.FLOAT64_val = tag->val.FLOAT64_val;
-            fprintf(stdout, "{\"%s\":%lf}\n", tag->key, tag->val.FLOAT64_val);
-            fflush(stdout);
-        }
-        break;
-    case t_FLOAT32:
-        tag->val.FLOAT32_val = plc_tag_get_float32(tag_handle, tag->offset);
-        if (!tag->watch) {
-            tag->last_val.FLOAT32_val = tag->val.FLOAT32_val;
-            fprintf(stdout, "{\"%s\":%f}\n", tag->key, tag->val.FLOAT32_val);
-            fflush(stdout);
+        default:
+            raw = tag->val.UINT64_val;
             break;
         }
-        if (tag->val.FLOAT32_val != tag->last_val.FLOAT32_val) {
-            tag->last_val.FLOAT32_val = tag->val.FLOAT32_val;
-            fprintf(stdout, "{\"%s\":%f}\n", tag->key, tag->val.FLOAT32_val);
-            fflush(stdout);
-        }
-        break;
-    case t_BOOL:
-        if (tag->bit == -1) {
-            tag->val.BOOL_val = plc_tag_get_uint8(tag_handle, tag->offset);
-        } else {
-            tag->val.BOOL_val = plc_tag_get_bit(tag_handle, tag->bit);
-        }
-        if (!tag->watch) {
-            tag->last_val.BOOL_val = tag->val.BOOL_val;
-            fprintf(stdout, "{\"%s\":%s}\n", tag->key, btoa(tag->val.BOOL_val));
-            fflush(stdout);
-            break;
+
+        if (out_append_le(tag->index, 2) != 0
+            || out_append_le((uint64_t)tag->type, 1) != 0
+            || out_append_le((uint64_t)tag->decoder->size, 1) != 0
+            || out_append_le(raw, tag->decoder->size) != 0) {
+            return -1;
         }
-        if (tag->val.BOOL_val != tag->last_val.BOOL_val) {
-            tag->last_val.BOOL_val = tag->val.BOOL_val;
-            fprintf(stdout, "{\"%s\":%s}\n", tag->key, btoa(tag->val.BOOL_val));
-            fflush(stdout);
+
+        return 0;
+    }
+
+    len = tag->decoder->format(buf, sizeof(buf), tag);
+    if (len < 0 || len >= (int)sizeof(buf)) {
+        pdebug(DEBUG_WARN, "Unable to format value of tag %s!", tag->key);
+        return -1;
+    }
+
+    if (out_append(tag->json_key, (size_t)tag->json_key_len) != 0
+        || out_append(buf, (size_t)len) != 0
+        || out_append("}\n", 2) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Finish the cycle and flush it.  When report is set, NDJSON output gets
+ * a cycle record with the number of values and of changes dropped.
+ */
+int end_output(int dropped, bool report)
+{
+    char buf[200];
+    int len = 0;
+
+    if (out.values == 0 && dropped == 0) {
+        /* nothing to say, drop an empty frame. */
+        out.len = out.frame_start;
+        return out_flush();
+    }
+
+    if (cli_request.format == BINARY) {
+        out_put_le(out.frame_start + FRAME_HEADER_SIZE + 12, (uint64_t)dropped, 4);
+        out_put_le(out.frame_start + FRAME_HEADER_SIZE + 16, out.values, 2);
+        end_frame();
+    } else if (report) {
+        len = snprintf(buf, sizeof(buf), "{\"@cycle\":{\"seq\":%" PRIu32 ",\"time_ms\":%" PRIi64 ",\"values\":%" PRIu32 ",\"dropped\":%d}}\n",
+                       out.cycle, out.time_ms, out.values, dropped);
+
+        if (out_append(buf, (size_t)len) != 0) {
+            return -1;
         }
-        break;
-    default:
-        return PLCTAG_ERR_BAD_STATUS;
-        break;
+    }
+
+    return out_flush();
+}
+
+int get_tag(int32_t tag_handle, tag_t *tag) {
+    tag->decoder->get(tag_handle, tag);
+
+    if (tag->watch && !memcmp(&tag->val, &tag->last_val, (size_t)tag->decoder->size)) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    tag->last_val = tag->val;
+
+    if (emit_value(tag) != 0) {
+        return PLCTAG_ERR_NO_MEM;
     }
 
     return PLCTAG_STATUS_OK;
@@ -739,6 +927,10 @@ int read_tags(void) {
         util_sleep_ms(1);
     }
 
+    if (begin_output(0, util_time_ms()) != 0) {
+        return PLCTAG_ERR_NO_MEM;
+    }
+
     for(t = tags; t != NULL; t = t->hh.next) {
         rc = get_tag(t->tag_handle, &t->tag);
         if(rc != PLCTAG_STATUS_OK) {
@@ -747,6 +939,10 @@ int read_tags(void) {
         }
     }
 
+    if (end_output(0, false) != 0) {
+        return PLCTAG_ERR_WRITE;
+    }
+
     return 0;
 }
 
@@ -912,26 +1108,33 @@ int write_tags(void) {
     return 0;
 }
 
-void tag_callback(int32_t tag_handle, int event, int status) {
-    /* get that tag associated with the handle */
-    struct tags *t;
-    HASH_FIND_INT(tags, &tag_handle, t);
+void tag_callback(int32_t tag_handle, int event, int status, void *userdata) {
+    /* the tag entry is passed as the user data */
+    struct tags *t = (struct tags *)userdata;
+
+    (void)tag_handle;
 
     /* handle the events. */
     switch(event) {
     case PLCTAG_EVENT_ABORTED:
         pdebug(DEBUG_INFO, "tag(%s): Tag operation was aborted!", t->tag.key);
         break;
+    case PLCTAG_EVENT_CREATED:
+        pdebug(DEBUG_INFO, "tag(%s): Tag created with status %s.", t->tag.key, plc_tag_decode_error(status));
+        break;
     case PLCTAG_EVENT_DESTROYED:
         pdebug(DEBUG_INFO, "tag(%s): Tag was destroyed.", t->tag.key);
         break;
     case PLCTAG_EVENT_READ_COMPLETED:
-        get_tag(tag_handle, &t->tag);
         pdebug(DEBUG_INFO, "tag(%s): Tag read operation completed with status %s.", t->tag.key, plc_tag_decode_error(status));
         break;
     case PLCTAG_EVENT_READ_STARTED:
         pdebug(DEBUG_INFO, "tag(%s): Tag read operation started.", t->tag.key);
         break;
+    case PLCTAG_EVENT_VALUE_CHANGED:
+        /* only count it, the watch loop decodes and writes the value. */
+        t->tag.changes++;
+        break;
     case PLCTAG_EVENT_WRITE_COMPLETED:
         break;
     case PLCTAG_EVENT_WRITE_STARTED:
@@ -942,22 +1145,78 @@ void tag_callback(int32_t tag_handle, int event, int status) {
     }
 }
 
+/*
+ * The library reads the tags in the background and the callback counts
+ * the changes.  Once per interval, decode the tags that changed, buffer
+ * the new values and write them out in one go.  A change that is
+ * overwritten by a later one before the cycle gets to it is counted as
+ * dropped for that cycle.
+ */
 int watch_tags(void) {
-    int rc = PLCTAG_STATUS_OK;
     struct tags *t;
+    uint32_t cycle = 0;
+    int64_t next_cycle = 0;
+    int64_t now = 0;
 
-    /* set all the tags to watch and register callbacks */
     for(t = tags; t != NULL; t = t->hh.next) {
         t->tag.watch = true;
-        rc = plc_tag_register_callback(t->tag_handle, tag_callback);
-        if(rc != PLCTAG_STATUS_OK) {
-            pdebug(DEBUG_ERROR, "Unable to register callback for tag %s!", plc_tag_decode_error(rc));
-            return rc;
-        }
+        t->tag.changes_seen = t->tag.changes;
     }
 
-    while(true){
-        util_sleep_ms(1000);
+    next_cycle = util_time_ms();
+
+    while(true) {
+        int dropped = 0;
+
+        cycle++;
+
+        if (begin_output(cycle, util_time_ms()) != 0) {
+            return PLCTAG_ERR_NO_MEM;
+        }
+
+        for(t = tags; t != NULL; t = t->hh.next) {
+            tag_t *tag = &t->tag;
+            int changes = tag->changes;
+            int new_changes = changes - tag->changes_seen;
+            int emitted = 0;
+
+            /* the first cycle checks everything to catch changes since the initial read. */
+            if (new_changes == 0 && cycle > 1) {
+                continue;
+            }
+
+            tag->changes_seen = changes;
+            tag->decoder->get(t->tag_handle, tag);
+
+            if (memcmp(&tag->val, &tag->last_val, (size_t)tag->decoder->size)) {
+                tag->last_val = tag->val;
+
+                if (emit_value(tag) != 0) {
+                    return PLCTAG_ERR_NO_MEM;
+                }
+
+                emitted = 1;
+            }
+
+            if (new_changes > emitted) {
+                dropped += new_changes - emitted;
+            }
+        }
+
+        if (end_output(dropped, true) != 0) {
+            pdebug(DEBUG_ERROR, "Unable to write output, stopping watch.");
+            return PLCTAG_ERR_WRITE;
+        }
+
+        /* if we fell behind, start over from now.  The missed changes show up as drops. */
+        next_cycle += cli_request.interval;
+        now = util_time_ms();
+
+        if (next_cycle > now) {
+            util_sleep_ms((int)(next_cycle - now));
+        } else {
+            next_cycle = now;
+        }
     }
 
     return 0;
@@ -1020,6 +1279,12 @@ int main(int argc, char *argv[])
 
     plc_tag_set_debug_level(cli_request.debug_level);
 
+#ifdef _WIN32
+    if (cli_request.format == BINARY) {
+        _setmode(_fileno(stdout), _O_BINARY);
+    }
+#endif
+
     print_request();
 
     if (process_tags() != PLCTAG_STATUS_OK) {
@@ -1037,6 +1302,11 @@ int main(int argc, char *argv[])
         util_sleep_ms(1);
     }
 
+    if (emit_keys() != 0) {
+        pdebug(DEBUG_ERROR, "Could not write the tag keys.");
+        exit(1);
+    }
+
     switch (cli_request.operation) {
     case READ:
         if (read_tags() != PLCTAG_STATUS_OK) {
@@ -1055,7 +1325,12 @@ int main(int argc, char *argv[])
             pdebug(DEBUG_ERROR, "Tag read failed.");
             exit(1);
         }
-        watch_tags();
+        if (watch_tags() != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_ERROR, "Tag watch failed.");
+            destroy_tags();
+            plc_tag_shutdown();
+            exit(1);
+        }
         break;
     default:
         break;
@@ -1063,6 +1338,7 @@ int main(int argc, char *argv[])
 
     destroy_tags();
     plc_tag_shutdown();
+    free(out.data);
 
     pdebug(DEBUG_INFO, "DONE.");
     exit(0);
@@ -4,9 +4,18 @@
 
 /* tag paths */
 #define TAG_PATH                  "protocol=%s&gateway=%s&path=%s&plc=%s&debug=%d&name=%s%s"
-#define TAG_PATH_AUTO_READ_SYNC   "protocol=%s&gateway=%s&path=%s&plc=%s&debug=%d&auto_sync_read_ms=%d&name=%s%s"
+#define TAG_PATH_AUTO_READ_SYNC   "protocol=%s&gateway=%s&path=%s&plc=%s&debug=%d&auto_sync_read_ms=%d&on_change=1&double_buffer=1&name=%s%s"
 #define DATA_TIMEOUT              5000
 
+/* binary output framing, all integers are little endian. */
+#define FRAME_MAGIC_0             'P'
+#define FRAME_MAGIC_1             'T'
+#define FRAME_HEADER_SIZE         8
+#define FRAME_KEYS                1
+#define FRAME_VALUES              2
+#define OUTPUT_BUF_MIN            4096
+#define MAX_TAGS                  65535
+
 /* bool utils */
 #define btoa(x) ( (x) ? "true" : "false" )
 
@@ -17,6 +26,12 @@ typedef enum {
     WATCH
 } cli_operation_t;
 
+/* output formats */
+typedef enum {
+    NDJSON,
+    BINARY
+} output_format_t;
+
 /* cli request definition */
 typedef struct {
     const char *protocol;
@@ -28,6 +43,7 @@ typedef struct {
     int debug_level;
     const char *attributes;
     bool offline;
+    output_format_t format;
 } cli_request_t;
 
 /* tag line parts definition */
@@ -46,8 +62,18 @@ typedef enum {
     t_BOOL 
 } data_type_t;
 
-/* tag definition */
+struct tag_s;
+
+/* per type decoder, picked once when the tag line is parsed. */
 typedef struct {
+    const char *name;
+    int size;
+    void (*get)(int32_t tag_handle, struct tag_s *tag);
+    int (*format)(char *buf, size_t buf_size, const struct tag_s *tag);
+} decoder_t;
+
+/* tag definition */
+typedef struct tag_s {
     const char *key;
     data_type_t type;
     const char *path;
@@ -67,8 +93,25 @@ typedef struct {
     int bit;
     int offset;
     bool watch;
+    const decoder_t *decoder;
+    char *json_key;
+    int json_key_len;
+    uint16_t index;
+    volatile int changes;
+    int changes_seen;
 } tag_t;
 
+/* output buffer, written to stdout once per cycle */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    size_t frame_start;
+    uint32_t values;
+    uint32_t cycle;
+    int64_t time_ms;
+} output_t;
+
 /* tags hash definition */
 struct tags {
     int tag_handle;
@@ -86,14 +129,26 @@ tag_line_parts_t split_string(const char *str, const char *sep);
 int process_line(const char *line, tag_t *tag);
 int validate_line(tag_line_parts_t tag_line_parts);
 void print_tag(tag_t *tag);
-void add_tag(int32_t tag_handle, tag_t tag);
+int make_json_key(tag_t *tag);
+void add_tag(struct tags *t);
 int check_tags(void);
+int out_reserve(size_t extra);
+int out_append(const void *data, size_t len);
+void out_put_le(size_t pos, uint64_t val, int size);
+int out_append_le(uint64_t val, int size);
+int out_flush(void);
+int begin_frame(uint8_t kind);
+void end_frame(void);
+int emit_keys(void);
+int begin_output(uint32_t cycle, int64_t time_ms);
+int emit_value(tag_t *tag);
+int end_output(int dropped, bool report);
 int get_tag(int32_t tag_handle, tag_t *tag);
 int read_tags(void);
 int set_tag(int32_t tag_handle, tag_t *tag);
 int verify_write_tags(void);
 int write_tags(void);
 int watch_tags(void);
-void tag_callback(int32_t tag_handle, int event, int status);
+void tag_callback(int32_t tag_handle, int event, int status, void *userdata);
 int destroy_tags(void);
 int do_offline(void);
@@ -44,241 +44,63 @@
 #include "../lib/libplctag.h"
 #include "utils.h"
 
-#define REQUIRED_VERSION 2,1,0
+#define REQUIRED_VERSION 2,6,0
 
-#define MAX_TAGS 5000
-#define RECONNECT_DELAY_MS 5000
+#define BATCH_SIZE 1000
+#define POLL_DELAY_MS 100
+#define MAX_NAME_LEN 128
 
 
-typedef enum { UNKNOWN = 0, DINT, INT, SINT, REAL } data_type_t;
-
-struct {
-    const char *name;
-    int rpi;
-    int64_t next_read;
-    int32_t tag_id;
-    int reading;
-    data_type_t data_type;
-    union {
-        int32_t DINT_val;
-        int16_t INT_val;
-        int8_t SINT_val;
-        float REAL_val;
-    } val;
-} tags[MAX_TAGS];
+/* the samples are copied out of the poller into these, nothing is allocated per sample. */
+int64_t timestamps_us[BATCH_SIZE];
+int32_t tag_indexes[BATCH_SIZE];
+double values[BATCH_SIZE];
 
+char (*tag_names)[MAX_NAME_LEN] = NULL;
 int num_tags = 0;
 
-
-volatile sig_atomic_t terminate = 0;
-
-
-
-int is_comment(const char *line)
-{
-    int i = 0;
-
-    /* scan past the first whitespace */
-    for(i=0; line[i] && isspace(line[i]); i++);
-
-    return (line[i] == '#') ? 1 : 0;
-}
-
-
-
-
-
-char **split_string(const char *str, const char *sep)
-{
-    size_t sub_str_count=0;
-    size_t source_size = 0;
-    size_t result_size = 0;
-    const char *sub;
-    const char *tmp;
-    char **res = NULL;
-
-    /* first, count the sub strings */
-    tmp = str;
-    sub = strstr(tmp, sep);
-
-    while(sub && *sub) {
-        /* separator could be at the front. */
-        if(sub != tmp) {
-            sub_str_count++;
-        }
-
-        tmp = sub + strlen(sep);
-        sub = strstr(tmp,sep);
-    }
-
-    if(tmp && *tmp && (!sub || !*sub)) {
-        sub_str_count++;
-    }
-
-    /* calculate total size for string plus pointers */
-    source_size = strlen(str) + 1;
-    result_size = (sizeof(char *)*(sub_str_count+1)) + source_size;
-
-    /* allocate enough memory */
-    res = malloc(result_size);
-    if(!res) {
-        return NULL;
-    }
-
-    /* calculate the beginning of the string */
-    tmp = (char *)res + (sizeof(char *) * (size_t)(sub_str_count+1));
-
-    /* copy the string into the new buffer past the first part with the array of char pointers. */
-    strcpy((char *)tmp, str);
-
-    /* set up the pointers */
-    sub_str_count=0;
-    sub = strstr(tmp, sep);
-
-    while(sub && *sub) {
-        /* separator could be at the front */
-        if(sub != tmp) {
-            /* store the pointer */
-            res[sub_str_count] = (char *)tmp;
-
-            sub_str_count++;
-        }
-
-        /* zero out the separator chars */
-        memset((char*)sub, 0, strlen(sep));
-
-        /* point past the separator (now zero) */
-        tmp = sub + strlen(sep);
-
-        /* find the next separator */
-        sub = strstr(tmp,sep);
-    }
-
-    /* if there is a chunk at the end, store it. */
-    if(tmp && *tmp && (!sub || !*sub)) {
-        res[sub_str_count] = (char*)tmp;
-    }
-
-    return res;
-}
-
-
 /*
- * line format:
- *
- * <name>\t<type>\t<rpi>\t<tag string>
+ * the poller times are from a monotonic clock.  The first sample is lined
+ * up with the wall clock when it is logged and the rest are offsets from it.
  */
-int process_line(const char *line)
-{
-    char **parts = NULL;
+int64_t first_sample_us = 0;
+int64_t first_sample_epoch_ms = 0;
 
-    parts = split_string(line, "\t");
-    if(!parts) {
-        fprintf(stderr,"Splitting string failed for string %s!", line);
-        return PLCTAG_ERR_BAD_CONFIG;
-    }
-
-    /* make sure we got 4 pieces. */
-    for(int i=0; i < 4; i++) {
-        if(parts[i] == NULL) {
-            fprintf(stderr, "Line does not contain enough parts. Line: %s\n", line);
-            return PLCTAG_ERR_BAD_CONFIG;
-        }
-    }
-
-    tags[num_tags].name = strdup(parts[0]);
-
-    if(strcasecmp("dint",parts[1]) == 0) {
-        tags[num_tags].data_type = DINT;
-    } else if(strcasecmp("int", parts[1]) == 0) {
-        tags[num_tags].data_type = INT;
-    } else if(strcasecmp("sint", parts[1]) == 0) {
-        tags[num_tags].data_type = SINT;
-    } else if(strcasecmp("real", parts[1]) == 0) {
-        tags[num_tags].data_type = REAL;
-    } else {
-        fprintf(stderr, "Unknown data type for %s!\n", parts[1]);
-        return PLCTAG_ERR_BAD_CONFIG;
-    }
 
-    tags[num_tags].rpi = atoi(parts[2]);
-    tags[num_tags].next_read = 0;
-    tags[num_tags].tag_id = plc_tag_create(parts[3], 0); /* create async */
-
-    if(tags[num_tags].tag_id < 0) {
-        fprintf(stderr, "Error, %s, creating tag %s with string %s!\n", plc_tag_decode_error(tags[num_tags].tag_id), tags[num_tags].name, parts[3]);
-        free(parts);
-        return tags[num_tags].tag_id;
-    }
-
-    //printf("Tag %d has name %s, type %s, RPI %d, and tag string %s\n",num_tags, parts[0], parts[1], tags[num_tags].rpi, parts[3]);
-
-    free(parts);
-
-    num_tags++;
+volatile sig_atomic_t terminate = 0;
 
-    return PLCTAG_STATUS_OK;
-}
 
 
-void trim_line(char *line)
+/* read the whole config file into memory. */
+char *read_config(const char *config_filename)
 {
-    int len = 0;
-
-    if(!line || strlen(line) == 0) {
-        return;
-    }
-
-    len = (int)strlen(line);
-
-    while(len>0 && line[len - 1] == '\n') {
-        line[len - 1] = 0;
-        len--;
-    }
-}
-
-
-int read_config(const char *config_filename)
-{
-    int rc = PLCTAG_STATUS_OK;
     FILE *config = NULL;
-    char line[1024] = {0,};
-    int line_num = 0;
-
-//    printf("Reading config file %s.\n", config_filename);
+    char *buf = NULL;
+    long size = 0;
 
     /* open the config file */
     config = fopen(config_filename,"r");
     if(!config) {
         fprintf(stderr,"Unable to open config file %s!\n", config_filename);
-        return PLCTAG_ERR_NOT_FOUND;
+        return NULL;
     }
 
-    /* read all the lines */
-    while (fgets(line, sizeof(line), config)) {
-        line_num++;
-
-        trim_line(line);
+    if(fseek(config, 0, SEEK_END) == 0 && (size = ftell(config)) >= 0 && fseek(config, 0, SEEK_SET) == 0) {
+        buf = calloc(1, (size_t)size + 1);
 
-//        printf("Processing line %d: %s\n", line_num, line);
-
-        /* skip blank lines and comments */
-        if(strlen(line) < 25 || is_comment(line)) {
-            continue;
+        if(buf && fread(buf, 1, (size_t)size, config) != (size_t)size && ferror(config)) {
+            free(buf);
+            buf = NULL;
         }
+    }
 
-        if((rc = process_line(line)) != PLCTAG_STATUS_OK) {
-            fprintf(stderr,"Error, %s, processing config file on line %d!\n", plc_tag_decode_error(rc), line_num);
-            fclose(config);
-            return rc;
-        }
+    if(!buf) {
+        fprintf(stderr,"Unable to read config file %s!\n", config_filename);
     }
 
     fclose(config);
 
-    printf("Read %d tags from the config file.\n", num_tags);
-
-    return rc;
+    return buf;
 }
 
 
@@ -314,11 +136,10 @@ FILE *check_log_file()
 
 
 
-int make_prefix(char *prefix_buf, int prefix_buf_size)
+int make_prefix(int64_t epoch_ms, char *prefix_buf, int prefix_buf_size)
 {
     struct tm t;
     time_t epoch;
-    int64_t epoch_ms;
     int remainder_ms;
     int rc = PLCTAG_STATUS_OK;
 
@@ -330,7 +151,6 @@ int make_prefix(char *prefix_buf, int prefix_buf_size)
     /* build the prefix */
 
     /* get the time parts */
-    epoch_ms = util_time_ms();
     epoch = (time_t)(epoch_ms/1000);
     remainder_ms = (int)(epoch_ms % 1000);
 
@@ -354,7 +174,7 @@ int make_prefix(char *prefix_buf, int prefix_buf_size)
 
 
 
-int log_data()
+int log_data(int num_samples)
 {
     FILE *log = check_log_file();
     char timestamp_buf[128];
@@ -365,42 +185,21 @@ int log_data()
         return PLCTAG_ERR_OPEN;
     }
 
-    rc = make_prefix(timestamp_buf, sizeof(timestamp_buf));
-    if(rc < 0) {
-        fprintf(stderr, "Unable to make prefix, error %s!\n", plc_tag_decode_error(rc));
-        return rc;
+    if(first_sample_epoch_ms == 0) {
+        first_sample_us = timestamps_us[0];
+        first_sample_epoch_ms = util_time_ms();
     }
 
-    for(int tag=0; tag < num_tags; tag++) {
-        /* skip if this tag is not being read. */
-        if(!tags[tag].reading) {
-            continue;
-        }
-
-        fprintf(log,"%s,%s",timestamp_buf, tags[tag].name);
-
-        switch(tags[tag].data_type) {
-        case DINT:
-            fprintf(log,",%d\n",plc_tag_get_int32(tags[tag].tag_id,0));
-            break;
-
-        case INT:
-            fprintf(log,",%d\n",plc_tag_get_int16(tags[tag].tag_id,0));
-            break;
+    for(int i=0; i < num_samples; i++) {
+        int64_t epoch_ms = first_sample_epoch_ms + ((timestamps_us[i] - first_sample_us) / 1000);
 
-        case SINT:
-            fprintf(log,",%d\n",plc_tag_get_int8(tags[tag].tag_id,0));
-            break;
-
-        case REAL:
-            fprintf(log,",%f\n",plc_tag_get_float32(tags[tag].tag_id,0));
-            break;
-
-        default:
-            fprintf(stderr,"Unknown datatype (%d) for tag %d!\n", tags[tag].data_type, tag);
-            return PLCTAG_ERR_BAD_CONFIG;
-            break;
+        rc = make_prefix(epoch_ms, timestamp_buf, sizeof(timestamp_buf));
+        if(rc < 0) {
+            fprintf(stderr, "Unable to make prefix, error %s!\n", plc_tag_decode_error(rc));
+            return rc;
         }
+
+        fprintf(log,"%s,%s,%.15g\n", timestamp_buf, tag_names[tag_indexes[i]], values[i]);
     }
 
     fflush(log);
@@ -410,12 +209,12 @@ int log_data()
 
 
 /* loop while any tag is still in PLCTAG_STATUS_PENDING status */
-int check_tags()
+int check_tags(int32_t poller)
 {
     int rc = PLCTAG_STATUS_OK;
 
     for(int t = 0; t < num_tags; t++) {
-        rc = plc_tag_status(tags[t].tag_id);
+        rc = plc_tag_status(plc_tag_poller_get_tag_id(poller, t));
 
         if(rc != PLCTAG_STATUS_OK) {
             return rc;
@@ -426,46 +225,6 @@ int check_tags()
 }
 
 
-void destroy_tags()
-{
-    for(int t=0; t<num_tags; t++) {
-        if(tags[t].name) {
-            free((char*)tags[t].name);
-            plc_tag_destroy(tags[t].tag_id);
-        }
-    }
-}
-
-
-
-int start_reads()
-{
-    int64_t now = util_time_ms();
-    int rc = PLCTAG_STATUS_OK;
-
-    /* kick off any reads that need to happen */
-    for(int t=0; t<num_tags; t++) {
-        /* trigger a read if the interval is overdue. */
-        if(tags[t].next_read < now) {
-            tags[t].next_read = now + tags[t].rpi;
-
-            tags[t].reading = 1;
-
-            rc = plc_tag_read(tags[t].tag_id, 0);
-            if(rc != PLCTAG_STATUS_PENDING) {
-                fprintf(stderr,"Unable to start reading tag %s!\n", plc_tag_decode_error(rc));
-                destroy_tags();
-                return rc;
-            }
-        } else {
-            /* this tag is not being read. */
-            tags[t].reading = 0;
-        }
-    }
-
-    return PLCTAG_STATUS_OK;
-}
-
 
 void SIGINT_handler(int not_used)
 {
@@ -480,7 +239,7 @@ void usage(void)
     fprintf(stderr, "The config file must contain tab-delimited rows in the following format:\n");
     fprintf(stderr, "\t<name>\\t<type>\\t<rpi>\\t<tag string>\n");
     fprintf(stderr, "\t<name> = a name used when outputting the data.\n");
-    fprintf(stderr, "\t<type> = The type of the tag.  One of 'dint', 'int', 'sint', 'real'.\n");
+    fprintf(stderr, "\t<type> = The type of the tag.  One of 'bool', 'sint', 'usint', 'int', 'uint', 'dint', 'udint', 'lint', 'ulint', 'real' or 'lreal'.\n");
     fprintf(stderr, "\t<rpi> = The number of milliseconds between reads of the tag.\n");
     fprintf(stderr, "\t<tag string> = The tag attribute string for this tag.  E.g.:\n");
     fprintf(stderr, "\t\tprotocol=ab-eip&gateway=10.206.1.40&path=1,4&cpu=lgx&elem_size=4&elem_count=10&name=TestDINTArray[0]\n");
@@ -493,6 +252,8 @@ int main(int argc, char **argv)
 {
     int rc;
     struct sigaction act;
+    int32_t poller = 0;
+    char *config = NULL;
 
     /* check the library version. */
     if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
@@ -501,81 +262,86 @@ int main(int argc, char **argv)
     }
 
     /* set up signal handler first. */
+    memset(&act, 0, sizeof(act));
     act.sa_handler = SIGINT_handler;
     sigaction(SIGINT, &act, NULL);
 
-    memset(&tags, 0, sizeof(tags));
-
     if(argc < 2) {
         usage();
 
         return 1;
     }
 
-    if((rc = read_config(argv[1])) != PLCTAG_STATUS_OK) {
-        fprintf(stderr,"Unable to read config or set up tags. %s!\n", plc_tag_decode_error(rc));
-        destroy_tags();
+    if((config = read_config(argv[1])) == NULL) {
         return 1;
     }
 
-    /* wait for all tags to be ready */
-    while((rc = check_tags()) == PLCTAG_STATUS_PENDING) {
-        util_sleep_ms(1);
-    }
-
-    if(rc != PLCTAG_STATUS_OK) {
-        fprintf(stderr, "Error waiting for tags to finish being set up, %s!\n", plc_tag_decode_error(rc));
-        destroy_tags();
+    /* the poller groups the tags by PLC and RPI and reads them in the background. */
+    poller = plc_tag_poller_create(0);
+    if(poller < 0) {
+        fprintf(stderr, "Unable to create poller, %s!\n", plc_tag_decode_error(poller));
+        free(config);
         return 1;
     }
 
-    while(!terminate) {
-        int num_tags_read = 0;
-        int64_t start, end;
+    num_tags = plc_tag_poller_load(poller, config);
+    free(config);
 
-        start = util_time_ms();
+    if(num_tags < 0) {
+        fprintf(stderr,"Unable to read config or set up tags. %s!\n", plc_tag_decode_error(num_tags));
+        plc_tag_poller_destroy(poller);
+        return 1;
+    }
 
-        rc = start_reads();
+    printf("Read %d tags from the config file into %d groups.\n", num_tags, plc_tag_poller_get_int_attribute(poller, "num_groups", 0));
 
-        if(rc == PLCTAG_STATUS_OK) {
-            /* reads kicked off successfully */
+    tag_names = calloc((size_t)num_tags + 1, sizeof(*tag_names));
+    if(!tag_names) {
+        fprintf(stderr, "Unable to allocate tag names!\n");
+        plc_tag_poller_destroy(poller);
+        return 1;
+    }
 
-            /* wait for the reads to complete */
-            while((rc = check_tags()) == PLCTAG_STATUS_PENDING) {
-                util_sleep_ms(1);
-            }
+    for(int t=0; t < num_tags; t++) {
+        plc_tag_poller_get_tag_name(poller, t, tag_names[t], MAX_NAME_LEN);
+    }
 
-            end = util_time_ms();
+    /* wait for all tags to be ready */
+    while((rc = check_tags(poller)) == PLCTAG_STATUS_PENDING) {
+        util_sleep_ms(1);
+    }
 
-            if(rc == PLCTAG_STATUS_OK) {
-                /* tags are ready. */
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Error waiting for tags to finish being set up, %s!\n", plc_tag_decode_error(rc));
+        plc_tag_poller_destroy(poller);
+        free(tag_names);
+        return 1;
+    }
 
-                for(int t=0; t<num_tags; t++) {
-                    if(tags[t].reading) {
-                        num_tags_read++;
-                    }
-                }
+    while(!terminate) {
+        int num_samples = plc_tag_poller_read(poller, timestamps_us, tag_indexes, values, BATCH_SIZE);
 
-                if(num_tags_read > 0) {
-                    printf("Read %d tags in %dms\n", num_tags_read, (int)(end-start));
-                }
+        if(num_samples < 0) {
+            fprintf(stderr, "Error reading samples, %s!\n", plc_tag_decode_error(num_samples));
+            break;
+        }
 
-                rc = log_data();
-            }
+        if(num_samples > 0 && log_data(num_samples) != PLCTAG_STATUS_OK) {
+            break;
         }
 
-        if(rc != PLCTAG_STATUS_OK) {
-            /* delay a long delay to let the library reconnect. */
-            util_sleep_ms(RECONNECT_DELAY_MS);
-        } else {
-            /* delay a tiny bit. */
-            util_sleep_ms(1);
+        /* only wait if we emptied the rings. */
+        if(num_samples < BATCH_SIZE) {
+            util_sleep_ms(POLL_DELAY_MS);
         }
     }
 
-    printf("Terminating!\n");
+    printf("Terminating!  %d samples overrun, %d reads failed.\n",
+           plc_tag_poller_get_int_attribute(poller, "overruns", 0),
+           plc_tag_poller_get_int_attribute(poller, "read_errors", 0));
 
-    destroy_tags();
+    plc_tag_poller_destroy(poller);
+    free(tag_names);
 
     return 0;
 }
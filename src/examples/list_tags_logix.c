@@ -43,6 +43,7 @@
 
 #define TAG_STRING_SIZE (200)
 #define TAG_STRING_TEMPLATE "protocol=ab-eip&gateway=%s&path=%s&plc=ControlLogix&name="
+#define TAG_STRING_CACHE_TEMPLATE "protocol=ab-eip&gateway=%s&path=%s&plc=ControlLogix&udt_cache_file=%s&name="
 #define TIMEOUT_MS 5000
 
 
@@ -378,7 +379,7 @@ int main(int argc, char **argv)
 
 void usage()
 {
-    fprintf(stderr, "Usage: list_tags <PLC IP> <PLC path>\nExample: list_tags 10.1.2.3 1,0\n");
+    fprintf(stderr, "Usage: list_tags <PLC IP> <PLC path> [<UDT cache file>]\nExample: list_tags 10.1.2.3 1,0 udt_cache.bin\n");
     exit(1);
 }
 
@@ -406,8 +407,12 @@ char *setup_tag_string(int argc, char **argv)
 
     path = argv[2];
 
-    /* build the tag string. */
-    snprintf(tag_string, TAG_STRING_SIZE, TAG_STRING_TEMPLATE, gateway, path);
+    /* build the tag string, keeping UDT definitions in a file if one is given. */
+    if(argc > 3 && argv[3] && strlen(argv[3]) > 0) {
+        snprintf(tag_string, TAG_STRING_SIZE, TAG_STRING_CACHE_TEMPLATE, gateway, path, argv[3]);
+    } else {
+        snprintf(tag_string, TAG_STRING_SIZE, TAG_STRING_TEMPLATE, gateway, path);
+    }
 
     /* FIXME - check size! */
     if(debug_level >= PLCTAG_DEBUG_INFO) fprintf(stderr,  "Using tag string \"%s\".\n", tag_string);
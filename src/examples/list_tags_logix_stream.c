@@ -0,0 +1,138 @@
+/***************************************************************************
+ *   Copyright (C) 2021 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * List the controller tags of a Logix PLC as the pages arrive, without
+ * waiting for the whole symbol table.  An optional name prefix filters
+ * the tags in the library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_STRING_SIZE (200)
+#define TAG_STRING_TEMPLATE "protocol=ab-eip&gateway=%s&path=%s&plc=ControlLogix&name=@tags"
+#define TAG_STRING_PREFIX_TEMPLATE "protocol=ab-eip&gateway=%s&path=%s&plc=ControlLogix&listing_prefix=%s&name=@tags"
+#define TIMEOUT_MS 30000
+
+
+static int total_tags = 0;
+static int total_pages = 0;
+
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: list_tags_logix_stream <PLC IP> <PLC path> [<name prefix>]\nExample: list_tags_logix_stream 10.1.2.3 1,0 Motor\n");
+    exit(1);
+}
+
+
+
+static void listing_callback(int32_t tag_id, const plc_tag_listing_entry_t *entries, int num_entries, void *userdata)
+{
+    (void)tag_id;
+    (void)userdata;
+
+    total_pages++;
+
+    for(int i=0; i < num_entries; i++) {
+        printf("%s (instance %u) type %04x, %u byte elements", entries[i].name, entries[i].instance_id, entries[i].symbol_type, entries[i].elem_size);
+
+        for(int dim=0; dim < entries[i].num_dimensions; dim++) {
+            printf("%s%u", (dim == 0 ? " [" : ","), entries[i].dimensions[dim]);
+        }
+
+        printf("%s\n", (entries[i].num_dimensions > 0 ? "]" : ""));
+    }
+
+    total_tags += num_entries;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    char tag_string[TAG_STRING_SIZE+1] = {0};
+    int32_t tag = 0;
+    int rc = PLCTAG_STATUS_OK;
+    int64_t start = 0;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!\n", REQUIRED_VERSION);
+        return 1;
+    }
+
+    if(argc < 3 || strlen(argv[1]) == 0 || strlen(argv[2]) == 0) {
+        usage();
+    }
+
+    if(argc > 3 && strlen(argv[3]) > 0) {
+        snprintf(tag_string, TAG_STRING_SIZE, TAG_STRING_PREFIX_TEMPLATE, argv[1], argv[2], argv[3]);
+    } else {
+        snprintf(tag_string, TAG_STRING_SIZE, TAG_STRING_TEMPLATE, argv[1], argv[2]);
+    }
+
+    tag = plc_tag_create(tag_string, TIMEOUT_MS);
+    if(tag < 0) {
+        fprintf(stderr, "Unable to create listing tag, error %s!\n", plc_tag_decode_error(tag));
+        return 1;
+    }
+
+    rc = plc_tag_register_listing_callback(tag, listing_callback, NULL);
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Unable to register the listing callback, error %s!\n", plc_tag_decode_error(rc));
+        plc_tag_destroy(tag);
+        return 1;
+    }
+
+    start = util_time_ms();
+
+    rc = plc_tag_read(tag, TIMEOUT_MS);
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Unable to list the tags, error %s!\n", plc_tag_decode_error(rc));
+        plc_tag_destroy(tag);
+        return 1;
+    }
+
+    printf("Listed %d tags in %d pages in %dms.\n", total_tags, total_pages, (int)(util_time_ms() - start));
+
+    plc_tag_destroy(tag);
+
+    return 0;
+}
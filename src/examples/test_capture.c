@@ -0,0 +1,277 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+/*
+ * Check wire captures against ab_server:
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ *
+ * Writes and reads some values with a capture running, then checks that
+ * the capture file is a pcap file with whole EIP packets in each frame.
+ *
+ * The capture can be played back.  Run this against ab_server first,
+ * then start the server again with only the recording:
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --replay=test_capture.pcap
+ *
+ * and run this again with a different file name as the argument.  It
+ * passes because every read gets the response that was recorded for it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=10&name=TestBigArray"
+#define DEFAULT_FILE "test_capture.pcap"
+#define DATA_TIMEOUT 5000
+#define NUM_ROUNDS (10)
+#define ELEM_COUNT (10)
+#define ELEM_SIZE (4)
+#define EIP_PORT (44818)
+#define MAX_FRAME_SIZE (65535)
+
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | (uint16_t)p[1]);
+}
+
+
+static int check_api(const char *file_name)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    if((rc = plc_tag_capture_start("")) != PLCTAG_ERR_BAD_PARAM) {
+        fprintf(stderr, "ERROR: Starting a capture without a file name returned %s!\n", plc_tag_decode_error(rc));
+        return 0;
+    }
+
+    if((rc = plc_tag_capture_start(file_name)) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR: Unable to start the capture, %s!\n", plc_tag_decode_error(rc));
+        return 0;
+    }
+
+    if((rc = plc_tag_capture_start(file_name)) != PLCTAG_ERR_BUSY) {
+        fprintf(stderr, "ERROR: Starting a second capture returned %s!\n", plc_tag_decode_error(rc));
+        return 0;
+    }
+
+    return 1;
+}
+
+
+static int run_traffic(int64_t *read_time_ms)
+{
+    int32_t tag = plc_tag_create(TAG_ATTRIBS, DATA_TIMEOUT);
+    int rc = PLCTAG_STATUS_OK;
+    int ok = 1;
+
+    if(tag < 0) {
+        fprintf(stderr, "ERROR: Unable to create the tag, %s!\n", plc_tag_decode_error(tag));
+        return 0;
+    }
+
+    *read_time_ms = 0;
+
+    for(int round = 1; round <= NUM_ROUNDS && ok; round++) {
+        int64_t start = 0;
+
+        for(int i=0; i < ELEM_COUNT; i++) {
+            plc_tag_set_int32(tag, i * ELEM_SIZE, (round * 100) + i);
+        }
+
+        if((rc = plc_tag_write(tag, DATA_TIMEOUT)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Write %d failed, %s!\n", round, plc_tag_decode_error(rc));
+            ok = 0;
+            break;
+        }
+
+        start = util_time_ms();
+
+        if((rc = plc_tag_read(tag, DATA_TIMEOUT)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Read %d failed, %s!\n", round, plc_tag_decode_error(rc));
+            ok = 0;
+            break;
+        }
+
+        *read_time_ms += util_time_ms() - start;
+
+        for(int i=0; i < ELEM_COUNT; i++) {
+            int32_t val = plc_tag_get_int32(tag, i * ELEM_SIZE);
+
+            if(val != (round * 100) + i) {
+                fprintf(stderr, "ERROR: Round %d element %d is %d, expected %d!\n", round, i, val, (round * 100) + i);
+                ok = 0;
+                break;
+            }
+        }
+    }
+
+    plc_tag_destroy(tag);
+
+    return ok;
+}
+
+
+/* every frame must be one IPv4/TCP packet holding exactly one EIP packet. */
+static int check_file(const char *file_name)
+{
+    FILE *file = fopen(file_name, "rb");
+    uint8_t header[24];
+    uint8_t record[16];
+    static uint8_t frame[MAX_FRAME_SIZE];
+    int to_server = 0;
+    int from_server = 0;
+    int ok = 1;
+
+    if(!file) {
+        fprintf(stderr, "ERROR: Unable to open capture file %s!\n", file_name);
+        return 0;
+    }
+
+    if(fread(header, 1, sizeof(header), file) != sizeof(header) || get_le32(header) != 0xA1B2C3D4 || get_le32(header + 20) != 101) {
+        fprintf(stderr, "ERROR: Capture file does not start with a pcap header for raw IP!\n");
+        fclose(file);
+        return 0;
+    }
+
+    while(ok && fread(record, 1, sizeof(record), file) == sizeof(record)) {
+        uint32_t incl_len = get_le32(record + 8);
+        uint32_t orig_len = get_le32(record + 12);
+        uint16_t eip_len = 0;
+
+        if(incl_len != orig_len || incl_len < 40 + 24 || incl_len > MAX_FRAME_SIZE || fread(frame, 1, incl_len, file) != incl_len) {
+            fprintf(stderr, "ERROR: Bad frame of %u bytes in the capture!\n", (unsigned int)incl_len);
+            ok = 0;
+            break;
+        }
+
+        eip_len = (uint16_t)(frame[40 + 2] | (frame[40 + 3] << 8));
+
+        if(frame[0] != 0x45 || frame[9] != 6 || get_be16(frame + 2) != incl_len || incl_len != 40u + 24u + eip_len) {
+            fprintf(stderr, "ERROR: Frame is not a TCP packet with a whole EIP packet!\n");
+            ok = 0;
+            break;
+        }
+
+        if(get_be16(frame + 20 + 2) == EIP_PORT) {
+            to_server++;
+        } else if(get_be16(frame + 20) == EIP_PORT) {
+            from_server++;
+        } else {
+            fprintf(stderr, "ERROR: Frame does not use the EIP port!\n");
+            ok = 0;
+        }
+    }
+
+    fclose(file);
+
+    /* a write and a read each round. */
+    if(ok && (to_server < NUM_ROUNDS * 2 || from_server < NUM_ROUNDS * 2)) {
+        fprintf(stderr, "ERROR: Only %d frames to and %d frames from the PLC were captured!\n", to_server, from_server);
+        ok = 0;
+    }
+
+    if(ok) {
+        fprintf(stderr, "Captured %d frames to and %d frames from the PLC.\n", to_server, from_server);
+    }
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *file_name = (argc > 1 ? argv[1] : DEFAULT_FILE);
+    int64_t read_time_ms = 0;
+    int rc = PLCTAG_STATUS_OK;
+    int ok = 0;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    plc_tag_set_debug_level(PLCTAG_DEBUG_WARN);
+
+    do {
+        if(!check_api(file_name)) {
+            break;
+        }
+
+        if(!run_traffic(&read_time_ms)) {
+            break;
+        }
+
+        if((rc = plc_tag_capture_stop()) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Unable to stop the capture, %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        if((rc = plc_tag_capture_stop()) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Stopping a stopped capture returned %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        if(!check_file(file_name)) {
+            break;
+        }
+
+        fprintf(stderr, "%d reads took %dms.\n", NUM_ROUNDS, (int)read_time_ms);
+
+        ok = 1;
+    } while(0);
+
+    plc_tag_capture_stop();
+
+    if(!ok) {
+        return 1;
+    }
+
+    fprintf(stderr, "Done.\n");
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Keep several requests in flight to a PLC behind a DH+ bridge.  All the
+ * writes and then all the reads are started at once so that the session
+ * sends them without waiting for each response.  Each element has its own
+ * value, so a response matched to the wrong request shows up as bad data.
+ *
+ * Run against: ab_server --plc=SLC500 --dhp=A:5 --tag=N7[10]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=A:1:5&plc=%s&dhp_max_requests_in_flight=4&elem_count=1&name=N7:%d"
+#define NUM_TAGS (8)
+#define NUM_ROUNDS (5)
+#define DATA_TIMEOUT 5000
+
+
+static int wait_for_all(int32_t *tags, int num_tags)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int64_t timeout_time = util_time_ms() + DATA_TIMEOUT;
+
+    do {
+        rc = PLCTAG_STATUS_OK;
+
+        for(int i=0; i < num_tags; i++) {
+            int status = plc_tag_status(tags[i]);
+
+            if(status == PLCTAG_STATUS_PENDING) {
+                rc = PLCTAG_STATUS_PENDING;
+            } else if(status != PLCTAG_STATUS_OK) {
+                fprintf(stderr, "ERROR %s: Operation on N7:%d failed!\n", plc_tag_decode_error(status), i);
+                return status;
+            }
+        }
+
+        if(rc == PLCTAG_STATUS_PENDING) {
+            util_sleep_ms(1);
+        }
+    } while(rc == PLCTAG_STATUS_PENDING && util_time_ms() < timeout_time);
+
+    if(rc == PLCTAG_STATUS_PENDING) {
+        fprintf(stderr, "ERROR: Timed out waiting for the tags!\n");
+        return PLCTAG_ERR_TIMEOUT;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+static int run_round(int32_t *tags, int base_value)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    /* start all the writes. */
+    for(int i=0; i < NUM_TAGS; i++) {
+        plc_tag_set_int16(tags[i], 0, (int16_t)(base_value + i));
+
+        rc = plc_tag_write(tags[i], 0);
+        if(rc != PLCTAG_STATUS_PENDING && rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Unable to start write of N7:%d!\n", plc_tag_decode_error(rc), i);
+            return rc;
+        }
+    }
+
+    rc = wait_for_all(tags, NUM_TAGS);
+    if(rc != PLCTAG_STATUS_OK) {
+        return rc;
+    }
+
+    /* clear the local values and start all the reads. */
+    for(int i=0; i < NUM_TAGS; i++) {
+        plc_tag_set_int16(tags[i], 0, 0);
+
+        rc = plc_tag_read(tags[i], 0);
+        if(rc != PLCTAG_STATUS_PENDING && rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Unable to start read of N7:%d!\n", plc_tag_decode_error(rc), i);
+            return rc;
+        }
+    }
+
+    rc = wait_for_all(tags, NUM_TAGS);
+    if(rc != PLCTAG_STATUS_OK) {
+        return rc;
+    }
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        int16_t val = plc_tag_get_int16(tags[i], 0);
+
+        if(val != (int16_t)(base_value + i)) {
+            fprintf(stderr, "ERROR: Expected %d in N7:%d but got %d!\n", base_value + i, i, val);
+            rc = PLCTAG_ERR_BAD_DATA;
+        }
+    }
+
+    return rc;
+}
+
+
+int main(int argc, char **argv)
+{
+    int32_t tags[NUM_TAGS] = {0};
+    const char *plc = (argc > 1 ? argv[1] : "slc500");
+    int rc = PLCTAG_STATUS_OK;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        char attribs[200];
+
+        snprintf(attribs, sizeof(attribs), TAG_ATTRIBS, plc, i);
+
+        tags[i] = plc_tag_create(attribs, DATA_TIMEOUT);
+        if(tags[i] < 0) {
+            fprintf(stderr, "ERROR %s: Could not create tag %s!\n", plc_tag_decode_error(tags[i]), attribs);
+            plc_tag_shutdown();
+            return 1;
+        }
+    }
+
+    for(int round=0; round < NUM_ROUNDS && rc == PLCTAG_STATUS_OK; round++) {
+        fprintf(stderr, "Round %d: writing and reading %d elements of N7 at once.\n", round, NUM_TAGS);
+
+        rc = run_round(tags, (round + 1) * 100);
+    }
+
+    plc_tag_shutdown();
+
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR: Test failed with %s!\n", plc_tag_decode_error(rc));
+        return 1;
+    }
+
+    fprintf(stderr, "Test passed.\n");
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+
+
+
+/*
+ * Hammer the lock-free getters of a double-buffered tag from a second
+ * thread while the main thread changes the data with setters and with
+ * fragmented reads.  Every change writes the same value into all the
+ * elements, so every snapshot the getter returns must have all elements
+ * equal.  Last, setters are called between the fragments of reads.  They
+ * must not publish the half finished read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define ELEM_COUNT (1000)
+#define DB_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1000&name=TestBigArray[1000]&double_buffer=1"
+#define WRITE_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1000&name=TestBigArray[1000]"
+#define DATA_TIMEOUT 5000
+#define NUM_SETS (2000)
+#define NUM_READS (10)
+#define NUM_MID_READ_SETS (5)
+#define MAX_MID_READ_TRIES (200)
+
+static int32_t db_tag = 0;
+static volatile int done = 0;
+static volatile int failed = 0;
+static volatile int snapshots = 0;
+
+
+static void *check_snapshots(void *arg)
+{
+    uint8_t buf[ELEM_COUNT * 4];
+
+    (void)arg;
+
+    while(!done && !failed) {
+        if(plc_tag_get_raw_bytes(db_tag, 0, buf, (int)sizeof(buf)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Could not get the tag data!\n");
+            failed = 1;
+            break;
+        }
+
+        for(int elem=1; elem < ELEM_COUNT; elem++) {
+            if(memcmp(&buf[0], &buf[elem * 4], 4) != 0) {
+                fprintf(stderr, "ERROR: Element %d does not match element 0 in a snapshot!\n", elem);
+                failed = 1;
+                break;
+            }
+        }
+
+        snapshots++;
+    }
+
+    return NULL;
+}
+
+
+static int fill(int32_t tag, int32_t val)
+{
+    uint8_t buf[ELEM_COUNT * 4];
+
+    for(int elem=0; elem < ELEM_COUNT; elem++) {
+        buf[elem * 4 + 0] = (uint8_t)((uint32_t)val & 0xFF);
+        buf[elem * 4 + 1] = (uint8_t)(((uint32_t)val >> 8) & 0xFF);
+        buf[elem * 4 + 2] = (uint8_t)(((uint32_t)val >> 16) & 0xFF);
+        buf[elem * 4 + 3] = (uint8_t)(((uint32_t)val >> 24) & 0xFF);
+    }
+
+    return plc_tag_set_raw_bytes(tag, 0, buf, (int)sizeof(buf));
+}
+
+
+/*
+ * Start a read and stop it between two fragments by holding a view, then
+ * set the last element to the value being read.  The published copy must
+ * still have all elements equal while the read is stopped.  Returns 1 if
+ * the setter was called part way through the read, 0 if the read finished
+ * too fast to catch it and -1 on an error.
+ */
+static int set_during_read(int32_t val)
+{
+    const uint8_t *data = NULL;
+    int size = 0;
+    uint32_t seq = 0;
+    uint32_t view_seq = 0;
+    int64_t timeout = 0;
+    int caught = 0;
+    int rc = PLCTAG_STATUS_OK;
+
+    rc = plc_tag_read(db_tag, 0);
+    if(rc != PLCTAG_STATUS_PENDING && rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR %s: Could not start the read!\n", plc_tag_decode_error(rc));
+        return -1;
+    }
+
+    /* the sequence number is odd once the first fragment is in. */
+    timeout = util_time_ms() + DATA_TIMEOUT;
+    do {
+        plc_tag_get_data_seq(db_tag, &seq);
+    } while(!(seq & 1) && plc_tag_status(db_tag) == PLCTAG_STATUS_PENDING && util_time_ms() < timeout);
+
+    /* holding the view keeps the library from copying in the rest of the read. */
+    if((seq & 1) && plc_tag_view_acquire(db_tag, &data, &size, &view_seq) == PLCTAG_STATUS_OK) {
+        if(view_seq & 1) {
+            uint8_t buf[ELEM_COUNT * 4];
+
+            caught = 1;
+
+            plc_tag_set_int32(db_tag, (ELEM_COUNT - 1) * 4, val);
+
+            plc_tag_get_data_seq(db_tag, &seq);
+            if(seq != view_seq) {
+                fprintf(stderr, "ERROR: A setter ended the read's change, sequence %u went to %u!\n", view_seq, seq);
+                failed = 1;
+            }
+
+            if(plc_tag_get_raw_bytes(db_tag, 0, buf, (int)sizeof(buf)) != PLCTAG_STATUS_OK || memcmp(&buf[0], &buf[(ELEM_COUNT - 1) * 4], 4) != 0) {
+                fprintf(stderr, "ERROR: A setter published a half finished read!\n");
+                failed = 1;
+            }
+        }
+
+        plc_tag_view_release(db_tag);
+    }
+
+    timeout = util_time_ms() + DATA_TIMEOUT;
+    while((rc = plc_tag_status(db_tag)) == PLCTAG_STATUS_PENDING && util_time_ms() < timeout) {
+        util_sleep_ms(1);
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR %s: The read did not finish!\n", plc_tag_decode_error(rc));
+        return -1;
+    }
+
+    if(plc_tag_get_int32(db_tag, 0) != val || plc_tag_get_int32(db_tag, (ELEM_COUNT - 1) * 4) != val) {
+        fprintf(stderr, "ERROR: Getter did not see the value %d read!\n", val);
+        failed = 1;
+    }
+
+    return (failed ? -1 : caught);
+}
+
+
+int main(void)
+{
+    int32_t write_tag = 0;
+    pthread_t checker;
+    int rc = PLCTAG_STATUS_OK;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    write_tag = plc_tag_create(WRITE_ATTRIBS, DATA_TIMEOUT);
+    db_tag = plc_tag_create(DB_ATTRIBS, DATA_TIMEOUT);
+    if(write_tag < 0 || db_tag < 0) {
+        fprintf(stderr, "ERROR: Could not create tags!\n");
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    if(plc_tag_get_int_attribute(db_tag, "double_buffer", 0) != 1 || plc_tag_get_int_attribute(write_tag, "double_buffer", 1) != 0) {
+        fprintf(stderr, "ERROR: Wrong double_buffer attribute!\n");
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    /* start from data with all elements equal. */
+    fill(db_tag, 0);
+
+    pthread_create(&checker, NULL, &check_snapshots, NULL);
+
+    /* setters publish the new data when they return. */
+    for(int32_t i=1; i <= NUM_SETS && !failed; i++) {
+        fill(db_tag, i);
+
+        if(plc_tag_get_int32(db_tag, (ELEM_COUNT - 1) * 4) != i) {
+            fprintf(stderr, "ERROR: Getter did not see the value %d set!\n", i);
+            failed = 1;
+        }
+    }
+
+    /* reads publish the new data when the last fragment is in. */
+    for(int32_t i=1; i <= NUM_READS && !failed; i++) {
+        fill(write_tag, NUM_SETS + i);
+
+        rc = plc_tag_write(write_tag, DATA_TIMEOUT);
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Could not write value %d!\n", plc_tag_decode_error(rc), NUM_SETS + i);
+            break;
+        }
+
+        rc = plc_tag_read(db_tag, DATA_TIMEOUT);
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Could not read the tag!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        if(plc_tag_get_int32(db_tag, 0) != NUM_SETS + i) {
+            fprintf(stderr, "ERROR: Getter did not see the value %d read!\n", NUM_SETS + i);
+            failed = 1;
+        }
+    }
+
+    /* setters between the fragments of a read do not publish it. */
+    for(int32_t i=1, caught=0, tries=0; caught < NUM_MID_READ_SETS && rc == PLCTAG_STATUS_OK && !failed; i++) {
+        int32_t val = NUM_SETS + NUM_READS + i;
+        int res = 0;
+
+        if(++tries > MAX_MID_READ_TRIES) {
+            fprintf(stderr, "ERROR: Only caught %d of %d reads part way through!\n", caught, NUM_MID_READ_SETS);
+            failed = 1;
+            break;
+        }
+
+        fill(write_tag, val);
+
+        rc = plc_tag_write(write_tag, DATA_TIMEOUT);
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Could not write value %d!\n", plc_tag_decode_error(rc), val);
+            break;
+        }
+
+        res = set_during_read(val);
+        if(res < 0) {
+            failed = 1;
+        } else {
+            caught += res;
+        }
+    }
+
+    done = 1;
+    pthread_join(checker, NULL);
+
+    fprintf(stderr, "%d snapshots checked.\n", snapshots);
+
+    plc_tag_shutdown();
+
+    return ((rc == PLCTAG_STATUS_OK && !failed && snapshots > 0) ? 0 : 1);
+}
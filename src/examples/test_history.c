@@ -0,0 +1,257 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Check tag read histories against ab_server:
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ *
+ * An automatically read tag keeps every value written while nobody looks
+ * at it, in order and with increasing receive times.  Synchronous reads
+ * add one entry each and a small ring drops the oldest entries.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1&name=TestBigArray[0]"
+#define DATA_TIMEOUT 5000
+#define RPI_MS (20)
+#define NUM_VALUES (10)
+#define HISTORY_SIZE (128)
+#define SMALL_HISTORY (4)
+#define BATCH_SIZE (8)
+#define ELEM_SIZE (4)
+
+static int64_t timestamps[HISTORY_SIZE];
+static int statuses[HISTORY_SIZE];
+static uint8_t data[HISTORY_SIZE * ELEM_SIZE];
+
+
+static int32_t get_dint(int index)
+{
+    const uint8_t *p = data + (index * ELEM_SIZE);
+
+    return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+
+/* drain in small batches to check that the ring picks up where it left off. */
+static int drain(int32_t tag)
+{
+    int total = 0;
+    int rc = 0;
+
+    do {
+        rc = plc_tag_history_read(tag, timestamps + total, statuses + total, data + (total * ELEM_SIZE), ELEM_SIZE, BATCH_SIZE);
+
+        if(rc > 0) {
+            total += rc;
+        }
+    } while(rc == BATCH_SIZE && total + BATCH_SIZE <= HISTORY_SIZE);
+
+    return (rc < 0 ? rc : total);
+}
+
+
+static int check_auto_read_history(int32_t tag, int32_t write_tag)
+{
+    int num_entries = 0;
+    int32_t last_val = 0;
+    int next_expected = 1;
+    int rc = PLCTAG_STATUS_OK;
+
+    /* start from a known value and an empty history. */
+    plc_tag_set_int32(write_tag, 0, 0);
+    plc_tag_write(write_tag, DATA_TIMEOUT);
+    util_sleep_ms(RPI_MS * 5);
+    drain(tag);
+
+    for(int32_t val = 1; val <= NUM_VALUES; val++) {
+        plc_tag_set_int32(write_tag, 0, val);
+
+        if((rc = plc_tag_write(write_tag, DATA_TIMEOUT)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Unable to write %d, %s!\n", val, plc_tag_decode_error(rc));
+            return 0;
+        }
+
+        /* long enough for a few reads of each value. */
+        util_sleep_ms(RPI_MS * 4);
+    }
+
+    util_sleep_ms(RPI_MS * 4);
+
+    num_entries = drain(tag);
+    if(num_entries <= 0) {
+        fprintf(stderr, "ERROR: Draining the history returned %s!\n", plc_tag_decode_error(num_entries));
+        return 0;
+    }
+
+    for(int i=0; i < num_entries; i++) {
+        int32_t val = get_dint(i);
+
+        if(statuses[i] != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Entry %d has status %s!\n", i, plc_tag_decode_error(statuses[i]));
+            return 0;
+        }
+
+        if(i > 0 && timestamps[i] < timestamps[i - 1]) {
+            fprintf(stderr, "ERROR: Entry %d is older than the entry before it!\n", i);
+            return 0;
+        }
+
+        /* each value shows up in order, some reads may see the old value. */
+        if(val != last_val) {
+            if(val != next_expected) {
+                fprintf(stderr, "ERROR: Entry %d has value %d, expected %d!\n", i, val, next_expected);
+                return 0;
+            }
+
+            next_expected++;
+            last_val = val;
+        }
+    }
+
+    if(next_expected != NUM_VALUES + 1) {
+        fprintf(stderr, "ERROR: Only saw values up to %d!\n", next_expected - 1);
+        return 0;
+    }
+
+    fprintf(stderr, "%d history entries over %dus held all %d values.\n", num_entries, (int)(timestamps[num_entries - 1] - timestamps[0]), NUM_VALUES);
+
+    return 1;
+}
+
+
+int main(void)
+{
+    int32_t tag = 0;
+    int32_t write_tag = 0;
+    int32_t sync_tag = 0;
+    int32_t small_tag = 0;
+    int rc = PLCTAG_STATUS_OK;
+    int ok = 0;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    plc_tag_set_debug_level(PLCTAG_DEBUG_WARN);
+
+    do {
+        write_tag = plc_tag_create(TAG_ATTRIBS, DATA_TIMEOUT);
+        tag = plc_tag_create(TAG_ATTRIBS "&history=128&auto_sync_read_ms=20", DATA_TIMEOUT);
+        sync_tag = plc_tag_create(TAG_ATTRIBS "&history=8", DATA_TIMEOUT);
+        small_tag = plc_tag_create(TAG_ATTRIBS "&history=4&auto_sync_read_ms=10", DATA_TIMEOUT);
+
+        if(write_tag < 0 || tag < 0 || sync_tag < 0 || small_tag < 0) {
+            fprintf(stderr, "ERROR: Unable to create the tags!\n");
+            break;
+        }
+
+        if(plc_tag_get_int_attribute(tag, "history", 0) != HISTORY_SIZE || plc_tag_get_int_attribute(write_tag, "history", -1) != 0) {
+            fprintf(stderr, "ERROR: Wrong history sizes!\n");
+            break;
+        }
+
+        if((rc = plc_tag_history_read(write_tag, timestamps, statuses, NULL, 0, 1)) != PLCTAG_ERR_UNSUPPORTED) {
+            fprintf(stderr, "ERROR: Reading the history of a tag without one returned %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        if(!check_auto_read_history(tag, write_tag)) {
+            break;
+        }
+
+        /* a synchronous read raises completion twice, but is only one entry. */
+        drain(sync_tag);
+
+        for(int i=0; i < 3; i++) {
+            if((rc = plc_tag_read(sync_tag, DATA_TIMEOUT)) != PLCTAG_STATUS_OK) {
+                fprintf(stderr, "ERROR: Unable to read the synchronous tag, %s!\n", plc_tag_decode_error(rc));
+                break;
+            }
+        }
+
+        if(rc != PLCTAG_STATUS_OK) {
+            break;
+        }
+
+        if(plc_tag_get_int_attribute(sync_tag, "history_count", 0) != 3) {
+            fprintf(stderr, "ERROR: Three synchronous reads left %d entries!\n", plc_tag_get_int_attribute(sync_tag, "history_count", 0));
+            break;
+        }
+
+        if((rc = plc_tag_history_read(sync_tag, timestamps, statuses, data, 2, HISTORY_SIZE)) != PLCTAG_ERR_TOO_SMALL) {
+            fprintf(stderr, "ERROR: Reading into too small entries returned %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        /* only the times and statuses. */
+        if((rc = plc_tag_history_read(sync_tag, timestamps, statuses, NULL, 0, HISTORY_SIZE)) != 3) {
+            fprintf(stderr, "ERROR: Reading only times and statuses returned %d!\n", rc);
+            break;
+        }
+
+        /* a small ring keeps the newest entries. */
+        if(plc_tag_get_int_attribute(small_tag, "history_count", 0) != SMALL_HISTORY || plc_tag_get_int_attribute(small_tag, "history_overruns", 0) <= 0) {
+            fprintf(stderr, "ERROR: Small history has %d entries and %d overruns!\n",
+                    plc_tag_get_int_attribute(small_tag, "history_count", 0), plc_tag_get_int_attribute(small_tag, "history_overruns", 0));
+            break;
+        }
+
+        fprintf(stderr, "Small history overran %d times.\n", plc_tag_get_int_attribute(small_tag, "history_overruns", 0));
+
+        ok = 1;
+    } while(0);
+
+    plc_tag_destroy(small_tag);
+    plc_tag_destroy(sync_tag);
+    plc_tag_destroy(tag);
+    plc_tag_destroy(write_tag);
+
+    if(!ok) {
+        return 1;
+    }
+
+    fprintf(stderr, "Done.\n");
+
+    return 0;
+}
@@ -0,0 +1,297 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Check shared memory tag images against ab_server:
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ *
+ * The publisher and the reader are in the same process here, but the
+ * reader maps the segment separately, just as another process would.
+ * Every snapshot of a four element block that is rewritten while it is
+ * read must have all four elements from the same write.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_BASE "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&name=TestBigArray[0]&elem_count="
+#define IMAGE_NAME "/plctag_test_image"
+#define DATA_TIMEOUT 5000
+#define RPI_MS (20)
+#define MAX_TAGS (4)
+#define MAX_DATA_SIZE (16)
+#define BLOCK_ELEMS (4)
+#define NUM_WRITES (20)
+
+
+static int write_block(int32_t write_tag, int32_t val)
+{
+    for(int i=0; i < BLOCK_ELEMS; i++) {
+        plc_tag_set_int32(write_tag, i * 4, val);
+    }
+
+    return plc_tag_write(write_tag, DATA_TIMEOUT);
+}
+
+
+/* wait until a slot has data with a sequence number after min_seq. */
+static int wait_for_slot(plc_tag_image_reader_p reader, int slot, uint32_t min_seq, uint8_t *buf, int *status, uint32_t *seq)
+{
+    int64_t timeout = util_time_ms() + DATA_TIMEOUT;
+    int rc = PLCTAG_ERR_TIMEOUT;
+
+    while(util_time_ms() < timeout) {
+        rc = plc_tag_image_read(reader, slot, buf, MAX_DATA_SIZE, NULL, status, seq);
+
+        if(rc < 0 || (*seq > min_seq && *status != PLCTAG_STATUS_PENDING)) {
+            return rc;
+        }
+
+        util_sleep_ms(5);
+    }
+
+    return PLCTAG_ERR_TIMEOUT;
+}
+
+
+static int32_t get_dint(const uint8_t *buf, int index)
+{
+    const uint8_t *p = buf + (index * 4);
+
+    return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+
+static int check_torn_reads(plc_tag_image_reader_p reader, int32_t write_tag)
+{
+    uint8_t buf[MAX_DATA_SIZE];
+    int snapshots = 0;
+    int status = 0;
+    uint32_t seq = 0;
+
+    for(int32_t val = 1; val <= NUM_WRITES; val++) {
+        int rc = PLCTAG_STATUS_OK;
+
+        for(int i=0; i < BLOCK_ELEMS; i++) {
+            plc_tag_set_int32(write_tag, i * 4, val);
+        }
+
+        rc = plc_tag_write(write_tag, 0);
+        if(rc != PLCTAG_STATUS_PENDING && rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Unable to start writing %d, %s!\n", val, plc_tag_decode_error(rc));
+            return 0;
+        }
+
+        /* read as fast as possible while the write and the automatic reads run. */
+        while((rc = plc_tag_status(write_tag)) == PLCTAG_STATUS_PENDING) {
+            if((rc = plc_tag_image_read(reader, 1, buf, (int)sizeof(buf), NULL, &status, &seq)) != BLOCK_ELEMS * 4) {
+                fprintf(stderr, "ERROR: Reading the block returned %s!\n", plc_tag_decode_error(rc));
+                return 0;
+            }
+
+            for(int i=1; i < BLOCK_ELEMS; i++) {
+                if(get_dint(buf, i) != get_dint(buf, 0)) {
+                    fprintf(stderr, "ERROR: Torn snapshot at sequence %u, element %d is %d and element 0 is %d!\n", seq, i, get_dint(buf, i), get_dint(buf, 0));
+                    return 0;
+                }
+            }
+
+            snapshots++;
+        }
+
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Unable to write %d, %s!\n", val, plc_tag_decode_error(rc));
+            return 0;
+        }
+
+        util_sleep_ms(RPI_MS / 2);
+    }
+
+    fprintf(stderr, "Checked %d snapshots, the block was updated %u times.\n", snapshots, seq);
+
+    return 1;
+}
+
+
+int main(void)
+{
+    int32_t image = 0;
+    int32_t write_tag = 0;
+    plc_tag_image_reader_p reader = NULL;
+    uint8_t buf[MAX_DATA_SIZE];
+    int64_t timestamp = 0;
+    int status = 0;
+    uint32_t seq = 0;
+    int rc = PLCTAG_STATUS_OK;
+    int ok = 0;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    plc_tag_set_debug_level(PLCTAG_DEBUG_WARN);
+
+    write_tag = plc_tag_create(TAG_BASE "4", DATA_TIMEOUT);
+    if(write_tag < 0) {
+        fprintf(stderr, "ERROR: Unable to create the write tag, %s!\n", plc_tag_decode_error(write_tag));
+        return 1;
+    }
+
+    do {
+        if((rc = write_block(write_tag, 42)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Unable to write the test values, %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        image = plc_tag_image_create(IMAGE_NAME, MAX_TAGS, MAX_DATA_SIZE);
+        if(image < 0) {
+            fprintf(stderr, "ERROR: Unable to create the image, %s!\n", plc_tag_decode_error(image));
+            break;
+        }
+
+        if(plc_tag_image_add(image, "first", RPI_MS, TAG_BASE "1") != 0
+           || plc_tag_image_add(image, "block", RPI_MS, TAG_BASE "4") != 1
+           || plc_tag_image_add(image, "too_big", RPI_MS * 10, TAG_BASE "8") != 2) {
+            fprintf(stderr, "ERROR: Unable to add the tags to the image!\n");
+            break;
+        }
+
+        if(plc_tag_image_add(image, "first", RPI_MS, TAG_BASE "1") != PLCTAG_ERR_DUPLICATE) {
+            fprintf(stderr, "ERROR: A duplicate key was accepted!\n");
+            break;
+        }
+
+        /* a second publisher cannot take the name from a running one. */
+        if((rc = plc_tag_image_create(IMAGE_NAME, MAX_TAGS, MAX_DATA_SIZE)) != PLCTAG_ERR_DUPLICATE) {
+            fprintf(stderr, "ERROR: Creating an image with a name in use returned %s!\n", plc_tag_decode_error(rc));
+
+            if(rc > 0) {
+                plc_tag_image_destroy(rc);
+            }
+
+            break;
+        }
+
+        if((rc = plc_tag_image_open(IMAGE_NAME, &reader)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Unable to open the image, %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        if(plc_tag_image_get_int_attribute(reader, "num_tags", 0) != 3
+           || plc_tag_image_get_int_attribute(reader, "max_data_size", 0) != MAX_DATA_SIZE
+           || plc_tag_image_find(reader, "block") != 1
+           || plc_tag_image_find(reader, "missing") != PLCTAG_ERR_NOT_FOUND) {
+            fprintf(stderr, "ERROR: The reader does not see the tags!\n");
+            break;
+        }
+
+        rc = wait_for_slot(reader, 0, 0, buf, &status, &seq);
+        if(rc != 4 || status != PLCTAG_STATUS_OK || get_dint(buf, 0) != 42) {
+            fprintf(stderr, "ERROR: First slot returned %d with status %s!\n", rc, plc_tag_decode_error(status));
+            break;
+        }
+
+        /* oversized data is cut off and flagged. */
+        rc = wait_for_slot(reader, 2, 0, buf, &status, &seq);
+        if(rc != MAX_DATA_SIZE || status != PLCTAG_ERR_TOO_LARGE) {
+            fprintf(stderr, "ERROR: Oversized slot returned %d with status %s!\n", rc, plc_tag_decode_error(status));
+            break;
+        }
+
+        rc = wait_for_slot(reader, 1, 0, buf, &status, &seq);
+        if(rc != BLOCK_ELEMS * 4 || status != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Block slot returned %d with status %s!\n", rc, plc_tag_decode_error(status));
+            break;
+        }
+
+        rc = plc_tag_image_read(reader, 1, buf, 8, &timestamp, &status, &seq);
+        if(rc != PLCTAG_ERR_TOO_SMALL) {
+            fprintf(stderr, "ERROR: Reading into a small buffer returned %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        if(plc_tag_image_read(reader, 1, buf, (int)sizeof(buf), &timestamp, &status, &seq) < 0 || timestamp > util_time_ms() || timestamp < util_time_ms() - DATA_TIMEOUT) {
+            fprintf(stderr, "ERROR: Bad slot timestamp %ld!\n", (long)timestamp);
+            break;
+        }
+
+        if(!check_torn_reads(reader, write_tag)) {
+            break;
+        }
+
+        /* readers see the publisher go away. */
+        plc_tag_image_destroy(image);
+        image = 0;
+
+        if(plc_tag_image_read(reader, 0, buf, (int)sizeof(buf), NULL, NULL, NULL) != PLCTAG_ERR_ABORT || plc_tag_image_get_int_attribute(reader, "closed", 0) != 1) {
+            fprintf(stderr, "ERROR: The reader did not see the image close!\n");
+            break;
+        }
+
+        plc_tag_image_close(reader);
+        reader = NULL;
+
+        if((rc = plc_tag_image_open(IMAGE_NAME, &reader)) != PLCTAG_ERR_NOT_FOUND) {
+            fprintf(stderr, "ERROR: Opening a destroyed image returned %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        ok = 1;
+    } while(0);
+
+    if(reader) {
+        plc_tag_image_close(reader);
+    }
+
+    if(image > 0) {
+        plc_tag_image_destroy(image);
+    }
+
+    plc_tag_destroy(write_tag);
+
+    if(!ok) {
+        return 1;
+    }
+
+    fprintf(stderr, "Done.\n");
+
+    return 0;
+}
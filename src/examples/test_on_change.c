@@ -0,0 +1,137 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+/*
+ * Watch a tag with automatic reads and on_change=1.  The callback only
+ * gets PLCTAG_EVENT_VALUE_CHANGED when the data read back differs, so
+ * writing the same value twice should only be seen once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define WATCH_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1&name=TestBigArray[10]&auto_sync_read_ms=20&on_change=1"
+#define WRITE_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1&name=TestBigArray[10]"
+#define DATA_TIMEOUT 5000
+#define SETTLE_MS (300)
+
+static volatile int changes = 0;
+static volatile int32_t last_value = 0;
+
+
+static void tag_callback(int32_t tag_id, int event, int status, void *userdata)
+{
+    (void)userdata;
+
+    if(event == PLCTAG_EVENT_VALUE_CHANGED) {
+        last_value = plc_tag_get_int32(tag_id, 0);
+        changes++;
+
+        fprintf(stderr, "Tag %d changed to %d with status %s.\n", tag_id, last_value, plc_tag_decode_error(status));
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    int32_t watch_tag = 0;
+    int32_t write_tag = 0;
+    int32_t base_value = (argc > 1 ? atoi(argv[1]) : 1000);
+    int32_t values[] = { base_value + 1, base_value + 2, base_value + 2, base_value + 3 };
+    int expected_changes = 1;
+    int rc = PLCTAG_STATUS_OK;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    write_tag = plc_tag_create(WRITE_ATTRIBS, DATA_TIMEOUT);
+    if(write_tag < 0) {
+        fprintf(stderr, "ERROR %s: Could not create tag to write!\n", plc_tag_decode_error(write_tag));
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    /* start from a known value. */
+    plc_tag_set_int32(write_tag, 0, base_value);
+    rc = plc_tag_write(write_tag, DATA_TIMEOUT);
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR %s: Could not write the starting value!\n", plc_tag_decode_error(rc));
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    watch_tag = plc_tag_create_ex(WATCH_ATTRIBS, tag_callback, NULL, DATA_TIMEOUT);
+    if(watch_tag < 0) {
+        fprintf(stderr, "ERROR %s: Could not create tag to watch!\n", plc_tag_decode_error(watch_tag));
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    util_sleep_ms(SETTLE_MS);
+
+    for(int i=0; i < (int)(sizeof(values)/sizeof(values[0])); i++) {
+        if(i == 0 || values[i] != values[i - 1]) {
+            expected_changes++;
+        }
+
+        plc_tag_set_int32(write_tag, 0, values[i]);
+        rc = plc_tag_write(write_tag, DATA_TIMEOUT);
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Could not write value %d!\n", plc_tag_decode_error(rc), values[i]);
+            plc_tag_shutdown();
+            return 1;
+        }
+
+        util_sleep_ms(SETTLE_MS);
+    }
+
+    fprintf(stderr, "Saw %d changes, expected %d.\n", changes, expected_changes);
+
+    if(changes != expected_changes || last_value != values[(sizeof(values)/sizeof(values[0])) - 1]) {
+        fprintf(stderr, "ERROR: Change events do not match the values written!\n");
+        rc = PLCTAG_ERR_BAD_DATA;
+    }
+
+    plc_tag_shutdown();
+
+    return (rc == PLCTAG_STATUS_OK ? 0 : 1);
+}
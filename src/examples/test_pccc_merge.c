@@ -0,0 +1,214 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+/*
+ * Read several elements of the same SLC data file at once so that the
+ * session merges the reads into one range read.  Then add a read past the
+ * end of the data file.  The merged read fails and the reads must be sent
+ * on their own, so the good ones still get their data.
+ *
+ * The first read goes out alone and the server delay keeps it in flight
+ * while the rest are queued, so the rest are merged.
+ *
+ * Run against: ab_server --plc=SLC500 --tag=N7[10] --delay=50
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&plc=%s&elem_count=1&name=N7:%d"
+#define NUM_TAGS (5)
+#define BAD_ELEMENT (12)
+#define DATA_TIMEOUT 5000
+#define SEND_WAIT_MS (10)
+
+
+/* the tag's initial read past the end of the file is queued with the others. */
+static int read_all(int32_t *tags, int num_tags, const char *bad_attribs)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int64_t timeout_time = util_time_ms() + DATA_TIMEOUT;
+
+    for(int i=0; i < num_tags; i++) {
+        rc = plc_tag_read(tags[i], 0);
+        if(rc != PLCTAG_STATUS_PENDING && rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Unable to start read of tag %d!\n", plc_tag_decode_error(rc), i);
+            return rc;
+        }
+
+        /* let the first one go out so that the rest are queued together. */
+        if(i == 0) {
+            util_sleep_ms(SEND_WAIT_MS);
+        }
+    }
+
+    if(bad_attribs) {
+        tags[num_tags] = plc_tag_create(bad_attribs, 0);
+        if(tags[num_tags] < 0) {
+            fprintf(stderr, "ERROR %s: Unable to start creating tag %s!\n", plc_tag_decode_error(tags[num_tags]), bad_attribs);
+            return tags[num_tags];
+        }
+
+        num_tags++;
+    }
+
+    do {
+        rc = PLCTAG_STATUS_OK;
+
+        for(int i=0; i < num_tags; i++) {
+            if(plc_tag_status(tags[i]) == PLCTAG_STATUS_PENDING) {
+                rc = PLCTAG_STATUS_PENDING;
+            }
+        }
+
+        if(rc == PLCTAG_STATUS_PENDING) {
+            util_sleep_ms(1);
+        }
+    } while(rc == PLCTAG_STATUS_PENDING && util_time_ms() < timeout_time);
+
+    if(rc == PLCTAG_STATUS_PENDING) {
+        fprintf(stderr, "ERROR: Timed out waiting for the reads!\n");
+        return PLCTAG_ERR_TIMEOUT;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+static int check_values(int32_t *tags, int base_value)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        int status = plc_tag_status(tags[i]);
+        int16_t val = plc_tag_get_int16(tags[i], 0);
+
+        fprintf(stderr, "N7:%d = %d (%s)\n", i, val, plc_tag_decode_error(status));
+
+        if(status != PLCTAG_STATUS_OK || val != (int16_t)(base_value + i)) {
+            fprintf(stderr, "ERROR: Unexpected value or status for N7:%d!\n", i);
+            rc = PLCTAG_ERR_BAD_DATA;
+        }
+    }
+
+    return rc;
+}
+
+
+int main(int argc, char **argv)
+{
+    int32_t tags[NUM_TAGS + 1] = {0};
+    const char *plc = (argc > 1 ? argv[1] : "slc500");
+    char bad_attribs[200];
+    int rc = PLCTAG_STATUS_OK;
+    int base_value = 100;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        char attribs[200];
+
+        snprintf(attribs, sizeof(attribs), TAG_ATTRIBS, plc, i);
+
+        tags[i] = plc_tag_create(attribs, DATA_TIMEOUT);
+        if(tags[i] < 0) {
+            fprintf(stderr, "ERROR %s: Could not create tag %s!\n", plc_tag_decode_error(tags[i]), attribs);
+            plc_tag_shutdown();
+            return 1;
+        }
+    }
+
+    /* give each element its own value, one write at a time. */
+    for(int i=0; i < NUM_TAGS; i++) {
+        plc_tag_set_int16(tags[i], 0, (int16_t)(base_value + i));
+
+        rc = plc_tag_write(tags[i], DATA_TIMEOUT);
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Unable to write N7:%d!\n", plc_tag_decode_error(rc), i);
+            plc_tag_shutdown();
+            return 1;
+        }
+
+        plc_tag_set_int16(tags[i], 0, 0);
+    }
+
+    /* these reads are merged. */
+    fprintf(stderr, "Reading %d elements of N7 together.\n", NUM_TAGS);
+
+    rc = read_all(tags, NUM_TAGS, NULL);
+    if(rc == PLCTAG_STATUS_OK) {
+        rc = check_values(tags, base_value);
+    }
+
+    /* the read past the end of the file makes the merged read fail. */
+    snprintf(bad_attribs, sizeof(bad_attribs), TAG_ATTRIBS, plc, BAD_ELEMENT);
+
+    if(rc == PLCTAG_STATUS_OK) {
+        for(int i=0; i < NUM_TAGS; i++) {
+            plc_tag_set_int16(tags[i], 0, 0);
+        }
+
+        fprintf(stderr, "Reading %d elements of N7 together with N7:%d.\n", NUM_TAGS, BAD_ELEMENT);
+
+        rc = read_all(tags, NUM_TAGS, bad_attribs);
+        if(rc == PLCTAG_STATUS_OK) {
+            rc = check_values(tags, base_value);
+        }
+
+        if(rc == PLCTAG_STATUS_OK && plc_tag_status(tags[NUM_TAGS]) == PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: The read of N7:%d should have failed!\n", BAD_ELEMENT);
+            rc = PLCTAG_ERR_BAD_STATUS;
+        }
+    }
+
+    plc_tag_shutdown();
+
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR: Test failed with %s!\n", plc_tag_decode_error(rc));
+        return 1;
+    }
+
+    fprintf(stderr, "Test passed.\n");
+
+    return 0;
+}
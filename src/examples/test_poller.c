@@ -0,0 +1,268 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Check the poller against ab_server:
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ *
+ * Tags at two RPIs end up in two groups, the samples come back with the
+ * right tag indexes and values, and a small ring overruns instead of
+ * growing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_BASE "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1&name="
+#define WRITE_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=3&name=TestBigArray[0]"
+#define DATA_TIMEOUT 5000
+#define RUN_MS (2000)
+#define FAST_RPI (50)
+#define SLOW_RPI (250)
+#define NUM_TAGS (3)
+#define BATCH_SIZE (64)
+#define SMALL_RING (4)
+
+static const char *poll_list =
+    "# name\ttype\trpi\ttag string\n"
+    "\n"
+    "fast0\tdint\t50\t" TAG_BASE "TestBigArray[0]\n"
+    "fast1\tDINT\t50\t" TAG_BASE "TestBigArray[1]\r\n"
+    "slow\tdint\t250\t" TAG_BASE "TestBigArray[2]\n";
+
+static int64_t timestamps[BATCH_SIZE];
+static int32_t tag_indexes[BATCH_SIZE];
+static double values[BATCH_SIZE];
+
+
+static int wait_for_tags(int32_t poller, int num_tags)
+{
+    int rc = PLCTAG_STATUS_PENDING;
+    int64_t timeout = util_time_ms() + DATA_TIMEOUT;
+
+    while(rc == PLCTAG_STATUS_PENDING && util_time_ms() < timeout) {
+        rc = PLCTAG_STATUS_OK;
+
+        for(int i=0; i < num_tags && rc == PLCTAG_STATUS_OK; i++) {
+            rc = plc_tag_status(plc_tag_poller_get_tag_id(poller, i));
+        }
+
+        if(rc == PLCTAG_STATUS_PENDING) {
+            util_sleep_ms(10);
+        }
+    }
+
+    return rc;
+}
+
+
+static int check_samples(int32_t poller)
+{
+    int counts[NUM_TAGS] = {0};
+    int64_t last_time[NUM_TAGS] = {0};
+    double last_val[NUM_TAGS] = {0};
+    int num_samples = 0;
+
+    while((num_samples = plc_tag_poller_read(poller, timestamps, tag_indexes, values, BATCH_SIZE)) > 0) {
+        for(int i=0; i < num_samples; i++) {
+            int index = tag_indexes[i];
+
+            if(index < 0 || index >= NUM_TAGS) {
+                fprintf(stderr, "ERROR: Sample has bad tag index %d!\n", index);
+                return 0;
+            }
+
+            if(timestamps[i] < last_time[index]) {
+                fprintf(stderr, "ERROR: Samples of tag %d are out of order!\n", index);
+                return 0;
+            }
+
+            counts[index]++;
+            last_time[index] = timestamps[i];
+            last_val[index] = values[i];
+        }
+    }
+
+    if(num_samples < 0) {
+        fprintf(stderr, "ERROR: Unable to read samples, %s!\n", plc_tag_decode_error(num_samples));
+        return 0;
+    }
+
+    fprintf(stderr, "Samples: fast0=%d fast1=%d slow=%d.\n", counts[0], counts[1], counts[2]);
+
+    /* allow for slow test machines, but the fast tags must be read much more often. */
+    if(counts[0] < (RUN_MS / FAST_RPI) / 2 || counts[1] < (RUN_MS / FAST_RPI) / 2 || counts[2] < (RUN_MS / SLOW_RPI) / 2 || counts[2] >= counts[0]) {
+        fprintf(stderr, "ERROR: Unexpected number of samples!\n");
+        return 0;
+    }
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        if(last_val[i] != (double)(100 * (i + 1))) {
+            fprintf(stderr, "ERROR: Last sample of tag %d is %f, expected %d!\n", i, last_val[i], 100 * (i + 1));
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+int main(void)
+{
+    int32_t poller = 0;
+    int32_t small = 0;
+    int32_t write_tag = 0;
+    int rc = PLCTAG_STATUS_OK;
+    char name[16];
+    int ok = 0;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    plc_tag_set_debug_level(PLCTAG_DEBUG_WARN);
+
+    /* set the values the poller should see. */
+    write_tag = plc_tag_create(WRITE_ATTRIBS, DATA_TIMEOUT);
+    if(write_tag < 0) {
+        fprintf(stderr, "ERROR: Unable to create the write tag, %s!\n", plc_tag_decode_error(write_tag));
+        return 1;
+    }
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        plc_tag_set_int32(write_tag, i * 4, 100 * (i + 1));
+    }
+
+    if((rc = plc_tag_write(write_tag, DATA_TIMEOUT)) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR: Unable to write the test values, %s!\n", plc_tag_decode_error(rc));
+        plc_tag_destroy(write_tag);
+        return 1;
+    }
+
+    plc_tag_destroy(write_tag);
+
+    do {
+        poller = plc_tag_poller_create(0);
+        if(poller < 0) {
+            fprintf(stderr, "ERROR: Unable to create poller, %s!\n", plc_tag_decode_error(poller));
+            break;
+        }
+
+        if((rc = plc_tag_poller_load(poller, poll_list)) != NUM_TAGS) {
+            fprintf(stderr, "ERROR: Loading the poll list returned %d, expected %d!\n", rc, NUM_TAGS);
+            break;
+        }
+
+        /* bad lines are rejected. */
+        if(plc_tag_poller_load(poller, "bad\tline\n") != PLCTAG_ERR_BAD_CONFIG
+           || plc_tag_poller_add(poller, "bad", "string", 100, TAG_BASE "TestBigArray[3]") != PLCTAG_ERR_BAD_PARAM) {
+            fprintf(stderr, "ERROR: A bad poll list entry was accepted!\n");
+            break;
+        }
+
+        if(plc_tag_poller_get_int_attribute(poller, "num_tags", 0) != NUM_TAGS || plc_tag_poller_get_int_attribute(poller, "num_groups", 0) != 2) {
+            fprintf(stderr, "ERROR: Expected %d tags in 2 groups, got %d tags in %d groups!\n", NUM_TAGS,
+                    plc_tag_poller_get_int_attribute(poller, "num_tags", 0), plc_tag_poller_get_int_attribute(poller, "num_groups", 0));
+            break;
+        }
+
+        if(plc_tag_poller_get_tag_name(poller, 1, name, (int)sizeof(name)) != PLCTAG_STATUS_OK || strcmp(name, "fast1") != 0) {
+            fprintf(stderr, "ERROR: Tag 1 is not named fast1!\n");
+            break;
+        }
+
+        if((rc = wait_for_tags(poller, NUM_TAGS)) != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR: Tags did not become ready, %s!\n", plc_tag_decode_error(rc));
+            break;
+        }
+
+        util_sleep_ms(RUN_MS);
+
+        if(!check_samples(poller)) {
+            break;
+        }
+
+        /* a small ring drops the oldest samples. */
+        small = plc_tag_poller_create(SMALL_RING);
+        if(small < 0 || plc_tag_poller_add(small, "small", "dint", 20, TAG_BASE "TestBigArray[0]") != 0) {
+            fprintf(stderr, "ERROR: Unable to set up the small poller!\n");
+            break;
+        }
+
+        util_sleep_ms(500);
+
+        if(plc_tag_poller_get_int_attribute(small, "buffered", 0) != SMALL_RING || plc_tag_poller_get_int_attribute(small, "overruns", 0) <= 0) {
+            fprintf(stderr, "ERROR: Small ring has %d samples and %d overruns!\n",
+                    plc_tag_poller_get_int_attribute(small, "buffered", 0), plc_tag_poller_get_int_attribute(small, "overruns", 0));
+            break;
+        }
+
+        if(plc_tag_poller_read(small, timestamps, tag_indexes, values, 3) != 3 || plc_tag_poller_read(small, timestamps, tag_indexes, values, 3) < 1) {
+            fprintf(stderr, "ERROR: Unable to drain the small ring in pieces!\n");
+            break;
+        }
+
+        fprintf(stderr, "Small ring overran %d times.\n", plc_tag_poller_get_int_attribute(small, "overruns", 0));
+
+        ok = 1;
+    } while(0);
+
+    if(small > 0) {
+        plc_tag_poller_destroy(small);
+    }
+
+    if(poller > 0) {
+        plc_tag_poller_destroy(poller);
+
+        if(plc_tag_poller_destroy(poller) != PLCTAG_ERR_NOT_FOUND) {
+            fprintf(stderr, "ERROR: Destroying the poller twice did not fail!\n");
+            ok = 0;
+        }
+    }
+
+    if(!ok) {
+        return 1;
+    }
+
+    fprintf(stderr, "Done.\n");
+
+    return 0;
+}
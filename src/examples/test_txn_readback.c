@@ -0,0 +1,190 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+/*
+ * Write a set of setpoints and read them back in one transaction.  The
+ * readbacks go out in the same Multiple Service Packet as the writes.
+ * Then check that destroying a transaction in flight aborts it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1&name=%s"
+#define NUM_TAGS (3)
+#define DATA_TIMEOUT 5000
+
+static const char *tag_names[NUM_TAGS] = { "TestDINT1", "TestDINT2", "TestDINT3" };
+
+static volatile int txn_done = 0;
+static int txn_ok = 0;
+static int txn_aborted = 0;
+
+
+static void txn_callback(int32_t txn_id, int num_ops, const int *op_status, void *userdata)
+{
+    (void)userdata;
+
+    txn_ok = 1;
+
+    for(int i=0; i < num_ops; i++) {
+        if(op_status[i] == PLCTAG_ERR_ABORT) {
+            txn_aborted++;
+        } else if(op_status[i] != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "Transaction %d operation %d failed with %s!\n", txn_id, i, plc_tag_decode_error(op_status[i]));
+            txn_ok = 0;
+        }
+    }
+
+    txn_done++;
+}
+
+
+static int run_txn(int32_t txn)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int64_t timeout_time = 0;
+
+    txn_done = 0;
+    txn_aborted = 0;
+
+    rc = plc_tag_txn_submit(txn, txn_callback, NULL);
+    if(rc != PLCTAG_STATUS_PENDING) {
+        fprintf(stderr, "ERROR %s: Could not submit transaction!\n", plc_tag_decode_error(rc));
+        return rc;
+    }
+
+    timeout_time = util_time_ms() + DATA_TIMEOUT;
+    while(!txn_done && util_time_ms() < timeout_time) {
+        util_sleep_ms(10);
+    }
+
+    if(!txn_done || !txn_ok || txn_aborted) {
+        fprintf(stderr, "ERROR: Transaction %s!\n", (txn_done ? "failed" : "timed out"));
+        return PLCTAG_ERR_TIMEOUT;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+int main(int argc, char **argv)
+{
+    int32_t tags[NUM_TAGS] = {0};
+    int32_t txn = 0;
+    int rc = PLCTAG_STATUS_OK;
+    int32_t base_value = (argc > 1 ? atoi(argv[1]) : 42);
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    for(int i=0; i < NUM_TAGS; i++) {
+        char attribs[200];
+
+        snprintf(attribs, sizeof(attribs), TAG_ATTRIBS, tag_names[i]);
+
+        tags[i] = plc_tag_create(attribs, DATA_TIMEOUT);
+        if(tags[i] < 0) {
+            fprintf(stderr, "ERROR: Could not create tag %s!\n", tag_names[i]);
+            plc_tag_shutdown();
+            return 1;
+        }
+    }
+
+    txn = plc_tag_txn_create();
+    if(txn < 0) {
+        fprintf(stderr, "ERROR %s: Could not create transaction!\n", plc_tag_decode_error(txn));
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    /* each read right after the write of the same tag. */
+    for(int i=0; i < NUM_TAGS; i++) {
+        plc_tag_txn_add_write(txn, tags[i]);
+        plc_tag_txn_add_read(txn, tags[i]);
+    }
+
+    /* run it twice, the second time the readback handles already exist. */
+    for(int pass=0; pass < 2 && rc == PLCTAG_STATUS_OK; pass++) {
+        for(int i=0; i < NUM_TAGS; i++) {
+            plc_tag_set_int32(tags[i], 0, base_value + (pass * 100) + i);
+        }
+
+        if(run_txn(txn) != PLCTAG_STATUS_OK) {
+            plc_tag_shutdown();
+            return 1;
+        }
+
+        for(int i=0; i < NUM_TAGS; i++) {
+            int32_t val = plc_tag_get_int32(tags[i], 0);
+
+            fprintf(stderr, "%s = %d\n", tag_names[i], val);
+
+            if(val != base_value + (pass * 100) + i) {
+                fprintf(stderr, "ERROR: Readback of %s does not match the value written!\n", tag_names[i]);
+                rc = PLCTAG_ERR_BAD_DATA;
+            }
+        }
+    }
+
+    /* destroying it in flight must call the callback once. */
+    txn_done = 0;
+    txn_ok = 0;
+    txn_aborted = 0;
+
+    if(rc == PLCTAG_STATUS_OK && plc_tag_txn_submit(txn, txn_callback, NULL) == PLCTAG_STATUS_PENDING) {
+        plc_tag_txn_destroy(txn);
+        util_sleep_ms(100);
+
+        fprintf(stderr, "Destroyed transaction in flight, %d operations aborted.\n", txn_aborted);
+
+        if(txn_done != 1 || !txn_ok) {
+            fprintf(stderr, "ERROR: Transaction callback was called %d times with %s!\n", txn_done, (txn_ok ? "good status" : "bad status"));
+            rc = PLCTAG_ERR_BAD_STATUS;
+        }
+    } else {
+        plc_tag_txn_destroy(txn);
+    }
+
+    plc_tag_shutdown();
+
+    return (rc == PLCTAG_STATUS_OK ? 0 : 1);
+}
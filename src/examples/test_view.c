@@ -0,0 +1,229 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+
+
+/*
+ * Read a large tag through a pinned view and through the lock-free
+ * sequence check while the library keeps reading it in the background.
+ * Every lock-free copy that the sequence check accepts must match what
+ * a locked view shows at the same sequence number.  Last, a setter called
+ * while a view holds a read between two fragments must leave the sequence
+ * number odd.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define ELEM_COUNT (1000)
+#define VIEW_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1000&name=TestBigArray[1000]&auto_sync_read_ms=10"
+#define WRITE_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1000&name=TestBigArray[1000]"
+#define DATA_TIMEOUT 5000
+#define NUM_WRITES (20)
+#define READS_PER_WRITE (50)
+#define NUM_MID_READ_SETS (5)
+
+static uint8_t copy_buf[ELEM_COUNT * 4];
+static uint8_t view_buf[ELEM_COUNT * 4];
+
+
+int main(void)
+{
+    int32_t view_tag = 0;
+    int32_t write_tag = 0;
+    const uint8_t *data = NULL;
+    int size = 0;
+    uint32_t first_seq = 0;
+    uint32_t seq1 = 0;
+    uint32_t seq2 = 0;
+    int retries = 0;
+    int checked = 0;
+    int rc = PLCTAG_STATUS_OK;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    write_tag = plc_tag_create(WRITE_ATTRIBS, DATA_TIMEOUT);
+    view_tag = plc_tag_create(VIEW_ATTRIBS, DATA_TIMEOUT);
+    if(write_tag < 0 || view_tag < 0) {
+        fprintf(stderr, "ERROR: Could not create tags!\n");
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    /* wait for the first automatic read to finish. */
+    for(int waited = 0; (seq1 == 0 || (seq1 & 1)) && waited < DATA_TIMEOUT; waited += 10) {
+        util_sleep_ms(10);
+        plc_tag_get_data_seq(view_tag, &seq1);
+    }
+
+    if(seq1 == 0 || (seq1 & 1)) {
+        fprintf(stderr, "ERROR: Timed out waiting for the tag to be read!\n");
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    /* the view must show the whole tag. */
+    rc = plc_tag_view_acquire(view_tag, &data, &size, &first_seq);
+    if(rc != PLCTAG_STATUS_OK || size != ELEM_COUNT * 4 || plc_tag_get_int32(view_tag, 0) != (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24))) {
+        fprintf(stderr, "ERROR %s: Bad view of %d bytes!\n", plc_tag_decode_error(rc), size);
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    plc_tag_view_release(view_tag);
+
+    if(plc_tag_view_release(view_tag) != PLCTAG_ERR_NOT_ALLOWED) {
+        fprintf(stderr, "ERROR: Releasing a view twice should fail!\n");
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    for(int i=0; i < NUM_WRITES && rc == PLCTAG_STATUS_OK; i++) {
+        for(int elem=0; elem < ELEM_COUNT; elem++) {
+            plc_tag_set_int32(write_tag, elem * 4, i);
+        }
+
+        rc = plc_tag_write(write_tag, DATA_TIMEOUT);
+        if(rc != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "ERROR %s: Could not write value %d!\n", plc_tag_decode_error(rc), i);
+            break;
+        }
+
+        for(int j=0; j < READS_PER_WRITE; j++) {
+            uint32_t view_seq = 0;
+
+            /* lock-free copy with the sequence check. */
+            for(;;) {
+                plc_tag_get_data_seq(view_tag, &seq1);
+                memcpy(copy_buf, data, sizeof(copy_buf));
+                plc_tag_get_data_seq(view_tag, &seq2);
+
+                if(!(seq1 & 1) && seq1 == seq2) {
+                    break;
+                }
+
+                retries++;
+                util_sleep_ms(1);
+            }
+
+            /* if nothing changed since, the locked view must match. */
+            rc = plc_tag_view_acquire(view_tag, &data, &size, &view_seq);
+            if(rc != PLCTAG_STATUS_OK) {
+                fprintf(stderr, "ERROR %s: Could not acquire the view!\n", plc_tag_decode_error(rc));
+                break;
+            }
+
+            if(view_seq == seq1) {
+                memcpy(view_buf, data, sizeof(view_buf));
+                checked++;
+            }
+
+            plc_tag_view_release(view_tag);
+
+            if(view_seq == seq1 && memcmp(copy_buf, view_buf, sizeof(copy_buf)) != 0) {
+                fprintf(stderr, "ERROR: Lock-free copy at sequence %u does not match the view!\n", seq1);
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
+            util_sleep_ms(1);
+        }
+    }
+
+    fprintf(stderr, "Sequence went from %u to %u, %d copies checked, %d retries.\n", first_seq, seq1, checked, retries);
+
+    /* a setter between the fragments of a read must not end the read's change. */
+    if(rc == PLCTAG_STATUS_OK) {
+        int64_t timeout = util_time_ms() + DATA_TIMEOUT;
+        int caught = 0;
+
+        while(caught < NUM_MID_READ_SETS && util_time_ms() < timeout) {
+            uint32_t view_seq = 0;
+
+            plc_tag_get_data_seq(view_tag, &seq1);
+            if(!(seq1 & 1)) {
+                continue;
+            }
+
+            /* the automatic read cannot go on while the view is held. */
+            rc = plc_tag_view_acquire(view_tag, &data, &size, &view_seq);
+            if(rc != PLCTAG_STATUS_OK) {
+                fprintf(stderr, "ERROR %s: Could not acquire the view!\n", plc_tag_decode_error(rc));
+                break;
+            }
+
+            if(view_seq & 1) {
+                caught++;
+
+                plc_tag_set_int32(view_tag, 0, caught);
+                plc_tag_get_data_seq(view_tag, &seq2);
+
+                if(seq2 != view_seq) {
+                    fprintf(stderr, "ERROR: A setter ended the read's change, sequence %u went to %u!\n", view_seq, seq2);
+                    rc = PLCTAG_ERR_BAD_DATA;
+                }
+            }
+
+            plc_tag_view_release(view_tag);
+
+            if(rc != PLCTAG_STATUS_OK) {
+                break;
+            }
+        }
+
+        if(rc == PLCTAG_STATUS_OK && caught < NUM_MID_READ_SETS) {
+            fprintf(stderr, "ERROR: Only caught %d of %d reads part way through!\n", caught, NUM_MID_READ_SETS);
+            rc = PLCTAG_ERR_TIMEOUT;
+        }
+    }
+
+    if(rc == PLCTAG_STATUS_OK && (seq1 == first_seq || checked == 0)) {
+        fprintf(stderr, "ERROR: The sequence number did not move!\n");
+        rc = PLCTAG_ERR_BAD_DATA;
+    }
+
+    plc_tag_shutdown();
+
+    return (rc == PLCTAG_STATUS_OK ? 0 : 1);
+}
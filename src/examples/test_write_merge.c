@@ -0,0 +1,215 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Write neighbouring elements of an array in one transaction so that the
+ * session merges the writes.  One element is written twice with different
+ * values.  Merging must not move the first write of that element after
+ * the second one, so the element must end up with the second value.
+ *
+ * Run against: ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/libplctag.h"
+#include "utils.h"
+
+#define REQUIRED_VERSION 2,6,0
+
+#define TAG_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=1&name=TestBigArray[%d]"
+#define NUM_WRITES (4)
+#define NUM_ROUNDS (3)
+#define DATA_TIMEOUT 5000
+
+/* element 5 is written twice, the last write must win. */
+static const int write_elements[NUM_WRITES] = { 6, 5, 5, 4 };
+
+static volatile int txn_done = 0;
+static int txn_ok = 0;
+
+
+static void txn_callback(int32_t txn_id, int num_ops, const int *op_status, void *userdata)
+{
+    (void)userdata;
+
+    txn_ok = 1;
+
+    for(int i=0; i < num_ops; i++) {
+        if(op_status[i] != PLCTAG_STATUS_OK) {
+            fprintf(stderr, "Transaction %d operation %d failed with %s!\n", txn_id, i, plc_tag_decode_error(op_status[i]));
+            txn_ok = 0;
+        }
+    }
+
+    txn_done = 1;
+}
+
+
+static int run_txn(int32_t txn)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int64_t timeout_time = 0;
+
+    txn_done = 0;
+
+    rc = plc_tag_txn_submit(txn, txn_callback, NULL);
+    if(rc != PLCTAG_STATUS_PENDING) {
+        fprintf(stderr, "ERROR %s: Could not submit transaction!\n", plc_tag_decode_error(rc));
+        return rc;
+    }
+
+    timeout_time = util_time_ms() + DATA_TIMEOUT;
+    while(!txn_done && util_time_ms() < timeout_time) {
+        util_sleep_ms(10);
+    }
+
+    if(!txn_done || !txn_ok) {
+        fprintf(stderr, "ERROR: Transaction %s!\n", (txn_done ? "failed" : "timed out"));
+        return PLCTAG_ERR_BAD_STATUS;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+static int check_element(int element, int32_t expected)
+{
+    char attribs[200];
+    int32_t tag = 0;
+    int32_t val = 0;
+    int rc = PLCTAG_STATUS_OK;
+
+    snprintf(attribs, sizeof(attribs), TAG_ATTRIBS, element);
+
+    tag = plc_tag_create(attribs, DATA_TIMEOUT);
+    if(tag < 0) {
+        fprintf(stderr, "ERROR %s: Could not create tag %s!\n", plc_tag_decode_error(tag), attribs);
+        return tag;
+    }
+
+    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    if(rc == PLCTAG_STATUS_OK) {
+        val = plc_tag_get_int32(tag, 0);
+
+        fprintf(stderr, "TestBigArray[%d] = %d\n", element, val);
+
+        if(val != expected) {
+            fprintf(stderr, "ERROR: Expected %d in TestBigArray[%d]!\n", expected, element);
+            rc = PLCTAG_ERR_BAD_DATA;
+        }
+    } else {
+        fprintf(stderr, "ERROR %s: Unable to read TestBigArray[%d]!\n", plc_tag_decode_error(rc), element);
+    }
+
+    plc_tag_destroy(tag);
+
+    return rc;
+}
+
+
+int main(void)
+{
+    int32_t tags[NUM_WRITES] = {0};
+    int32_t txn = 0;
+    int rc = PLCTAG_STATUS_OK;
+
+    /* check the library version. */
+    if(plc_tag_check_lib_version(REQUIRED_VERSION) != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "Required compatible library version %d.%d.%d not available!", REQUIRED_VERSION);
+        exit(1);
+    }
+
+    /* a handle per write, so the same element has two handles. */
+    for(int i=0; i < NUM_WRITES; i++) {
+        char attribs[200];
+
+        snprintf(attribs, sizeof(attribs), TAG_ATTRIBS, write_elements[i]);
+
+        tags[i] = plc_tag_create(attribs, DATA_TIMEOUT);
+        if(tags[i] < 0) {
+            fprintf(stderr, "ERROR %s: Could not create tag %s!\n", plc_tag_decode_error(tags[i]), attribs);
+            plc_tag_shutdown();
+            return 1;
+        }
+    }
+
+    txn = plc_tag_txn_create();
+    if(txn < 0) {
+        fprintf(stderr, "ERROR %s: Could not create transaction!\n", plc_tag_decode_error(txn));
+        plc_tag_shutdown();
+        return 1;
+    }
+
+    for(int i=0; i < NUM_WRITES; i++) {
+        plc_tag_txn_add_write(txn, tags[i]);
+    }
+
+    for(int round=0; round < NUM_ROUNDS && rc == PLCTAG_STATUS_OK; round++) {
+        int32_t base_value = (round + 1) * 1000;
+
+        for(int i=0; i < NUM_WRITES; i++) {
+            plc_tag_set_int32(tags[i], 0, base_value + i);
+        }
+
+        rc = run_txn(txn);
+
+        /* the last write of each element wins. */
+        for(int i=0; i < NUM_WRITES && rc == PLCTAG_STATUS_OK; i++) {
+            int last = i;
+
+            for(int j=i + 1; j < NUM_WRITES; j++) {
+                if(write_elements[j] == write_elements[i]) {
+                    last = j;
+                }
+            }
+
+            if(last == i) {
+                rc = check_element(write_elements[i], base_value + i);
+            }
+        }
+    }
+
+    plc_tag_txn_destroy(txn);
+
+    plc_tag_shutdown();
+
+    if(rc != PLCTAG_STATUS_OK) {
+        fprintf(stderr, "ERROR: Test failed with %s!\n", plc_tag_decode_error(rc));
+        return 1;
+    }
+
+    fprintf(stderr, "Test passed.\n");
+
+    return 0;
+}
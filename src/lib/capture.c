@@ -0,0 +1,434 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#define LIBPLCTAGDLL_EXPORTS 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <lib/libplctag.h>
+#include <lib/tag.h>
+#include <lib/init.h>
+#include <lib/capture.h>
+#include <platform.h>
+#include <util/debug.h>
+
+
+/*
+ * Captures are pcap files with the raw IP link type.  There is no IP or
+ * TCP header to record, so each frame gets a made up one.  The client
+ * is 10.0.0.1, the server is 10.0.0.2 and each connection has its own
+ * client port so that tools can follow the streams.  The server port is
+ * the real one, so Wireshark picks the EtherNet/IP or Modbus dissector.
+ * The TCP sequence numbers count the bytes of each side of a connection.
+ *
+ * Timestamps come from the monotonic clock, offset so that the first
+ * frame is at about the wall clock time the capture was started.
+ */
+
+#define PCAP_MAGIC (0xA1B2C3D4)
+#define PCAP_VERSION_MAJOR (2)
+#define PCAP_VERSION_MINOR (4)
+#define PCAP_SNAP_LEN (65535)
+#define PCAP_LINKTYPE_RAW (101)
+
+#define CAPTURE_IP_HEADER_SIZE (20)
+#define CAPTURE_TCP_HEADER_SIZE (20)
+#define CAPTURE_HEADER_SIZE (CAPTURE_IP_HEADER_SIZE + CAPTURE_TCP_HEADER_SIZE)
+#define CAPTURE_MAX_PAYLOAD (PCAP_SNAP_LEN - CAPTURE_HEADER_SIZE)
+
+#define CAPTURE_CLIENT_ADDR (0x0A000001) /* 10.0.0.1 */
+#define CAPTURE_SERVER_ADDR (0x0A000002) /* 10.0.0.2 */
+#define CAPTURE_CLIENT_PORT_BASE (49152)
+#define CAPTURE_CLIENT_PORT_MASK (0x3FFF)
+
+volatile int capture_enabled = 0;
+
+static mutex_p capture_mutex = NULL;
+static FILE *capture_file = NULL;
+static int64_t capture_start_epoch_us = 0;
+static int64_t capture_start_mono_us = 0;
+static uint16_t capture_ip_id = 0;
+static int32_t next_capture_conn_id = 1;
+
+
+static int write_file_header(FILE *file);
+static void close_capture_file(void);
+static void put_uint16_be(uint8_t *buf, uint16_t val);
+static void put_uint32_be(uint8_t *buf, uint32_t val);
+static void put_uint32_le(uint8_t *buf, uint32_t val);
+static uint32_t checksum_add(uint32_t sum, const uint8_t *data, int size);
+static uint16_t checksum_finish(uint32_t sum);
+
+
+
+int capture_init(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    pdebug(DEBUG_INFO,"Creating capture mutex.");
+    rc = mutex_create((mutex_p *)&capture_mutex);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to create capture mutex!");
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+void capture_teardown(void)
+{
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(capture_mutex) {
+        critical_block(capture_mutex) {
+            close_capture_file();
+        }
+
+        pdebug(DEBUG_INFO,"Tearing down capture mutex.");
+        mutex_destroy(&capture_mutex);
+        capture_mutex = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+/*
+ * capture_conn_open
+ *
+ * Give a new socket its own identity in the capture.  This is called
+ * whether or not a capture is running so that a capture started later
+ * can still tell the connections apart.
+ */
+
+void capture_conn_open(capture_conn_t *conn, int server_port)
+{
+    if(!conn) {
+        return;
+    }
+
+    if(capture_mutex) {
+        critical_block(capture_mutex) {
+            conn->id = next_capture_conn_id++;
+        }
+    }
+
+    conn->server_port = (uint16_t)server_port;
+    conn->client_seq = 1;
+    conn->server_seq = 1;
+}
+
+
+
+/*
+ * capture_frame_impl
+ *
+ * Write one frame to the capture file.  Use the capture_frame() macro
+ * instead, it skips the call when no capture is running.
+ */
+
+void capture_frame_impl(capture_conn_t *conn, int from_server, const uint8_t *data, int size)
+{
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    uint8_t record[16];
+    uint8_t pseudo[12];
+    uint8_t *ip = &header[0];
+    uint8_t *tcp = &header[CAPTURE_IP_HEADER_SIZE];
+    uint32_t src_addr = (from_server ? CAPTURE_SERVER_ADDR : CAPTURE_CLIENT_ADDR);
+    uint32_t dst_addr = (from_server ? CAPTURE_CLIENT_ADDR : CAPTURE_SERVER_ADDR);
+    uint16_t client_port = 0;
+    int payload_size = 0;
+    int64_t ts_us = 0;
+    uint32_t sum = 0;
+
+    if(!conn || !data || size <= 0 || !capture_mutex) {
+        return;
+    }
+
+    payload_size = (size > CAPTURE_MAX_PAYLOAD ? CAPTURE_MAX_PAYLOAD : size);
+    client_port = (uint16_t)(CAPTURE_CLIENT_PORT_BASE + (conn->id & CAPTURE_CLIENT_PORT_MASK));
+    ts_us = capture_start_epoch_us + (time_monotonic_us() - capture_start_mono_us);
+
+    critical_block(capture_mutex) {
+        if(!capture_file) {
+            break;
+        }
+
+        /* IPv4 header. */
+        ip[0] = 0x45; /* version 4, 5 words */
+        ip[1] = 0;
+        put_uint16_be(&ip[2], (uint16_t)(CAPTURE_HEADER_SIZE + payload_size));
+        put_uint16_be(&ip[4], capture_ip_id++);
+        put_uint16_be(&ip[6], 0x4000); /* don't fragment */
+        ip[8] = 64; /* TTL */
+        ip[9] = 6; /* TCP */
+        put_uint16_be(&ip[10], 0);
+        put_uint32_be(&ip[12], src_addr);
+        put_uint32_be(&ip[16], dst_addr);
+        put_uint16_be(&ip[10], checksum_finish(checksum_add(0, ip, CAPTURE_IP_HEADER_SIZE)));
+
+        /* TCP header. */
+        put_uint16_be(&tcp[0], (from_server ? conn->server_port : client_port));
+        put_uint16_be(&tcp[2], (from_server ? client_port : conn->server_port));
+        put_uint32_be(&tcp[4], (from_server ? conn->server_seq : conn->client_seq));
+        put_uint32_be(&tcp[8], (from_server ? conn->client_seq : conn->server_seq));
+        tcp[12] = 0x50; /* 5 words */
+        tcp[13] = 0x18; /* PSH, ACK */
+        put_uint16_be(&tcp[14], 0xFFFF);
+        put_uint16_be(&tcp[16], 0);
+        put_uint16_be(&tcp[18], 0);
+
+        put_uint32_be(&pseudo[0], src_addr);
+        put_uint32_be(&pseudo[4], dst_addr);
+        pseudo[8] = 0;
+        pseudo[9] = 6;
+        put_uint16_be(&pseudo[10], (uint16_t)(CAPTURE_TCP_HEADER_SIZE + payload_size));
+
+        sum = checksum_add(0, pseudo, (int)sizeof(pseudo));
+        sum = checksum_add(sum, tcp, CAPTURE_TCP_HEADER_SIZE);
+        sum = checksum_add(sum, data, payload_size);
+        put_uint16_be(&tcp[16], checksum_finish(sum));
+
+        if(from_server) {
+            conn->server_seq += (uint32_t)size;
+        } else {
+            conn->client_seq += (uint32_t)size;
+        }
+
+        /* pcap record header. */
+        put_uint32_le(&record[0], (uint32_t)(ts_us / 1000000));
+        put_uint32_le(&record[4], (uint32_t)(ts_us % 1000000));
+        put_uint32_le(&record[8], (uint32_t)(CAPTURE_HEADER_SIZE + payload_size));
+        put_uint32_le(&record[12], (uint32_t)(CAPTURE_HEADER_SIZE + size));
+
+        if(fwrite(record, 1, sizeof(record), capture_file) != sizeof(record)
+           || fwrite(header, 1, sizeof(header), capture_file) != sizeof(header)
+           || fwrite(data, 1, (size_t)payload_size, capture_file) != (size_t)payload_size) {
+            pdebug(DEBUG_WARN, "Error writing capture file, stopping the capture!");
+            close_capture_file();
+        }
+    }
+}
+
+
+
+
+/*
+ * plc_tag_capture_start
+ *
+ * Start writing all frames to and from PLCs to a pcap file.  See
+ * libplctag.h for details.
+ */
+
+LIB_EXPORT int plc_tag_capture_start(const char *file_name)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* make sure that the library is initialized. */
+    rc = initialize_modules();
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to initialize the internal library state!");
+        return rc;
+    }
+
+    if(!file_name || str_length(file_name) == 0) {
+        pdebug(DEBUG_WARN, "A capture file name is required!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    critical_block(capture_mutex) {
+        FILE *file = NULL;
+
+        if(capture_file) {
+            pdebug(DEBUG_WARN, "A capture is already running!");
+            rc = PLCTAG_ERR_BUSY;
+            break;
+        }
+
+        file = fopen(file_name, "wb");
+        if(!file) {
+            pdebug(DEBUG_WARN, "Unable to open capture file \"%s\"!", file_name);
+            rc = PLCTAG_ERR_OPEN;
+            break;
+        }
+
+        rc = write_file_header(file);
+        if(rc != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Unable to write the header of capture file \"%s\"!", file_name);
+            fclose(file);
+            break;
+        }
+
+        capture_start_epoch_us = time_us();
+        capture_start_mono_us = time_monotonic_us();
+        capture_file = file;
+        capture_enabled = 1;
+    }
+
+    pdebug(DEBUG_INFO, "Done with status %s.", plc_tag_decode_error(rc));
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_capture_stop
+ *
+ * Stop the capture and close the file.  It is not an error if there
+ * is no capture running.
+ */
+
+LIB_EXPORT int plc_tag_capture_stop(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!capture_mutex) {
+        pdebug(DEBUG_INFO, "Library not initialized, no capture running.");
+        return PLCTAG_STATUS_OK;
+    }
+
+    critical_block(capture_mutex) {
+        if(capture_file && fflush(capture_file) != 0) {
+            pdebug(DEBUG_WARN, "Error flushing the capture file!");
+            rc = PLCTAG_ERR_WRITE;
+        }
+
+        close_capture_file();
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+
+/***********************************************************************
+ **************************** Helper Functions *************************
+ **********************************************************************/
+
+
+int write_file_header(FILE *file)
+{
+    uint8_t buf[24];
+
+    put_uint32_le(&buf[0], PCAP_MAGIC);
+    buf[4] = PCAP_VERSION_MAJOR;
+    buf[5] = 0;
+    buf[6] = PCAP_VERSION_MINOR;
+    buf[7] = 0;
+    put_uint32_le(&buf[8], 0); /* GMT offset */
+    put_uint32_le(&buf[12], 0); /* timestamp accuracy */
+    put_uint32_le(&buf[16], PCAP_SNAP_LEN);
+    put_uint32_le(&buf[20], PCAP_LINKTYPE_RAW);
+
+    return (fwrite(buf, 1, sizeof(buf), file) == sizeof(buf) ? PLCTAG_STATUS_OK : PLCTAG_ERR_WRITE);
+}
+
+
+/* must be called with the capture mutex held. */
+void close_capture_file(void)
+{
+    capture_enabled = 0;
+
+    if(capture_file) {
+        fclose(capture_file);
+        capture_file = NULL;
+    }
+}
+
+
+void put_uint16_be(uint8_t *buf, uint16_t val)
+{
+    buf[0] = (uint8_t)((val >> 8) & 0xFF);
+    buf[1] = (uint8_t)(val & 0xFF);
+}
+
+
+void put_uint32_be(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (uint8_t)((val >> 24) & 0xFF);
+    buf[1] = (uint8_t)((val >> 16) & 0xFF);
+    buf[2] = (uint8_t)((val >> 8) & 0xFF);
+    buf[3] = (uint8_t)(val & 0xFF);
+}
+
+
+void put_uint32_le(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (uint8_t)(val & 0xFF);
+    buf[1] = (uint8_t)((val >> 8) & 0xFF);
+    buf[2] = (uint8_t)((val >> 16) & 0xFF);
+    buf[3] = (uint8_t)((val >> 24) & 0xFF);
+}
+
+
+/* the Internet checksum, RFC 1071. */
+uint32_t checksum_add(uint32_t sum, const uint8_t *data, int size)
+{
+    int i = 0;
+
+    for(i = 0; i + 1 < size; i += 2) {
+        sum += ((uint32_t)data[i] << 8) | (uint32_t)data[i + 1];
+    }
+
+    if(i < size) {
+        sum += (uint32_t)data[i] << 8;
+    }
+
+    return sum;
+}
+
+
+uint16_t checksum_finish(uint32_t sum)
+{
+    while(sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return (uint16_t)(~sum & 0xFFFF);
+}
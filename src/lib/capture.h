@@ -0,0 +1,67 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#ifndef __LIB_CAPTURE_H__
+#define __LIB_CAPTURE_H__ 1
+
+#include <stdint.h>
+
+/*
+ * Wire capture, see plc_tag_capture_start().
+ *
+ * Each transport embeds a capture_conn_t and calls capture_conn_open()
+ * whenever it opens a new socket.  It passes every complete frame it
+ * sends or receives to capture_frame().  That is a flag check unless a
+ * capture is running.
+ */
+
+typedef struct {
+    int32_t id;
+    uint16_t server_port;
+    uint32_t client_seq;
+    uint32_t server_seq;
+} capture_conn_t;
+
+extern volatile int capture_enabled;
+
+extern int capture_init(void);
+extern void capture_teardown(void);
+
+extern void capture_conn_open(capture_conn_t *conn, int server_port);
+extern void capture_frame_impl(capture_conn_t *conn, int from_server, const uint8_t *data, int size);
+
+#define capture_frame(conn, from_server, data, size) \
+    do { if(capture_enabled) capture_frame_impl((conn), (from_server), (data), (size)); } while(0)
+
+#endif
@@ -0,0 +1,860 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+#define LIBPLCTAGDLL_EXPORTS 1
+
+#include <limits.h>
+#include <stdlib.h>
+#include <lib/libplctag.h>
+#include <lib/tag.h>
+#include <lib/init.h>
+#include <lib/image.h>
+#include <platform.h>
+#include <util/debug.h>
+#include <util/hashtable.h>
+#include <util/rc.h>
+
+
+/*
+ * Shared memory tag images, see plc_tag_image_create().
+ *
+ * The publisher maps a named shared memory segment read/write.  It starts
+ * with a header, followed by max_tags fixed size slots.  Each slot has a
+ * sequence number, the time, status and size of the last read, the key
+ * and the data.  Only the tag's callback writes a slot.  It makes the
+ * sequence number odd, writes the slot and makes it even again.  Readers
+ * map the segment read-only, copy the slot and retry if the sequence
+ * number was odd or changed while they copied.
+ *
+ * All fields are fixed size and the 64-bit fields are at offsets that are
+ * multiples of eight so that 32 and 64-bit processes agree on the layout.
+ */
+
+#define INITIAL_IMAGE_TABLE_SIZE (11)
+#define IMAGE_ID_MASK (0xFFFFFFF)
+#define MAX_IMAGE_MAP_ATTEMPTS (50)
+
+#define IMAGE_MAGIC (0x54494C50) /* "PLIT" in little endian. */
+#define IMAGE_VERSION (1)
+#define IMAGE_KEY_SIZE (64)
+#define IMAGE_READ_SPINS (100)
+#define IMAGE_READ_ATTEMPTS (1000)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t header_size;
+    int32_t slot_size;
+    int32_t max_tags;
+    int32_t max_data_size;
+    volatile int64_t num_tags;
+    volatile int64_t closed;
+    int64_t created_ms;
+    int64_t publisher_pid;
+} image_header_t;
+
+typedef struct {
+    volatile int64_t seq;
+    int64_t timestamp_ms;
+    int32_t status;
+    int32_t data_size;
+    char key[IMAGE_KEY_SIZE];
+    /* max_data_size bytes of data follow, padded to a multiple of eight. */
+} image_slot_t;
+
+typedef struct {
+    image_slot_t *slot;
+    int max_data_size;
+    int32_t tag_id;
+} image_tag_t;
+
+struct plc_tag_image_t {
+    int32_t image_id;
+    mutex_p mutex;
+    shared_mem_p shm;
+    image_header_t *header;
+    int num_tags;
+    image_tag_t *tags;
+};
+
+typedef struct plc_tag_image_t *plc_tag_image_p;
+
+struct plc_tag_image_reader_t {
+    shared_mem_p shm;
+    const image_header_t *header;
+};
+
+
+static volatile int32_t next_image_id = 1;
+static volatile hashtable_p images = NULL;
+static mutex_p image_mutex = NULL;
+
+
+static plc_tag_image_p lookup_image(int32_t image_id);
+static void image_destroy(void *image_arg);
+static image_slot_t *get_slot(const image_header_t *header, int slot_index);
+static int image_is_stale(const char *name);
+static void image_tag_callback(int32_t tag_id, int event, int status, void *userdata);
+
+
+
+
+int image_init(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    pdebug(DEBUG_INFO,"Creating image hashtable.");
+    if((images = hashtable_create(INITIAL_IMAGE_TABLE_SIZE)) == NULL) {
+        pdebug(DEBUG_ERROR, "Unable to create image hashtable!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    pdebug(DEBUG_INFO,"Creating image mutex.");
+    rc = mutex_create((mutex_p *)&image_mutex);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to create image mutex!");
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+void image_teardown(void)
+{
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(images) {
+        pdebug(DEBUG_INFO, "Destroying image hashtable.");
+
+        plc_tag_generic_destroy_rc_table(images);
+        images = NULL;
+    }
+
+    if(image_mutex) {
+        pdebug(DEBUG_INFO,"Tearing down image mutex.");
+        mutex_destroy(&image_mutex);
+        image_mutex = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+
+/*
+ * plc_tag_image_create
+ *
+ * Create the shared memory segment for an image with room for max_tags
+ * tags of up to max_data_size bytes each.  See libplctag.h.
+ */
+
+LIB_EXPORT int32_t plc_tag_image_create(const char *name, int max_tags, int max_data_size)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_image_p image = NULL;
+    int32_t image_id = 0;
+    int64_t slot_size = 0;
+    int64_t total_size = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* make sure that the library is initialized. */
+    rc = initialize_modules();
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to initialize the internal library state!");
+        return rc;
+    }
+
+    if(!name || str_length(name) == 0) {
+        pdebug(DEBUG_WARN, "An image name is required!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    if(max_tags <= 0 || max_data_size <= 0) {
+        pdebug(DEBUG_WARN, "The tag count and data size must be positive!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    slot_size = (int64_t)sizeof(image_slot_t) + (((int64_t)max_data_size + 7) & ~(int64_t)7);
+    total_size = (int64_t)sizeof(image_header_t) + (slot_size * max_tags);
+
+    if(total_size > INT_MAX) {
+        pdebug(DEBUG_WARN, "An image of %d tags of %d bytes is too large!", max_tags, max_data_size);
+        return PLCTAG_ERR_TOO_LARGE;
+    }
+
+    image = (plc_tag_image_p)rc_alloc((int)sizeof(struct plc_tag_image_t), image_destroy);
+    if(!image) {
+        pdebug(DEBUG_WARN, "Unable to allocate image!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = mutex_create(&image->mutex);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to create image mutex!");
+        rc_dec(image);
+        return rc;
+    }
+
+    image->tags = (image_tag_t *)mem_alloc((int)sizeof(image_tag_t) * max_tags);
+    if(!image->tags) {
+        pdebug(DEBUG_WARN, "Unable to allocate image tags!");
+        rc_dec(image);
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = shared_mem_create(name, (int)total_size, &image->shm);
+
+    /* a live publisher keeps its image, one that closed it or went away does not. */
+    if(rc == PLCTAG_ERR_DUPLICATE && image_is_stale(name)) {
+        pdebug(DEBUG_INFO, "Replacing the stale image %s.", name);
+
+        rc = shared_mem_remove(name);
+        if(rc == PLCTAG_STATUS_OK) {
+            rc = shared_mem_create(name, (int)total_size, &image->shm);
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to create shared memory for image %s, error %s!", name, plc_tag_decode_error(rc));
+        rc_dec(image);
+        return rc;
+    }
+
+    /* the segment starts zero filled, no tags and all sequence numbers even. */
+    image->header = (image_header_t *)shared_mem_data(image->shm);
+    image->header->version = IMAGE_VERSION;
+    image->header->header_size = (int32_t)sizeof(image_header_t);
+    image->header->slot_size = (int32_t)slot_size;
+    image->header->max_tags = max_tags;
+    image->header->max_data_size = max_data_size;
+    image->header->created_ms = time_ms();
+    image->header->publisher_pid = process_id();
+
+    /* the magic goes last, readers check it first. */
+    mem_barrier();
+    image->header->magic = IMAGE_MAGIC;
+    mem_barrier();
+
+    rc = PLCTAG_ERR_NO_RESOURCES;
+
+    critical_block(image_mutex) {
+        for(int attempts = 0; attempts < MAX_IMAGE_MAP_ATTEMPTS; attempts++) {
+            image_id = (next_image_id + 1) & IMAGE_ID_MASK;
+
+            if(image_id == 0) {
+                image_id = 1;
+            }
+
+            next_image_id = image_id;
+
+            if(!hashtable_get(images, (int64_t)image_id)) {
+                image->image_id = image_id;
+                rc = hashtable_put(images, (int64_t)image_id, image);
+                break;
+            }
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to add image to the table, error %s!", plc_tag_decode_error(rc));
+        rc_dec(image);
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done, created image %d with %d bytes of shared memory.", image_id, (int)total_size);
+
+    return image_id;
+}
+
+
+
+/*
+ * plc_tag_image_add
+ *
+ * Create a tag read every rpi_ms milliseconds by the automatic reads and
+ * publish its data in the next free slot.  Returns the slot index.
+ */
+
+LIB_EXPORT int plc_tag_image_add(int32_t image_id, const char *key, int rpi_ms, const char *attrib_str)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_image_p image = NULL;
+    char *tag_attribs = NULL;
+    int index = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!key || str_length(key) == 0 || str_length(key) >= IMAGE_KEY_SIZE) {
+        pdebug(DEBUG_WARN, "The key must be between 1 and %d characters long!", IMAGE_KEY_SIZE - 1);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    image = lookup_image(image_id);
+    if(!image) {
+        pdebug(DEBUG_WARN, "Image %d not found!", image_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    rc = plc_tag_generic_make_auto_read_attribs(attrib_str, rpi_ms, &tag_attribs);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to set up the automatic reads for tag %s, error %s!", key, plc_tag_decode_error(rc));
+        rc_dec(image);
+        return rc;
+    }
+
+    critical_block(image->mutex) {
+        image_tag_t *itag = NULL;
+
+        if(image->num_tags >= image->header->max_tags) {
+            rc = PLCTAG_ERR_NO_RESOURCES;
+            break;
+        }
+
+        for(int i=0; i < image->num_tags; i++) {
+            if(str_cmp(image->tags[i].slot->key, key) == 0) {
+                rc = PLCTAG_ERR_DUPLICATE;
+                break;
+            }
+        }
+
+        if(rc != PLCTAG_STATUS_OK) {
+            break;
+        }
+
+        index = image->num_tags;
+        itag = &image->tags[index];
+        itag->slot = get_slot(image->header, index);
+        itag->max_data_size = image->header->max_data_size;
+
+        /* readers do not look at the slot until num_tags covers it. */
+        str_copy(itag->slot->key, IMAGE_KEY_SIZE, key);
+        itag->slot->status = PLCTAG_STATUS_PENDING;
+
+        /* the slot must be set before the first read completes. */
+        itag->tag_id = plc_tag_create_ex(tag_attribs, image_tag_callback, itag, 0);
+        if(itag->tag_id < 0) {
+            rc = itag->tag_id;
+            mem_set(itag->slot, 0, (int)sizeof(image_slot_t));
+            break;
+        }
+
+        image->num_tags++;
+
+        /* full barrier, the slot is ready before readers see it. */
+        atomic_counter_add(&image->header->num_tags, 1);
+    }
+
+    mem_free(tag_attribs);
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to add tag %s to image %d, error %s!", key, image_id, plc_tag_decode_error(rc));
+    }
+
+    rc_dec(image);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return (rc == PLCTAG_STATUS_OK ? index : rc);
+}
+
+
+
+/*
+ * plc_tag_image_get_tag_id
+ *
+ * Get the ID of the tag in a slot.  The image owns the tag, do not
+ * destroy it.
+ */
+
+LIB_EXPORT int32_t plc_tag_image_get_tag_id(int32_t image_id, int slot)
+{
+    int32_t rc = PLCTAG_ERR_OUT_OF_BOUNDS;
+    plc_tag_image_p image = lookup_image(image_id);
+
+    if(!image) {
+        pdebug(DEBUG_WARN, "Image %d not found!", image_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(image->mutex) {
+        if(slot >= 0 && slot < image->num_tags) {
+            rc = image->tags[slot].tag_id;
+        }
+    }
+
+    rc_dec(image);
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_image_destroy
+ *
+ * Mark the image closed for readers, destroy the tags and remove the
+ * shared memory segment.
+ */
+
+LIB_EXPORT int plc_tag_image_destroy(int32_t image_id)
+{
+    plc_tag_image_p image = NULL;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!images || !image_mutex) {
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(image_mutex) {
+        image = hashtable_remove(images, (int64_t)image_id);
+    }
+
+    if(!image) {
+        pdebug(DEBUG_WARN, "Image %d not found!", image_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    rc_dec(image);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+
+/*
+ * plc_tag_image_open
+ *
+ * Map an image published by another process, or this one, read-only.
+ * This does not initialize the library, no threads are started.
+ */
+
+LIB_EXPORT int plc_tag_image_open(const char *name, plc_tag_image_reader_p *reader)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_image_reader_p result = NULL;
+    const image_header_t *header = NULL;
+    int64_t needed = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!name || !reader) {
+        pdebug(DEBUG_WARN, "Called with null pointers!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    *reader = NULL;
+
+    result = (plc_tag_image_reader_p)mem_alloc((int)sizeof(struct plc_tag_image_reader_t));
+    if(!result) {
+        pdebug(DEBUG_WARN, "Unable to allocate image reader!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = shared_mem_open(name, &result->shm);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to open image %s, error %s!", name, plc_tag_decode_error(rc));
+        mem_free(result);
+        return rc;
+    }
+
+    header = (const image_header_t *)shared_mem_data(result->shm);
+
+    if(shared_mem_size(result->shm) < (int)sizeof(image_header_t) || header->magic != IMAGE_MAGIC) {
+        /* possibly caught the publisher before it finished the header. */
+        pdebug(DEBUG_WARN, "Shared memory %s is not a tag image, or is not ready yet!", name);
+        rc = PLCTAG_ERR_BAD_DATA;
+    } else {
+        mem_barrier();
+
+        needed = (int64_t)header->header_size + ((int64_t)header->slot_size * header->max_tags);
+
+        if(header->version != IMAGE_VERSION || header->header_size != (int32_t)sizeof(image_header_t)) {
+            pdebug(DEBUG_WARN, "Image %s has version %u, expected %d!", name, header->version, IMAGE_VERSION);
+            rc = PLCTAG_ERR_UNSUPPORTED;
+        } else if(header->slot_size < (int32_t)sizeof(image_slot_t) + header->max_data_size || needed > shared_mem_size(result->shm)) {
+            pdebug(DEBUG_WARN, "Image %s has a bad layout!", name);
+            rc = PLCTAG_ERR_BAD_DATA;
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        shared_mem_destroy(&result->shm);
+        mem_free(result);
+        return rc;
+    }
+
+    result->header = header;
+
+    *reader = result;
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_image_get_int_attribute
+ *
+ * Get num_tags, max_tags, max_data_size or closed from the image header.
+ */
+
+LIB_EXPORT int plc_tag_image_get_int_attribute(plc_tag_image_reader_p reader, const char *attrib_name, int default_value)
+{
+    const image_header_t *header = NULL;
+    int res = default_value;
+
+    if(!reader || !attrib_name) {
+        pdebug(DEBUG_WARN, "Called with null pointers!");
+        return default_value;
+    }
+
+    header = reader->header;
+
+    if(str_cmp_i(attrib_name, "num_tags") == 0) {
+        res = (int)header->num_tags;
+        mem_barrier();
+    } else if(str_cmp_i(attrib_name, "max_tags") == 0) {
+        res = header->max_tags;
+    } else if(str_cmp_i(attrib_name, "max_data_size") == 0) {
+        res = header->max_data_size;
+    } else if(str_cmp_i(attrib_name, "closed") == 0) {
+        res = (header->closed ? 1 : 0);
+    } else {
+        pdebug(DEBUG_WARN, "Unsupported image attribute \"%s\"!", attrib_name);
+    }
+
+    return res;
+}
+
+
+
+/*
+ * plc_tag_image_find
+ *
+ * Find the slot index of a key.  The slots are in the order the publisher
+ * added them, so look a key up once and keep the index.
+ */
+
+LIB_EXPORT int plc_tag_image_find(plc_tag_image_reader_p reader, const char *key)
+{
+    int num_tags = 0;
+
+    if(!reader || !key) {
+        pdebug(DEBUG_WARN, "Called with null pointers!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    num_tags = (int)reader->header->num_tags;
+    mem_barrier();
+
+    if(num_tags > reader->header->max_tags) {
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    for(int i=0; i < num_tags; i++) {
+        const image_slot_t *slot = get_slot(reader->header, i);
+
+        /* keys do not change once the slot is visible. */
+        if(slot->key[IMAGE_KEY_SIZE - 1] == 0 && str_cmp(slot->key, key) == 0) {
+            return i;
+        }
+    }
+
+    return PLCTAG_ERR_NOT_FOUND;
+}
+
+
+
+/*
+ * plc_tag_image_read
+ *
+ * Copy a consistent snapshot of a slot.  Returns the data size or an
+ * error.  This does not make system calls unless the publisher is in the
+ * middle of updating the slot for a long time.
+ */
+
+LIB_EXPORT int plc_tag_image_read(plc_tag_image_reader_p reader, int slot_index, uint8_t *buffer, int buffer_length, int64_t *timestamp_ms, int *status, uint32_t *seq)
+{
+    const image_header_t *header = NULL;
+    const image_slot_t *slot = NULL;
+    const uint8_t *data = NULL;
+    int num_tags = 0;
+
+    if(!reader) {
+        pdebug(DEBUG_WARN, "Reader pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(!buffer && buffer_length > 0) {
+        pdebug(DEBUG_WARN, "Buffer pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    header = reader->header;
+
+    if(header->closed) {
+        pdebug(DEBUG_DETAIL, "The publisher closed the image.");
+        return PLCTAG_ERR_ABORT;
+    }
+
+    num_tags = (int)header->num_tags;
+    mem_barrier();
+
+    if(slot_index < 0 || slot_index >= num_tags || slot_index >= header->max_tags) {
+        pdebug(DEBUG_WARN, "Slot %d is out of bounds!", slot_index);
+        return PLCTAG_ERR_OUT_OF_BOUNDS;
+    }
+
+    slot = get_slot(header, slot_index);
+    data = (const uint8_t *)(slot + 1);
+
+    for(int attempt = 0; attempt < IMAGE_READ_ATTEMPTS; attempt++) {
+        int64_t seq_start = slot->seq;
+        int64_t slot_timestamp = 0;
+        int slot_status = 0;
+        int data_size = 0;
+
+        mem_barrier();
+
+        if((seq_start & 1) == 0) {
+            slot_timestamp = slot->timestamp_ms;
+            slot_status = slot->status;
+            data_size = slot->data_size;
+
+            if(data_size < 0 || data_size > header->max_data_size) {
+                data_size = -1; /* torn, the sequence check below catches it. */
+            } else if(data_size <= buffer_length) {
+                mem_copy(buffer, (uint8_t *)data, data_size);
+            }
+
+            mem_barrier();
+
+            if(slot->seq == seq_start && data_size >= 0) {
+                if(timestamp_ms) {
+                    *timestamp_ms = slot_timestamp;
+                }
+
+                if(status) {
+                    *status = slot_status;
+                }
+
+                if(seq) {
+                    *seq = (uint32_t)(seq_start >> 1);
+                }
+
+                return (data_size <= buffer_length ? data_size : PLCTAG_ERR_TOO_SMALL);
+            }
+        }
+
+        /* the publisher is part way through an update. */
+        if(attempt >= IMAGE_READ_SPINS) {
+            sleep_ms(1);
+        }
+    }
+
+    pdebug(DEBUG_WARN, "Slot %d stayed busy, the publisher may have died during an update.", slot_index);
+
+    return PLCTAG_ERR_BUSY;
+}
+
+
+
+LIB_EXPORT int plc_tag_image_close(plc_tag_image_reader_p reader)
+{
+    if(!reader) {
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    shared_mem_destroy(&reader->shm);
+    mem_free(reader);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+
+/*****************************************************************************************************
+ ****************************************** Support Functions ****************************************
+ *****************************************************************************************************/
+
+
+plc_tag_image_p lookup_image(int32_t image_id)
+{
+    plc_tag_image_p image = NULL;
+
+    if(!images || !image_mutex) {
+        return NULL;
+    }
+
+    critical_block(image_mutex) {
+        image = rc_inc(hashtable_get(images, (int64_t)image_id));
+    }
+
+    return image;
+}
+
+
+
+/*
+ * An existing segment can be replaced if it is an image that its publisher
+ * closed or whose publisher is no longer running.  Anything else, including
+ * an image whose publisher has not finished the header yet, is in use.
+ */
+
+int image_is_stale(const char *name)
+{
+    shared_mem_p shm = NULL;
+    const image_header_t *header = NULL;
+    int stale = 0;
+
+    if(shared_mem_open(name, &shm) != PLCTAG_STATUS_OK) {
+        return 0;
+    }
+
+    header = (const image_header_t *)shared_mem_data(shm);
+
+    if(shared_mem_size(shm) >= (int)sizeof(image_header_t) && header->magic == IMAGE_MAGIC) {
+        mem_barrier();
+
+        stale = (header->closed || !process_is_running(header->publisher_pid));
+    }
+
+    shared_mem_destroy(&shm);
+
+    return stale;
+}
+
+
+
+void image_destroy(void *image_arg)
+{
+    plc_tag_image_p image = (plc_tag_image_p)image_arg;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* tell readers first, they keep their mapping after the name is removed. */
+    if(image->header) {
+        atomic_counter_add(&image->header->closed, 1);
+    }
+
+    /* destroying a tag waits for its callback, after this nothing writes the slots. */
+    if(image->tags) {
+        for(int i = image->num_tags - 1; i >= 0; i--) {
+            plc_tag_destroy(image->tags[i].tag_id);
+        }
+
+        mem_free(image->tags);
+        image->tags = NULL;
+    }
+
+    if(image->shm) {
+        shared_mem_destroy(&image->shm);
+        image->header = NULL;
+    }
+
+    if(image->mutex) {
+        mutex_destroy(&image->mutex);
+        image->mutex = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+image_slot_t *get_slot(const image_header_t *header, int slot_index)
+{
+    return (image_slot_t *)((uint8_t *)header + header->header_size + ((intptr_t)header->slot_size * slot_index));
+}
+
+
+
+/*
+ * Publish a completed read.  This runs in the library's thread with the
+ * tag's API mutex held, so only one update of a slot runs at a time.
+ */
+
+void image_tag_callback(int32_t tag_id, int event, int status, void *userdata)
+{
+    image_tag_t *itag = (image_tag_t *)userdata;
+    image_slot_t *slot = NULL;
+    int size = -1;
+
+    if(event != PLCTAG_EVENT_READ_COMPLETED || !itag) {
+        return;
+    }
+
+    slot = itag->slot;
+
+    if(status == PLCTAG_STATUS_OK) {
+        size = plc_tag_get_size(tag_id);
+
+        if(size < 0) {
+            status = size;
+        } else if(size > itag->max_data_size) {
+            status = PLCTAG_ERR_TOO_LARGE;
+            size = itag->max_data_size;
+        }
+    }
+
+    /* odd, readers retry until the update is done. */
+    atomic_counter_add(&slot->seq, 1);
+
+    slot->status = status;
+
+    /* a failed read keeps the last good data and its time. */
+    if(size >= 0) {
+        plc_tag_get_raw_bytes(tag_id, 0, (uint8_t *)(slot + 1), size);
+        slot->data_size = size;
+        slot->timestamp_ms = time_ms();
+    }
+
+    atomic_counter_add(&slot->seq, 1);
+}
@@ -42,6 +42,9 @@
 #include <omron/omron.h>
 #include <system/system.h>
 #include <lib/init.h>
+#include <lib/capture.h>
+#include <lib/image.h>
+#include <lib/poller.h>
 
 
 
@@ -60,6 +63,7 @@ struct {
 } tag_type_map[] = {
     /* System tags */
     {NULL, "system", "library", NULL, system_tag_create},
+    {"system", NULL, NULL, NULL, system_tag_create},
     /* Allen-Bradley PLCs */
     {"ab-eip", NULL, NULL, NULL, ab_tag_create},
     {"ab_eip", NULL, NULL, NULL, ab_tag_create},
@@ -143,12 +147,18 @@ tag_create_function find_tag_create_func(attr attributes)
 
 void destroy_modules(void)
 {
+    poller_teardown();
+
+    image_teardown();
+
     ab_teardown();
 
     mb_teardown();
 
     omron_teardown();
 
+    capture_teardown();
+
     lib_teardown();
 
     spin_block(&library_initialization_lock) {
@@ -225,6 +235,21 @@ int initialize_modules(void)
                     rc = omron_init();
                 }
 
+                pdebug(DEBUG_INFO,"Initializing poller module.");
+                if(rc == PLCTAG_STATUS_OK) {
+                    rc = poller_init();
+                }
+
+                pdebug(DEBUG_INFO,"Initializing image module.");
+                if(rc == PLCTAG_STATUS_OK) {
+                    rc = image_init();
+                }
+
+                pdebug(DEBUG_INFO,"Initializing capture module.");
+                if(rc == PLCTAG_STATUS_OK) {
+                    rc = capture_init();
+                }
+
                 /* hook the destructor */
                 atexit(plc_tag_shutdown);
 
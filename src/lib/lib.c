@@ -37,6 +37,7 @@
 #include <float.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <lib/libplctag.h>
 #include <lib/tag.h>
@@ -48,6 +49,7 @@
 #include <util/debug.h>
 #include <util/hash.h>
 #include <util/hashtable.h>
+#include <util/metrics.h>
 #include <util/rc.h>
 #include <util/vector.h>
 #include <ab/ab.h>
@@ -73,6 +75,132 @@ static cond_p tag_tickler_wait = NULL;
 #define TAG_TICKLER_TIMEOUT_MIN_MS (10)
 static int64_t tag_tickler_wait_timeout_end = 0;
 
+/* transactions, see plc_tag_txn_create(). */
+#define INITIAL_TXN_TABLE_SIZE (31)
+#define TXN_OPS_INC (8)
+
+/* a readback handle gets a real read of its own. */
+#define TXN_READBACK_ATTRIBS "&read_cache_ms=0&auto_sync_read_ms=0&auto_sync_write_ms=0&on_change=0&history=0&double_buffer=0"
+
+typedef struct {
+    int32_t tag_id;
+    int32_t readback_tag_id;
+    int is_write;
+    int phase;
+    int held;
+} txn_op_t;
+
+struct plc_tag_txn_t {
+    int32_t txn_id;
+    int in_flight;
+    int starting;
+    int waiting;
+    int aborting;
+    int phase;
+    int num_phases;
+    int num_ops;
+    int ops_capacity;
+    txn_op_t *ops;
+    int *op_status;
+    void (*callback)(int32_t txn_id, int num_ops, const int *op_status, void *userdata);
+    void *userdata;
+};
+
+typedef struct plc_tag_txn_t *plc_tag_txn_p;
+
+/* batch ID for the automatic reads and writes started in one pass of the tickler.  Transaction IDs are positive. */
+#define AUTO_SYNC_BATCH_ID (-1)
+
+static volatile int32_t next_txn_id = 1;
+static volatile hashtable_p txns = NULL;
+static mutex_p txn_mutex = NULL;
+
+/*
+ * automatic read schedule groups.  Tags on the same connection with the same
+ * read period share a phase so that their reads fall due in the same pass of
+ * the tickler and are packed together.  The groups of one period are spread
+ * across it so that they do not all fall due at once.  The groups are kept by
+ * ID.  The group that new tags of a connection and period go into is kept by
+ * the connection and period.
+ */
+#define AUTO_SYNC_READ_GROUP_SIZE (50)
+
+typedef struct {
+    int32_t group_id;
+    uint32_t conn_key;
+    int32_t period_ms;
+    int32_t phase_index;
+    int64_t phase_ms;
+    int num_tags;
+} auto_read_group_t;
+
+typedef struct {
+    int32_t period_ms;
+    int num_phases;
+    uint8_t *phase_used;
+} auto_read_phase_check_t;
+
+static volatile int32_t next_auto_read_group_id = 1;
+static hashtable_p auto_read_groups = NULL;
+static hashtable_p auto_read_open_groups = NULL;
+static mutex_p auto_read_mutex = NULL;
+
+/* the tags of one automatic read group held by the tickler in a pass. */
+typedef struct {
+    int num_tags;
+    vector_p tags;
+} held_group_t;
+
+/*
+ * published copies of the data of double-buffered tags.  The I/O path and the
+ * setters change tag->data under the API mutex as usual.  When a change is done,
+ * the bytes it touched are copied into the spare copy and one atomic increment
+ * of the sequence number publishes it.  The low bit of the sequence number picks
+ * the published copy.  Getters read the published copy without the mutex and
+ * read again if the sequence number moved meanwhile.  Copies that are replaced
+ * by larger ones are kept until the tag is freed as readers may still be in them.
+ */
+typedef struct {
+    int32_t capacity;
+    int32_t size;
+    uint8_t data[];
+} tag_data_copy_t;
+
+struct tag_data_pub_t {
+    volatile int64_t seq;
+    tag_data_copy_t * volatile copies[2];
+    int32_t dirty_start[2];
+    int32_t dirty_end[2];
+    tag_data_copy_t **retired;
+    int num_retired;
+};
+
+/*
+ * Tags created with history=N keep the last N reads in a ring.  The data
+ * is allocated for the tag's size on the first read and the ring is
+ * cleared if the size changes.  It is only used with the API mutex held.
+ */
+struct tag_history_t {
+    int32_t capacity;
+    int32_t entry_size;
+    int32_t head;
+    int32_t count;
+    int64_t overruns;
+    int64_t *timestamps_us;
+    int32_t *statuses;
+    uint8_t *data;
+};
+
+/*
+ * The getters read the tag data inside a tag_data_read_block().  This holds the
+ * API mutex for most tags.  For double-buffered tags, it points data and size at
+ * the published copy and runs the block again if a new copy was published while
+ * it ran, so the block must only compute results.
+ */
+#define TAG_DATA_READ_DONE (-1)
+#define tag_data_read_block(tag, data, size) \
+for(int64_t __read_seq_nargle = tag_data_read_start(tag, &(data), &(size)); __read_seq_nargle != TAG_DATA_READ_DONE; __read_seq_nargle = tag_data_read_next(tag, __read_seq_nargle, &(data), &(size))) for(int __read_flag_nargle = 1; __read_flag_nargle; __read_flag_nargle = 0)
+
 //static mutex_p global_library_mutex = NULL;
 
 
@@ -89,6 +217,39 @@ static int get_string_length_unsafe(plc_tag_p tag, int offset);
 static int resize_tag_buffer_at_offset_unsafe(plc_tag_p tag, int old_split_index, int new_split_index);
 static int resize_tag_buffer_unsafe(plc_tag_p tag, int new_size);
 static int get_new_string_total_length_unsafe(plc_tag_p tag, const char *string_val);
+static plc_tag_txn_p lookup_txn(int32_t txn_id);
+static int txn_add_op(int32_t txn_id, int32_t tag_id, int is_write);
+static int32_t txn_create_readback(int32_t tag_id);
+static int32_t txn_op_tag_id(txn_op_t *op);
+static void txn_start(plc_tag_txn_p txn);
+static void txn_start_phase(plc_tag_txn_p txn);
+static void txn_end_starting(plc_tag_txn_p txn);
+static void txn_abort(plc_tag_txn_p txn);
+static int txn_copy_readback(txn_op_t *op);
+static void txn_tickler(vector_p tick_txns, vector_p op_tags);
+static void txn_destroy(void *txn_arg);
+static uint32_t auto_read_conn_key(attr attribs);
+static void auto_read_join(plc_tag_p tag);
+static void auto_read_leave(plc_tag_p tag);
+static int64_t auto_read_phase(int32_t period_ms, int32_t phase_index);
+static int64_t auto_read_open_key(uint32_t conn_key, int32_t period_ms);
+static int auto_read_mark_phase(hashtable_p table, int64_t key, void *data, void *context);
+static int auto_read_free_group(hashtable_p table, int64_t key, void *data, void *context);
+static int auto_read_group_size(int32_t group_id);
+static void release_held_tags(vector_p held_tags);
+static held_group_t *held_group_add(hashtable_p held_groups, plc_tag_p tag);
+static void held_group_release(hashtable_p held_groups, int32_t group_id, held_group_t *group);
+static int held_group_release_entry(hashtable_p held_groups, int64_t key, void *data, void *context);
+static int snapshot_entry(hashtable_p table, int64_t key, void *data, void *context);
+static void release_generic_tag_data(plc_tag_p tag);
+static double get_change_float(plc_tag_p tag, uint8_t *data, int offset);
+static int data_pub_create(plc_tag_p tag);
+static int history_create(plc_tag_p tag, int capacity);
+static void history_destroy(plc_tag_p tag);
+static void data_pub_get_published(plc_tag_p tag, int64_t seq, const uint8_t **data, int32_t *size);
+static int64_t tag_data_read_start(plc_tag_p tag, const uint8_t **data, int32_t *size);
+static int64_t tag_data_read_next(plc_tag_p tag, int64_t seq, const uint8_t **data, int32_t *size);
+static int get_byte_order_attrib(plc_tag_p tag, const char *attrib_name, uint8_t *buffer, int buffer_length);
 
 
 #ifdef LIPLCTAGDLL_EXPORTS
@@ -157,6 +318,30 @@ int lib_init(void)
         pdebug(DEBUG_ERROR, "Unable to create tag condition var!");
     }
 
+    pdebug(DEBUG_INFO,"Creating transaction hashtable.");
+    if((txns = hashtable_create(INITIAL_TXN_TABLE_SIZE)) == NULL) {
+        pdebug(DEBUG_ERROR, "Unable to create transaction hashtable!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    pdebug(DEBUG_INFO,"Creating transaction mutex.");
+    rc = mutex_create((mutex_p *)&txn_mutex);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to create transaction mutex!");
+    }
+
+    pdebug(DEBUG_INFO,"Creating automatic read group tables.");
+    if((auto_read_groups = hashtable_create(64)) == NULL || (auto_read_open_groups = hashtable_create(16)) == NULL) {
+        pdebug(DEBUG_ERROR, "Unable to create automatic read group tables!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    pdebug(DEBUG_INFO,"Creating automatic read group mutex.");
+    rc = mutex_create((mutex_p *)&auto_read_mutex);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to create automatic read group mutex!");
+    }
+
     pdebug(DEBUG_INFO,"Creating tag tickler thread.");
     rc = thread_create(&tag_tickler_thread, tag_tickler_func, 32*1024, NULL);
     if (rc != PLCTAG_STATUS_OK) {
@@ -201,6 +386,38 @@ void lib_teardown(void)
         tag_lookup_mutex = NULL;
     }
 
+    if(txns) {
+        pdebug(DEBUG_INFO, "Destroying transaction hashtable.");
+
+        plc_tag_generic_destroy_rc_table(txns);
+        txns = NULL;
+    }
+
+    if(txn_mutex) {
+        pdebug(DEBUG_INFO,"Tearing down transaction mutex.");
+        mutex_destroy(&txn_mutex);
+        txn_mutex = NULL;
+    }
+
+    if(auto_read_open_groups) {
+        hashtable_destroy(auto_read_open_groups);
+        auto_read_open_groups = NULL;
+    }
+
+    if(auto_read_groups) {
+        pdebug(DEBUG_INFO, "Destroying automatic read groups.");
+
+        hashtable_on_each(auto_read_groups, auto_read_free_group, NULL);
+        hashtable_destroy(auto_read_groups);
+        auto_read_groups = NULL;
+    }
+
+    if(auto_read_mutex) {
+        pdebug(DEBUG_INFO,"Tearing down automatic read group mutex.");
+        mutex_destroy(&auto_read_mutex);
+        auto_read_mutex = NULL;
+    }
+
     if(tags) {
         pdebug(DEBUG_INFO, "Destroying tag hashtable.");
         hashtable_destroy(tags);
@@ -302,8 +519,12 @@ void plc_tag_generic_tickler(plc_tag_p tag)
 
                 /* have we already done something about automatic reads? */
                 if(!tag->auto_sync_next_write) {
-                    /* we need to queue up a new write. */
-                    tag->auto_sync_next_write = time_ms() + tag->auto_sync_write_ms;
+                    /*
+                     * we need to queue up a new write.  Round up to the tickler's shortest wait
+                     * so that tags written close together fall due in the same pass.
+                     */
+                    tag->auto_sync_next_write = time_ms() + tag->auto_sync_write_ms + (TAG_TICKLER_TIMEOUT_MIN_MS - 1);
+                    tag->auto_sync_next_write -= tag->auto_sync_next_write % TAG_TICKLER_TIMEOUT_MIN_MS;
 
                     pdebug(DEBUG_DETAIL, "Queueing up automatic write in %dms.", tag->auto_sync_write_ms);
                 } else if(!tag->write_in_flight && tag->auto_sync_next_write <= time_ms()) {
@@ -322,6 +543,14 @@ void plc_tag_generic_tickler(plc_tag_p tag)
                     tag->write_in_flight = 1;
                     tag->auto_sync_next_write = 0;
 
+                    /*
+                     * hold the connection so that all the writes due in this pass of the
+                     * tickler go out together.  The tickler releases it after the pass.
+                     */
+                    if(!tag->skip_tickler && !tag->auto_sync_held && tag->vtable && tag->vtable->batch_hold && tag->vtable->batch_release) {
+                        tag->auto_sync_held = (tag->vtable->batch_hold(tag) == PLCTAG_STATUS_OK);
+                    }
+
                     if(tag->vtable && tag->vtable->write) {
                         tag->status = (int8_t)tag->vtable->write(tag);
                     }
@@ -336,21 +565,22 @@ void plc_tag_generic_tickler(plc_tag_p tag)
         if(tag->auto_sync_read_ms > 0) {
             int64_t current_time = time_ms();
 
-            // /* spread these out randomly to avoid too much clustering. */
-            // if(tag->auto_sync_next_read == 0) {
-            //     tag->auto_sync_next_read = current_time - (rand() % tag->auto_sync_read_ms);
-            // }
-
             /* do we need to read? */
-            if(tag->auto_sync_next_read < current_time) {
+            if(tag->auto_sync_next_read <= current_time) {
                 /* make sure that we do not have an outstanding read or write. */
                 if(!tag->read_in_flight && !tag->tag_is_dirty && !tag->write_in_flight) {
+                    int64_t late_ms = current_time - tag->auto_sync_next_read;
                     int64_t periods = 0;
 
                     pdebug(DEBUG_DETAIL, "Triggering automatic read start.");
 
                     tag->read_in_flight = 1;
 
+                    /* hold the connection so that the reads of the tag's schedule group go out together. */
+                    if(!tag->skip_tickler && !tag->auto_sync_held && tag->vtable && tag->vtable->batch_hold && tag->vtable->batch_release) {
+                        tag->auto_sync_held = (tag->vtable->batch_hold(tag) == PLCTAG_STATUS_OK);
+                    }
+
                     if(tag->vtable && tag->vtable->read) {
                         tag->status = (int8_t)tag->vtable->read(tag);
                     }
@@ -364,15 +594,20 @@ void plc_tag_generic_tickler(plc_tag_p tag)
                     * Note that there will be some jitter.  In that case we want to skip
                     * to the next read time that is a whole multiple of the read period.
                     *
-                    * This keeps the jitter from slowly moving the polling cycle.
+                    * This keeps the jitter from slowly moving the polling cycle and keeps
+                    * the tag in step with the rest of its schedule group.
                     *
-                    * Round up to the next period.
+                    * Every whole period we are late is a missed deadline.
                     */
-                    periods = (current_time - tag->auto_sync_next_read + (tag->auto_sync_read_ms - 1))/tag->auto_sync_read_ms;
+                    periods = (late_ms / tag->auto_sync_read_ms) + 1;
+
+                    metrics_hist_record(&(metrics_tickler.read_late_us), late_ms * 1000);
 
-                    /* warn if we need to skip more than one period. */
                     if(periods > 1) {
-                        pdebug(DEBUG_WARN, "Skipping %" PRId64 " periods of %" PRId32 "ms.", periods, tag->auto_sync_read_ms);
+                        pdebug(DEBUG_WARN, "Missed %" PRId64 " deadlines of %" PRId32 "ms.", periods - 1, tag->auto_sync_read_ms);
+
+                        tag->auto_sync_read_misses += (int32_t)(periods - 1);
+                        atomic_counter_add(&(metrics_tickler.read_misses), periods - 1);
                     }
 
                     tag->auto_sync_next_read += (periods * tag->auto_sync_read_ms);
@@ -440,6 +675,13 @@ void plc_tag_generic_handle_event_callbacks(plc_tag_p tag)
                 tag->event_read_complete_status = PLCTAG_STATUS_OK;
             }
 
+            /* did the read change the data? */
+            if(tag->event_value_changed) {
+                pdebug(DEBUG_DETAIL, "Tag value changed.");
+                tag->callback(tag->tag_id, PLCTAG_EVENT_VALUE_CHANGED, PLCTAG_STATUS_OK, tag->userdata);
+                tag->event_value_changed = 0;
+            }
+
             /* was there a write completion? */
             if(tag->event_write_complete) {
                 pdebug(DEBUG_DETAIL, "Tag write completed with status %s.", plc_tag_decode_error(tag->event_write_complete_status));
@@ -463,6 +705,143 @@ void plc_tag_generic_handle_event_callbacks(plc_tag_p tag)
 
 
 
+/*
+ * plc_tag_generic_get_tag_count
+ *
+ * Returns the number of tags currently in the tag lookup table.
+ */
+
+int plc_tag_generic_get_tag_count(void)
+{
+    int count = 0;
+
+    if(!tag_lookup_mutex) {
+        return 0;
+    }
+
+    critical_block(tag_lookup_mutex) {
+        count = hashtable_entries(tags);
+    }
+
+    return count;
+}
+
+
+
+/*
+ * plc_tag_generic_make_auto_read_attribs
+ *
+ * Check the attribute string and RPI of a tag added to a poller or image and
+ * build the attribute string with auto_sync_read_ms set to the RPI.  This
+ * overrides any automatic read period already in the string.  The caller
+ * frees the new string.
+ */
+
+int plc_tag_generic_make_auto_read_attribs(const char *attrib_str, int rpi_ms, char **tag_attribs)
+{
+    char rpi_buf[16] = {0,};
+
+    if(!tag_attribs) {
+        pdebug(DEBUG_WARN, "Called with null output pointer!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    *tag_attribs = NULL;
+
+    if(!attrib_str || str_length(attrib_str) == 0) {
+        pdebug(DEBUG_WARN, "An attribute string is required!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    if(rpi_ms <= 0) {
+        pdebug(DEBUG_WARN, "The RPI must be positive, got %d!", rpi_ms);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    snprintf_platform(rpi_buf, sizeof(rpi_buf), "%d", rpi_ms);
+
+    *tag_attribs = str_concat(attrib_str, "&auto_sync_read_ms=", rpi_buf);
+    if(!*tag_attribs) {
+        pdebug(DEBUG_WARN, "Unable to allocate memory for the tag attribute string!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * plc_tag_generic_check_value_change
+ *
+ * Compare the tag data after a completed read with the copy saved at the
+ * last change.   Without a deadband any byte that differs is a change.
+ * With one, the data is compared as floats and only an element that moved
+ * by more than the deadband is a change.   Bit tags only look at their bit.
+ *
+ * Returns 1 and saves the data if it changed.  The caller must hold the
+ * tag API mutex.
+ */
+
+int plc_tag_generic_check_value_change(plc_tag_p tag)
+{
+    int changed = 0;
+
+    if(!tag->data || tag->size <= 0) {
+        return 0;
+    }
+
+    /* the first value, or the tag changed size. */
+    if(!tag->change_shadow || tag->change_shadow_size != tag->size) {
+        if(tag->change_shadow) {
+            mem_free(tag->change_shadow);
+        }
+
+        tag->change_shadow_size = 0;
+        tag->change_shadow = mem_alloc(tag->size);
+        if(!tag->change_shadow) {
+            pdebug(DEBUG_WARN, "Unable to allocate change detection buffer!");
+            return 1;
+        }
+
+        mem_copy(tag->change_shadow, tag->data, tag->size);
+        tag->change_shadow_size = tag->size;
+
+        return 1;
+    }
+
+    if(tag->is_bit) {
+        int byte_offset = tag->bit / 8;
+        uint8_t mask = (uint8_t)(1 << (tag->bit % 8));
+
+        changed = (byte_offset < tag->size && ((tag->data[byte_offset] ^ tag->change_shadow[byte_offset]) & mask));
+    } else if(tag->change_float_size > 0) {
+        int offset = 0;
+
+        for(offset = 0; !changed && offset + tag->change_float_size <= tag->size; offset += tag->change_float_size) {
+            double diff = get_change_float(tag, tag->data, offset) - get_change_float(tag, tag->change_shadow, offset);
+
+            /* NaN compares false, so moving to or from NaN is a change. */
+            changed = !((diff < 0.0 ? -diff : diff) <= tag->change_deadband);
+        }
+
+        /* anything after the last whole float must match exactly. */
+        if(!changed && offset < tag->size) {
+            changed = (mem_cmp(tag->data + offset, tag->size - offset, tag->change_shadow + offset, tag->size - offset) != 0);
+        }
+    } else {
+        changed = (mem_cmp(tag->data, tag->size, tag->change_shadow, tag->size) != 0);
+    }
+
+    if(changed) {
+        mem_copy(tag->change_shadow, tag->data, tag->size);
+    }
+
+    return changed;
+}
+
+
+
 int plc_tag_generic_init_tag(plc_tag_p tag, attr attribs, void (*tag_callback_func)(int32_t tag_id, int event, int status, void *userdata), void *userdata)
 {
     int rc = PLCTAG_STATUS_OK;
@@ -509,44 +888,66 @@ int plc_tag_generic_init_tag(plc_tag_p tag, attr attribs, void (*tag_callback_fu
 
 THREAD_FUNC(tag_tickler_func)
 {
+    vector_p held_tags = NULL;
+    hashtable_p held_groups = NULL;
+    vector_p tick_tags = NULL;
+    vector_p tick_txns = NULL;
+    int64_t planned_wake_us = 0;
+
     (void)arg;
 
     debug_set_tag_id(0);
 
     pdebug(DEBUG_INFO, "Starting.");
 
+    tick_tags = vector_create(100, 100); /* MAGIC */
+    tick_txns = vector_create(10, 10);
+    if(!tick_tags || !tick_txns) {
+        pdebug(DEBUG_ERROR, "Unable to allocate vectors for the tags and transactions to tickle!");
+
+        if(tick_tags) {
+            vector_destroy(tick_tags);
+        }
+
+        THREAD_RETURN(0);
+    }
+
+    held_tags = vector_create(10, 10);
+    if(!held_tags) {
+        pdebug(DEBUG_WARN, "Unable to allocate vector for automatic operation batches, reads and writes will not be batched!");
+    }
+
+    held_groups = hashtable_create(10);
+    if(!held_groups) {
+        pdebug(DEBUG_WARN, "Unable to allocate table for automatic read groups, groups will go out at the end of each pass!");
+    }
+
     while(!atomic_get(&library_terminating)) {
-        int max_index = 0;
         int64_t timeout_wait_ms = TAG_TICKLER_TIMEOUT_MS;
+        int64_t loop_start_us = time_monotonic_us();
+
+        /* how late are we compared to the wake up time we planned for?  Early wake ups count as on time. */
+        if(planned_wake_us > 0) {
+            int64_t lag_us = loop_start_us - planned_wake_us;
+
+            metrics_hist_record(&(metrics_tickler.lag_us), (lag_us > 0 ? lag_us : 0));
+        }
 
         /* what is the maximum time we will wait until */
         tag_tickler_wait_timeout_end = time_ms() + timeout_wait_ms;
 
+        /* take a reference to each tag so that the table is not locked while the tags are tickled. */
         critical_block(tag_lookup_mutex) {
-            max_index = hashtable_capacity(tags);
+            hashtable_on_each(tags, snapshot_entry, tick_tags);
         }
 
-        for(int i=0; i < max_index; i++) {
-            plc_tag_p tag = NULL;
-
-            critical_block(tag_lookup_mutex) {
-                /* look up the max index again. it may have changed. */
-                max_index = hashtable_capacity(tags);
-
-                if(i < max_index) {
-                    tag = hashtable_get_index(tags, i);
-
-                    if(tag) {
-                        debug_set_tag_id(tag->tag_id);
-                        tag = rc_inc(tag);
-                    }
-                } else {
-                    debug_set_tag_id(0);
-                    tag = NULL;
-                }
-            }
+        for(int i=0; i < vector_length(tick_tags); i++) {
+            plc_tag_p tag = vector_get(tick_tags, i);
 
             if(tag) {
+                held_group_t *held_group = NULL;
+                int32_t held_group_id = 0;
+
                 debug_set_tag_id(tag->tag_id);
 
                 if(!tag->skip_tickler) {
@@ -587,6 +988,18 @@ THREAD_FUNC(tag_tickler_func)
                             }
                         }
 
+                        /* keep track of the connections held for automatic reads and writes, by read group where we can. */
+                        if(tag->auto_sync_held) {
+                            if(tag->auto_sync_read_group && (held_group = held_group_add(held_groups, tag))) {
+                                held_group_id = tag->auto_sync_read_group;
+                            } else if(held_tags) {
+                                vector_put(held_tags, vector_length(held_tags), rc_inc(tag));
+                            } else {
+                                tag->vtable->batch_release(tag, AUTO_SYNC_BATCH_ID);
+                                tag->auto_sync_held = 0;
+                            }
+                        }
+
                         /* wake up earlier if the time until the next write wake up is sooner. */
                         if(tag->auto_sync_next_write && tag->auto_sync_next_write < tag_tickler_wait_timeout_end) {
                             tag_tickler_wait_timeout_end = tag->auto_sync_next_write;
@@ -606,6 +1019,11 @@ THREAD_FUNC(tag_tickler_func)
                         pdebug(DEBUG_DETAIL, "Skipping tag as it is already locked.");
                     }
 
+                    /* once all of a read group is started, do not keep its connection waiting for the rest of the pass. */
+                    if(held_group && vector_length(held_group->tags) >= held_group->num_tags) {
+                        held_group_release(held_groups, held_group_id, held_group);
+                    }
+
                 } else {
                     pdebug(DEBUG_DETAIL, "Tag has its own tickler.");
                 }
@@ -618,13 +1036,32 @@ THREAD_FUNC(tag_tickler_func)
                 debug_set_tag_id(0);
             }
 
-            if(tag) {
-                rc_dec(tag);
-            }
-
             debug_set_tag_id(0);
         }
 
+        /* drop the references taken above. */
+        while(vector_length(tick_tags) > 0) {
+            rc_dec(vector_remove(tick_tags, vector_length(tick_tags) - 1));
+        }
+
+        /* send the rest of the automatic reads and writes started in this pass. */
+        release_held_tags(held_tags);
+
+        if(held_groups && hashtable_entries(held_groups) > 0) {
+            hashtable_on_each(held_groups, held_group_release_entry, NULL);
+            hashtable_destroy(held_groups);
+
+            held_groups = hashtable_create(10);
+            if(!held_groups) {
+                pdebug(DEBUG_WARN, "Unable to allocate table for automatic read groups, groups will go out at the end of each pass!");
+            }
+        }
+
+        /* complete transactions or start their next phase. */
+        txn_tickler(tick_txns, tick_tags);
+
+        metrics_hist_record(&(metrics_tickler.loop_us), time_monotonic_us() - loop_start_us);
+
         if(tag_tickler_wait) {
             int64_t time_to_wait = tag_tickler_wait_timeout_end - time_ms();
             int wait_rc = PLCTAG_STATUS_OK;
@@ -633,6 +1070,9 @@ THREAD_FUNC(tag_tickler_func)
                 time_to_wait = TAG_TICKLER_TIMEOUT_MIN_MS;
             }
 
+            /* the wake up time is kept on the monotonic clock so that the lag is not thrown off by clock changes. */
+            planned_wake_us = time_monotonic_us() + (time_to_wait * 1000);
+
             if(time_to_wait > 0) {
                 wait_rc = cond_wait(tag_tickler_wait, (int)time_to_wait);
                 if(wait_rc == PLCTAG_ERR_TIMEOUT) {
@@ -644,6 +1084,17 @@ THREAD_FUNC(tag_tickler_func)
         }
     }
 
+    if(held_tags) {
+        vector_destroy(held_tags);
+    }
+
+    if(held_groups) {
+        hashtable_destroy(held_groups);
+    }
+
+    vector_destroy(tick_tags);
+    vector_destroy(tick_txns);
+
     debug_set_tag_id(0);
 
     pdebug(DEBUG_INFO,"Terminating.");
@@ -834,6 +1285,8 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
     int read_cache_ms = 0;
     tag_create_function tag_constructor;
 	int debug_level = -1;
+    int double_buffer = 0;
+    int history_size = 0;
 
     /* we are creating a tag, there is no ID yet. */
     debug_set_tag_id(0);
@@ -926,14 +1379,11 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
         attr_destroy(attribs);
         rc_dec(tag);
         return PLCTAG_ERR_BAD_PARAM;
-    } else if(tag->auto_sync_read_ms > 0) {
-        /* how many periods did we already pass? */
-        // int64_t periods = (time_ms() / tag->auto_sync_read_ms);
-        // tag->auto_sync_next_read = (periods + 1) * tag->auto_sync_read_ms;
-        /* start some time in the future, but with random jitter. */
-        tag->auto_sync_next_read = time_ms() + (rand() % tag->auto_sync_read_ms);
     }
 
+    /* automatic reads are scheduled with the other tags on the same connection. */
+    tag->auto_sync_conn_key = auto_read_conn_key(attribs);
+
     tag->auto_sync_write_ms = attr_get_int(attribs, "auto_sync_write_ms", 0);
     if(tag->auto_sync_write_ms < 0) {
         pdebug(DEBUG_WARN, "auto_sync_write_ms value must be positive!");
@@ -944,9 +1394,44 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
         tag->auto_sync_next_write = 0;
     }
 
+    /* set up change detection. */
+    tag->on_change = (attr_get_int(attribs, "on_change", 0) ? 1 : 0);
+    tag->change_deadband = (double)attr_get_float(attribs, "change_deadband", 0.0f);
+    if(tag->change_deadband < 0.0) {
+        pdebug(DEBUG_WARN, "change_deadband value must not be negative!");
+        attr_destroy(attribs);
+        rc_dec(tag);
+        return PLCTAG_ERR_BAD_PARAM;
+    } else if(tag->change_deadband > 0.0) {
+        const char *deadband_type = attr_get_str(attribs, "change_deadband_type", "float32");
+
+        if(str_cmp_i(deadband_type, "float32") == 0) {
+            tag->change_float_size = 4;
+        } else if(str_cmp_i(deadband_type, "float64") == 0) {
+            tag->change_float_size = 8;
+        } else {
+            pdebug(DEBUG_WARN, "Unsupported change_deadband_type \"%s\", must be float32 or float64!", deadband_type);
+            attr_destroy(attribs);
+            rc_dec(tag);
+            return PLCTAG_ERR_BAD_PARAM;
+        }
+    }
+
     /* See if we are allowed to resize fields */
     tag->allow_field_resize = attr_get_int(attribs, "allow_field_resize", 0);
 
+    /* getters can read a published copy of the data without the API mutex. */
+    double_buffer = attr_get_int(attribs, "double_buffer", 0);
+
+    /* keep the last history_size reads for plc_tag_history_read(). */
+    history_size = attr_get_int(attribs, "history", 0);
+    if(history_size < 0) {
+        pdebug(DEBUG_WARN, "The history size must not be negative!");
+        attr_destroy(attribs);
+        rc_dec(tag);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
     /* set up the tag byte order if there are any overrides. */
     rc = set_tag_byte_order(tag, attribs);
     if(rc != PLCTAG_STATUS_OK) {
@@ -961,12 +1446,44 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
      */
     attr_destroy(attribs);
 
+    /* transactions use this to make a second handle for readbacks. */
+    tag->attrib_str = str_dup(attrib_str);
+    if(!tag->attrib_str) {
+        pdebug(DEBUG_WARN, "Unable to copy the tag attribute string!");
+        rc_dec(tag);
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    /* find the tag's place in the automatic read schedule. */
+    auto_read_join(tag);
+
+    if(double_buffer) {
+        rc = data_pub_create(tag);
+        if(rc != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Unable to set up double buffering for tag: %s!", plc_tag_decode_error(rc));
+            release_generic_tag_data(tag);
+            rc_dec(tag);
+            return rc;
+        }
+    }
+
+    if(history_size > 0) {
+        rc = history_create(tag, history_size);
+        if(rc != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Unable to set up the read history for tag: %s!", plc_tag_decode_error(rc));
+            release_generic_tag_data(tag);
+            rc_dec(tag);
+            return rc;
+        }
+    }
+
     /* map the tag to a tag ID */
     id = add_tag_lookup(tag);
 
     /* if the mapping failed, then punt */
     if(id < 0) {
         pdebug(DEBUG_ERROR, "Unable to map tag %p to lookup table entry, rc=%s", tag, plc_tag_decode_error(id));
+        release_generic_tag_data(tag);
         rc_dec(tag);
         return id;
     }
@@ -1000,6 +1517,7 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
             hashtable_remove(tags, (int64_t)tag->tag_id);
         }
 
+        release_generic_tag_data(tag);
         rc_dec(tag);
         return rc;
     }
@@ -1043,6 +1561,7 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
                     hashtable_remove(tags, (int64_t)tag->tag_id);
                 }
 
+                release_generic_tag_data(tag);
                 rc_dec(tag);
                 return rc;
             }
@@ -1066,6 +1585,7 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str, void (*tag_callback
                     hashtable_remove(tags, (int64_t)tag->tag_id);
                 }
 
+                release_generic_tag_data(tag);
                 rc_dec(tag);
                 return rc;
             }
@@ -1118,8 +1638,9 @@ LIB_EXPORT void plc_tag_shutdown(void)
         tag_table_entries = hashtable_capacity(tags);
     }
 
-    for(int i=0; i<tag_table_entries; i++) {
+    for(int i=0; i<tag_table_entries; ) {
         plc_tag_p tag = NULL;
+        plc_tag_p next_tag = NULL;
 
         critical_block(tag_lookup_mutex) {
             tag_table_entries = hashtable_capacity(tags);
@@ -1140,6 +1661,22 @@ LIB_EXPORT void plc_tag_shutdown(void)
             debug_set_tag_id(tag->tag_id);
             pdebug(DEBUG_DETAIL, "Destroying tag %" PRId32 ".", tag->tag_id);
             plc_tag_destroy(tag->tag_id);
+        }
+
+        /* removing a tag can shift the next one into this slot, so only move on if the slot did not change. */
+        critical_block(tag_lookup_mutex) {
+            tag_table_entries = hashtable_capacity(tags);
+
+            if(i<tag_table_entries && tag_table_entries >= 0) {
+                next_tag = hashtable_get_index(tags, i);
+            }
+        }
+
+        if(!tag || !next_tag || next_tag == tag) {
+            i++;
+        }
+
+        if(tag) {
             rc_dec(tag);
         }
     }
@@ -1330,34 +1867,39 @@ LIB_EXPORT int plc_tag_unregister_callback(int32_t tag_id)
 
 
 /*
- * plc_tag_register_logger
- *
- * This function registers the passed callback function with the library.  Only one callback function
- * may be registered with the library at a time!
- *
- * Once registered, the function will be called with any logging message that is normally printed due
- * to the current log level setting.
- *
- * WARNING: the callback will usually be called when the internal tag API mutex is held.   You cannot
- * call any tag functions within the callback!
- *
- * Return values:
- *
- * If there is already a callback registered, the function will return PLCTAG_ERR_DUPLICATE.   Only one callback
- * function may be registered at a time on each tag.
+ * plc_tag_register_listing_callback
  *
- * If all is successful, the function will return PLCTAG_STATUS_OK.
+ * This function registers a callback that gets each decoded page of a
+ * tag listing.  See libplctag.h.
  */
 
-LIB_EXPORT int plc_tag_register_logger(void (*log_callback_func)(int32_t tag_id, int debug_level, const char *message))
+LIB_EXPORT int plc_tag_register_listing_callback(int32_t tag_id, tag_listing_callback_func listing_callback_func, void *userdata)
 {
     int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = lookup_tag(tag_id);
 
-    pdebug(DEBUG_DETAIL, "Starting.");
+    pdebug(DEBUG_INFO, "Starting.");
 
-    rc = debug_register_logger(log_callback_func);
+    if (!tag) {
+        pdebug(DEBUG_WARN, "Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
 
-    pdebug(DEBUG_DETAIL, "Done.");
+    critical_block(tag->api_mutex) {
+        if(tag->read_in_flight) {
+            pdebug(DEBUG_WARN, "Cannot change the listing callback while a read is in flight!");
+            rc = PLCTAG_ERR_BUSY;
+        } else if(tag->listing_callback) {
+            rc = PLCTAG_ERR_DUPLICATE;
+        } else {
+            tag->listing_callback = listing_callback_func;
+            tag->listing_userdata = (listing_callback_func ? userdata : NULL);
+        }
+    }
+
+    rc_dec(tag);
+
+    pdebug(DEBUG_INFO, "Done.");
 
     return rc;
 }
@@ -1365,21 +1907,96 @@ LIB_EXPORT int plc_tag_register_logger(void (*log_callback_func)(int32_t tag_id,
 
 
 /*
- * plc_tag_unregister_logger
- *
- * This function removes the logger callback already registered for the library.
- *
- * Return values:
+ * plc_tag_unregister_listing_callback
  *
- * The function returns PLCTAG_STATUS_OK if there was a registered callback and removing it went well.
- * An error of PLCTAG_ERR_NOT_FOUND is returned if there was no registered callback.
+ * This function removes the listing callback already registered on the tag.
  */
 
-LIB_EXPORT int plc_tag_unregister_logger(void)
+LIB_EXPORT int plc_tag_unregister_listing_callback(int32_t tag_id)
 {
     int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = lookup_tag(tag_id);
 
-    pdebug(DEBUG_DETAIL, "Starting");
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!tag) {
+        pdebug(DEBUG_WARN,"Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        if(tag->read_in_flight) {
+            pdebug(DEBUG_WARN, "Cannot change the listing callback while a read is in flight!");
+            rc = PLCTAG_ERR_BUSY;
+        } else if(tag->listing_callback) {
+            tag->listing_callback = NULL;
+            tag->listing_userdata = NULL;
+        } else {
+            rc = PLCTAG_ERR_NOT_FOUND;
+        }
+    }
+
+    rc_dec(tag);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+
+/*
+ * plc_tag_register_logger
+ *
+ * This function registers the passed callback function with the library.  Only one callback function
+ * may be registered with the library at a time!
+ *
+ * Once registered, the function will be called with any logging message that is normally printed due
+ * to the current log level setting.
+ *
+ * WARNING: the callback will usually be called when the internal tag API mutex is held.   You cannot
+ * call any tag functions within the callback!
+ *
+ * Return values:
+ *
+ * If there is already a callback registered, the function will return PLCTAG_ERR_DUPLICATE.   Only one callback
+ * function may be registered at a time on each tag.
+ *
+ * If all is successful, the function will return PLCTAG_STATUS_OK.
+ */
+
+LIB_EXPORT int plc_tag_register_logger(void (*log_callback_func)(int32_t tag_id, int debug_level, const char *message))
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    rc = debug_register_logger(log_callback_func);
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_unregister_logger
+ *
+ * This function removes the logger callback already registered for the library.
+ *
+ * Return values:
+ *
+ * The function returns PLCTAG_STATUS_OK if there was a registered callback and removing it went well.
+ * An error of PLCTAG_ERR_NOT_FOUND is returned if there was no registered callback.
+ */
+
+LIB_EXPORT int plc_tag_unregister_logger(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_DETAIL, "Starting");
 
     rc = debug_unregister_logger();
 
@@ -1577,6 +2194,8 @@ LIB_EXPORT int plc_tag_destroy(int32_t tag_id)
         }
 
         tag_raise_event(tag, PLCTAG_EVENT_DESTROYED, PLCTAG_STATUS_OK);
+
+        release_generic_tag_data(tag);
     }
 
     /* wake the tickler */
@@ -1973,6 +2592,185 @@ LIB_EXPORT int plc_tag_write(int32_t id, int timeout)
 
 
 
+/*
+ * plc_tag_txn_create
+ *
+ * Create an empty transaction.  See libplctag.h for how transactions work.
+ */
+
+LIB_EXPORT int32_t plc_tag_txn_create(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_txn_p txn = NULL;
+    int32_t txn_id = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* make sure that the library is initialized. */
+    rc = initialize_modules();
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to initialize the internal library state!");
+        return rc;
+    }
+
+    txn = (plc_tag_txn_p)rc_alloc((int)sizeof(struct plc_tag_txn_t), txn_destroy);
+    if(!txn) {
+        pdebug(DEBUG_WARN, "Unable to allocate transaction!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = PLCTAG_ERR_NO_RESOURCES;
+
+    critical_block(txn_mutex) {
+        for(int attempts = 0; attempts < MAX_TAG_MAP_ATTEMPTS; attempts++) {
+            txn_id = tag_id_inc(next_txn_id);
+            next_txn_id = txn_id;
+
+            if(!hashtable_get(txns, (int64_t)txn_id)) {
+                txn->txn_id = txn_id;
+                rc = hashtable_put(txns, (int64_t)txn_id, txn);
+                break;
+            }
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to add transaction to the table, error %s!", plc_tag_decode_error(rc));
+        rc_dec(txn);
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done, created transaction %d.", txn_id);
+
+    return txn_id;
+}
+
+
+
+LIB_EXPORT int plc_tag_txn_add_read(int32_t txn_id, int32_t tag_id)
+{
+    return txn_add_op(txn_id, tag_id, 0);
+}
+
+
+
+LIB_EXPORT int plc_tag_txn_add_write(int32_t txn_id, int32_t tag_id)
+{
+    return txn_add_op(txn_id, tag_id, 1);
+}
+
+
+
+/*
+ * plc_tag_txn_submit
+ *
+ * Start the first phase of the transaction, or leave it to the tag
+ * tickler thread if the readback handles are still being created.  The
+ * tickler starts the rest and calls the callback when the last one is done.
+ */
+
+LIB_EXPORT int plc_tag_txn_submit(int32_t txn_id, void (*txn_callback_func)(int32_t txn_id, int num_ops, const int *op_status, void *userdata), void *userdata)
+{
+    int rc = PLCTAG_STATUS_PENDING;
+    plc_tag_txn_p txn = lookup_txn(txn_id);
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!txn) {
+        pdebug(DEBUG_WARN, "Transaction not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(txn_mutex) {
+        if(txn->in_flight) {
+            pdebug(DEBUG_WARN, "Transaction is already in flight!");
+            rc = PLCTAG_ERR_BUSY;
+            break;
+        }
+
+        if(txn->num_ops <= 0) {
+            pdebug(DEBUG_WARN, "Transaction has no operations!");
+            rc = PLCTAG_ERR_NO_DATA;
+            break;
+        }
+
+        for(int i=0; i < txn->num_ops; i++) {
+            txn->op_status[i] = PLCTAG_STATUS_PENDING;
+        }
+
+        txn->callback = txn_callback_func;
+        txn->userdata = userdata;
+        txn->phase = 0;
+        txn->in_flight = 1;
+        txn->starting = 1;
+        txn->waiting = 1;
+    }
+
+    if(rc == PLCTAG_STATUS_PENDING) {
+        txn_start(txn);
+    }
+
+    rc_dec(txn);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_txn_destroy
+ *
+ * Remove the transaction.  If it is in flight, abort it unless a phase
+ * is being started, in which case that finishes the abort.
+ */
+
+LIB_EXPORT int plc_tag_txn_destroy(int32_t txn_id)
+{
+    plc_tag_txn_p txn = NULL;
+    int abort = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!txns || !txn_mutex) {
+        pdebug(DEBUG_WARN, "Transaction table not initialized!");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(txn_mutex) {
+        txn = hashtable_remove(txns, (int64_t)txn_id);
+
+        if(txn && txn->in_flight) {
+            txn->aborting = 1;
+
+            if(!txn->starting) {
+                txn->in_flight = 0;
+                abort = 1;
+            }
+        }
+    }
+
+    if(!txn) {
+        pdebug(DEBUG_WARN, "Transaction not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    if(abort) {
+        txn_abort(txn);
+    }
+
+    rc_dec(txn);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+
+
 /*
  * Tag data accessors.
  */
@@ -2006,6 +2804,8 @@ LIB_EXPORT int plc_tag_get_int_attribute(int32_t id, const char *attrib_name, in
         } else if(str_cmp_i(attrib_name, "debug_level") == 0) {
             pdebug(DEBUG_WARN, "Deprecated attribute \"debug_level\" used, use \"debug\" instead.");
             res = (int)get_debug_level();
+        } else if(metrics_get_library_attrib(attrib_name, &res) == PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_DETAIL, "Got library metric \"%s\".", attrib_name);
         } else {
             pdebug(DEBUG_WARN, "Attribute \"%s\" is not supported at the library level!");
             res = default_value;
@@ -2033,6 +2833,24 @@ LIB_EXPORT int plc_tag_get_int_attribute(int32_t id, const char *attrib_name, in
             } else if(str_cmp_i(attrib_name, "auto_sync_write_ms") == 0) {
                 tag->status = PLCTAG_STATUS_OK;
                 res = (int)tag->auto_sync_write_ms;
+            } else if(str_cmp_i(attrib_name, "auto_sync_read_misses") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (int)tag->auto_sync_read_misses;
+            } else if(str_cmp_i(attrib_name, "on_change") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (int)tag->on_change;
+            } else if(str_cmp_i(attrib_name, "double_buffer") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (tag->data_pub ? 1 : 0);
+            } else if(str_cmp_i(attrib_name, "history") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (tag->history ? (int)tag->history->capacity : 0);
+            } else if(str_cmp_i(attrib_name, "history_count") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (tag->history ? (int)tag->history->count : 0);
+            } else if(str_cmp_i(attrib_name, "history_overruns") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (tag->history ? (tag->history->overruns > INT_MAX ? INT_MAX : (int)tag->history->overruns) : 0);
             } else if(str_cmp_i(attrib_name, "bit_num") == 0) {
                 tag->status = PLCTAG_STATUS_OK;
                 res = (int)(unsigned int)(tag->bit);
@@ -2117,6 +2935,7 @@ LIB_EXPORT int plc_tag_set_int_attribute(int32_t id, const char *attrib_name, in
             } else if(str_cmp_i(attrib_name, "auto_sync_read_ms") == 0) {
                 if(new_value >= 0) {
                     tag->auto_sync_read_ms = new_value;
+                    auto_read_join(tag);
                     tag->status = PLCTAG_STATUS_OK;
                     res = PLCTAG_STATUS_OK;
                 } else {
@@ -2124,6 +2943,23 @@ LIB_EXPORT int plc_tag_set_int_attribute(int32_t id, const char *attrib_name, in
                     tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                     res = PLCTAG_ERR_OUT_OF_BOUNDS;
                 }
+            } else if(str_cmp_i(attrib_name, "on_change") == 0) {
+                /* start over with the next read. */
+                tag->on_change = (new_value ? 1 : 0);
+                tag->change_shadow_size = 0;
+                tag->status = PLCTAG_STATUS_OK;
+                res = PLCTAG_STATUS_OK;
+            } else if(str_cmp_i(attrib_name, "auto_sync_read_misses") == 0) {
+                /* only resetting the count makes sense. */
+                if(new_value == 0) {
+                    tag->auto_sync_read_misses = 0;
+                    tag->status = PLCTAG_STATUS_OK;
+                    res = PLCTAG_STATUS_OK;
+                } else {
+                    pdebug(DEBUG_WARN, "auto_sync_read_misses can only be set to zero!");
+                    tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
+                    res = PLCTAG_ERR_OUT_OF_BOUNDS;
+                }
             } else if(str_cmp_i(attrib_name, "auto_sync_write_ms") == 0) {
                 if(new_value >= 0) {
                     tag->auto_sync_write_ms = new_value;
@@ -2188,6 +3024,12 @@ LIB_EXPORT int plc_tag_get_byte_array_attribute(int32_t id, const char *attrib_n
     }
 
     critical_block(tag->api_mutex) {
+        /* the byte order is the same for all protocols. */
+        rc = get_byte_order_attrib(tag, attrib_name, buffer, buffer_length);
+        if(rc != PLCTAG_ERR_UNSUPPORTED) {
+            break;
+        }
+
         if(tag->vtable && tag->vtable->get_byte_array_attrib) {
             rc = tag->vtable->get_byte_array_attrib(tag, attrib_name, buffer, buffer_length);
         } else {
@@ -2249,7 +3091,11 @@ LIB_EXPORT int plc_tag_set_size(int32_t id, int new_size)
     }
 
     critical_block(tag->api_mutex) {
+        int64_t change = tag_data_change_begin(tag);
+
         rc = resize_tag_buffer_unsafe(tag, new_size);
+
+        tag_data_change_end(tag, change);
     }
 
     rc_dec(tag);
@@ -2272,6 +3118,8 @@ LIB_EXPORT int plc_tag_get_bit(int32_t id, int offset_bit)
     int res = PLCTAG_ERR_OUT_OF_BOUNDS;
     int real_offset = offset_bit;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2297,9 +3145,9 @@ LIB_EXPORT int plc_tag_get_bit(int32_t id, int offset_bit)
 
     pdebug(DEBUG_SPEW, "selecting bit %d with offset %d in byte %d (%x).", real_offset, (real_offset % 8), (real_offset / 8), tag->data[real_offset / 8]);
 
-    critical_block(tag->api_mutex) {
-        if((real_offset >= 0) && ((real_offset / 8) < tag->size)) {
-            res = !!(((1 << (real_offset % 8)) & 0xFF) & (tag->data[real_offset / 8]));
+    tag_data_read_block(tag, data, size) {
+        if((real_offset >= 0) && ((real_offset / 8) < size)) {
+            res = !!(((1 << (real_offset % 8)) & 0xFF) & (data[real_offset / 8]));
             tag->status = PLCTAG_STATUS_OK;
         } else {
             pdebug(DEBUG_WARN, "Data offset out of bounds!");
@@ -2345,6 +3193,8 @@ LIB_EXPORT int plc_tag_set_bit(int32_t id, int offset_bit, int val)
     pdebug(DEBUG_SPEW, "Setting bit %d with offset %d in byte %d (%x).", real_offset, (real_offset % 8), (real_offset / 8), tag->data[real_offset / 8]);
 
     critical_block(tag->api_mutex) {
+        int64_t change = tag_data_change_begin_at(tag, real_offset / 8, 1);
+
         if((real_offset >= 0) && ((real_offset / 8) < tag->size)) {
             if(tag->auto_sync_write_ms > 0) {
                 tag->tag_is_dirty = 1;
@@ -2362,6 +3212,8 @@ LIB_EXPORT int plc_tag_set_bit(int32_t id, int offset_bit, int val)
             tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
             res = PLCTAG_ERR_OUT_OF_BOUNDS;
         }
+
+        tag_data_change_end(tag, change);
     }
 
     rc_dec(tag);
@@ -2375,6 +3227,8 @@ LIB_EXPORT uint64_t plc_tag_get_uint64(int32_t id, int offset)
 {
     uint64_t res = UINT64_MAX;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2392,16 +3246,16 @@ LIB_EXPORT uint64_t plc_tag_get_uint64(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(uint64_t)) <= tag->size)) {
-                res =   ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[0]]) << 0 ) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[1]]) << 8 ) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[2]]) << 16) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[3]]) << 24) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[4]]) << 32) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[5]]) << 40) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[6]]) << 48) +
-                        ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[7]]) << 56);
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(uint64_t)) <= size)) {
+                res =   ((uint64_t)(data[offset + tag->byte_order->int64_order[0]]) << 0 ) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[1]]) << 8 ) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[2]]) << 16) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[3]]) << 24) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[4]]) << 32) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[5]]) << 40) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[6]]) << 48) +
+                        ((uint64_t)(data[offset + tag->byte_order->int64_order[7]]) << 56);
 
                 tag->status = PLCTAG_STATUS_OK;
             } else {
@@ -2447,6 +3301,8 @@ LIB_EXPORT int plc_tag_set_uint64(int32_t id, int offset, uint64_t val)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 8);
+
             if((offset >= 0) && (offset + ((int)sizeof(uint64_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -2467,6 +3323,8 @@ LIB_EXPORT int plc_tag_set_uint64(int32_t id, int offset, uint64_t val)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -2488,6 +3346,8 @@ LIB_EXPORT int64_t plc_tag_get_int64(int32_t id, int offset)
 {
     int64_t res = INT64_MIN;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2505,16 +3365,16 @@ LIB_EXPORT int64_t plc_tag_get_int64(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(int64_t)) <= tag->size)) {
-                res = (int64_t)(((uint64_t)(tag->data[offset + tag->byte_order->int64_order[0]]) << 0 ) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[1]]) << 8 ) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[2]]) << 16) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[3]]) << 24) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[4]]) << 32) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[5]]) << 40) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[6]]) << 48) +
-                                ((uint64_t)(tag->data[offset + tag->byte_order->int64_order[7]]) << 56));
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(int64_t)) <= size)) {
+                res = (int64_t)(((uint64_t)(data[offset + tag->byte_order->int64_order[0]]) << 0 ) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[1]]) << 8 ) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[2]]) << 16) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[3]]) << 24) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[4]]) << 32) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[5]]) << 40) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[6]]) << 48) +
+                                ((uint64_t)(data[offset + tag->byte_order->int64_order[7]]) << 56));
 
                 tag->status = PLCTAG_STATUS_OK;
             } else {
@@ -2561,6 +3421,8 @@ LIB_EXPORT int plc_tag_set_int64(int32_t id, int offset, int64_t ival)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 8);
+
             if((offset >= 0) && (offset + ((int)sizeof(int64_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -2581,6 +3443,8 @@ LIB_EXPORT int plc_tag_set_int64(int32_t id, int offset, int64_t ival)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -2599,6 +3463,8 @@ LIB_EXPORT uint32_t plc_tag_get_uint32(int32_t id, int offset)
 {
     uint32_t res = UINT32_MAX;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2616,12 +3482,12 @@ LIB_EXPORT uint32_t plc_tag_get_uint32(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(uint32_t)) <= tag->size)) {
-                res =   ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[0]]) << 0 ) +
-                        ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[1]]) << 8 ) +
-                        ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[2]]) << 16) +
-                        ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[3]]) << 24);
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(uint32_t)) <= size)) {
+                res =   ((uint32_t)(data[offset + tag->byte_order->int32_order[0]]) << 0 ) +
+                        ((uint32_t)(data[offset + tag->byte_order->int32_order[1]]) << 8 ) +
+                        ((uint32_t)(data[offset + tag->byte_order->int32_order[2]]) << 16) +
+                        ((uint32_t)(data[offset + tag->byte_order->int32_order[3]]) << 24);
 
                 tag->status = PLCTAG_STATUS_OK;
             } else {
@@ -2667,6 +3533,8 @@ LIB_EXPORT int plc_tag_set_uint32(int32_t id, int offset, uint32_t val)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 4);
+
             if((offset >= 0) && (offset + ((int)sizeof(uint32_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -2683,6 +3551,8 @@ LIB_EXPORT int plc_tag_set_uint32(int32_t id, int offset, uint32_t val)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -2704,6 +3574,8 @@ LIB_EXPORT int32_t  plc_tag_get_int32(int32_t id, int offset)
 {
     int32_t res = INT32_MIN;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2721,12 +3593,12 @@ LIB_EXPORT int32_t  plc_tag_get_int32(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(int32_t)) <= tag->size)) {
-                res = (int32_t)(((uint32_t)(tag->data[offset + tag->byte_order->int32_order[0]]) << 0 ) +
-                                ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[1]]) << 8 ) +
-                                ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[2]]) << 16) +
-                                ((uint32_t)(tag->data[offset + tag->byte_order->int32_order[3]]) << 24));
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(int32_t)) <= size)) {
+                res = (int32_t)(((uint32_t)(data[offset + tag->byte_order->int32_order[0]]) << 0 ) +
+                                ((uint32_t)(data[offset + tag->byte_order->int32_order[1]]) << 8 ) +
+                                ((uint32_t)(data[offset + tag->byte_order->int32_order[2]]) << 16) +
+                                ((uint32_t)(data[offset + tag->byte_order->int32_order[3]]) << 24));
 
                 tag->status = PLCTAG_STATUS_OK;
             }  else {
@@ -2773,6 +3645,8 @@ LIB_EXPORT int plc_tag_set_int32(int32_t id, int offset, int32_t ival)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 4);
+
             if((offset >= 0) && (offset + ((int)sizeof(int32_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -2789,6 +3663,8 @@ LIB_EXPORT int plc_tag_set_int32(int32_t id, int offset, int32_t ival)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -2813,6 +3689,8 @@ LIB_EXPORT uint16_t plc_tag_get_uint16(int32_t id, int offset)
 {
     uint16_t res = UINT16_MAX;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2830,10 +3708,10 @@ LIB_EXPORT uint16_t plc_tag_get_uint16(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(uint16_t)) <= tag->size)) {
-                res =   (uint16_t)(((uint16_t)(tag->data[offset + tag->byte_order->int16_order[0]]) << 0 ) +
-                                   ((uint16_t)(tag->data[offset + tag->byte_order->int16_order[1]]) << 8 ));
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(uint16_t)) <= size)) {
+                res =   (uint16_t)(((uint16_t)(data[offset + tag->byte_order->int16_order[0]]) << 0 ) +
+                                   ((uint16_t)(data[offset + tag->byte_order->int16_order[1]]) << 8 ));
 
                 tag->status = PLCTAG_STATUS_OK;
             } else {
@@ -2880,6 +3758,8 @@ LIB_EXPORT int plc_tag_set_uint16(int32_t id, int offset, uint16_t val)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 2);
+
             if((offset >= 0) && (offset + ((int)sizeof(uint16_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -2894,6 +3774,8 @@ LIB_EXPORT int plc_tag_set_uint16(int32_t id, int offset, uint16_t val)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -2919,6 +3801,8 @@ LIB_EXPORT int16_t  plc_tag_get_int16(int32_t id, int offset)
 {
     int16_t res = INT16_MIN;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -2936,10 +3820,10 @@ LIB_EXPORT int16_t  plc_tag_get_int16(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(int16_t)) <= tag->size)) {
-                res =   (int16_t)(uint16_t)(((uint16_t)(tag->data[offset + tag->byte_order->int16_order[0]]) << 0 ) +
-                                            ((uint16_t)(tag->data[offset + tag->byte_order->int16_order[1]]) << 8 ));
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(int16_t)) <= size)) {
+                res =   (int16_t)(uint16_t)(((uint16_t)(data[offset + tag->byte_order->int16_order[0]]) << 0 ) +
+                                            ((uint16_t)(data[offset + tag->byte_order->int16_order[1]]) << 8 ));
                 tag->status = PLCTAG_STATUS_OK;
             } else {
                 pdebug(DEBUG_WARN, "Data offset out of bounds!");
@@ -2986,6 +3870,8 @@ LIB_EXPORT int plc_tag_set_int16(int32_t id, int offset, int16_t ival)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 2);
+
             if((offset >= 0) && (offset + ((int)sizeof(int16_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -3000,6 +3886,8 @@ LIB_EXPORT int plc_tag_set_int16(int32_t id, int offset, int16_t ival)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -3025,6 +3913,8 @@ LIB_EXPORT uint8_t plc_tag_get_uint8(int32_t id, int offset)
 {
     uint8_t res = UINT8_MAX;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -3042,9 +3932,9 @@ LIB_EXPORT uint8_t plc_tag_get_uint8(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(uint8_t)) <= tag->size)) {
-                res = tag->data[offset];
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(uint8_t)) <= size)) {
+                res = data[offset];
                 tag->status = PLCTAG_STATUS_OK;
             } else {
                 pdebug(DEBUG_WARN, "Data offset out of bounds!");
@@ -3090,6 +3980,8 @@ LIB_EXPORT int plc_tag_set_uint8(int32_t id, int offset, uint8_t val)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 1);
+
             if((offset >= 0) && (offset + ((int)sizeof(uint8_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -3103,6 +3995,8 @@ LIB_EXPORT int plc_tag_set_uint8(int32_t id, int offset, uint8_t val)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -3125,6 +4019,8 @@ LIB_EXPORT int8_t plc_tag_get_int8(int32_t id, int offset)
 {
     int8_t res = INT8_MIN;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -3142,9 +4038,9 @@ LIB_EXPORT int8_t plc_tag_get_int8(int32_t id, int offset)
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && (offset + ((int)sizeof(uint8_t)) <= tag->size)) {
-                res =   (int8_t)tag->data[offset];
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && (offset + ((int)sizeof(uint8_t)) <= size)) {
+                res =   (int8_t)data[offset];
                 tag->status = PLCTAG_STATUS_OK;
             } else {
                 pdebug(DEBUG_WARN, "Data offset out of bounds!");
@@ -3191,6 +4087,8 @@ LIB_EXPORT int plc_tag_set_int8(int32_t id, int offset, int8_t ival)
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, 1);
+
             if((offset >= 0) && (offset + ((int)sizeof(int8_t)) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -3204,6 +4102,8 @@ LIB_EXPORT int plc_tag_set_int8(int32_t id, int offset, int8_t ival)
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         if(!val) {
@@ -3229,6 +4129,8 @@ LIB_EXPORT double plc_tag_get_float64(int32_t id, int offset)
     int rc = PLCTAG_STATUS_OK;
     uint64_t ures = 0;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -3252,16 +4154,16 @@ LIB_EXPORT double plc_tag_get_float64(int32_t id, int offset)
         return res;
     }
 
-    critical_block(tag->api_mutex) {
-        if((offset >= 0) && (offset + ((int)sizeof(double)) <= tag->size)) {
-            ures =  ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[0]]) << 0 ) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[1]]) << 8 ) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[2]]) << 16) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[3]]) << 24) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[4]]) << 32) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[5]]) << 40) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[6]]) << 48) +
-                    ((uint64_t)(tag->data[offset + tag->byte_order->float64_order[7]]) << 56);
+    tag_data_read_block(tag, data, size) {
+        if((offset >= 0) && (offset + ((int)sizeof(double)) <= size)) {
+            ures =  ((uint64_t)(data[offset + tag->byte_order->float64_order[0]]) << 0 ) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[1]]) << 8 ) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[2]]) << 16) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[3]]) << 24) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[4]]) << 32) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[5]]) << 40) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[6]]) << 48) +
+                    ((uint64_t)(data[offset + tag->byte_order->float64_order[7]]) << 56);
 
             tag->status = PLCTAG_STATUS_OK;
             rc = PLCTAG_STATUS_OK;
@@ -3319,6 +4221,8 @@ LIB_EXPORT int plc_tag_set_float64(int32_t id, int offset, double fval)
     mem_copy(&val, &fval, sizeof(val));
 
     critical_block(tag->api_mutex) {
+        int64_t change = tag_data_change_begin_at(tag, offset, 8);
+
         if((offset >= 0) && (offset + ((int)sizeof(uint64_t)) <= tag->size)) {
             if(tag->auto_sync_write_ms > 0) {
                 tag->tag_is_dirty = 1;
@@ -3339,6 +4243,8 @@ LIB_EXPORT int plc_tag_set_float64(int32_t id, int offset, double fval)
             tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
             rc = PLCTAG_ERR_OUT_OF_BOUNDS;
         }
+
+        tag_data_change_end(tag, change);
     }
 
     rc_dec(tag);
@@ -3354,6 +4260,8 @@ LIB_EXPORT float plc_tag_get_float32(int32_t id, int offset)
     int rc = PLCTAG_STATUS_OK;
     uint32_t ures = 0;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -3377,12 +4285,12 @@ LIB_EXPORT float plc_tag_get_float32(int32_t id, int offset)
         return res;
     }
 
-    critical_block(tag->api_mutex) {
-        if((offset >= 0) && (offset + ((int)sizeof(float)) <= tag->size)) {
-            ures =  (uint32_t)(((uint32_t)(tag->data[offset + tag->byte_order->float32_order[0]]) << 0 ) +
-                               ((uint32_t)(tag->data[offset + tag->byte_order->float32_order[1]]) << 8 ) +
-                               ((uint32_t)(tag->data[offset + tag->byte_order->float32_order[2]]) << 16) +
-                               ((uint32_t)(tag->data[offset + tag->byte_order->float32_order[3]]) << 24));
+    tag_data_read_block(tag, data, size) {
+        if((offset >= 0) && (offset + ((int)sizeof(float)) <= size)) {
+            ures =  (uint32_t)(((uint32_t)(data[offset + tag->byte_order->float32_order[0]]) << 0 ) +
+                               ((uint32_t)(data[offset + tag->byte_order->float32_order[1]]) << 8 ) +
+                               ((uint32_t)(data[offset + tag->byte_order->float32_order[2]]) << 16) +
+                               ((uint32_t)(data[offset + tag->byte_order->float32_order[3]]) << 24));
 
             tag->status = PLCTAG_STATUS_OK;
             rc = PLCTAG_STATUS_OK;
@@ -3440,6 +4348,8 @@ LIB_EXPORT int plc_tag_set_float32(int32_t id, int offset, float fval)
     mem_copy(&val, &fval, sizeof(val));
 
     critical_block(tag->api_mutex) {
+        int64_t change = tag_data_change_begin_at(tag, offset, 4);
+
         if((offset >= 0) && (offset + ((int)sizeof(float)) <= tag->size)) {
             if(tag->auto_sync_write_ms > 0) {
                 tag->tag_is_dirty = 1;
@@ -3456,6 +4366,8 @@ LIB_EXPORT int plc_tag_set_float32(int32_t id, int offset, float fval)
             tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
             rc = PLCTAG_ERR_OUT_OF_BOUNDS;
         }
+
+        tag_data_change_end(tag, change);
     }
 
     rc_dec(tag);
@@ -3558,6 +4470,7 @@ LIB_EXPORT int plc_tag_set_string(int32_t tag_id, int string_start_offset, const
     plc_tag_p tag = lookup_tag(tag_id);
     unsigned int string_length = 0;
     unsigned int string_data_start_offset = (unsigned int)string_start_offset;
+    int64_t change = 0;
 
     pdebug(DEBUG_DETAIL, "Starting with string %s.", string_val);
 
@@ -3629,6 +4542,8 @@ LIB_EXPORT int plc_tag_set_string(int32_t tag_id, int string_start_offset, const
             break;
         }
 
+        change = tag_data_change_begin(tag);
+
         rc = resize_tag_buffer_at_offset_unsafe(tag, string_start_offset + old_string_size_in_buffer, string_start_offset + new_string_size_in_buffer);
         if(rc != PLCTAG_STATUS_OK) {
             break;
@@ -3759,6 +4674,11 @@ LIB_EXPORT int plc_tag_set_string(int32_t tag_id, int string_start_offset, const
         tag->status = (int8_t)rc;
     }
 
+    /* the error paths above break out of the block with the data change still open. */
+    critical_block(tag->api_mutex) {
+        tag_data_change_end(tag, change);
+    }
+
     rc_dec(tag);
 
     pdebug(DEBUG_DETAIL, "Done with status %s (%d).", plc_tag_decode_error(rc), rc);
@@ -3948,6 +4868,8 @@ LIB_EXPORT int plc_tag_set_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
 
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
+            int64_t change = tag_data_change_begin_at(tag, offset, buffer_size);
+
             if((offset >= 0) && ((offset + buffer_size) <= tag->size)) {
                 if(tag->auto_sync_write_ms > 0) {
                     tag->tag_is_dirty = 1;
@@ -3964,6 +4886,8 @@ LIB_EXPORT int plc_tag_set_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
                 tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                 rc = PLCTAG_ERR_OUT_OF_BOUNDS;
             }
+
+            tag_data_change_end(tag, change);
         }
     } else {
         pdebug(DEBUG_WARN,"Trying to write a list of values on a Tag bit.");
@@ -3981,6 +4905,8 @@ LIB_EXPORT int plc_tag_get_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
 {
     int rc = PLCTAG_STATUS_OK;
     plc_tag_p tag = lookup_tag(id);
+    const uint8_t *data = NULL;
+    int32_t size = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
@@ -4010,11 +4936,11 @@ LIB_EXPORT int plc_tag_get_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
     }
 
     if(!tag->is_bit) {
-        critical_block(tag->api_mutex) {
-            if((offset >= 0) && ((offset + buffer_size) <= tag->size)) {
+        tag_data_read_block(tag, data, size) {
+            if((offset >= 0) && ((offset + buffer_size) <= size)) {
                 int i;
                 for (i=0;i<buffer_size;i++) {
-                    buffer[i] = tag->data[offset + i];
+                    buffer[i] = data[offset + i];
                 }
 
                 tag->status = PLCTAG_STATUS_OK;
@@ -4036,6 +4962,200 @@ LIB_EXPORT int plc_tag_get_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
 }
 
 
+LIB_EXPORT int plc_tag_view_acquire(int32_t id, const uint8_t **data, int *size, uint32_t *seq)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = NULL;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(!data || !size || !seq) {
+        pdebug(DEBUG_WARN, "Null pointer passed for the view!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    tag = lookup_tag(id);
+    if(!tag) {
+        pdebug(DEBUG_WARN,"Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    /* this is held until the view is released. */
+    rc = mutex_lock(tag->api_mutex);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Error %s locking the tag!", plc_tag_decode_error(rc));
+        rc_dec(tag);
+        return rc;
+    }
+
+    if(!tag->data) {
+        pdebug(DEBUG_WARN,"Tag has no data!");
+        tag->status = PLCTAG_ERR_NO_DATA;
+        mutex_unlock(tag->api_mutex);
+        rc_dec(tag);
+        return PLCTAG_ERR_NO_DATA;
+    }
+
+    if(tag->data_pub) {
+        const uint8_t *pub_data = NULL;
+        int32_t pub_size = 0;
+
+        /* nothing is published while we hold the mutex, so the published copy is stable. */
+        data_pub_get_published(tag, atomic_counter_get(&(tag->data_pub->seq)), &pub_data, &pub_size);
+
+        *data = pub_data;
+        *size = (int)pub_size;
+    } else {
+        *data = tag->data;
+        *size = (int)tag->size;
+    }
+
+    *seq = (uint32_t)(uint64_t)atomic_counter_get(&(tag->data_seq));
+
+    /* the view keeps the tag reference until it is released. */
+    tag->data_views++;
+
+    pdebug(DEBUG_SPEW, "Done with %d views.", tag->data_views);
+
+    return rc;
+}
+
+
+
+LIB_EXPORT int plc_tag_view_release(int32_t id)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = lookup_tag(id);
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(!tag) {
+        pdebug(DEBUG_WARN,"Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        if(tag->data_views <= 0) {
+            pdebug(DEBUG_WARN, "Tag has no view to release!");
+            rc = PLCTAG_ERR_NOT_ALLOWED;
+            break;
+        }
+
+        tag->data_views--;
+
+        /* undo the lock from plc_tag_view_acquire(). */
+        rc = mutex_unlock(tag->api_mutex);
+    }
+
+    /* drop the reference the view was holding. */
+    if(rc == PLCTAG_STATUS_OK) {
+        rc_dec(tag);
+    }
+
+    rc_dec(tag);
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return rc;
+}
+
+
+
+LIB_EXPORT int plc_tag_get_data_seq(int32_t id, uint32_t *seq)
+{
+    plc_tag_p tag = NULL;
+
+    if(!seq) {
+        pdebug(DEBUG_WARN, "Null sequence pointer!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    tag = lookup_tag(id);
+    if(!tag) {
+        pdebug(DEBUG_WARN,"Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    /* no tag lock here, the counter is only changed atomically. */
+    *seq = (uint32_t)(uint64_t)atomic_counter_get(&(tag->data_seq));
+
+    rc_dec(tag);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * plc_tag_history_read
+ *
+ * Move up to max_entries of the oldest reads out of the tag's history
+ * ring.  Entry i's data goes to data + (i * entry_size).  Returns the
+ * number of entries moved.
+ */
+
+LIB_EXPORT int plc_tag_history_read(int32_t id, int64_t *timestamps_us, int *statuses, uint8_t *data, int entry_size, int max_entries)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = NULL;
+    int num_entries = 0;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(!timestamps_us || !statuses || (!data && entry_size > 0)) {
+        pdebug(DEBUG_WARN, "Entry array pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(entry_size < 0 || max_entries < 0) {
+        pdebug(DEBUG_WARN, "The entry size and count must not be negative!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    tag = lookup_tag(id);
+    if(!tag) {
+        pdebug(DEBUG_WARN,"Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        struct tag_history_t *hist = tag->history;
+
+        if(!hist) {
+            pdebug(DEBUG_WARN, "Tag was not created with a history!");
+            rc = PLCTAG_ERR_UNSUPPORTED;
+            break;
+        }
+
+        if(data && hist->count > 0 && entry_size < hist->entry_size) {
+            pdebug(DEBUG_WARN, "Entry size %d is smaller than the tag data size %d!", entry_size, hist->entry_size);
+            rc = PLCTAG_ERR_TOO_SMALL;
+            break;
+        }
+
+        while(num_entries < max_entries && hist->count > 0) {
+            timestamps_us[num_entries] = hist->timestamps_us[hist->head];
+            statuses[num_entries] = (int)hist->statuses[hist->head];
+
+            if(data && hist->entry_size > 0) {
+                mem_copy(data + (num_entries * entry_size), hist->data + (hist->head * hist->entry_size), hist->entry_size);
+            }
+
+            hist->head = (hist->head + 1) % hist->capacity;
+            hist->count--;
+            num_entries++;
+        }
+    }
+
+    rc_dec(tag);
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return (rc == PLCTAG_STATUS_OK ? num_entries : rc);
+}
+
+
+
 
 
 /*****************************************************************************************************
@@ -4787,3 +5907,1524 @@ int resize_tag_buffer_at_offset_unsafe(plc_tag_p tag, int old_split_index, int n
 
     return rc;
 }
+
+
+
+
+plc_tag_txn_p lookup_txn(int32_t txn_id)
+{
+    plc_tag_txn_p txn = NULL;
+
+    if(!txns || !txn_mutex) {
+        return NULL;
+    }
+
+    critical_block(txn_mutex) {
+        txn = rc_inc(hashtable_get(txns, (int64_t)txn_id));
+    }
+
+    return txn;
+}
+
+
+
+int txn_add_op(int32_t txn_id, int32_t tag_id, int is_write)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_txn_p txn = NULL;
+    plc_tag_p tag = lookup_tag(tag_id);
+    int need_readback = 0;
+    int32_t readback_tag_id = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!tag) {
+        pdebug(DEBUG_WARN, "Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    rc_dec(tag);
+
+    txn = lookup_txn(txn_id);
+    if(!txn) {
+        pdebug(DEBUG_WARN, "Transaction not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    /* a read right after a write of the same tag goes through a second handle. */
+    if(!is_write) {
+        critical_block(txn_mutex) {
+            for(int i = txn->num_ops - 1; i >= 0; i--) {
+                if(txn->ops[i].tag_id == tag_id) {
+                    need_readback = txn->ops[i].is_write;
+                    break;
+                }
+            }
+        }
+    }
+
+    if(need_readback) {
+        readback_tag_id = txn_create_readback(tag_id);
+        if(readback_tag_id < 0) {
+            pdebug(DEBUG_WARN, "Unable to create readback handle, error %s!  The read will start after the write completes.", plc_tag_decode_error(readback_tag_id));
+            readback_tag_id = 0;
+        }
+    }
+
+    critical_block(txn_mutex) {
+        if(txn->in_flight) {
+            pdebug(DEBUG_WARN, "Transaction is in flight!");
+            rc = PLCTAG_ERR_BUSY;
+            break;
+        }
+
+        if(txn->num_ops >= txn->ops_capacity) {
+            int new_capacity = txn->ops_capacity + TXN_OPS_INC;
+            txn_op_t *new_ops = (txn_op_t *)mem_realloc(txn->ops, new_capacity * (int)sizeof(txn_op_t));
+            int *new_status = NULL;
+
+            if(new_ops) {
+                txn->ops = new_ops;
+                new_status = (int *)mem_realloc(txn->op_status, new_capacity * (int)sizeof(int));
+            }
+
+            if(!new_ops || !new_status) {
+                pdebug(DEBUG_WARN, "Unable to grow the transaction operation list!");
+                rc = PLCTAG_ERR_NO_MEM;
+                break;
+            }
+
+            txn->op_status = new_status;
+            txn->ops_capacity = new_capacity;
+        }
+
+        mem_set(&(txn->ops[txn->num_ops]), 0, (int)sizeof(txn_op_t));
+        txn->ops[txn->num_ops].tag_id = tag_id;
+        txn->ops[txn->num_ops].readback_tag_id = readback_tag_id;
+        txn->ops[txn->num_ops].is_write = is_write;
+        txn->op_status[txn->num_ops] = PLCTAG_STATUS_OK;
+        txn->num_ops++;
+    }
+
+    if(rc != PLCTAG_STATUS_OK && readback_tag_id > 0) {
+        plc_tag_destroy(readback_tag_id);
+    }
+
+    rc_dec(txn);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * txn_create_readback
+ *
+ * Create a second handle with the same attributes as the tag.  A tag
+ * can only have one operation in flight, so the readback of a write
+ * uses this handle to go out in the same packet as the write.
+ */
+int32_t txn_create_readback(int32_t tag_id)
+{
+    plc_tag_p tag = lookup_tag(tag_id);
+    char *attrib_str = NULL;
+    int32_t readback_tag_id = PLCTAG_ERR_NO_MEM;
+
+    if(!tag) {
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        int attrib_str_size = 0;
+
+        if(!tag->attrib_str) {
+            break;
+        }
+
+        attrib_str_size = str_length(tag->attrib_str) + str_length(TXN_READBACK_ATTRIBS) + 1;
+
+        attrib_str = mem_alloc(attrib_str_size);
+        if(attrib_str) {
+            str_copy(attrib_str, attrib_str_size, tag->attrib_str);
+            str_copy(attrib_str + str_length(tag->attrib_str), attrib_str_size - str_length(tag->attrib_str), TXN_READBACK_ATTRIBS);
+        }
+    }
+
+    rc_dec(tag);
+
+    if(attrib_str) {
+        readback_tag_id = plc_tag_create(attrib_str, 0);
+        mem_free(attrib_str);
+    }
+
+    return readback_tag_id;
+}
+
+
+
+/* the tag the operation goes out on. */
+int32_t txn_op_tag_id(txn_op_t *op)
+{
+    return (op->readback_tag_id > 0 ? op->readback_tag_id : op->tag_id);
+}
+
+
+
+/*
+ * txn_start
+ *
+ * Wait for the readback handles to be created, then split the operations
+ * into phases and start the first one.  The caller must have set the
+ * starting flag.  The tickler calls this again until the handles are ready.
+ */
+void txn_start(plc_tag_txn_p txn)
+{
+    int ready = 1;
+
+    for(int i=0; i < txn->num_ops; i++) {
+        int32_t readback_tag_id = txn->ops[i].readback_tag_id;
+        int status = PLCTAG_STATUS_OK;
+
+        if(readback_tag_id <= 0) {
+            continue;
+        }
+
+        status = plc_tag_status(readback_tag_id);
+
+        if(status == PLCTAG_STATUS_PENDING) {
+            ready = 0;
+        } else if(status != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Readback handle %d failed with %s!  The read will start after the write completes.", readback_tag_id, plc_tag_decode_error(status));
+
+            critical_block(txn_mutex) {
+                txn->ops[i].readback_tag_id = 0;
+            }
+
+            plc_tag_destroy(readback_tag_id);
+        }
+    }
+
+    if(!ready) {
+        txn_end_starting(txn);
+        return;
+    }
+
+    critical_block(txn_mutex) {
+        /* a tag can only be used once per phase, start a new phase when one repeats. */
+        txn->num_phases = 1;
+
+        for(int i=0, phase_start=0; i < txn->num_ops; i++) {
+            for(int j=phase_start; j < i; j++) {
+                if(txn_op_tag_id(&(txn->ops[j])) == txn_op_tag_id(&(txn->ops[i]))) {
+                    txn->num_phases++;
+                    phase_start = i;
+                    break;
+                }
+            }
+
+            txn->ops[i].phase = txn->num_phases - 1;
+        }
+
+        txn->phase = 0;
+        txn->waiting = 0;
+    }
+
+    txn_start_phase(txn);
+}
+
+
+
+/*
+ * txn_start_phase
+ *
+ * Start the operations of the current phase.  The tags' connections are
+ * held while the requests are queued so that none of them go out early,
+ * then the requests are grouped into one batch.
+ *
+ * This must not be called with the transaction mutex held as the tag
+ * API mutexes are taken.  The starting flag keeps the tickler away.
+ */
+void txn_start_phase(plc_tag_txn_p txn)
+{
+    int phase = txn->phase;
+
+    pdebug(DEBUG_DETAIL, "Starting phase %d of transaction %d.", phase, txn->txn_id);
+
+    for(int i=0; i < txn->num_ops; i++) {
+        plc_tag_p tag = NULL;
+
+        if(txn->ops[i].phase != phase) {
+            continue;
+        }
+
+        txn->ops[i].held = 0;
+
+        tag = lookup_tag(txn_op_tag_id(&(txn->ops[i])));
+        if(tag) {
+            critical_block(tag->api_mutex) {
+                if(tag->vtable && tag->vtable->batch_hold && tag->vtable->batch_release) {
+                    txn->ops[i].held = (tag->vtable->batch_hold(tag) == PLCTAG_STATUS_OK);
+                }
+            }
+
+            rc_dec(tag);
+        }
+    }
+
+    for(int i=0; i < txn->num_ops; i++) {
+        int rc = PLCTAG_STATUS_OK;
+
+        if(txn->ops[i].phase != phase) {
+            continue;
+        }
+
+        if(txn->ops[i].is_write) {
+            rc = plc_tag_write(txn_op_tag_id(&(txn->ops[i])), 0);
+        } else {
+            rc = plc_tag_read(txn_op_tag_id(&(txn->ops[i])), 0);
+        }
+
+        critical_block(txn_mutex) {
+            txn->op_status[i] = rc;
+        }
+    }
+
+    for(int i=0; i < txn->num_ops; i++) {
+        plc_tag_p tag = NULL;
+
+        if(txn->ops[i].phase != phase || !txn->ops[i].held) {
+            continue;
+        }
+
+        tag = lookup_tag(txn_op_tag_id(&(txn->ops[i])));
+        if(tag) {
+            critical_block(tag->api_mutex) {
+                tag->vtable->batch_release(tag, txn->txn_id);
+            }
+
+            rc_dec(tag);
+        }
+
+        txn->ops[i].held = 0;
+    }
+
+    txn_end_starting(txn);
+
+    plc_tag_tickler_wake();
+
+    pdebug(DEBUG_DETAIL, "Done.");
+}
+
+
+
+/*
+ * txn_end_starting
+ *
+ * Clear the starting flag.  If the transaction was destroyed while it was
+ * being started, abort it now.
+ */
+void txn_end_starting(plc_tag_txn_p txn)
+{
+    int abort = 0;
+
+    critical_block(txn_mutex) {
+        txn->starting = 0;
+
+        if(txn->aborting && txn->in_flight) {
+            txn->in_flight = 0;
+            abort = 1;
+        }
+    }
+
+    if(abort) {
+        txn_abort(txn);
+    }
+}
+
+
+
+/*
+ * txn_abort
+ *
+ * Abort the unfinished operations of a transaction that was destroyed in
+ * flight and call the callback.  The caller must have cleared the in
+ * flight flag so that the tickler leaves the transaction alone.
+ */
+void txn_abort(plc_tag_txn_p txn)
+{
+    pdebug(DEBUG_INFO, "Aborting transaction %d.", txn->txn_id);
+
+    for(int i=0; i < txn->num_ops; i++) {
+        int started = 0;
+
+        critical_block(txn_mutex) {
+            if(txn->op_status[i] == PLCTAG_STATUS_PENDING) {
+                started = (!txn->waiting && txn->ops[i].phase == txn->phase);
+                txn->op_status[i] = PLCTAG_ERR_ABORT;
+            }
+        }
+
+        if(started) {
+            plc_tag_abort(txn_op_tag_id(&(txn->ops[i])));
+        }
+    }
+
+    if(txn->callback) {
+        pdebug(DEBUG_DETAIL, "Calling callback for transaction %d.", txn->txn_id);
+        txn->callback(txn->txn_id, txn->num_ops, txn->op_status, txn->userdata);
+    }
+}
+
+
+
+/*
+ * txn_copy_readback
+ *
+ * Copy the data read through a readback handle into the tag that was
+ * written.
+ */
+int txn_copy_readback(txn_op_t *op)
+{
+    plc_tag_p tag = lookup_tag(op->readback_tag_id);
+    uint8_t *data = NULL;
+    int32_t size = 0;
+
+    if(!tag) {
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        if(!tag->data || tag->size <= 0) {
+            break;
+        }
+
+        data = mem_alloc(tag->size);
+        if(data) {
+            size = tag->size;
+            mem_copy(data, tag->data, size);
+        }
+    }
+
+    rc_dec(tag);
+
+    if(!data) {
+        pdebug(DEBUG_WARN, "Unable to copy the readback data!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    tag = lookup_tag(op->tag_id);
+    if(tag) {
+        critical_block(tag->api_mutex) {
+            if(tag->data) {
+                int64_t change = tag_data_change_begin(tag);
+                mem_copy(tag->data, data, (size < tag->size ? size : tag->size));
+                tag_data_change_end(tag, change);
+            }
+        }
+
+        rc_dec(tag);
+    }
+
+    mem_free(data);
+
+    return (tag ? PLCTAG_STATUS_OK : PLCTAG_ERR_NOT_FOUND);
+}
+
+
+
+/*
+ * txn_tickler
+ *
+ * Called by the tag tickler thread after the tags have been ticked.  Find
+ * the operations that finished, then start the next phase or call the
+ * callback.  The tags of the operations are collected in op_tags and
+ * released outside of the transaction mutex as releasing the last reference
+ * runs the tag destructor.
+ */
+void txn_tickler(vector_p tick_txns, vector_p op_tags)
+{
+    if(!txns || !txn_mutex || !tick_txns || !op_tags) {
+        return;
+    }
+
+    critical_block(txn_mutex) {
+        hashtable_on_each(txns, snapshot_entry, tick_txns);
+    }
+
+    while(vector_length(tick_txns) > 0) {
+        plc_tag_txn_p txn = vector_remove(tick_txns, 0);
+        int retry_start = 0;
+        int phase_done = 0;
+        int txn_done = 0;
+        int done_phase = 0;
+
+        critical_block(txn_mutex) {
+            if(!txn->in_flight || txn->starting) {
+                break;
+            }
+
+            /* still waiting for the readback handles. */
+            if(txn->waiting) {
+                txn->starting = 1;
+                retry_start = 1;
+                break;
+            }
+
+            phase_done = 1;
+            done_phase = txn->phase;
+
+            for(int op=0; op < txn->num_ops; op++) {
+                plc_tag_p tag = NULL;
+                int tag_slot = vector_length(op_tags);
+
+                if(txn->ops[op].phase != txn->phase || txn->op_status[op] != PLCTAG_STATUS_PENDING) {
+                    continue;
+                }
+
+                /* make room first so that keeping the tag reference cannot fail. */
+                if(vector_put(op_tags, tag_slot, NULL) != PLCTAG_STATUS_OK) {
+                    pdebug(DEBUG_WARN, "Unable to allocate space for the transaction tags, checking again on the next pass.");
+                    phase_done = 0;
+                    break;
+                }
+
+                tag = lookup_tag(txn_op_tag_id(&(txn->ops[op])));
+                vector_put(op_tags, tag_slot, tag);
+
+                if(!tag) {
+                    txn->op_status[op] = PLCTAG_ERR_NOT_FOUND;
+                    continue;
+                }
+
+                /* do not wait on a tag held by the application. */
+                if(mutex_try_lock(tag->api_mutex) == PLCTAG_STATUS_OK) {
+                    int in_flight = (txn->ops[op].is_write ? tag->write_in_flight : tag->read_in_flight);
+
+                    if(!in_flight && tag->vtable && tag->vtable->status) {
+                        int status = tag->vtable->status(tag);
+
+                        if(status != PLCTAG_STATUS_PENDING) {
+                            txn->op_status[op] = status;
+                        }
+                    }
+
+                    mutex_unlock(tag->api_mutex);
+                }
+
+                if(txn->op_status[op] == PLCTAG_STATUS_PENDING) {
+                    phase_done = 0;
+                }
+            }
+
+            if(phase_done) {
+                if(txn->phase + 1 < txn->num_phases) {
+                    txn->phase++;
+                    txn->starting = 1;
+                } else {
+                    txn->in_flight = 0;
+                    txn_done = 1;
+                }
+            }
+        }
+
+        while(vector_length(op_tags) > 0) {
+            plc_tag_p tag = vector_remove(op_tags, vector_length(op_tags) - 1);
+
+            if(tag) {
+                rc_dec(tag);
+            }
+        }
+
+        if(retry_start) {
+            txn_start(txn);
+        }
+
+        /* the readbacks land in the written tags before the next phase can write them again. */
+        if(phase_done) {
+            for(int op=0; op < txn->num_ops; op++) {
+                if(txn->ops[op].phase == done_phase && txn->ops[op].readback_tag_id > 0 && txn->op_status[op] == PLCTAG_STATUS_OK) {
+                    int rc = txn_copy_readback(&(txn->ops[op]));
+
+                    critical_block(txn_mutex) {
+                        txn->op_status[op] = rc;
+                    }
+                }
+            }
+        }
+
+        if(phase_done && !txn_done) {
+            txn_start_phase(txn);
+        }
+
+        if(txn_done && txn->callback) {
+            pdebug(DEBUG_DETAIL, "Calling callback for transaction %d.", txn->txn_id);
+            txn->callback(txn->txn_id, txn->num_ops, txn->op_status, txn->userdata);
+        }
+
+        rc_dec(txn);
+    }
+}
+
+
+
+void txn_destroy(void *txn_arg)
+{
+    plc_tag_txn_p txn = (plc_tag_txn_p)txn_arg;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(txn->ops) {
+        /* the readback handles are already gone if the library is shutting down. */
+        for(int i=0; i < txn->num_ops && tag_lookup_mutex; i++) {
+            if(txn->ops[i].readback_tag_id > 0) {
+                plc_tag_destroy(txn->ops[i].readback_tag_id);
+            }
+        }
+
+        mem_free(txn->ops);
+        txn->ops = NULL;
+    }
+
+    if(txn->op_status) {
+        mem_free(txn->op_status);
+        txn->op_status = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+
+/*
+ * release_held_tags
+ *
+ * Release the connections held for the automatic reads and writes the
+ * tickler started.  The requests queued while they were held go out
+ * packed together where they fit.
+ */
+
+void release_held_tags(vector_p held_tags)
+{
+    while(held_tags && vector_length(held_tags) > 0) {
+        plc_tag_p tag = vector_remove(held_tags, vector_length(held_tags) - 1);
+
+        critical_block(tag->api_mutex) {
+            if(tag->auto_sync_held) {
+                tag->vtable->batch_release(tag, AUTO_SYNC_BATCH_ID);
+                tag->auto_sync_held = 0;
+            }
+        }
+
+        rc_dec(tag);
+    }
+}
+
+
+
+/*
+ * held_group_add
+ *
+ * Add a held tag to the tags of its automatic read group held in this
+ * pass of the tickler.  The group is released once all its tags are held.
+ *
+ * Returns the group or NULL if the tag could not be added.
+ */
+
+held_group_t *held_group_add(hashtable_p held_groups, plc_tag_p tag)
+{
+    held_group_t *group = NULL;
+
+    if(!held_groups) {
+        return NULL;
+    }
+
+    group = hashtable_get(held_groups, (int64_t)tag->auto_sync_read_group);
+    if(!group) {
+        group = mem_alloc((int)sizeof(*group));
+        if(!group) {
+            return NULL;
+        }
+
+        group->num_tags = auto_read_group_size(tag->auto_sync_read_group);
+        group->tags = vector_create(AUTO_SYNC_READ_GROUP_SIZE, AUTO_SYNC_READ_GROUP_SIZE);
+
+        if(!group->tags || hashtable_put(held_groups, (int64_t)tag->auto_sync_read_group, group) != PLCTAG_STATUS_OK) {
+            if(group->tags) {
+                vector_destroy(group->tags);
+            }
+
+            mem_free(group);
+            return NULL;
+        }
+    }
+
+    if(vector_put(group->tags, vector_length(group->tags), rc_inc(tag)) != PLCTAG_STATUS_OK) {
+        rc_dec(tag);
+        return NULL;
+    }
+
+    return group;
+}
+
+
+
+void held_group_release(hashtable_p held_groups, int32_t group_id, held_group_t *group)
+{
+    hashtable_remove(held_groups, (int64_t)group_id);
+
+    held_group_release_entry(held_groups, (int64_t)group_id, group, NULL);
+}
+
+
+
+/*
+ * held_group_release_entry
+ *
+ * Release the tags of a held group and free it.  This does not remove it
+ * from the table.
+ */
+
+int held_group_release_entry(hashtable_p held_groups, int64_t key, void *data, void *context)
+{
+    held_group_t *group = (held_group_t *)data;
+
+    (void)held_groups;
+    (void)key;
+    (void)context;
+
+    release_held_tags(group->tags);
+    vector_destroy(group->tags);
+    mem_free(group);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * auto_read_group_size
+ *
+ * Returns the number of tags in the automatic read group or zero if the
+ * group is gone.
+ */
+
+int auto_read_group_size(int32_t group_id)
+{
+    int num_tags = 0;
+
+    critical_block(auto_read_mutex) {
+        auto_read_group_t *group = hashtable_get(auto_read_groups, (int64_t)group_id);
+
+        if(group) {
+            num_tags = group->num_tags;
+        }
+    }
+
+    return num_tags;
+}
+
+
+
+/*
+ * plc_tag_generic_destroy_rc_table
+ *
+ * Destroy a table whose entries are reference counted and release the
+ * reference the table held to each one.  The entries are snapshotted
+ * first so that their destructors run after the table is gone.
+ */
+
+void plc_tag_generic_destroy_rc_table(hashtable_p table)
+{
+    vector_p entries = NULL;
+
+    if(!table) {
+        return;
+    }
+
+    entries = vector_create(hashtable_entries(table) + 1, 10);
+    if(!entries) {
+        pdebug(DEBUG_WARN, "Unable to allocate table snapshot, entries will leak!");
+    } else {
+        hashtable_on_each(table, snapshot_entry, entries);
+    }
+
+    hashtable_destroy(table);
+
+    if(entries) {
+        for(int i=0; i < vector_length(entries); i++) {
+            void *entry = vector_get(entries, i);
+
+            /* the snapshot's reference and then the table's. */
+            rc_dec(entry);
+            rc_dec(entry);
+        }
+
+        vector_destroy(entries);
+    }
+}
+
+
+
+
+/*
+ * snapshot_entry
+ *
+ * hashtable_on_each() callback that takes a reference to the entry and
+ * adds it to the vector passed as the context.  The caller must hold
+ * the mutex for the table.
+ */
+int snapshot_entry(hashtable_p table, int64_t key, void *data, void *context)
+{
+    vector_p snapshot = (vector_p)context;
+    void *ref = rc_inc(data);
+
+    (void)table;
+    (void)key;
+
+    /* the entry is being destroyed. */
+    if(!ref) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(vector_put(snapshot, vector_length(snapshot), ref) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to add entry to the snapshot!");
+        rc_dec(ref);
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * auto_read_conn_key
+ *
+ * Tags with the same gateway, path, PLC type and connection group will
+ * share a connection.  Hash those together so that we can group the tags
+ * without asking the protocol layer.
+ */
+
+uint32_t auto_read_conn_key(attr attribs)
+{
+    const char *names[] = { "protocol", "gateway", "path", "plc", "cpu" };
+    uint32_t key = 0;
+
+    for(size_t i=0; i < sizeof(names)/sizeof(names[0]); i++) {
+        key = hash_str_i(attr_get_str(attribs, names[i], ""), key);
+    }
+
+    return key + (uint32_t)attr_get_int(attribs, "connection_group_id", 0);
+}
+
+
+
+/*
+ * auto_read_join
+ *
+ * Put the tag into a schedule group for its connection and read period
+ * and set the time of its first automatic read.  The groups are filled up
+ * to AUTO_SYNC_READ_GROUP_SIZE tags.   Each new group of a period takes the
+ * first phase not used by another group of that period.
+ *
+ * The tag must not be in use by anything else or the caller must hold the
+ * API mutex.
+ */
+
+void auto_read_join(plc_tag_p tag)
+{
+    auto_read_group_t *group = NULL;
+    int64_t period_ms = tag->auto_sync_read_ms;
+    int64_t phase_ms = 0;
+    int64_t now = 0;
+
+    auto_read_leave(tag);
+
+    if(period_ms <= 0) {
+        tag->auto_sync_next_read = 0;
+        return;
+    }
+
+    critical_block(auto_read_mutex) {
+        int64_t open_key = auto_read_open_key(tag->auto_sync_conn_key, tag->auto_sync_read_ms);
+        int32_t phase_index = 0;
+
+        group = hashtable_get(auto_read_open_groups, open_key);
+
+        if(!group) {
+            int num_groups = hashtable_entries(auto_read_groups);
+            auto_read_phase_check_t phase_check = {0};
+
+            /* find the first free phase.  There are never more phases in use than groups. */
+            phase_check.period_ms = tag->auto_sync_read_ms;
+            phase_check.num_phases = num_groups + 1;
+            phase_check.phase_used = mem_alloc(num_groups + 1);
+
+            if(phase_check.phase_used) {
+                hashtable_on_each(auto_read_groups, auto_read_mark_phase, &phase_check);
+
+                while(phase_check.phase_used[phase_index]) {
+                    phase_index++;
+                }
+
+                mem_free(phase_check.phase_used);
+            } else {
+                phase_index = num_groups;
+            }
+
+            group = mem_alloc((int)sizeof(*group));
+            if(!group) {
+                pdebug(DEBUG_WARN, "Unable to allocate automatic read group!");
+                break;
+            }
+
+            group->group_id = next_auto_read_group_id++;
+            group->conn_key = tag->auto_sync_conn_key;
+            group->period_ms = tag->auto_sync_read_ms;
+            group->phase_index = phase_index;
+            group->phase_ms = auto_read_phase(group->period_ms, phase_index);
+
+            if(hashtable_put(auto_read_groups, (int64_t)group->group_id, group) != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Unable to add automatic read group!");
+                mem_free(group);
+                group = NULL;
+                break;
+            }
+
+            /* if this fails, the next tag just starts another group. */
+            hashtable_put(auto_read_open_groups, open_key, group);
+
+            pdebug(DEBUG_DETAIL, "Created automatic read group %" PRId32 " with phase %" PRId64 "ms of %" PRId32 "ms.", group->group_id, group->phase_ms, group->period_ms);
+        }
+
+        group->num_tags++;
+        tag->auto_sync_read_group = group->group_id;
+        phase_ms = group->phase_ms;
+
+        if(group->num_tags >= AUTO_SYNC_READ_GROUP_SIZE) {
+            hashtable_remove(auto_read_open_groups, open_key);
+        }
+    }
+
+    now = time_ms();
+
+    if(!group) {
+        /* fall back to spreading the reads randomly. */
+        tag->auto_sync_next_read = now + (rand() % period_ms);
+        return;
+    }
+
+    /* the first time on the group's schedule after now. */
+    tag->auto_sync_next_read = now + period_ms - (((now - phase_ms) % period_ms + period_ms) % period_ms);
+
+    pdebug(DEBUG_DETAIL, "Tag is in automatic read group %" PRId32 ", first read at %" PRId64 ".", tag->auto_sync_read_group, tag->auto_sync_next_read);
+}
+
+
+
+void auto_read_leave(plc_tag_p tag)
+{
+    if(!tag->auto_sync_read_group) {
+        return;
+    }
+
+    critical_block(auto_read_mutex) {
+        auto_read_group_t *group = hashtable_get(auto_read_groups, (int64_t)tag->auto_sync_read_group);
+        int64_t open_key = 0;
+
+        if(!group) {
+            break;
+        }
+
+        open_key = auto_read_open_key(group->conn_key, group->period_ms);
+        group->num_tags--;
+
+        if(group->num_tags <= 0) {
+            if(hashtable_get(auto_read_open_groups, open_key) == group) {
+                hashtable_remove(auto_read_open_groups, open_key);
+            }
+
+            hashtable_remove(auto_read_groups, (int64_t)group->group_id);
+            mem_free(group);
+        } else if(!hashtable_get(auto_read_open_groups, open_key)) {
+            /* the group has room again. */
+            hashtable_put(auto_read_open_groups, open_key, group);
+        }
+    }
+
+    tag->auto_sync_read_group = 0;
+}
+
+
+
+/*
+ * auto_read_open_key
+ *
+ * The key of the group that new tags of a connection and period go into.
+ */
+
+int64_t auto_read_open_key(uint32_t conn_key, int32_t period_ms)
+{
+    return (int64_t)(((uint64_t)conn_key << 32) | (uint64_t)(uint32_t)period_ms);
+}
+
+
+
+int auto_read_mark_phase(hashtable_p table, int64_t key, void *data, void *context)
+{
+    auto_read_group_t *group = (auto_read_group_t *)data;
+    auto_read_phase_check_t *phase_check = (auto_read_phase_check_t *)context;
+
+    (void)table;
+    (void)key;
+
+    if(group->period_ms == phase_check->period_ms && group->phase_index < phase_check->num_phases) {
+        phase_check->phase_used[group->phase_index] = 1;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int auto_read_free_group(hashtable_p table, int64_t key, void *data, void *context)
+{
+    (void)table;
+    (void)key;
+    (void)context;
+
+    mem_free(data);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * auto_read_phase
+ *
+ * Spread the phases of a period with the bit-reversed index.  Each new
+ * phase splits the largest gap left by the ones before it, so the groups
+ * stay evenly spread however many there are.   Phases are rounded down to
+ * the tickler's shortest wait.
+ */
+
+int64_t auto_read_phase(int32_t period_ms, int32_t phase_index)
+{
+    uint32_t reversed = 0;
+    uint32_t index = (uint32_t)phase_index;
+    int64_t phase_ms = 0;
+
+    for(int i=0; i < 32; i++) {
+        reversed = (reversed << 1) | (index & 1);
+        index >>= 1;
+    }
+
+    phase_ms = (int64_t)(((uint64_t)(uint32_t)period_ms * reversed) >> 32);
+
+    return phase_ms - (phase_ms % TAG_TICKLER_TIMEOUT_MIN_MS);
+}
+
+
+
+
+/*
+ * release_generic_tag_data
+ *
+ * Undo the library level set up of a tag that is being destroyed.  The
+ * caller must hold the tag API mutex or be the only user of the tag.
+ */
+
+void release_generic_tag_data(plc_tag_p tag)
+{
+    auto_read_leave(tag);
+
+    tag->on_change = 0;
+
+    if(tag->change_shadow) {
+        mem_free(tag->change_shadow);
+        tag->change_shadow = NULL;
+    }
+
+    tag->change_shadow_size = 0;
+
+    history_destroy(tag);
+
+    if(tag->attrib_str) {
+        mem_free(tag->attrib_str);
+        tag->attrib_str = NULL;
+    }
+}
+
+
+
+/*
+ * plc_tag_generic_mark_data_change
+ *
+ * Note that the bytes from offset for length are about to change so that
+ * both copies of a double-buffered tag pick them up.  A negative length
+ * marks the rest of the buffer.  The caller must hold the tag API mutex.
+ */
+
+void plc_tag_generic_mark_data_change(plc_tag_p tag, int offset, int length)
+{
+    struct tag_data_pub_t *pub = tag->data_pub;
+    int32_t start = 0;
+    int32_t end = 0;
+
+    if(!pub) {
+        return;
+    }
+
+    start = (offset > 0 ? (int32_t)offset : 0);
+
+    if(length < 0 || (int64_t)start + (int64_t)length > INT32_MAX) {
+        end = INT32_MAX;
+    } else {
+        end = start + (int32_t)length;
+    }
+
+    for(int i=0; i < 2; i++) {
+        if(pub->dirty_start[i] >= pub->dirty_end[i]) {
+            pub->dirty_start[i] = start;
+            pub->dirty_end[i] = end;
+        } else {
+            if(start < pub->dirty_start[i]) {
+                pub->dirty_start[i] = start;
+            }
+
+            if(end > pub->dirty_end[i]) {
+                pub->dirty_end[i] = end;
+            }
+        }
+    }
+}
+
+
+
+/*
+ * plc_tag_generic_publish_data
+ *
+ * Bring the spare copy of a double-buffered tag up to date with the tag
+ * data and make it the published copy.  The caller must hold the tag API
+ * mutex.
+ */
+
+void plc_tag_generic_publish_data(plc_tag_p tag)
+{
+    struct tag_data_pub_t *pub = tag->data_pub;
+    int spare = 0;
+    int32_t size = 0;
+    tag_data_copy_t *copy = NULL;
+
+    if(!pub) {
+        return;
+    }
+
+    spare = (int)((atomic_counter_get(&(pub->seq)) + 1) & 1);
+    size = (tag->data ? (int32_t)tag->size : 0);
+    copy = pub->copies[spare];
+
+    if(size < 0) {
+        size = 0;
+    }
+
+    if(!copy || copy->capacity < size) {
+        tag_data_copy_t *new_copy = NULL;
+        tag_data_copy_t **new_retired = NULL;
+
+        pdebug(DEBUG_DETAIL, "Allocating a %d byte copy of the tag data.", (int)size);
+
+        new_copy = mem_alloc((int)sizeof(*new_copy) + size);
+        if(!new_copy) {
+            pdebug(DEBUG_WARN, "Unable to allocate copy of the tag data, not publishing the change!");
+            return;
+        }
+
+        /* readers may still be in the old copy so keep it until the tag goes away. */
+        if(copy) {
+            new_retired = mem_realloc(pub->retired, (int)sizeof(*new_retired) * (pub->num_retired + 1));
+            if(!new_retired) {
+                pdebug(DEBUG_WARN, "Unable to allocate retired copy list, not publishing the change!");
+                mem_free(new_copy);
+                return;
+            }
+
+            new_retired[pub->num_retired] = copy;
+            pub->retired = new_retired;
+            pub->num_retired++;
+        }
+
+        new_copy->capacity = size;
+        pub->dirty_start[spare] = 0;
+        pub->dirty_end[spare] = size;
+
+        copy = new_copy;
+    }
+
+    if(pub->dirty_end[spare] > size) {
+        pub->dirty_end[spare] = size;
+    }
+
+    if(pub->dirty_start[spare] < pub->dirty_end[spare]) {
+        mem_copy(copy->data + pub->dirty_start[spare], tag->data + pub->dirty_start[spare], pub->dirty_end[spare] - pub->dirty_start[spare]);
+    }
+
+    pub->dirty_start[spare] = 0;
+    pub->dirty_end[spare] = 0;
+
+    copy->size = size;
+    pub->copies[spare] = copy;
+
+    /* this is the publish, the barrier makes the copy visible first. */
+    atomic_counter_add(&(pub->seq), 1);
+}
+
+
+
+/*
+ * plc_tag_generic_destroy_data_pub
+ *
+ * Free the published copies of a double-buffered tag.  This must only be
+ * called when the tag itself is being freed as lock free readers can be
+ * in the copies as long as they have a reference to the tag.
+ */
+
+void plc_tag_generic_destroy_data_pub(plc_tag_p tag)
+{
+    struct tag_data_pub_t *pub = tag->data_pub;
+
+    if(!pub) {
+        return;
+    }
+
+    tag->data_pub = NULL;
+
+    for(int i=0; i < 2; i++) {
+        if(pub->copies[i]) {
+            mem_free(pub->copies[i]);
+        }
+    }
+
+    for(int i=0; i < pub->num_retired; i++) {
+        mem_free(pub->retired[i]);
+    }
+
+    if(pub->retired) {
+        mem_free(pub->retired);
+    }
+
+    mem_free(pub);
+}
+
+
+
+/*
+ * plc_tag_generic_push_history
+ *
+ * Add the tag data and the status of a finished read to the history ring.
+ * The time is when the protocol received the response, if it noted that,
+ * otherwise now.  The caller must hold the tag API mutex.
+ */
+
+void plc_tag_generic_push_history(plc_tag_p tag, int status)
+{
+    struct tag_history_t *hist = tag->history;
+    int64_t timestamp_us = (tag->read_received_us ? tag->read_received_us : time_monotonic_us());
+    int slot = 0;
+
+    tag->read_received_us = 0;
+
+    if(!hist) {
+        return;
+    }
+
+    /* (re)size the data for the tag's current size, old entries cannot be kept. */
+    if(!hist->data || hist->entry_size != tag->size) {
+        int64_t data_size = (int64_t)hist->capacity * tag->size;
+
+        if(hist->data) {
+            mem_free(hist->data);
+            hist->data = NULL;
+        }
+
+        hist->overruns += hist->count;
+        hist->head = 0;
+        hist->count = 0;
+        hist->entry_size = 0;
+
+        if(data_size > INT_MAX || !(hist->data = mem_alloc((int)(data_size > 0 ? data_size : 1)))) {
+            pdebug(DEBUG_WARN, "Unable to allocate %" PRId64 " bytes of history for the tag!", data_size);
+            hist->overruns++;
+            return;
+        }
+
+        hist->entry_size = tag->size;
+    }
+
+    /* full, drop the oldest entry. */
+    if(hist->count == hist->capacity) {
+        hist->head = (hist->head + 1) % hist->capacity;
+        hist->count--;
+        hist->overruns++;
+    }
+
+    slot = (hist->head + hist->count) % hist->capacity;
+
+    hist->timestamps_us[slot] = timestamp_us;
+    hist->statuses[slot] = (int32_t)status;
+
+    if(tag->data && hist->entry_size > 0) {
+        mem_copy(hist->data + (slot * hist->entry_size), tag->data, hist->entry_size);
+    }
+
+    hist->count++;
+}
+
+
+
+int history_create(plc_tag_p tag, int capacity)
+{
+    struct tag_history_t *hist = NULL;
+
+    if(capacity > (INT_MAX / (int)sizeof(int64_t))) {
+        pdebug(DEBUG_WARN, "History size %d is too large!", capacity);
+        return PLCTAG_ERR_TOO_LARGE;
+    }
+
+    hist = mem_alloc((int)sizeof(*hist));
+    if(!hist) {
+        pdebug(DEBUG_WARN, "Unable to allocate history for tag!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    hist->capacity = capacity;
+    hist->timestamps_us = mem_alloc((int)sizeof(int64_t) * capacity);
+    hist->statuses = mem_alloc((int)sizeof(int32_t) * capacity);
+
+    critical_block(tag->api_mutex) {
+        tag->history = hist;
+
+        /* the read started by the creation has no start event. */
+        tag->history_read_pending = 1;
+    }
+
+    if(!hist->timestamps_us || !hist->statuses) {
+        pdebug(DEBUG_WARN, "Unable to allocate history for tag!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/* must be called with the tag API mutex held or as the last user of the tag. */
+void history_destroy(plc_tag_p tag)
+{
+    struct tag_history_t *hist = tag->history;
+
+    if(!hist) {
+        return;
+    }
+
+    tag->history = NULL;
+
+    if(hist->timestamps_us) {
+        mem_free(hist->timestamps_us);
+    }
+
+    if(hist->statuses) {
+        mem_free(hist->statuses);
+    }
+
+    if(hist->data) {
+        mem_free(hist->data);
+    }
+
+    mem_free(hist);
+}
+
+
+
+/* set up double buffering and publish the initial data. */
+int data_pub_create(plc_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    struct tag_data_pub_t *pub = NULL;
+
+    pub = mem_alloc((int)sizeof(*pub));
+    if(!pub) {
+        pdebug(DEBUG_WARN, "Unable to allocate double buffer for tag!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    critical_block(tag->api_mutex) {
+        tag->data_pub = pub;
+
+        plc_tag_generic_mark_data_change(tag, 0, -1);
+        plc_tag_generic_publish_data(tag);
+
+        if(!pub->copies[atomic_counter_get(&(pub->seq)) & 1]) {
+            rc = PLCTAG_ERR_NO_MEM;
+        }
+
+        /* a read may already be filling in the data without marking it. */
+        plc_tag_generic_mark_data_change(tag, 0, -1);
+    }
+
+    return rc;
+}
+
+
+
+void data_pub_get_published(plc_tag_p tag, int64_t seq, const uint8_t **data, int32_t *size)
+{
+    tag_data_copy_t *copy = tag->data_pub->copies[seq & 1];
+
+    if(copy) {
+        *data = copy->data;
+        *size = copy->size;
+    } else {
+        *data = NULL;
+        *size = 0;
+    }
+}
+
+
+
+/*
+ * tag_data_read_start and tag_data_read_next drive tag_data_read_block().
+ * Double-buffered tags return the publish sequence number the data came
+ * from, others take the API mutex for the single pass.
+ */
+
+int64_t tag_data_read_start(plc_tag_p tag, const uint8_t **data, int32_t *size)
+{
+    int64_t seq = 0;
+
+    if(tag->data_pub) {
+        seq = atomic_counter_get(&(tag->data_pub->seq));
+        data_pub_get_published(tag, seq, data, size);
+        return seq;
+    }
+
+    if(mutex_lock(tag->api_mutex) != PLCTAG_STATUS_OK) {
+        return TAG_DATA_READ_DONE;
+    }
+
+    *data = tag->data;
+    *size = tag->size;
+
+    return 0;
+}
+
+
+
+int64_t tag_data_read_next(plc_tag_p tag, int64_t seq, const uint8_t **data, int32_t *size)
+{
+    int64_t new_seq = 0;
+
+    if(!tag->data_pub) {
+        mutex_unlock(tag->api_mutex);
+        return TAG_DATA_READ_DONE;
+    }
+
+    new_seq = atomic_counter_get(&(tag->data_pub->seq));
+    if(new_seq == seq) {
+        return TAG_DATA_READ_DONE;
+    }
+
+    data_pub_get_published(tag, new_seq, data, size);
+
+    return new_seq;
+}
+
+
+
+/*
+ * get_byte_order_attrib
+ *
+ * Copy one of the tag's byte order maps, int16_byte_order etc., into the
+ * buffer.  Byte i of the value in host order is at data[offset + buffer[i]].
+ * Returns the number of bytes copied or PLCTAG_ERR_UNSUPPORTED if the
+ * attribute is not a byte order.  The caller must hold the tag API mutex.
+ */
+
+int get_byte_order_attrib(plc_tag_p tag, const char *attrib_name, uint8_t *buffer, int buffer_length)
+{
+    const int *order = NULL;
+    int order_size = 0;
+
+    if(str_cmp_i(attrib_name, "int16_byte_order") == 0) {
+        order = (tag->byte_order ? tag->byte_order->int16_order : NULL);
+        order_size = 2;
+    } else if(str_cmp_i(attrib_name, "int32_byte_order") == 0) {
+        order = (tag->byte_order ? tag->byte_order->int32_order : NULL);
+        order_size = 4;
+    } else if(str_cmp_i(attrib_name, "int64_byte_order") == 0) {
+        order = (tag->byte_order ? tag->byte_order->int64_order : NULL);
+        order_size = 8;
+    } else if(str_cmp_i(attrib_name, "float32_byte_order") == 0) {
+        order = (tag->byte_order ? tag->byte_order->float32_order : NULL);
+        order_size = 4;
+    } else if(str_cmp_i(attrib_name, "float64_byte_order") == 0) {
+        order = (tag->byte_order ? tag->byte_order->float64_order : NULL);
+        order_size = 8;
+    } else {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    if(!order) {
+        pdebug(DEBUG_WARN, "Tag has no byte order!");
+        tag->status = PLCTAG_ERR_NOT_IMPLEMENTED;
+        return PLCTAG_ERR_NOT_IMPLEMENTED;
+    }
+
+    if(buffer_length < order_size) {
+        pdebug(DEBUG_WARN, "Byte order is larger, %d bytes, than the buffer can hold, %d bytes.", order_size, buffer_length);
+        tag->status = PLCTAG_ERR_TOO_SMALL;
+        return PLCTAG_ERR_TOO_SMALL;
+    }
+
+    for(int i=0; i < order_size; i++) {
+        buffer[i] = (uint8_t)order[i];
+    }
+
+    tag->status = PLCTAG_STATUS_OK;
+
+    return order_size;
+}
+
+
+
+/* decode a float of the deadband type in the tag byte order. */
+double get_change_float(plc_tag_p tag, uint8_t *data, int offset)
+{
+    if(tag->change_float_size == 8) {
+        uint64_t uval = 0;
+        double fval = 0.0;
+
+        for(int i=0; i < 8; i++) {
+            uval |= ((uint64_t)(data[offset + tag->byte_order->float64_order[i]]) << (i * 8));
+        }
+
+        mem_copy(&fval, &uval, (int)sizeof(fval));
+
+        return fval;
+    } else {
+        uint32_t uval = 0;
+        float fval = 0.0f;
+
+        for(int i=0; i < 4; i++) {
+            uval |= ((uint32_t)(data[offset + tag->byte_order->float32_order[i]]) << (i * 8));
+        }
+
+        mem_copy(&fval, &uval, (int)sizeof(fval));
+
+        return (double)fval;
+    }
+}
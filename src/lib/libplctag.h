@@ -241,6 +241,7 @@ LIB_EXPORT void plc_tag_shutdown(void);
  *
  *      * starting a tag read operation.
  *      * a tag read operation ending.
+ *      * a completed read changing the tag data (only with on_change=1, see below).
  *      * a tag read being aborted.
  *      * starting a tag write operation.
  *      * a tag write operation ending.
@@ -258,6 +259,13 @@ LIB_EXPORT void plc_tag_shutdown(void);
  * When the callback is called with the PLCTAG_EVENT_DESTROY_STARTED, do not call any tag functions.  It is
  * not guaranteed that they will work and they will possibly hang or fail.
  *
+ * Tags created with the attribute on_change=1 raise PLCTAG_EVENT_VALUE_CHANGED after
+ * PLCTAG_EVENT_READ_COMPLETED when the data read differs from the data of the last change.
+ * The first successful read always counts as a change.  With change_deadband=<n> the tag data is
+ * compared as an array of floats (change_deadband_type=float32, the default, or float64) and a
+ * change is only raised when an element moves by more than n.  Use this with auto_sync_read_ms
+ * to get called only when the value changes.
+ *
  * Return values:
  *
  * If there is already a callback registered, the function will return PLCTAG_ERR_DUPLICATE.   Only one callback
@@ -278,7 +286,9 @@ LIB_EXPORT void plc_tag_shutdown(void);
 
 #define PLCTAG_EVENT_CREATED            (7)
 
-#define PLCTAG_EVENT_MAX                (PLCTAG_EVENT_CREATED + 1)
+#define PLCTAG_EVENT_VALUE_CHANGED      (8)
+
+#define PLCTAG_EVENT_MAX                (PLCTAG_EVENT_VALUE_CHANGED + 1)
 
 LIB_EXPORT int plc_tag_register_callback(int32_t tag_id, void (*tag_callback_func)(int32_t tag_id, int event, int status));
 
@@ -301,6 +311,69 @@ LIB_EXPORT int plc_tag_unregister_callback(int32_t tag_id);
 
 
 
+/*
+ * plc_tag_register_listing_callback
+ *
+ * This function streams the results of a tag listing tag, one whose name is "@tags" or
+ * "PROGRAM:<name>.@tags", to the passed callback function.  Only one listing callback function
+ * may be registered on a tag at a time!
+ *
+ * Without a listing callback, a read of a listing tag collects the whole symbol table in the tag
+ * data buffer before the read completes.  With one, each page of symbols is decoded as it arrives
+ * and passed to the callback.  The tag data buffer is not filled in.  The read completes as usual
+ * after the last page.
+ *
+ * The entries and the names they point to are only valid during the call.  Copy anything you need.
+ *
+ * Entries can be filtered in the library before they are passed to the callback with these tag
+ * attributes:
+ *
+ *      * listing_prefix=<string>   only names starting with the string, ignoring case.
+ *      * listing_type=<number>     only entries with this symbol type.   The array dimension bits
+ *                                  (13 and 14) are ignored when comparing.
+ *
+ * The filters also apply when no listing callback is registered.
+ *
+ * The callback is called in the context of the internal tag helper thread with the same rules as
+ * the callbacks registered with plc_tag_register_callback().
+ *
+ * Return values:
+ *
+ * If there is already a listing callback registered, the function will return PLCTAG_ERR_DUPLICATE.
+ * If a read is in flight on the tag, the function will return PLCTAG_ERR_BUSY.
+ *
+ * If all is successful, the function will return PLCTAG_STATUS_OK.
+ */
+
+typedef struct {
+    uint32_t instance_id;
+    uint16_t symbol_type;
+    uint16_t elem_size;
+    int num_dimensions;
+    uint32_t dimensions[3];
+    const char *name;   /* zero terminated. */
+} plc_tag_listing_entry_t;
+
+LIB_EXPORT int plc_tag_register_listing_callback(int32_t tag_id, void (*listing_callback_func)(int32_t tag_id, const plc_tag_listing_entry_t *entries, int num_entries, void *userdata), void *userdata);
+
+
+
+/*
+ * plc_tag_unregister_listing_callback
+ *
+ * This function removes the listing callback already registered on the tag.
+ *
+ * Return values:
+ *
+ * The function returns PLCTAG_STATUS_OK if there was a registered listing callback and removing it went well.
+ * An error of PLCTAG_ERR_NOT_FOUND is returned if there was no registered listing callback.
+ * If a read is in flight on the tag, the function will return PLCTAG_ERR_BUSY.
+ */
+
+LIB_EXPORT int plc_tag_unregister_listing_callback(int32_t tag_id);
+
+
+
 /*
  * plc_tag_register_logger
  *
@@ -450,14 +523,226 @@ LIB_EXPORT int plc_tag_write(int32_t tag, int timeout);
 
 
 
+/*
+ * Transactions
+ *
+ * A transaction collects reads and writes of several tags and starts them together.  Where
+ * the tags share a PLC connection that supports it, the requests are queued together and
+ * go out in one Multiple Service Packet if they fit.  They are not split across packets
+ * with other requests.  When every operation is done, the callback is called once with
+ * the status of each operation, in the order they were added.
+ *
+ * A tag can only have one operation in flight.  A read of a tag right after a write of it in
+ * the same transaction goes through a second handle that the transaction creates with the
+ * same attributes, so the write and the readback go out in the same packet.  The data read
+ * is copied into the tag before the callback is called.  The first submit after adding
+ * such a read waits for that handle to be created.  Any other repeated use of a tag is
+ * started after the earlier operations on it complete, so it goes out in a later packet.
+ *
+ * The PLC still runs each service on its own.  A packet is not all-or-nothing, so check
+ * the status of every operation.
+ *
+ * plc_tag_txn_create returns a transaction ID or an error.
+ *
+ * plc_tag_txn_add_read and plc_tag_txn_add_write add an operation on a tag.  Set the tag
+ * data before submitting a write.  They return PLCTAG_ERR_BUSY while the transaction is in
+ * flight.
+ *
+ * plc_tag_txn_submit starts the operations.  It returns PLCTAG_STATUS_PENDING, or
+ * PLCTAG_ERR_BUSY if the transaction is already in flight.  Once the callback has been
+ * called, the transaction can be submitted again.
+ *
+ * The callback is called in the context of the internal tag helper thread.  It must not
+ * block for long.
+ *
+ * plc_tag_txn_destroy frees the transaction.  If it is still in flight, the operations
+ * that have not finished are aborted and the callback is called with PLCTAG_ERR_ABORT as
+ * their status.  This can happen in the calling thread.
+ */
+
+LIB_EXPORT int32_t plc_tag_txn_create(void);
+LIB_EXPORT int plc_tag_txn_add_read(int32_t txn_id, int32_t tag_id);
+LIB_EXPORT int plc_tag_txn_add_write(int32_t txn_id, int32_t tag_id);
+LIB_EXPORT int plc_tag_txn_submit(int32_t txn_id, void (*txn_callback_func)(int32_t txn_id, int num_ops, const int *op_status, void *userdata), void *userdata);
+LIB_EXPORT int plc_tag_txn_destroy(int32_t txn_id);
+
+
+
+
+/*
+ * Pollers
+ *
+ * A poller reads a list of tags at fixed intervals and keeps the values for you to pick
+ * up in batches.  Each tag has a name, a type, an RPI (requested packet interval) in
+ * milliseconds and a tag attribute string.  The poller creates the tag with
+ * auto_sync_read_ms set to the RPI and the library's automatic reads do the polling.
+ *
+ * Tags are grouped by PLC (protocol, gateway, path and plc) and RPI.  Each group has a
+ * ring of samples that is allocated when the group is created.  Each sample has the time
+ * of the read in microseconds from a monotonic clock, the index of the tag and the value.
+ * Only the differences between these times mean anything.  When a ring is full the oldest
+ * sample is dropped and counted as an overrun.
+ *
+ * The types are bool, sint, usint, int, uint, dint, udint, lint, ulint, real and lreal.
+ * The value is read at offset zero and stored as a double, so 64-bit integers larger than
+ * 2^53 lose precision.
+ *
+ * plc_tag_poller_create returns a poller ID or an error.  ring_size is the number of
+ * samples in each group's ring, zero for the default of 4096.
+ *
+ * plc_tag_poller_add creates a tag and returns its index in the poller.  Indexes start at
+ * zero and go up in the order the tags are added.
+ *
+ * plc_tag_poller_load adds the tags in a poll list, one per line, in the format used by
+ * the data_dumper example:
+ *
+ *     <name>\t<type>\t<rpi>\t<tag attribute string>
+ *
+ * Blank lines and lines starting with # are skipped.  It returns the number of tags
+ * added.  On an error, the tags before the bad line stay in the poller.
+ *
+ * plc_tag_poller_read moves up to max_samples samples into the three arrays and returns
+ * how many it moved.  Nothing is allocated.  Samples from one group are in time order.
+ * Different groups are drained in turn so samples from different groups are not merged
+ * by time.
+ *
+ * plc_tag_poller_get_int_attribute returns num_tags, num_groups, ring_size, buffered
+ * (samples waiting to be read), overruns (samples dropped because a ring was full) and
+ * read_errors (reads that failed).
+ *
+ * plc_tag_poller_get_tag_name and plc_tag_poller_get_tag_id look up a tag by its index.
+ * The poller owns the tag, do not destroy it.
+ *
+ * plc_tag_poller_destroy destroys the tags and frees the rings.
+ */
+
+LIB_EXPORT int32_t plc_tag_poller_create(int ring_size);
+LIB_EXPORT int plc_tag_poller_add(int32_t poller_id, const char *name, const char *type_name, int rpi_ms, const char *attrib_str);
+LIB_EXPORT int plc_tag_poller_load(int32_t poller_id, const char *poll_list);
+LIB_EXPORT int plc_tag_poller_read(int32_t poller_id, int64_t *timestamps_us, int32_t *tag_indexes, double *values, int max_samples);
+LIB_EXPORT int plc_tag_poller_get_int_attribute(int32_t poller_id, const char *attrib_name, int default_value);
+LIB_EXPORT int plc_tag_poller_get_tag_name(int32_t poller_id, int tag_index, char *buffer, int buffer_length);
+LIB_EXPORT int32_t plc_tag_poller_get_tag_id(int32_t poller_id, int tag_index);
+LIB_EXPORT int plc_tag_poller_destroy(int32_t poller_id);
+
+
+
+
+/*
+ * Shared memory tag images
+ *
+ * An image publishes the latest data of a set of tags in a named shared memory segment so
+ * that other processes on the same machine can use it without opening their own
+ * connections to the PLCs.  One process is the publisher.  Any number of processes can be
+ * readers.
+ *
+ * The publisher creates the image with plc_tag_image_create.  max_tags is the number of
+ * slots and max_data_size the largest tag data a slot holds.  The segment size is fixed
+ * when it is created.  It returns an image ID or an error.  Creating an image whose name is
+ * in use by a running publisher fails with PLCTAG_ERR_DUPLICATE.  On POSIX systems a leading
+ * / is added to the name if it is missing and an old segment with the same name, e.g. from a
+ * publisher that crashed, is replaced.  On Windows the name is that of a file mapping.
+ *
+ * plc_tag_image_add creates a tag from the attribute string with auto_sync_read_ms set to
+ * rpi_ms and returns its slot index.  Slots are used in the order tags are added.  The key
+ * is how readers find the slot and must be unique and shorter than 64 characters.  When a
+ * read completes, the data, its size, the time of the read and the status are copied into
+ * the slot.  A failed read only changes the status.  Data larger than max_data_size is cut
+ * off and the status is PLCTAG_ERR_TOO_LARGE.  Until the first read the status is
+ * PLCTAG_STATUS_PENDING.
+ *
+ * plc_tag_image_get_tag_id gets the tag in a slot.  The image owns the tag, do not destroy
+ * it.  plc_tag_image_destroy marks the image closed, destroys the tags and removes the
+ * segment's name.  Readers that have it open keep their mapping.
+ *
+ * Readers use a plc_tag_image_reader_p instead of an ID.  plc_tag_image_open maps the
+ * segment read-only.  It does not initialize the library, no threads are started and no
+ * sockets are opened.  plc_tag_image_get_int_attribute returns num_tags, max_tags,
+ * max_data_size or closed.  plc_tag_image_find returns the slot of a key.
+ *
+ * plc_tag_image_read copies the data of a slot into the buffer and returns its size.
+ * Each slot has a sequence lock.  The read is a memory copy with no system calls and it
+ * retries if the publisher updated the slot during the copy, so the data, timestamp and
+ * status always come from the same update.  The timestamp is milliseconds since the epoch
+ * and seq counts the updates of the slot, use it to tell whether anything changed since
+ * the last read.  The timestamp, status and seq pointers may be NULL.  If the buffer is
+ * too small, PLCTAG_ERR_TOO_SMALL is returned, a buffer of max_data_size bytes is always
+ * large enough.  Once the publisher destroys the image, plc_tag_image_read returns
+ * PLCTAG_ERR_ABORT.  Close the reader and open the image again when the publisher comes
+ * back.
+ *
+ * plc_tag_image_close unmaps the segment and frees the reader.
+ */
+
+typedef struct plc_tag_image_reader_t *plc_tag_image_reader_p;
+
+LIB_EXPORT int32_t plc_tag_image_create(const char *name, int max_tags, int max_data_size);
+LIB_EXPORT int plc_tag_image_add(int32_t image_id, const char *key, int rpi_ms, const char *attrib_str);
+LIB_EXPORT int32_t plc_tag_image_get_tag_id(int32_t image_id, int slot);
+LIB_EXPORT int plc_tag_image_destroy(int32_t image_id);
+
+LIB_EXPORT int plc_tag_image_open(const char *name, plc_tag_image_reader_p *reader);
+LIB_EXPORT int plc_tag_image_get_int_attribute(plc_tag_image_reader_p reader, const char *attrib_name, int default_value);
+LIB_EXPORT int plc_tag_image_find(plc_tag_image_reader_p reader, const char *key);
+LIB_EXPORT int plc_tag_image_read(plc_tag_image_reader_p reader, int slot, uint8_t *buffer, int buffer_length, int64_t *timestamp_ms, int *status, uint32_t *seq);
+LIB_EXPORT int plc_tag_image_close(plc_tag_image_reader_p reader);
+
+
+
+
+/*
+ * Wire capture
+ *
+ * plc_tag_capture_start writes every frame sent to or received from a PLC to a pcap file
+ * until plc_tag_capture_stop is called.  This covers the EtherNet/IP (AB and Omron) and
+ * Modbus TCP transports.  Only one capture can run at a time, starting a second one returns
+ * PLCTAG_ERR_BUSY.  If the file cannot be opened, PLCTAG_ERR_OPEN is returned.  Stopping
+ * when no capture is running is not an error.
+ *
+ * Frames are recorded whole, as they are handed to or read from the socket, with a
+ * monotonic timestamp.  The file has the raw IP link type.  The IP and TCP headers are made
+ * up: the library is 10.0.0.1, the PLC is 10.0.0.2 and every connection gets its own client
+ * port.  The server port is the real one, so Wireshark and tcpdump decode the frames.  The
+ * time between a request and its response is the round trip time as the library saw it.
+ *
+ * ab_server --replay=<file> plays the responses in an EtherNet/IP capture back to a client
+ * with the original timing.  See the ab_server usage text.
+ *
+ * Writes to the file are buffered.  Stop the capture before reading the file.
+ */
+
+LIB_EXPORT int plc_tag_capture_start(const char *file_name);
+LIB_EXPORT int plc_tag_capture_stop(void);
+
+
+
+
 /*
  * Tag data accessors.
+ *
+ * The getters and setters normally take the tag API mutex, so a getter waits
+ * while the library copies a read response into the tag.  Tags created with
+ * double_buffer=1 keep a second, published copy of the data.  The library
+ * updates it with the changed bytes when a read, write or setter finishes and
+ * the numeric, bit and raw byte getters read it without taking the mutex.
+ * They never see a half finished read, but they do not see a setter's new
+ * value until the setter returns.  A setter called between the fragments of
+ * a large read is published with the read when it completes.  The string
+ * getters still take the mutex.
+ * plc_tag_get_int_attribute(tag, "double_buffer", 0) tells which mode a tag
+ * is in.
  */
 
 /* attributes */
 LIB_EXPORT int plc_tag_get_int_attribute(int32_t tag, const char *attrib_name, int default_value);
 LIB_EXPORT int plc_tag_set_int_attribute(int32_t tag, const char *attrib_name, int new_value);
 
+/*
+ * int16_byte_order, int32_byte_order, int64_byte_order, float32_byte_order and
+ * float64_byte_order return the tag's byte order as 2, 4 or 8 bytes.  Byte i of
+ * the value, least significant first, is at offset + buffer[i] in the tag data.
+ * This lets wrappers decode the data themselves.
+ */
 LIB_EXPORT int plc_tag_get_byte_array_attribute(int32_t tag, const char *attrib_name, uint8_t *buffer, int buffer_length);
 
 LIB_EXPORT int plc_tag_get_size(int32_t tag);
@@ -505,6 +790,92 @@ LIB_EXPORT int plc_tag_set_float32(int32_t tag, int offset, float val);
 LIB_EXPORT int plc_tag_set_raw_bytes(int32_t id, int offset, uint8_t *buffer, int buffer_length);
 LIB_EXPORT int plc_tag_get_raw_bytes(int32_t id, int offset, uint8_t *buffer, int buffer_length);
 
+/*
+ * plc_tag_view_acquire
+ *
+ * Pin the tag data and get a read-only pointer to it without copying.  This
+ * is meant for wrappers and bulk consumers that want to expose the whole tag
+ * buffer (a Python buffer, a Go slice etc.) instead of calling a getter per
+ * field.
+ *
+ * On success the tag is locked against the library until plc_tag_view_release()
+ * is called from the same thread.  While the view is held, the data pointer,
+ * size and sequence number do not change.  The library's background thread
+ * skips the tag in that time, so keep views short and do not call plc_tag_read()
+ * or plc_tag_write() on the tag until the view is released.  The getters can be
+ * called while holding a view.
+ *
+ * The sequence number is odd while the library is part way through changing the
+ * data, for instance between the fragments of a large read, and moves on by two
+ * with every completed change.  A setter called part way through a read does
+ * not end the read's change, the number stays odd until the read completes.  For double-buffered tags the view is of the
+ * published copy, which is always complete.
+ *
+ * Returns PLCTAG_STATUS_OK on success or an error if the tag cannot be found,
+ * has no data or any of the pointers are NULL.
+ */
+
+LIB_EXPORT int plc_tag_view_acquire(int32_t id, const uint8_t **data, int *size, uint32_t *seq);
+
+
+
+/*
+ * plc_tag_view_release
+ *
+ * Release a view gotten from plc_tag_view_acquire().  The data pointer must
+ * not be used for anything but the seqlock check below after this.
+ */
+
+LIB_EXPORT int plc_tag_view_release(int32_t id);
+
+
+
+/*
+ * plc_tag_get_data_seq
+ *
+ * Get the tag data sequence number without taking the tag lock.  Together with
+ * a pointer from a released view this allows a seqlock-style lock-free read:
+ *
+ *     do {
+ *         plc_tag_get_data_seq(tag, &seq1);
+ *         copy what is needed from the data pointer
+ *         plc_tag_get_data_seq(tag, &seq2);
+ *     } while((seq1 & 1) || seq1 != seq2);
+ *
+ * This is only safe when the tag size does not change after the first read as
+ * the library may reallocate the buffer otherwise.  Acquire a new view if
+ * plc_tag_get_size() changes.
+ */
+
+LIB_EXPORT int plc_tag_get_data_seq(int32_t id, uint32_t *seq);
+
+
+
+/*
+ * plc_tag_history_read
+ *
+ * Tags created with the attribute history=N keep the last N reads in a ring so
+ * that a consumer that is slower than the reads does not lose values.  Each
+ * entry has a copy of the tag data, the status of the read and the time the
+ * response was received in microseconds from a monotonic clock.  Only the
+ * differences between these times mean anything.  The time is taken when the
+ * response comes off the socket for AB and Modbus tags and when the read
+ * completes for other tags.  Do not use the data of entries with an error
+ * status.
+ *
+ * This moves up to max_entries of the oldest entries out of the ring and returns
+ * how many it moved.  The data of entry i goes to data + (i * entry_size) and
+ * entry_size must be at least plc_tag_get_size().  Pass NULL data and a zero
+ * entry_size to only get the times and statuses.  When the ring is full the
+ * oldest entry is dropped.  If the tag size changes the ring is emptied.
+ *
+ * plc_tag_get_int_attribute() returns history (the ring size), history_count
+ * (entries waiting) and history_overruns (entries dropped).
+ * PLCTAG_ERR_UNSUPPORTED is returned for tags without a history.
+ */
+
+LIB_EXPORT int plc_tag_history_read(int32_t id, int64_t *timestamps_us, int *statuses, uint8_t *data, int entry_size, int max_entries);
+
 /* string accessors */
 
 LIB_EXPORT int plc_tag_get_string(int32_t tag_id, int string_start_offset, char *buffer, int buffer_length);
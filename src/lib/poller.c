@@ -0,0 +1,992 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#define LIBPLCTAGDLL_EXPORTS 1
+
+#include <limits.h>
+#include <stdlib.h>
+#include <lib/libplctag.h>
+#include <lib/tag.h>
+#include <lib/init.h>
+#include <lib/poller.h>
+#include <platform.h>
+#include <util/attr.h>
+#include <util/debug.h>
+#include <util/hashtable.h>
+#include <util/rc.h>
+#include <util/vector.h>
+
+
+/*
+ * Pollers, see plc_tag_poller_create().
+ *
+ * A poller owns a set of tags read by the library's automatic reads.  The
+ * tags are grouped by PLC and RPI.  Each group has a ring of samples kept
+ * as separate columns of timestamps, tag indexes and values.  The rings are
+ * allocated when the group is created and never grow.  When a ring is
+ * full, the oldest sample is overwritten and counted as an overrun.
+ */
+
+#define INITIAL_POLLER_TABLE_SIZE (11)
+#define POLLER_ID_MASK (0xFFFFFFF)
+#define MAX_POLLER_MAP_ATTEMPTS (50)
+#define POLLER_DEFAULT_RING_SIZE (4096)
+#define POLLER_VECTOR_INC (32)
+
+typedef enum {
+    POLL_TYPE_BOOL,
+    POLL_TYPE_SINT,
+    POLL_TYPE_USINT,
+    POLL_TYPE_INT,
+    POLL_TYPE_UINT,
+    POLL_TYPE_DINT,
+    POLL_TYPE_UDINT,
+    POLL_TYPE_LINT,
+    POLL_TYPE_ULINT,
+    POLL_TYPE_REAL,
+    POLL_TYPE_LREAL
+} poll_type_t;
+
+static const struct {
+    const char *name;
+    poll_type_t type;
+} poll_type_map[] = {
+    {"bool", POLL_TYPE_BOOL},
+    {"sint", POLL_TYPE_SINT},
+    {"usint", POLL_TYPE_USINT},
+    {"int", POLL_TYPE_INT},
+    {"uint", POLL_TYPE_UINT},
+    {"dint", POLL_TYPE_DINT},
+    {"udint", POLL_TYPE_UDINT},
+    {"lint", POLL_TYPE_LINT},
+    {"ulint", POLL_TYPE_ULINT},
+    {"real", POLL_TYPE_REAL},
+    {"lreal", POLL_TYPE_LREAL}
+};
+
+typedef struct {
+    char *plc_key;
+    int rpi_ms;
+    mutex_p mutex;
+
+    /* the ring, samples run from head for count entries. */
+    int capacity;
+    int head;
+    int count;
+    int64_t *timestamps;
+    int32_t *tag_indexes;
+    double *values;
+
+    int64_t overruns;
+    int64_t read_errors;
+} poll_group_t;
+
+typedef poll_group_t *poll_group_p;
+
+typedef struct {
+    char *name;
+    poll_type_t type;
+    int32_t tag_id;
+    int32_t index;
+    poll_group_p group;
+} poll_tag_t;
+
+typedef poll_tag_t *poll_tag_p;
+
+struct plc_tag_poller_t {
+    int32_t poller_id;
+    int ring_size;
+    int next_group;
+    mutex_p mutex;
+    vector_p tags;
+    vector_p groups;
+};
+
+typedef struct plc_tag_poller_t *plc_tag_poller_p;
+
+
+static volatile int32_t next_poller_id = 1;
+static volatile hashtable_p pollers = NULL;
+static mutex_p poller_mutex = NULL;
+
+
+static plc_tag_poller_p lookup_poller(int32_t poller_id);
+static void poller_destroy(void *poller_arg);
+static int parse_poll_type(const char *type_name, poll_type_t *type);
+static char *make_plc_key(const char *attrib_str);
+static poll_group_p get_group(plc_tag_poller_p poller, const char *plc_key, int rpi_ms);
+static void group_destroy(poll_group_p group);
+static int group_read(poll_group_p group, int64_t *timestamps, int32_t *tag_indexes, double *values, int max_samples);
+static double decode_value(int32_t tag_id, poll_type_t type);
+static void poll_tag_callback(int32_t tag_id, int event, int status, void *userdata);
+
+
+
+
+int poller_init(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    pdebug(DEBUG_INFO,"Creating poller hashtable.");
+    if((pollers = hashtable_create(INITIAL_POLLER_TABLE_SIZE)) == NULL) {
+        pdebug(DEBUG_ERROR, "Unable to create poller hashtable!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    pdebug(DEBUG_INFO,"Creating poller mutex.");
+    rc = mutex_create((mutex_p *)&poller_mutex);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to create poller mutex!");
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+void poller_teardown(void)
+{
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(pollers) {
+        pdebug(DEBUG_INFO, "Destroying poller hashtable.");
+
+        plc_tag_generic_destroy_rc_table(pollers);
+        pollers = NULL;
+    }
+
+    if(poller_mutex) {
+        pdebug(DEBUG_INFO,"Tearing down poller mutex.");
+        mutex_destroy(&poller_mutex);
+        poller_mutex = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+
+/*
+ * plc_tag_poller_create
+ *
+ * Create an empty poller.  See libplctag.h for how pollers work.
+ */
+
+LIB_EXPORT int32_t plc_tag_poller_create(int ring_size)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_poller_p poller = NULL;
+    int32_t poller_id = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* make sure that the library is initialized. */
+    rc = initialize_modules();
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to initialize the internal library state!");
+        return rc;
+    }
+
+    if(ring_size < 0) {
+        pdebug(DEBUG_WARN, "Ring size must not be negative!");
+        return PLCTAG_ERR_OUT_OF_BOUNDS;
+    }
+
+    poller = (plc_tag_poller_p)rc_alloc((int)sizeof(struct plc_tag_poller_t), poller_destroy);
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Unable to allocate poller!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    poller->ring_size = (ring_size > 0 ? ring_size : POLLER_DEFAULT_RING_SIZE);
+
+    rc = mutex_create(&poller->mutex);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to create poller mutex!");
+        rc_dec(poller);
+        return rc;
+    }
+
+    poller->tags = vector_create(POLLER_VECTOR_INC, POLLER_VECTOR_INC);
+    poller->groups = vector_create(POLLER_VECTOR_INC, POLLER_VECTOR_INC);
+    if(!poller->tags || !poller->groups) {
+        pdebug(DEBUG_WARN, "Unable to allocate poller vectors!");
+        rc_dec(poller);
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = PLCTAG_ERR_NO_RESOURCES;
+
+    critical_block(poller_mutex) {
+        for(int attempts = 0; attempts < MAX_POLLER_MAP_ATTEMPTS; attempts++) {
+            poller_id = (next_poller_id + 1) & POLLER_ID_MASK;
+
+            if(poller_id == 0) {
+                poller_id = 1;
+            }
+
+            next_poller_id = poller_id;
+
+            if(!hashtable_get(pollers, (int64_t)poller_id)) {
+                poller->poller_id = poller_id;
+                rc = hashtable_put(pollers, (int64_t)poller_id, poller);
+                break;
+            }
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to add poller to the table, error %s!", plc_tag_decode_error(rc));
+        rc_dec(poller);
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done, created poller %d.", poller_id);
+
+    return poller_id;
+}
+
+
+
+/*
+ * plc_tag_poller_add
+ *
+ * Create a tag read every rpi_ms milliseconds by the automatic reads and
+ * put it in the group for its PLC and RPI.  Returns the index of the tag
+ * in the poller.
+ */
+
+LIB_EXPORT int plc_tag_poller_add(int32_t poller_id, const char *name, const char *type_name, int rpi_ms, const char *attrib_str)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_poller_p poller = NULL;
+    poll_tag_p ptag = NULL;
+    poll_type_t type = POLL_TYPE_DINT;
+    char *plc_key = NULL;
+    char *tag_attribs = NULL;
+    int index = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!name || str_length(name) == 0) {
+        pdebug(DEBUG_WARN, "A name is required!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    if((rc = parse_poll_type(type_name, &type)) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unsupported type \"%s\" for %s!", (type_name ? type_name : "NULL"), name);
+        return rc;
+    }
+
+    poller = lookup_poller(poller_id);
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Poller %d not found!", poller_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    /* the poller drives the reads. */
+    rc = plc_tag_generic_make_auto_read_attribs(attrib_str, rpi_ms, &tag_attribs);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to set up the automatic reads for tag %s, error %s!", name, plc_tag_decode_error(rc));
+        rc_dec(poller);
+        return rc;
+    }
+
+    plc_key = make_plc_key(attrib_str);
+    ptag = (poll_tag_p)mem_alloc((int)sizeof(poll_tag_t));
+
+    if(!plc_key || !ptag || !(ptag->name = str_dup(name))) {
+        pdebug(DEBUG_WARN, "Unable to allocate memory for tag %s!", name);
+        rc = PLCTAG_ERR_NO_MEM;
+    }
+
+    if(rc == PLCTAG_STATUS_OK) {
+        ptag->type = type;
+
+        /* hold the poller while the tag is created so the indexes stay in add order. */
+        critical_block(poller->mutex) {
+            ptag->group = get_group(poller, plc_key, rpi_ms);
+            if(!ptag->group) {
+                rc = PLCTAG_ERR_NO_MEM;
+                break;
+            }
+
+            index = vector_length(poller->tags);
+            ptag->index = index;
+
+            /* the group and index must be set before the first read completes. */
+            ptag->tag_id = plc_tag_create_ex(tag_attribs, poll_tag_callback, ptag, 0);
+            if(ptag->tag_id < 0) {
+                rc = ptag->tag_id;
+                break;
+            }
+
+            rc = vector_put(poller->tags, index, ptag);
+            if(rc != PLCTAG_STATUS_OK) {
+                plc_tag_destroy(ptag->tag_id);
+            }
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to add tag %s to poller %d, error %s!", name, poller_id, plc_tag_decode_error(rc));
+
+        if(ptag) {
+            if(ptag->name) {
+                mem_free(ptag->name);
+            }
+
+            mem_free(ptag);
+        }
+    }
+
+    if(tag_attribs) {
+        mem_free(tag_attribs);
+    }
+
+    if(plc_key) {
+        mem_free(plc_key);
+    }
+
+    rc_dec(poller);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return (rc == PLCTAG_STATUS_OK ? index : rc);
+}
+
+
+
+/*
+ * plc_tag_poller_load
+ *
+ * Add the tags in a poll list.  Each line is
+ *
+ *     <name>\t<type>\t<rpi>\t<tag string>
+ *
+ * Blank lines and lines starting with # are skipped.  Returns the number
+ * of tags added.  On an error, the tags from the lines before it stay in
+ * the poller.
+ */
+
+LIB_EXPORT int plc_tag_poller_load(int32_t poller_id, const char *poll_list)
+{
+    int rc = PLCTAG_STATUS_OK;
+    char **lines = NULL;
+    int num_added = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!poll_list) {
+        pdebug(DEBUG_WARN, "Poll list pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    lines = str_split(poll_list, "\n");
+    if(!lines) {
+        pdebug(DEBUG_WARN, "Unable to split the poll list into lines!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    for(int i=0; lines[i] && rc == PLCTAG_STATUS_OK; i++) {
+        char *line = lines[i];
+        char **fields = NULL;
+        int len = str_length(line);
+        int rpi_ms = 0;
+
+        /* trim trailing white space, including the CR of CRLF line ends. */
+        while(len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t')) {
+            line[--len] = 0;
+        }
+
+        /* skip leading white space to check for blank lines and comments. */
+        while(*line == ' ' || *line == '\t') {
+            line++;
+        }
+
+        if(*line == 0 || *line == '#') {
+            continue;
+        }
+
+        fields = str_split(line, "\t");
+        if(!fields) {
+            rc = PLCTAG_ERR_NO_MEM;
+            break;
+        }
+
+        if(!fields[0] || !fields[1] || !fields[2] || !fields[3]) {
+            pdebug(DEBUG_WARN, "Poll list line %d does not have four tab separated fields!", i + 1);
+            rc = PLCTAG_ERR_BAD_CONFIG;
+        } else if(str_to_int(fields[2], &rpi_ms) != 0) {
+            pdebug(DEBUG_WARN, "Poll list line %d has a bad RPI \"%s\"!", i + 1, fields[2]);
+            rc = PLCTAG_ERR_BAD_CONFIG;
+        } else {
+            rc = plc_tag_poller_add(poller_id, fields[0], fields[1], rpi_ms, fields[3]);
+
+            if(rc >= 0) {
+                num_added++;
+                rc = PLCTAG_STATUS_OK;
+            } else {
+                pdebug(DEBUG_WARN, "Unable to add the tag on poll list line %d, error %s!", i + 1, plc_tag_decode_error(rc));
+            }
+        }
+
+        mem_free(fields);
+    }
+
+    mem_free(lines);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return (rc == PLCTAG_STATUS_OK ? num_added : rc);
+}
+
+
+
+/*
+ * plc_tag_poller_read
+ *
+ * Move up to max_samples samples out of the rings into the caller's
+ * column arrays.  The groups are drained in turn, starting after the group
+ * the last call stopped in, so that one busy group does not starve the
+ * others.  Returns the number of samples copied.
+ */
+
+LIB_EXPORT int plc_tag_poller_read(int32_t poller_id, int64_t *timestamps_us, int32_t *tag_indexes, double *values, int max_samples)
+{
+    plc_tag_poller_p poller = NULL;
+    int num_samples = 0;
+
+    if(!timestamps_us || !tag_indexes || !values) {
+        pdebug(DEBUG_WARN, "Sample array pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(max_samples <= 0) {
+        return 0;
+    }
+
+    poller = lookup_poller(poller_id);
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Poller %d not found!", poller_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(poller->mutex) {
+        int num_groups = vector_length(poller->groups);
+
+        for(int i=0; i < num_groups && num_samples < max_samples; i++) {
+            int group_index = (poller->next_group + i) % num_groups;
+            poll_group_p group = vector_get(poller->groups, group_index);
+
+            num_samples += group_read(group, timestamps_us + num_samples, tag_indexes + num_samples, values + num_samples, max_samples - num_samples);
+
+            /* start with the next group if this one might have more. */
+            poller->next_group = (group_index + 1) % num_groups;
+        }
+    }
+
+    rc_dec(poller);
+
+    return num_samples;
+}
+
+
+
+/*
+ * plc_tag_poller_get_int_attribute
+ *
+ * Get the poller counters.  See libplctag.h for the names.
+ */
+
+LIB_EXPORT int plc_tag_poller_get_int_attribute(int32_t poller_id, const char *attrib_name, int default_value)
+{
+    plc_tag_poller_p poller = NULL;
+    int64_t res = default_value;
+
+    if(!attrib_name || str_length(attrib_name) == 0) {
+        pdebug(DEBUG_WARN, "Attribute name must not be null or zero-length!");
+        return default_value;
+    }
+
+    poller = lookup_poller(poller_id);
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Poller %d not found!", poller_id);
+        return default_value;
+    }
+
+    critical_block(poller->mutex) {
+        int num_groups = vector_length(poller->groups);
+
+        if(str_cmp_i(attrib_name, "num_tags") == 0) {
+            res = vector_length(poller->tags);
+        } else if(str_cmp_i(attrib_name, "num_groups") == 0) {
+            res = num_groups;
+        } else if(str_cmp_i(attrib_name, "ring_size") == 0) {
+            res = poller->ring_size;
+        } else if(str_cmp_i(attrib_name, "buffered") == 0 || str_cmp_i(attrib_name, "overruns") == 0 || str_cmp_i(attrib_name, "read_errors") == 0) {
+            res = 0;
+
+            for(int i=0; i < num_groups; i++) {
+                poll_group_p group = vector_get(poller->groups, i);
+
+                critical_block(group->mutex) {
+                    if(str_cmp_i(attrib_name, "buffered") == 0) {
+                        res += group->count;
+                    } else if(str_cmp_i(attrib_name, "overruns") == 0) {
+                        res += group->overruns;
+                    } else {
+                        res += group->read_errors;
+                    }
+                }
+            }
+        } else {
+            pdebug(DEBUG_WARN, "Unsupported poller attribute \"%s\"!", attrib_name);
+        }
+    }
+
+    rc_dec(poller);
+
+    return (res > INT_MAX ? INT_MAX : (int)res);
+}
+
+
+
+/*
+ * plc_tag_poller_get_tag_name
+ *
+ * Copy the name of the tag at tag_index into the buffer.
+ */
+
+LIB_EXPORT int plc_tag_poller_get_tag_name(int32_t poller_id, int tag_index, char *buffer, int buffer_length)
+{
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_poller_p poller = NULL;
+
+    if(!buffer || buffer_length <= 0) {
+        pdebug(DEBUG_WARN, "Buffer is null or zero length!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    poller = lookup_poller(poller_id);
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Poller %d not found!", poller_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(poller->mutex) {
+        poll_tag_p ptag = NULL;
+
+        if(tag_index < 0 || tag_index >= vector_length(poller->tags)) {
+            rc = PLCTAG_ERR_OUT_OF_BOUNDS;
+            break;
+        }
+
+        ptag = vector_get(poller->tags, tag_index);
+
+        if(str_length(ptag->name) >= buffer_length) {
+            rc = PLCTAG_ERR_TOO_SMALL;
+            break;
+        }
+
+        str_copy(buffer, buffer_length, ptag->name);
+    }
+
+    rc_dec(poller);
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_poller_get_tag_id
+ *
+ * Get the ID of the tag at tag_index, to check its status or read other
+ * parts of its data.  The poller owns the tag, do not destroy it.
+ */
+
+LIB_EXPORT int32_t plc_tag_poller_get_tag_id(int32_t poller_id, int tag_index)
+{
+    int32_t rc = PLCTAG_ERR_OUT_OF_BOUNDS;
+    plc_tag_poller_p poller = lookup_poller(poller_id);
+
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Poller %d not found!", poller_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(poller->mutex) {
+        if(tag_index >= 0 && tag_index < vector_length(poller->tags)) {
+            poll_tag_p ptag = vector_get(poller->tags, tag_index);
+
+            rc = ptag->tag_id;
+        }
+    }
+
+    rc_dec(poller);
+
+    return rc;
+}
+
+
+
+/*
+ * plc_tag_poller_destroy
+ *
+ * Destroy the poller, its tags and its rings.
+ */
+
+LIB_EXPORT int plc_tag_poller_destroy(int32_t poller_id)
+{
+    plc_tag_poller_p poller = NULL;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!pollers || !poller_mutex) {
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(poller_mutex) {
+        poller = hashtable_remove(pollers, (int64_t)poller_id);
+    }
+
+    if(!poller) {
+        pdebug(DEBUG_WARN, "Poller %d not found!", poller_id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    rc_dec(poller);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+
+/*****************************************************************************************************
+ ****************************************** Support Functions ****************************************
+ *****************************************************************************************************/
+
+
+plc_tag_poller_p lookup_poller(int32_t poller_id)
+{
+    plc_tag_poller_p poller = NULL;
+
+    if(!pollers || !poller_mutex) {
+        return NULL;
+    }
+
+    critical_block(poller_mutex) {
+        poller = rc_inc(hashtable_get(pollers, (int64_t)poller_id));
+    }
+
+    return poller;
+}
+
+
+
+void poller_destroy(void *poller_arg)
+{
+    plc_tag_poller_p poller = (plc_tag_poller_p)poller_arg;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* destroying a tag waits for its callback, after this nothing touches the rings. */
+    if(poller->tags) {
+        while(vector_length(poller->tags) > 0) {
+            poll_tag_p ptag = vector_remove(poller->tags, vector_length(poller->tags) - 1);
+
+            plc_tag_destroy(ptag->tag_id);
+
+            mem_free(ptag->name);
+            mem_free(ptag);
+        }
+
+        vector_destroy(poller->tags);
+        poller->tags = NULL;
+    }
+
+    if(poller->groups) {
+        while(vector_length(poller->groups) > 0) {
+            group_destroy(vector_remove(poller->groups, vector_length(poller->groups) - 1));
+        }
+
+        vector_destroy(poller->groups);
+        poller->groups = NULL;
+    }
+
+    if(poller->mutex) {
+        mutex_destroy(&poller->mutex);
+        poller->mutex = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+int parse_poll_type(const char *type_name, poll_type_t *type)
+{
+    if(!type_name) {
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    for(size_t i=0; i < sizeof(poll_type_map)/sizeof(poll_type_map[0]); i++) {
+        if(str_cmp_i(poll_type_map[i].name, type_name) == 0) {
+            *type = poll_type_map[i].type;
+            return PLCTAG_STATUS_OK;
+        }
+    }
+
+    return PLCTAG_ERR_BAD_PARAM;
+}
+
+
+
+/*
+ * Tags with the same protocol, gateway, path and PLC type go to the same
+ * PLC.  The key is only used to group tags, the library still decides
+ * how connections are shared.
+ */
+
+char *make_plc_key(const char *attrib_str)
+{
+    attr attribs = attr_create_from_str(attrib_str);
+    char *key = NULL;
+
+    if(!attribs) {
+        return NULL;
+    }
+
+    key = str_concat(attr_get_str(attribs, "protocol", ""), "|",
+                     attr_get_str(attribs, "gateway", ""), "|",
+                     attr_get_str(attribs, "path", ""), "|",
+                     attr_get_str(attribs, "plc", attr_get_str(attribs, "cpu", "")));
+
+    attr_destroy(attribs);
+
+    return key;
+}
+
+
+
+/* find or create the group for the PLC and RPI.  Must be called with the poller mutex held. */
+poll_group_p get_group(plc_tag_poller_p poller, const char *plc_key, int rpi_ms)
+{
+    poll_group_p group = NULL;
+
+    for(int i=0; i < vector_length(poller->groups); i++) {
+        group = vector_get(poller->groups, i);
+
+        if(group->rpi_ms == rpi_ms && str_cmp(group->plc_key, plc_key) == 0) {
+            return group;
+        }
+    }
+
+    pdebug(DEBUG_INFO, "Creating group for %s at %dms with %d samples.", plc_key, rpi_ms, poller->ring_size);
+
+    group = (poll_group_p)mem_alloc((int)sizeof(poll_group_t));
+    if(!group) {
+        return NULL;
+    }
+
+    group->rpi_ms = rpi_ms;
+    group->capacity = poller->ring_size;
+    group->plc_key = str_dup(plc_key);
+    group->timestamps = (int64_t *)mem_alloc((int)sizeof(int64_t) * group->capacity);
+    group->tag_indexes = (int32_t *)mem_alloc((int)sizeof(int32_t) * group->capacity);
+    group->values = (double *)mem_alloc((int)sizeof(double) * group->capacity);
+
+    if(!group->plc_key || !group->timestamps || !group->tag_indexes || !group->values
+       || mutex_create(&group->mutex) != PLCTAG_STATUS_OK
+       || vector_put(poller->groups, vector_length(poller->groups), group) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to allocate group!");
+        group_destroy(group);
+        return NULL;
+    }
+
+    return group;
+}
+
+
+
+void group_destroy(poll_group_p group)
+{
+    if(!group) {
+        return;
+    }
+
+    if(group->mutex) {
+        mutex_destroy(&group->mutex);
+    }
+
+    if(group->plc_key) {
+        mem_free(group->plc_key);
+    }
+
+    if(group->timestamps) {
+        mem_free(group->timestamps);
+    }
+
+    if(group->tag_indexes) {
+        mem_free(group->tag_indexes);
+    }
+
+    if(group->values) {
+        mem_free(group->values);
+    }
+
+    mem_free(group);
+}
+
+
+
+/* copy out the oldest samples, at most two copies per column as the ring wraps. */
+int group_read(poll_group_p group, int64_t *timestamps, int32_t *tag_indexes, double *values, int max_samples)
+{
+    int num_samples = 0;
+
+    critical_block(group->mutex) {
+        num_samples = (group->count < max_samples ? group->count : max_samples);
+
+        for(int copied = 0; copied < num_samples; ) {
+            int chunk = num_samples - copied;
+
+            if(chunk > group->capacity - group->head) {
+                chunk = group->capacity - group->head;
+            }
+
+            mem_copy(timestamps + copied, group->timestamps + group->head, (int)sizeof(int64_t) * chunk);
+            mem_copy(tag_indexes + copied, group->tag_indexes + group->head, (int)sizeof(int32_t) * chunk);
+            mem_copy(values + copied, group->values + group->head, (int)sizeof(double) * chunk);
+
+            group->head = (group->head + chunk) % group->capacity;
+            group->count -= chunk;
+            copied += chunk;
+        }
+    }
+
+    return num_samples;
+}
+
+
+
+double decode_value(int32_t tag_id, poll_type_t type)
+{
+    switch(type) {
+    case POLL_TYPE_BOOL:
+        return (plc_tag_get_bit(tag_id, 0) > 0 ? 1.0 : 0.0);
+    case POLL_TYPE_SINT:
+        return (double)plc_tag_get_int8(tag_id, 0);
+    case POLL_TYPE_USINT:
+        return (double)plc_tag_get_uint8(tag_id, 0);
+    case POLL_TYPE_INT:
+        return (double)plc_tag_get_int16(tag_id, 0);
+    case POLL_TYPE_UINT:
+        return (double)plc_tag_get_uint16(tag_id, 0);
+    case POLL_TYPE_DINT:
+        return (double)plc_tag_get_int32(tag_id, 0);
+    case POLL_TYPE_UDINT:
+        return (double)plc_tag_get_uint32(tag_id, 0);
+    case POLL_TYPE_LINT:
+        return (double)plc_tag_get_int64(tag_id, 0);
+    case POLL_TYPE_ULINT:
+        return (double)plc_tag_get_uint64(tag_id, 0);
+    case POLL_TYPE_REAL:
+        return (double)plc_tag_get_float32(tag_id, 0);
+    case POLL_TYPE_LREAL:
+        return plc_tag_get_float64(tag_id, 0);
+    default:
+        return 0.0;
+    }
+}
+
+
+
+/*
+ * Called by the library when an automatic read of a tag completes.  This
+ * runs in the tickler thread, so it only decodes the value and stores it.
+ */
+
+void poll_tag_callback(int32_t tag_id, int event, int status, void *userdata)
+{
+    poll_tag_p ptag = (poll_tag_p)userdata;
+    poll_group_p group = NULL;
+    int64_t timestamp = 0;
+    double value = 0.0;
+
+    if(event != PLCTAG_EVENT_READ_COMPLETED || !ptag) {
+        return;
+    }
+
+    group = ptag->group;
+
+    if(status != PLCTAG_STATUS_OK) {
+        critical_block(group->mutex) {
+            group->read_errors++;
+        }
+
+        return;
+    }
+
+    timestamp = time_monotonic_us();
+    value = decode_value(tag_id, ptag->type);
+
+    critical_block(group->mutex) {
+        int slot = 0;
+
+        /* full, drop the oldest sample. */
+        if(group->count == group->capacity) {
+            group->head = (group->head + 1) % group->capacity;
+            group->count--;
+            group->overruns++;
+        }
+
+        slot = (group->head + group->count) % group->capacity;
+
+        group->timestamps[slot] = timestamp;
+        group->tag_indexes[slot] = ptag->index;
+        group->values[slot] = value;
+        group->count++;
+    }
+}
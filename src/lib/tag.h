@@ -39,6 +39,7 @@
 #include <platform.h>
 #include <util/attr.h>
 #include <util/debug.h>
+#include <util/hashtable.h>
 
 // #define PLCTAG_CANARY (0xACA7CAFE)
 // #define PLCTAG_DATA_LITTLE_ENDIAN   (0)
@@ -65,6 +66,14 @@ struct tag_vtable_t {
     int (*set_int_attrib)(plc_tag_p tag, const char *attrib_name, int new_value);
 
     int (*get_byte_array_attrib)(plc_tag_p tag, const char *attrib_name, uint8_t *buffer, int buffer_length);
+
+    /*
+     * optional, used by transactions.  batch_hold stops the tag's connection from
+     * sending until batch_release is called.  batch_release groups the requests the
+     * tag queued in the meantime with the others of the same batch.
+     */
+    tag_vtable_func batch_hold;
+    int (*batch_release)(plc_tag_p tag, int32_t batch_id);
 };
 
 typedef struct tag_vtable_t *tag_vtable_p;
@@ -103,6 +112,7 @@ typedef struct tag_byte_order_s tag_byte_order_t;
 
 typedef void (*tag_callback_func)(int32_t tag_id, int event, int status);
 typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status, void *user_data);
+typedef void (*tag_listing_callback_func)(int32_t tag_id, const plc_tag_listing_entry_t *entries, int num_entries, void *user_data);
 
 /*
  * The base definition of the tag structure.  This is used
@@ -128,7 +138,11 @@ typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status
                         uint8_t event_write_started: 1; \
                         uint8_t event_write_complete_enable: 1; \
                         uint8_t event_write_complete: 1; \
+                        uint8_t event_value_changed: 1; \
+                        uint8_t on_change: 1; \
                         uint8_t allow_field_resize:1; \
+                        uint8_t auto_sync_held:1; \
+                        uint8_t history_read_pending:1; \
                         int8_t event_creation_complete_status; \
                         int8_t event_deletion_started_status; \
                         int8_t event_operation_aborted_status; \
@@ -143,7 +157,18 @@ typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status
                         int32_t tag_id; \
                         int32_t auto_sync_read_ms; \
                         int32_t auto_sync_write_ms; \
+                        int32_t auto_sync_read_group; \
+                        int32_t auto_sync_read_misses; \
+                        uint32_t auto_sync_conn_key; \
+                        int32_t change_shadow_size; \
+                        int32_t change_float_size; \
+                        int32_t data_views; \
+                        double change_deadband; \
+                        uint8_t *change_shadow; \
                         uint8_t *data; \
+                        struct tag_data_pub_t *data_pub; \
+                        struct tag_history_t *history; \
+                        char *attrib_str; \
                         tag_byte_order_t *byte_order; \
                         mutex_p ext_mutex; \
                         mutex_p api_mutex; \
@@ -151,10 +176,14 @@ typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status
                         tag_vtable_p vtable; \
                         tag_extended_callback_func callback; \
                         void *userdata; \
+                        tag_listing_callback_func listing_callback; \
+                        void *listing_userdata; \
                         int64_t read_cache_expire; \
                         int64_t read_cache_ms; \
                         int64_t auto_sync_next_read; \
-                        int64_t auto_sync_next_write
+                        int64_t auto_sync_next_write; \
+                        int64_t read_received_us; \
+                        volatile int64_t data_seq
 
 
 
@@ -176,10 +205,84 @@ extern void plc_tag_generic_handle_event_callbacks(plc_tag_p tag);
 extern int plc_tag_tickler_wake_impl(const char *func, int line_num);
 #define plc_tag_generic_wake_tag(tag) plc_tag_generic_wake_tag_impl(__func__, __LINE__, tag)
 extern int plc_tag_generic_wake_tag_impl(const char *func, int line_num, plc_tag_p tag);
+extern int plc_tag_generic_get_tag_count(void);
+extern int plc_tag_generic_make_auto_read_attribs(const char *attrib_str, int rpi_ms, char **tag_attribs);
+extern void plc_tag_generic_destroy_rc_table(hashtable_p table);
+extern int plc_tag_generic_check_value_change(plc_tag_p tag);
+extern void plc_tag_generic_mark_data_change(plc_tag_p tag, int offset, int length);
+extern void plc_tag_generic_publish_data(plc_tag_p tag);
+extern void plc_tag_generic_destroy_data_pub(plc_tag_p tag);
+extern void plc_tag_generic_push_history(plc_tag_p tag, int status);
 extern int plc_tag_generic_init_tag(plc_tag_p tag, attr attributes, void (*tag_callback_func)(int32_t tag_id, int event, int status, void *userdata), void *userdata);
 
+/*
+ * The data sequence number is odd while the library is changing the tag data
+ * and moves on to the next even value when the change is done.  These must be
+ * called with the tag API mutex held.  Protocol code only needs to call
+ * tag_data_change_begin() before it copies data into the tag as the next
+ * completed or aborted event ends the change.  Setters pass the bytes they
+ * change so that double-buffered tags only publish those.  A length of -1 is
+ * the rest of the buffer.
+ *
+ * tag_data_change_begin_at() returns the odd sequence number when it opened
+ * the change and zero when a change, such as a fragmented read, was already
+ * open.  tag_data_change_end() only ends the change it is given, so a setter
+ * called between the fragments of a read leaves the read's change open and
+ * its bytes are published when the read completes.
+ */
+static inline int64_t tag_data_change_begin_at(plc_tag_p tag, int offset, int length)
+{
+    if(tag->data_pub) {
+        plc_tag_generic_mark_data_change(tag, offset, length);
+    }
+
+    if(!(atomic_counter_get(&(tag->data_seq)) & 1)) {
+        return atomic_counter_add(&(tag->data_seq), 1);
+    }
+
+    return 0;
+}
+
+static inline int64_t tag_data_change_begin(plc_tag_p tag)
+{
+    return tag_data_change_begin_at(tag, 0, -1);
+}
+
+static inline void tag_data_change_finish(plc_tag_p tag, int publish)
+{
+    if(atomic_counter_get(&(tag->data_seq)) & 1) {
+        if(publish && tag->data_pub) {
+            plc_tag_generic_publish_data(tag);
+        }
+
+        atomic_counter_add(&(tag->data_seq), 1);
+    }
+}
+
+static inline void tag_data_change_end(plc_tag_p tag, int64_t change)
+{
+    if(change && atomic_counter_get(&(tag->data_seq)) == change) {
+        tag_data_change_finish(tag, 1);
+    }
+}
+
 static inline void tag_raise_event(plc_tag_p tag, int event, int8_t status)
 {
+    /* a finished or aborted operation ends any change to the data, callback or not.  Only good data is published. */
+    if(event == PLCTAG_EVENT_READ_COMPLETED || event == PLCTAG_EVENT_WRITE_COMPLETED || event == PLCTAG_EVENT_ABORTED) {
+        tag_data_change_finish(tag, (event != PLCTAG_EVENT_ABORTED && status == PLCTAG_STATUS_OK));
+    }
+
+    /* the history gets one entry per read, callback or not.  Synchronous reads raise completion twice. */
+    if(tag->history) {
+        if(event == PLCTAG_EVENT_READ_STARTED) {
+            tag->history_read_pending = 1;
+        } else if(event == PLCTAG_EVENT_READ_COMPLETED && tag->history_read_pending) {
+            tag->history_read_pending = 0;
+            plc_tag_generic_push_history(tag, status);
+        }
+    }
+
     /* do not stack up events if there is no callback. */
     if(!tag->callback) {
         return;
@@ -230,6 +333,11 @@ static inline void tag_raise_event(plc_tag_p tag, int event, int8_t status)
                 tag->event_read_complete_enable = 0;
                 pdebug(DEBUG_DETAIL, "Disabled PLCTAG_EVENT_READ_COMPLETE.");
             }
+
+            if(tag->on_change && status == PLCTAG_STATUS_OK && plc_tag_generic_check_value_change(tag)) {
+                pdebug(DEBUG_DETAIL, "PLCTAG_EVENT_VALUE_CHANGED raised.");
+                tag->event_value_changed = 1;
+            }
             break;
 
         case PLCTAG_EVENT_READ_STARTED:
@@ -49,11 +49,16 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <time.h>
 #include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
 
 #include <lib/libplctag.h>
 #include <util/debug.h>
@@ -947,6 +952,17 @@ extern int thread_destroy(thread_p *t)
 
 #define ATOMIC_LOCK_VAL (1)
 
+/* how many times to spin with a CPU pause before yielding the CPU. */
+#define LOCK_SPIN_LIMIT (100)
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CPU_PAUSE() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+    #define CPU_PAUSE() __asm__ __volatile__("yield")
+#else
+    #define CPU_PAUSE() do { } while(0)
+#endif
+
 extern int lock_acquire_try(lock_t *lock)
 {
     int rc = __sync_lock_test_and_set((int*)lock, ATOMIC_LOCK_VAL);
@@ -958,9 +974,29 @@ extern int lock_acquire_try(lock_t *lock)
     }
 }
 
+/*
+ * lock_acquire
+ *
+ * Spin until we get the lock.  While the lock is held, spin on a plain
+ * read with a CPU pause so that we do not hammer the cache line with
+ * atomic writes.  If the lock is held for a long time, the holder has
+ * probably been preempted, so give up the CPU between attempts.
+ */
+
 int lock_acquire(lock_t *lock)
 {
-    while(!lock_acquire_try(lock)) ;
+    int spins = 0;
+
+    while(!lock_acquire_try(lock)) {
+        while(*(volatile lock_t *)lock) {
+            if(spins < LOCK_SPIN_LIMIT) {
+                CPU_PAUSE();
+                spins++;
+            } else {
+                sched_yield();
+            }
+        }
+    }
 
     return 1;
 }
@@ -973,6 +1009,58 @@ extern void lock_release(lock_t *lock)
 }
 
 
+
+/*
+ * atomic_cas_int
+ *
+ * Atomically set the target to the new value if it is currently the
+ * old value.
+ *
+ * Returns the value of the target before the operation.  The swap
+ * happened if that is equal to the old value.
+ */
+
+int atomic_cas_int(volatile int *target, int old_val, int new_val)
+{
+    return __sync_val_compare_and_swap(target, old_val, new_val);
+}
+
+
+
+/*
+ * atomic_counter_add
+ *
+ * Atomically add to a 64-bit counter without taking a lock.  This
+ * is meant for statistics that are bumped on hot paths.
+ *
+ * Returns the new value of the counter.
+ */
+
+int64_t atomic_counter_add(volatile int64_t *counter, int64_t amount)
+{
+    return __sync_add_and_fetch(counter, amount);
+}
+
+
+int64_t atomic_counter_get(volatile int64_t *counter)
+{
+    return __sync_add_and_fetch(counter, 0);
+}
+
+
+/*
+ * mem_barrier
+ *
+ * Full memory fence.  Use this to order plain loads and stores where
+ * a locked operation is not possible, e.g. on a read-only mapping.
+ */
+
+void mem_barrier(void)
+{
+    __sync_synchronize();
+}
+
+
 /***************************************************************************
  ************************* Condition Variables *****************************
  ***************************************************************************/
@@ -1200,6 +1288,351 @@ int cond_destroy(cond_p *c)
 
 
 
+/***************************************************************************
+ **************************** Shared Memory ********************************
+ **************************************************************************/
+
+
+struct shared_mem_t {
+    char *name;
+    uint8_t *data;
+    int size;
+    int owner;
+    dev_t dev;
+    ino_t ino;
+};
+
+
+static int shared_mem_make_name(const char *name, char **shm_name);
+
+
+/*
+ * shared_mem_create
+ *
+ * Create a named shared memory segment of the given size and map it
+ * read/write.  A leading '/' is added to the name if it is missing.
+ * If a segment with the name already exists, PLCTAG_ERR_DUPLICATE is
+ * returned.  Use shared_mem_remove() first if it is known to be stale.
+ * The name is removed when the segment is destroyed.
+ */
+
+int shared_mem_create(const char *name, int size, shared_mem_p *shm)
+{
+#ifdef __ANDROID__
+    (void)name;
+    (void)size;
+    (void)shm;
+
+    pdebug(DEBUG_WARN, "Shared memory is not supported on Android.");
+
+    return PLCTAG_ERR_UNSUPPORTED;
+#else
+    int rc = PLCTAG_STATUS_OK;
+    shared_mem_p result = NULL;
+    struct stat info;
+    int fd = -1;
+    void *data = NULL;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!name || !shm || size <= 0) {
+        pdebug(DEBUG_WARN, "Called with bad arguments!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    *shm = NULL;
+
+    result = (shared_mem_p)mem_alloc((int)sizeof(*result));
+    if(!result) {
+        pdebug(DEBUG_ERROR, "Unable to allocate shared memory struct!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = shared_mem_make_name(name, &result->name);
+    if(rc != PLCTAG_STATUS_OK) {
+        mem_free(result);
+        return rc;
+    }
+
+    fd = shm_open(result->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0) {
+        rc = (errno == EEXIST ? PLCTAG_ERR_DUPLICATE : PLCTAG_ERR_CREATE);
+        pdebug(DEBUG_WARN, "Unable to create shared memory segment %s, errno %d!", result->name, errno);
+        mem_free(result->name);
+        mem_free(result);
+        return rc;
+    }
+
+    /* remember which segment is ours, the name may point to another one by the time it is destroyed. */
+    if(fstat(fd, &info) != 0 || ftruncate(fd, (off_t)size) != 0) {
+        pdebug(DEBUG_WARN, "Unable to size shared memory segment %s to %d bytes, errno %d!", result->name, size, errno);
+        close(fd);
+        shm_unlink(result->name);
+        mem_free(result->name);
+        mem_free(result);
+        return PLCTAG_ERR_CREATE;
+    }
+
+    data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    /* the mapping keeps the segment open. */
+    close(fd);
+
+    if(data == MAP_FAILED) {
+        pdebug(DEBUG_WARN, "Unable to map shared memory segment %s, errno %d!", result->name, errno);
+        shm_unlink(result->name);
+        mem_free(result->name);
+        mem_free(result);
+        return PLCTAG_ERR_CREATE;
+    }
+
+    /* a new segment is zero filled. */
+    result->data = (uint8_t *)data;
+    result->size = size;
+    result->owner = 1;
+    result->dev = info.st_dev;
+    result->ino = info.st_ino;
+
+    *shm = result;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return rc;
+#endif
+}
+
+
+/*
+ * shared_mem_open
+ *
+ * Map an existing named shared memory segment read-only.  The size
+ * is that of the segment, which may be rounded up to a whole page.
+ */
+
+int shared_mem_open(const char *name, shared_mem_p *shm)
+{
+#ifdef __ANDROID__
+    (void)name;
+    (void)shm;
+
+    pdebug(DEBUG_WARN, "Shared memory is not supported on Android.");
+
+    return PLCTAG_ERR_UNSUPPORTED;
+#else
+    int rc = PLCTAG_STATUS_OK;
+    shared_mem_p result = NULL;
+    struct stat info;
+    int fd = -1;
+    void *data = NULL;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!name || !shm) {
+        pdebug(DEBUG_WARN, "Called with bad arguments!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    *shm = NULL;
+
+    result = (shared_mem_p)mem_alloc((int)sizeof(*result));
+    if(!result) {
+        pdebug(DEBUG_ERROR, "Unable to allocate shared memory struct!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    rc = shared_mem_make_name(name, &result->name);
+    if(rc != PLCTAG_STATUS_OK) {
+        mem_free(result);
+        return rc;
+    }
+
+    fd = shm_open(result->name, O_RDONLY, 0);
+    if(fd < 0) {
+        rc = (errno == ENOENT ? PLCTAG_ERR_NOT_FOUND : PLCTAG_ERR_OPEN);
+        pdebug(DEBUG_WARN, "Unable to open shared memory segment %s, errno %d!", result->name, errno);
+        mem_free(result->name);
+        mem_free(result);
+        return rc;
+    }
+
+    if(fstat(fd, &info) != 0 || info.st_size <= 0 || info.st_size > INT_MAX) {
+        pdebug(DEBUG_WARN, "Unable to get a usable size for shared memory segment %s!", result->name);
+        close(fd);
+        mem_free(result->name);
+        mem_free(result);
+        return PLCTAG_ERR_OPEN;
+    }
+
+    data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if(data == MAP_FAILED) {
+        pdebug(DEBUG_WARN, "Unable to map shared memory segment %s, errno %d!", result->name, errno);
+        mem_free(result->name);
+        mem_free(result);
+        return PLCTAG_ERR_OPEN;
+    }
+
+    result->data = (uint8_t *)data;
+    result->size = (int)info.st_size;
+    result->owner = 0;
+
+    *shm = result;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return rc;
+#endif
+}
+
+
+uint8_t *shared_mem_data(shared_mem_p shm)
+{
+    return (shm ? shm->data : NULL);
+}
+
+
+int shared_mem_size(shared_mem_p shm)
+{
+    return (shm ? shm->size : 0);
+}
+
+
+/*
+ * shared_mem_destroy
+ *
+ * Unmap the segment.  If this process created it, the name is removed
+ * too.  Processes that still have it mapped keep their mapping.
+ */
+
+int shared_mem_destroy(shared_mem_p *shm)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!shm || !*shm) {
+        pdebug(DEBUG_WARN, "Null shared memory pointer!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+#ifndef __ANDROID__
+    munmap((*shm)->data, (size_t)(*shm)->size);
+
+    /* only remove the name if it still points to our segment. */
+    if((*shm)->owner) {
+        struct stat info;
+        int fd = shm_open((*shm)->name, O_RDONLY, 0);
+
+        if(fd >= 0) {
+            if(fstat(fd, &info) == 0 && info.st_dev == (*shm)->dev && info.st_ino == (*shm)->ino) {
+                shm_unlink((*shm)->name);
+            } else {
+                pdebug(DEBUG_WARN, "Shared memory segment %s was replaced, not removing it.", (*shm)->name);
+            }
+
+            close(fd);
+        }
+    }
+#endif
+
+    mem_free((*shm)->name);
+    mem_free(*shm);
+
+    *shm = NULL;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*
+ * shared_mem_remove
+ *
+ * Remove the name of a segment without mapping it, e.g. one left behind
+ * by a process that crashed.  Processes that have it mapped keep their
+ * mapping.
+ */
+
+int shared_mem_remove(const char *name)
+{
+#ifdef __ANDROID__
+    (void)name;
+
+    return PLCTAG_ERR_UNSUPPORTED;
+#else
+    char *shm_name = NULL;
+    int rc = PLCTAG_STATUS_OK;
+
+    rc = shared_mem_make_name(name, &shm_name);
+    if(rc != PLCTAG_STATUS_OK) {
+        return rc;
+    }
+
+    if(shm_unlink(shm_name) != 0 && errno != ENOENT) {
+        pdebug(DEBUG_WARN, "Unable to remove shared memory segment %s, errno %d!", shm_name, errno);
+        rc = PLCTAG_ERR_NOT_ALLOWED;
+    }
+
+    mem_free(shm_name);
+
+    return rc;
+#endif
+}
+
+
+/*
+ * process_id
+ *
+ * Return the ID of this process.
+ */
+
+int64_t process_id(void)
+{
+    return (int64_t)getpid();
+}
+
+
+/*
+ * process_is_running
+ *
+ * Check whether a process with the given ID exists.  A process that
+ * we may not signal still exists.
+ */
+
+int process_is_running(int64_t pid)
+{
+    if(pid <= 0 || pid > INT_MAX) {
+        return 0;
+    }
+
+    return (kill((pid_t)pid, 0) == 0 || errno == EPERM);
+}
+
+
+int shared_mem_make_name(const char *name, char **shm_name)
+{
+    if(!name || !*name || str_length(name) > NAME_MAX) {
+        pdebug(DEBUG_WARN, "Shared memory name is missing or too long!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    if(name[0] == '/') {
+        *shm_name = str_dup(name);
+    } else {
+        *shm_name = str_concat("/", name);
+    }
+
+    if(!*shm_name) {
+        pdebug(DEBUG_ERROR, "Unable to allocate shared memory name!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
 /***************************************************************************
  ******************************* Sockets ***********************************
  **************************************************************************/
@@ -1315,6 +1748,13 @@ int socket_connect_tcp_start(sock_p s, const char *host, int port)
         return PLCTAG_ERR_OPEN;
     }
 
+    /* send small requests at once, pipelined requests must not wait on the ACK of the one before. */
+    if(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char*)&sock_opt, sizeof(sock_opt))) {
+        close(fd);
+        pdebug(DEBUG_ERROR, "Error setting socket no delay option, errno: %d", errno);
+        return PLCTAG_ERR_OPEN;
+    }
+
     /* abort the connection immediately upon close. */
     so_linger.l_onoff = 1;
     so_linger.l_linger = 0;
@@ -2301,3 +2741,34 @@ int64_t time_ms(void)
 
     return  ((int64_t)tv.tv_sec*1000)+ ((int64_t)tv.tv_usec/1000);
 }
+
+
+/*
+ * time_us
+ *
+ * Return the current epoch time in microseconds.
+ */
+int64_t time_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+
+    return  ((int64_t)tv.tv_sec*1000000)+ (int64_t)tv.tv_usec;
+}
+
+
+/*
+ * time_monotonic_us
+ *
+ * Return a time in microseconds that does not jump when the system
+ * clock is set.  Only differences between two of these are meaningful.
+ */
+int64_t time_monotonic_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((int64_t)ts.tv_sec*1000000) + ((int64_t)ts.tv_nsec/1000);
+}
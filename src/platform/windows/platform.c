@@ -47,6 +47,7 @@
 #include <timeapi.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <winnt.h>
 #include <errno.h>
 #include <math.h>
@@ -1040,6 +1041,9 @@ extern int thread_destroy(thread_p *t)
 #define ATOMIC_UNLOCK_VAL ((LONG)(0))
 #define ATOMIC_LOCK_VAL ((LONG)(1))
 
+/* how many times to spin with a CPU pause before yielding the CPU. */
+#define LOCK_SPIN_LIMIT (100)
+
 extern int lock_acquire_try(lock_t *lock)
 {
     LONG rc = InterlockedExchange(lock, ATOMIC_LOCK_VAL);
@@ -1052,9 +1056,29 @@ extern int lock_acquire_try(lock_t *lock)
 }
 
 
+/*
+ * lock_acquire
+ *
+ * Spin until we get the lock.  While the lock is held, spin on a plain
+ * read with a CPU pause so that we do not hammer the cache line with
+ * atomic writes.  If the lock is held for a long time, the holder has
+ * probably been preempted, so give up the CPU between attempts.
+ */
+
 extern int lock_acquire(lock_t *lock)
 {
-    while(!lock_acquire_try(lock)) ;
+    int spins = 0;
+
+    while(!lock_acquire_try(lock)) {
+        while(*lock != ATOMIC_UNLOCK_VAL) {
+            if(spins < LOCK_SPIN_LIMIT) {
+                YieldProcessor();
+                spins++;
+            } else {
+                SwitchToThread();
+            }
+        }
+    }
 
     return 1;
 }
@@ -1067,6 +1091,58 @@ extern void lock_release(lock_t *lock)
 
 
 
+/*
+ * atomic_cas_int
+ *
+ * Atomically set the target to the new value if it is currently the
+ * old value.
+ *
+ * Returns the value of the target before the operation.  The swap
+ * happened if that is equal to the old value.
+ */
+
+int atomic_cas_int(volatile int *target, int old_val, int new_val)
+{
+    return (int)InterlockedCompareExchange((LONG volatile *)target, (LONG)new_val, (LONG)old_val);
+}
+
+
+
+/*
+ * atomic_counter_add
+ *
+ * Atomically add to a 64-bit counter without taking a lock.  This
+ * is meant for statistics that are bumped on hot paths.
+ *
+ * Returns the new value of the counter.
+ */
+
+int64_t atomic_counter_add(volatile int64_t *counter, int64_t amount)
+{
+    return (int64_t)InterlockedExchangeAdd64((LONG64 volatile *)counter, (LONG64)amount) + amount;
+}
+
+
+int64_t atomic_counter_get(volatile int64_t *counter)
+{
+    return (int64_t)InterlockedCompareExchange64((LONG64 volatile *)counter, 0, 0);
+}
+
+
+/*
+ * mem_barrier
+ *
+ * Full memory fence.  Use this to order plain loads and stores where
+ * a locked operation is not possible, e.g. on a read-only mapping.
+ */
+
+void mem_barrier(void)
+{
+    MemoryBarrier();
+}
+
+
+
 
 
 /***************************************************************************
@@ -1261,6 +1337,244 @@ int cond_destroy(cond_p *c)
 
 
 
+/***************************************************************************
+ **************************** Shared Memory ********************************
+ **************************************************************************/
+
+
+struct shared_mem_t {
+    HANDLE mapping;
+    uint8_t *data;
+    int size;
+};
+
+
+/*
+ * shared_mem_create
+ *
+ * Create a named, pagefile backed, file mapping of the given size and
+ * map it read/write.  A leading '/' on the name is dropped so that the
+ * same names work as on POSIX systems.  The mapping goes away when the
+ * last process using it closes it.
+ */
+
+int shared_mem_create(const char *name, int size, shared_mem_p *shm)
+{
+    shared_mem_p result = NULL;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!name || !shm || size <= 0) {
+        pdebug(DEBUG_WARN, "Called with bad arguments!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    *shm = NULL;
+
+    if(name[0] == '/') {
+        name++;
+    }
+
+    if(!*name) {
+        pdebug(DEBUG_WARN, "Shared memory name is empty!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    result = (shared_mem_p)mem_alloc((int)sizeof(*result));
+    if(!result) {
+        pdebug(DEBUG_ERROR, "Unable to allocate shared memory struct!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    result->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, name);
+    if(!result->mapping) {
+        pdebug(DEBUG_WARN, "Unable to create file mapping %s, error %d!", name, (int)GetLastError());
+        mem_free(result);
+        return PLCTAG_ERR_CREATE;
+    }
+
+    /* unlike POSIX, the old mapping cannot be stale, someone is still using it. */
+    if(GetLastError() == ERROR_ALREADY_EXISTS) {
+        pdebug(DEBUG_WARN, "File mapping %s is already in use!", name);
+        CloseHandle(result->mapping);
+        mem_free(result);
+        return PLCTAG_ERR_DUPLICATE;
+    }
+
+    result->data = (uint8_t *)MapViewOfFile(result->mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+    if(!result->data) {
+        pdebug(DEBUG_WARN, "Unable to map view of %s, error %d!", name, (int)GetLastError());
+        CloseHandle(result->mapping);
+        mem_free(result);
+        return PLCTAG_ERR_CREATE;
+    }
+
+    result->size = size;
+
+    *shm = result;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*
+ * shared_mem_open
+ *
+ * Map an existing named file mapping read-only.  The size is that of
+ * the mapped region, which may be rounded up to a whole page.
+ */
+
+int shared_mem_open(const char *name, shared_mem_p *shm)
+{
+    shared_mem_p result = NULL;
+    MEMORY_BASIC_INFORMATION info;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!name || !shm) {
+        pdebug(DEBUG_WARN, "Called with bad arguments!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    *shm = NULL;
+
+    if(name[0] == '/') {
+        name++;
+    }
+
+    result = (shared_mem_p)mem_alloc((int)sizeof(*result));
+    if(!result) {
+        pdebug(DEBUG_ERROR, "Unable to allocate shared memory struct!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    result->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if(!result->mapping) {
+        int rc = (GetLastError() == ERROR_FILE_NOT_FOUND ? PLCTAG_ERR_NOT_FOUND : PLCTAG_ERR_OPEN);
+
+        pdebug(DEBUG_WARN, "Unable to open file mapping %s, error %d!", name, (int)GetLastError());
+        mem_free(result);
+        return rc;
+    }
+
+    result->data = (uint8_t *)MapViewOfFile(result->mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!result->data || VirtualQuery(result->data, &info, sizeof(info)) == 0 || info.RegionSize > INT_MAX) {
+        pdebug(DEBUG_WARN, "Unable to map view of %s, error %d!", name, (int)GetLastError());
+        if(result->data) {
+            UnmapViewOfFile(result->data);
+        }
+        CloseHandle(result->mapping);
+        mem_free(result);
+        return PLCTAG_ERR_OPEN;
+    }
+
+    result->size = (int)info.RegionSize;
+
+    *shm = result;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+uint8_t *shared_mem_data(shared_mem_p shm)
+{
+    return (shm ? shm->data : NULL);
+}
+
+
+int shared_mem_size(shared_mem_p shm)
+{
+    return (shm ? shm->size : 0);
+}
+
+
+int shared_mem_destroy(shared_mem_p *shm)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!shm || !*shm) {
+        pdebug(DEBUG_WARN, "Null shared memory pointer!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    UnmapViewOfFile((*shm)->data);
+    CloseHandle((*shm)->mapping);
+
+    mem_free(*shm);
+
+    *shm = NULL;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*
+ * shared_mem_remove
+ *
+ * A file mapping goes away when the last handle to it is closed, there
+ * is no name to remove.
+ */
+
+int shared_mem_remove(const char *name)
+{
+    (void)name;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*
+ * process_id
+ *
+ * Return the ID of this process.
+ */
+
+int64_t process_id(void)
+{
+    return (int64_t)GetCurrentProcessId();
+}
+
+
+/*
+ * process_is_running
+ *
+ * Check whether a process with the given ID is still running.  A process
+ * that we may not open still exists.
+ */
+
+int process_is_running(int64_t pid)
+{
+    HANDLE process = NULL;
+    int running = 0;
+
+    if(pid <= 0 || pid > (int64_t)UINT32_MAX) {
+        return 0;
+    }
+
+    process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if(!process) {
+        return (GetLastError() == ERROR_ACCESS_DENIED);
+    }
+
+    running = (WaitForSingleObject(process, 0) == WAIT_TIMEOUT);
+
+    CloseHandle(process);
+
+    return running;
+}
+
+
+
+
+
+
+
 /***************************************************************************
  ******************************** Sockets **********************************
  **************************************************************************/
@@ -1396,6 +1710,13 @@ int socket_connect_tcp_start(sock_p s, const char *host, int port)
         return PLCTAG_ERR_OPEN;
     }
 
+    /* send small requests at once, pipelined requests must not wait on the ACK of the one before. */
+    if(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char*)&sock_opt, (int)sizeof(sock_opt))) {
+        closesocket(fd);
+        pdebug(DEBUG_WARN,"Error setting socket no delay option, errno: %d",errno);
+        return PLCTAG_ERR_OPEN;
+    }
+
     /* abort the connection on close. */
     so_linger.l_onoff = 1;
     so_linger.l_linger = 0;
@@ -2626,6 +2947,50 @@ int64_t time_ms(void)
 }
 
 
+
+/*
+ * time_us
+ *
+ * Return current system time in microsecond units.  See time_ms()
+ * for the epoch handling.
+ */
+
+int64_t time_us(void)
+{
+    FILETIME ft;
+    int64_t res;
+
+    GetSystemTimeAsFileTime(&ft);
+
+    /* calculate time as 100ns increments since Jan 1, 1601. */
+    res = (int64_t)(ft.dwLowDateTime) + ((int64_t)(ft.dwHighDateTime) << 32);
+
+    /* get time in us.   Magic offset is for Jan 1, 1970 Unix epoch baseline. */
+    res = (res - 116444736000000000) / 10;
+
+    return  res;
+}
+
+
+/*
+ * time_monotonic_us
+ *
+ * Return a time in microseconds that does not jump when the system
+ * clock is set.  Only differences between two of these are meaningful.
+ */
+int64_t time_monotonic_us(void)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    /* split to avoid overflowing with high counter frequencies. */
+    return ((count.QuadPart / freq.QuadPart) * 1000000) + (((count.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+}
+
+
 struct tm *localtime_r(const time_t *timep, struct tm *result)
 {
     time_t t = *timep;
@@ -237,6 +237,16 @@ extern int lock_acquire_try(lock_t *lock);
 extern int lock_acquire(lock_t *lock);
 extern void lock_release(lock_t *lock);
 
+/* lock-free compare and swap, returns the value before the operation. */
+extern int atomic_cas_int(volatile int *target, int old_val, int new_val);
+
+/* lock-free 64-bit counters, return the new value. */
+extern int64_t atomic_counter_add(volatile int64_t *counter, int64_t amount);
+extern int64_t atomic_counter_get(volatile int64_t *counter);
+
+/* full memory fence, for plain loads and stores that must stay ordered. */
+extern void mem_barrier(void);
+
 
 /* condition variables */
 typedef struct cond_t* cond_p;
@@ -250,6 +260,21 @@ extern int cond_destroy(cond_p *c);
 #define cond_signal(c) cond_signal_impl(__func__, __LINE__, c)
 #define cond_clear(c) cond_clear_impl(__func__, __LINE__, c)
 
+
+/* named shared memory segments */
+typedef struct shared_mem_t *shared_mem_p;
+extern int shared_mem_create(const char *name, int size, shared_mem_p *shm);
+extern int shared_mem_open(const char *name, shared_mem_p *shm);
+extern uint8_t *shared_mem_data(shared_mem_p shm);
+extern int shared_mem_size(shared_mem_p shm);
+extern int shared_mem_destroy(shared_mem_p *shm);
+extern int shared_mem_remove(const char *name);
+
+/* processes */
+extern int64_t process_id(void);
+extern int process_is_running(int64_t pid);
+
+
 /* socket functions */
 typedef struct sock_t *sock_p;
 typedef enum {
@@ -287,6 +312,8 @@ extern int plc_lib_serial_port_write(serial_port_p serial_port, uint8_t *data, i
 /* time functions */
 extern int sleep_ms(int ms);
 extern int64_t time_ms(void);
+extern int64_t time_us(void);
+extern int64_t time_monotonic_us(void);
 extern struct tm *localtime_r(const time_t *timep, struct tm *result);
 
 /* some functions can be simply replaced */
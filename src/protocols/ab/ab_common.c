@@ -51,9 +51,11 @@
 #include <ab/eip_slc_dhp.h>
 #include <ab/session.h>
 #include <ab/tag.h>
+#include <ab/udt_cache.h>
 #include <omron/omron.h>
 #include <util/attr.h>
 #include <util/debug.h>
+#include <util/metrics.h>
 #include <util/vector.h>
 
 
@@ -110,7 +112,11 @@ struct tag_vtable_t default_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
 
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* no transaction batching */
+    (tag_vtable_func)NULL,
+    NULL
 };
 
 
@@ -132,6 +138,11 @@ int ab_init(void)
         return rc;
     }
 
+    if((rc = udt_cache_startup()) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to initialize UDT template cache!");
+        return rc;
+    }
+
     pdebug(DEBUG_INFO,"Finished initializing AB protocol library.");
 
     return rc;
@@ -160,6 +171,8 @@ void ab_teardown(void)
 
     session_teardown();
 
+    udt_cache_teardown();
+
     ab_protocol_terminating = 0;
 
     pdebug(DEBUG_INFO,"Done.");
@@ -247,6 +260,21 @@ plc_tag_p ab_tag_create(attr attribs, void (*tag_callback_func)(int32_t tag_id,
         /* default to requiring a connection and allowing packing. */
         tag->use_connected_msg = attr_get_int(attribs,"use_connected_msg", 1);
         tag->allow_packing = attr_get_int(attribs, "allow_packing", 1);
+
+        /* large reads can keep several fragment requests in flight. */
+        tag->read_frag_window = attr_get_int(attribs, "read_frag_window", AB_MAX_READ_FRAGS);
+        if(tag->read_frag_window < 1 || tag->read_frag_window > AB_MAX_READ_FRAGS) {
+            pdebug(DEBUG_WARN, "Read fragment window must be between 1 and %d!", AB_MAX_READ_FRAGS);
+            tag->status = PLCTAG_ERR_BAD_PARAM;
+            return (plc_tag_p)tag;
+        }
+
+        /* opt in to addressing reads by symbol instance, this needs listing which needs a connection. */
+        tag->use_symbol_instance = attr_get_int(attribs, "use_symbol_instance", 0);
+        if(tag->use_symbol_instance && !tag->use_connected_msg) {
+            pdebug(DEBUG_WARN, "Symbol instance addressing needs connected messaging, using symbolic names.");
+            tag->use_symbol_instance = 0;
+        }
         break;
 
     case AB_PLC_MICRO800:
@@ -617,10 +645,42 @@ int get_tag_data_type(ab_tag_p tag, attr attribs)
                 /* check for special tags. */
                 if(str_cmp_i(tmp_tag_name, "@raw") == 0) {
                     special_tag_rc = setup_raw_tag(tag);
+                } else if(str_cmp_i(tmp_tag_name, "@changes") == 0) {
+                    if(tag->plc_type == AB_PLC_LGX && tag->use_connected_msg) {
+                        special_tag_rc = setup_changes_tag(tag);
+                    } else {
+                        pdebug(DEBUG_WARN, "Controller change counters are only supported on connected Logix PLCs!");
+                        special_tag_rc = PLCTAG_ERR_UNSUPPORTED;
+                    }
                 } else if(str_str_cmp_i(tmp_tag_name, "@tags")) {
+                        const char *listing_prefix = attr_get_str(attribs, "listing_prefix", NULL);
+
                         special_tag_rc = setup_tag_listing_tag(tag, tmp_tag_name);
+
+                        /* optional filters for the listing entries. */
+                        tag->listing_type = attr_get_int(attribs, "listing_type", -1);
+
+                        if(special_tag_rc == PLCTAG_STATUS_OK && listing_prefix && str_length(listing_prefix) > 0) {
+                            tag->listing_prefix = str_dup(listing_prefix);
+                            if(!tag->listing_prefix) {
+                                special_tag_rc = PLCTAG_ERR_NO_MEM;
+                            }
+                        }
                 } else if(str_str_cmp_i(tmp_tag_name, "@udt/")) {
+                        const char *udt_cache_file = attr_get_str(attribs, "udt_cache_file", NULL);
+
                         special_tag_rc = setup_udt_tag(tag, tmp_tag_name);
+
+                        if(special_tag_rc == PLCTAG_STATUS_OK && udt_cache_file) {
+                            special_tag_rc = udt_cache_open_file(udt_cache_file);
+                        }
+
+                        if(special_tag_rc == PLCTAG_STATUS_OK && udt_cache_file) {
+                            tag->udt_cache_file = str_dup(udt_cache_file);
+                            if(!tag->udt_cache_file) {
+                                special_tag_rc = PLCTAG_ERR_NO_MEM;
+                            }
+                        }
                 } /* else not a special tag. */
 
                 if(special_tag_rc != PLCTAG_STATUS_OK) {
@@ -731,6 +791,19 @@ int ab_tag_abort(ab_tag_p tag)
         pdebug(DEBUG_DETAIL, "Called without a request in flight.");
     }
 
+    /* abort any fragment requests of a parallel read. */
+    for(int i=0; i < AB_MAX_READ_FRAGS; i++) {
+        if(tag->read_frags[i].req) {
+            spin_block(&tag->read_frags[i].req->lock) {
+                tag->read_frags[i].req->abort_request = 1;
+            }
+
+            tag->read_frags[i].req = rc_dec(tag->read_frags[i].req);
+        }
+    }
+
+    tag->read_frags_active = 0;
+
     tag->read_in_progress = 0;
     tag->write_in_progress = 0;
     tag->offset = 0;
@@ -774,6 +847,55 @@ int ab_tag_status(ab_tag_p tag)
 
 
 
+/*
+ * ab_tag_batch_hold
+ *
+ * Hold the tag's session while a transaction queues its requests.
+ */
+int ab_tag_batch_hold(ab_tag_p tag)
+{
+    if(!tag->session) {
+        pdebug(DEBUG_WARN, "Tag has no session!");
+        return PLCTAG_ERR_CREATE;
+    }
+
+    return session_batch_hold(tag->session);
+}
+
+
+/*
+ * ab_tag_batch_release
+ *
+ * Put the requests the tag queued since ab_tag_batch_hold() into the
+ * batch and release the session.
+ */
+int ab_tag_batch_release(plc_tag_p raw_tag, int32_t batch_id)
+{
+    ab_tag_p tag = (ab_tag_p)raw_tag;
+
+    if(!tag->session) {
+        pdebug(DEBUG_WARN, "Tag has no session!");
+        return PLCTAG_ERR_CREATE;
+    }
+
+    if(tag->req) {
+        session_batch_add_request(tag->session, tag->req, batch_id);
+    }
+
+    if(tag->symbol_req) {
+        session_batch_add_request(tag->session, tag->symbol_req, batch_id);
+    }
+
+    for(int i=0; i < AB_MAX_READ_FRAGS; i++) {
+        if(tag->read_frags[i].req) {
+            session_batch_add_request(tag->session, tag->read_frags[i].req, batch_id);
+        }
+    }
+
+    return session_batch_release(tag->session);
+}
+
+
 
 /*
  * ab_tag_destroy
@@ -801,6 +923,42 @@ void ab_tag_destroy(ab_tag_p tag)
 
     session = tag->session;
 
+    /* stop loading the session symbol table so another tag can take over. */
+    if(tag->symbol_req) {
+        spin_block(&tag->symbol_req->lock) {
+            tag->symbol_req->abort_request = 1;
+        }
+
+        tag->symbol_req = rc_dec(tag->symbol_req);
+    }
+
+    if(session && tag->symbol_state == AB_SYMBOL_LOADING) {
+        session_symbols_load_done(session, tag->tag_id, PLCTAG_ERR_ABORT);
+    } else if(session && tag->symbol_checking) {
+        session_symbols_check_done(session, tag->tag_id, PLCTAG_ERR_ABORT, NULL, 0);
+    }
+
+    if(tag->instance_name) {
+        mem_free(tag->instance_name);
+        tag->instance_name = NULL;
+    }
+
+    if(tag->listing_prefix) {
+        mem_free(tag->listing_prefix);
+        tag->listing_prefix = NULL;
+    }
+
+    if(tag->udt_cache_file) {
+        udt_cache_flush(tag->udt_cache_file);
+        mem_free(tag->udt_cache_file);
+        tag->udt_cache_file = NULL;
+    }
+
+    if(tag->udt_changes) {
+        mem_free(tag->udt_changes);
+        tag->udt_changes = NULL;
+    }
+
     /* tags should always have a session.  Release it. */
     pdebug(DEBUG_DETAIL,"Getting ready to release tag session %p",tag->session);
     if(session) {
@@ -836,6 +994,8 @@ void ab_tag_destroy(ab_tag_p tag)
         tag->data = NULL;
     }
 
+    plc_tag_generic_destroy_data_pub((plc_tag_p)tag);
+
     pdebug(DEBUG_INFO,"Finished releasing all tag resources.");
 
     pdebug(DEBUG_INFO, "done");
@@ -885,6 +1045,8 @@ int ab_get_int_attrib(plc_tag_p raw_tag, const char *attrib_name, int default_va
                 pdebug(DEBUG_WARN, "Unsupported PLC type %d!", tag->plc_type);
                 break;
         }
+    } else if(tag->session && metrics_get_session_attrib(&(tag->session->metrics), attrib_name, &res) == PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_DETAIL, "Got session metric \"%s\".", attrib_name);
     } else {
         pdebug(DEBUG_WARN, "Unsupported attribute name \"%s\"!", attrib_name);
         tag->status = PLCTAG_ERR_UNSUPPORTED;
@@ -1053,6 +1215,9 @@ int check_tag_name(ab_tag_p tag, const char* name)
             return rc;
         }
 
+        /* keep the parsed address so that the session can merge reads of the same data file. */
+        tag->pccc_addr = pccc_address;
+
         break;
 
     case AB_PLC_MICRO800:
@@ -1135,6 +1300,9 @@ int check_read_request_status(ab_tag_p tag, ab_request_p request)
 
             break;
         }
+
+        /* fragmented reads end up with the time of the last fragment. */
+        tag->read_received_us = request->time_received_us;
     }
 
     if(rc != PLCTAG_STATUS_OK) {
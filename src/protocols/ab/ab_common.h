@@ -50,6 +50,8 @@ typedef struct ab_request_t *ab_request_p;
 
 extern int ab_tag_abort(ab_tag_p tag);
 extern int ab_tag_status(ab_tag_p tag);
+extern int ab_tag_batch_hold(ab_tag_p tag);
+extern int ab_tag_batch_release(plc_tag_p tag, int32_t batch_id);
 
 
 extern int ab_get_int_attrib(plc_tag_p tag, const char *attrib_name, int default_value);
@@ -41,6 +41,7 @@
 #include <ab/tag.h>
 #include <ab/session.h>
 #include <ab/eip_cip.h>
+#include <ab/eip_cip_special.h>
 #include <ab/error_codes.h>
 #include <util/attr.h>
 #include <util/debug.h>
@@ -128,18 +129,35 @@ START_PACK typedef struct {
 
 
 
-static int build_read_request_connected(ab_tag_p tag, int byte_offset);
+static int build_read_request_connected(ab_tag_p tag, int byte_offset, ab_request_p *req_out);
 //static int build_tag_list_request_connected(ab_tag_p tag);
-static int build_read_request_unconnected(ab_tag_p tag, int byte_offset);
+static int build_read_request_unconnected(ab_tag_p tag, int byte_offset, ab_request_p *req_out);
 static int build_write_request_connected(ab_tag_p tag, int byte_offset);
 static int build_write_request_unconnected(ab_tag_p tag, int byte_offset);
 static int build_write_bit_request_connected(ab_tag_p tag);
 static int build_write_bit_request_unconnected(ab_tag_p tag);
+static int find_array_index_segment(ab_tag_p tag, int *seg_offset, uint32_t *index);
 static int check_read_status_connected(ab_tag_p tag);
 static int check_read_status_unconnected(ab_tag_p tag);
 static int check_write_status_connected(ab_tag_p tag);
 static int check_write_status_unconnected(ab_tag_p tag);
 static int calculate_write_data_per_packet(ab_tag_p tag);
+static int read_reply_fills_packet(ab_tag_p tag);
+static int read_frags_can_start(ab_tag_p tag, int frag_size);
+static int read_frags_start(ab_tag_p tag, int frag_size);
+static int read_frags_fill(ab_tag_p tag);
+static int read_frag_issue(ab_tag_p tag, ab_read_frag_t *frag);
+static int decode_read_frag_response(ab_tag_p tag, ab_request_p request, uint8_t **payload, int *payload_size, int *partial_data);
+static int check_read_frags_status(ab_tag_p tag);
+static int symbol_instance_tickler(ab_tag_p tag);
+static int symbol_instance_base_name(ab_tag_p tag, char *name, int name_capacity);
+static int symbol_instance_encode(ab_tag_p tag, uint32_t instance);
+static int symbol_instance_type_ok(ab_tag_p tag, uint8_t *type_info, int available);
+static int symbol_instance_fallback(ab_tag_p tag, int rc);
+static int symbol_instance_usable(ab_tag_p tag);
+static int symbol_changes_check_response(ab_tag_p tag);
+static int symbol_list_build_request(ab_tag_p tag);
+static int symbol_list_check_response(ab_tag_p tag);
 
 static int tag_read_start(ab_tag_p tag);
 static int tag_tickler(ab_tag_p tag);
@@ -158,7 +176,11 @@ struct tag_vtable_t eip_cip_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
 
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 /* default string types used for ControlLogix-class PLCs. */
@@ -221,13 +243,25 @@ int tag_tickler(ab_tag_p tag)
 
     pdebug(DEBUG_SPEW,"Starting.");
 
+    /* resolve the symbol instance in the background. */
+    if(tag->use_symbol_instance && (tag->symbol_state == AB_SYMBOL_UNRESOLVED || tag->symbol_state == AB_SYMBOL_LOADING || tag->symbol_checking)) {
+        symbol_instance_tickler(tag);
+    }
+
     if (tag->read_in_progress) {
-        if(tag->use_connected_msg) {
+        if(tag->read_frags_active) {
+            rc = check_read_frags_status(tag);
+        } else if(tag->use_connected_msg) {
             rc = check_read_status_connected(tag);
         } else {
             rc = check_read_status_unconnected(tag);
         }
 
+        /* a stale symbol instance gets one retry by name. */
+        if(rc_is_error(rc) && symbol_instance_fallback(tag, rc)) {
+            rc = tag_read_start(tag);
+        }
+
         tag->status = (int8_t)rc;
 
         /* if the operation completed, make a note so that the callback will be called. */
@@ -302,10 +336,10 @@ int tag_read_start(ab_tag_p tag)
         // if(tag->tag_list) {
         //     rc = build_tag_list_request_connected(tag);
         // } else {
-            rc = build_read_request_connected(tag, tag->offset);
+            rc = build_read_request_connected(tag, tag->offset, &(tag->req));
         // }
     } else {
-        rc = build_read_request_unconnected(tag, tag->offset);
+        rc = build_read_request_unconnected(tag, tag->offset, &(tag->req));
     }
 
     if (rc != PLCTAG_STATUS_OK) {
@@ -390,7 +424,7 @@ int tag_write_start(ab_tag_p tag)
 
 
 
-int build_read_request_connected(ab_tag_p tag, int byte_offset)
+int build_read_request_connected(ab_tag_p tag, int byte_offset, ab_request_p *req_out)
 {
     eip_cip_co_req* cip = NULL;
     uint8_t* data = NULL;
@@ -434,9 +468,15 @@ int build_read_request_connected(ab_tag_p tag, int byte_offset)
     *data = read_cmd;
     data++;
 
-    /* copy the tag name into the request */
-    mem_copy(data, tag->encoded_name, tag->encoded_name_size);
-    data += tag->encoded_name_size;
+    /* copy the tag name into the request, by symbol instance if we have one. */
+    tag->read_by_instance = symbol_instance_usable(tag);
+    if(tag->read_by_instance) {
+        mem_copy(data, tag->instance_name, tag->instance_name_size);
+        data += tag->instance_name_size;
+    } else {
+        mem_copy(data, tag->encoded_name, tag->encoded_name_size);
+        data += tag->encoded_name_size;
+    }
 
     /* add the count of elements to read. */
     *((uint16_le*)data) = h2le16((uint16_t)(tag->elem_count));
@@ -469,19 +509,23 @@ int build_read_request_connected(ab_tag_p tag, int byte_offset)
     /* set the session so that we know what session the request is aiming at */
     //req->session = tag->session;
 
-    req->allow_packing = tag->allow_packing;
+    /* pieces of a parallel read fill a packet each, packing would only split them. */
+    req->allow_packing = (tag->read_frags_active || read_reply_fills_packet(tag) ? 0 : tag->allow_packing);
+
+    /* send the pieces without waiting for the answer to the one before. */
+    req->allow_pipelining = tag->read_frags_active;
 
     /* add the request to the session's list. */
     rc = session_add_request(tag->session, req);
 
     if (rc != PLCTAG_STATUS_OK) {
         pdebug(DEBUG_ERROR, "Unable to add request to session! rc=%d", rc);
-        tag->req = rc_dec(req);
+        *req_out = rc_dec(req);
         return rc;
     }
 
     /* save the request for later */
-    tag->req = req;
+    *req_out = req;
 
     pdebug(DEBUG_INFO, "Done");
 
@@ -491,7 +535,7 @@ int build_read_request_connected(ab_tag_p tag, int byte_offset)
 
 
 
-int build_read_request_unconnected(ab_tag_p tag, int byte_offset)
+int build_read_request_unconnected(ab_tag_p tag, int byte_offset, ab_request_p *req_out)
 {
     eip_cip_uc_req* cip;
     uint8_t* data;
@@ -607,20 +651,20 @@ int build_read_request_unconnected(ab_tag_p tag, int byte_offset)
     /* set the size of the request */
     req->request_size = (int)(data - (req->data));
 
-    /* allow packing if the tag allows it. */
-    req->allow_packing = tag->allow_packing;
+    /* pieces of a parallel read fill a packet each, packing would only split them. */
+    req->allow_packing = (tag->read_frags_active || read_reply_fills_packet(tag) ? 0 : tag->allow_packing);
 
     /* add the request to the session's list. */
     rc = session_add_request(tag->session, req);
 
     if (rc != PLCTAG_STATUS_OK) {
         pdebug(DEBUG_ERROR, "Unable to add request to session! rc=%d", rc);
-        tag->req = rc_dec(req);
+        *req_out = rc_dec(req);
         return rc;
     }
 
     /* save the request for later */
-    tag->req = req;
+    *req_out = req;
 
     pdebug(DEBUG_INFO, "Done");
 
@@ -1105,6 +1149,26 @@ int build_write_request_connected(ab_tag_p tag, int byte_offset)
     /* allow packing if the tag allows it. */
     req->allow_packing = tag->allow_packing;
 
+    /*
+     * A whole write of atomic elements of a one dimensional array can be
+     * merged by the session with writes of the neighbouring elements.
+     */
+    if(!multiple_requests && tag->allow_packing && tag->encoded_type_info_size == 2
+       && tag->encoded_type_info[0] != AB_CIP_DATA_BIT && write_size == tag->size) {
+        int seg_offset = 0;
+        uint32_t index = 0;
+
+        if(find_array_index_segment(tag, &seg_offset, &index) == PLCTAG_STATUS_OK) {
+            req->cip_write_merge = 1;
+            req->cip_name_offset = (int)sizeof(eip_cip_co_req) + 1;
+            req->cip_index_offset = req->cip_name_offset + seg_offset;
+            req->cip_type_offset = req->cip_name_offset + tag->encoded_name_size;
+            req->cip_index = index;
+            req->cip_elem_count = tag->elem_count;
+            req->cip_elem_size = tag->elem_size;
+        }
+    }
+
     /* add the request to the session's list. */
     rc = session_add_request(tag->session, req);
 
@@ -1124,6 +1188,87 @@ int build_write_request_connected(ab_tag_p tag, int byte_offset)
 
 
 
+/*
+ * find_array_index_segment
+ *
+ * Find the numeric element segment at the end of the encoded name, if
+ * it directly follows a symbolic segment.  The offset is from the start
+ * of the encoded name.
+ */
+int find_array_index_segment(ab_tag_p tag, int *seg_offset, uint32_t *index)
+{
+    int offset = 1; /* skip the path size byte. */
+    int last_offset = -1;
+    int prev_type = 0;
+    int last_type = 0;
+
+    while(offset < tag->encoded_name_size) {
+        int seg_type = tag->encoded_name[offset];
+        int seg_size = 0;
+
+        switch(seg_type) {
+            case 0x91: /* symbolic segment, padded to an even length. */
+                if(offset + 1 >= tag->encoded_name_size) {
+                    return PLCTAG_ERR_BAD_DATA;
+                }
+
+                seg_size = 2 + tag->encoded_name[offset + 1] + (tag->encoded_name[offset + 1] & 0x01);
+                break;
+
+            case 0x28: /* 8-bit element */
+                seg_size = 2;
+                break;
+
+            case 0x29: /* 16-bit element */
+                seg_size = 4;
+                break;
+
+            case 0x2A: /* 32-bit element */
+                seg_size = 6;
+                break;
+
+            default:
+                return PLCTAG_ERR_UNSUPPORTED;
+        }
+
+        prev_type = last_type;
+        last_type = seg_type;
+        last_offset = offset;
+        offset += seg_size;
+    }
+
+    if(offset != tag->encoded_name_size || prev_type != 0x91 || last_offset < 0) {
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    switch(last_type) {
+        case 0x28:
+            *index = tag->encoded_name[last_offset + 1];
+            break;
+
+        case 0x29:
+            *index = (uint32_t)tag->encoded_name[last_offset + 2]
+                   | ((uint32_t)tag->encoded_name[last_offset + 3] << 8);
+            break;
+
+        case 0x2A:
+            *index = (uint32_t)tag->encoded_name[last_offset + 2]
+                   | ((uint32_t)tag->encoded_name[last_offset + 3] << 8)
+                   | ((uint32_t)tag->encoded_name[last_offset + 4] << 16)
+                   | ((uint32_t)tag->encoded_name[last_offset + 5] << 24);
+            break;
+
+        default:
+            return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    *seg_offset = last_offset;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
 
 int build_write_request_unconnected(ab_tag_p tag, int byte_offset)
 {
@@ -1331,6 +1476,7 @@ static int check_read_status_connected(ab_tag_p tag)
     uint8_t* data;
     uint8_t* data_end;
     int partial_data = 0;
+    int frag_bytes = 0;
     ab_request_p request = NULL;
 
     pdebug(DEBUG_SPEW, "Starting.");
@@ -1441,6 +1587,12 @@ static int check_read_status_connected(ab_tag_p tag)
                 }
             }
 
+            /* a symbol instance that now holds another type means the project changed. */
+            if(!symbol_instance_type_ok(tag, data, (int)payload_size)) {
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
             /* skip past the type data */
             data += (tag->encoded_type_info_size);
 
@@ -1448,6 +1600,8 @@ static int check_read_status_connected(ab_tag_p tag)
             payload_size = (data_end - data);
 
             /* copy the data into the tag and realloc if we need more space. */
+            tag_data_change_begin((plc_tag_p)tag);
+
             if(payload_size + tag->offset > tag->size) {
                 tag->size = (int)payload_size + tag->offset;
                 tag->elem_size = tag->size / tag->elem_count;
@@ -1476,6 +1630,7 @@ static int check_read_status_connected(ab_tag_p tag)
 
             /* bump the byte offset */
             tag->offset += (int)(payload_size);
+            frag_bytes = (int)payload_size;
         } else {
             pdebug(DEBUG_DETAIL, "Response returned no data and no error.");
         }
@@ -1504,9 +1659,15 @@ static int check_read_status_connected(ab_tag_p tag)
 
         /* skip if we are doing a pre-write read. */
         if (!tag->pre_write_read && partial_data) {
-            /* call read start again to get the next piece */
-            pdebug(DEBUG_DETAIL, "calling tag_read_start() to get the next chunk.");
-            rc = tag_read_start(tag);
+            if(read_frags_can_start(tag, frag_bytes)) {
+                /* the size is known, so ask for all the remaining pieces at once. */
+                pdebug(DEBUG_DETAIL, "starting parallel reads of the remaining chunks.");
+                rc = read_frags_start(tag, frag_bytes);
+            } else {
+                /* call read start again to get the next piece */
+                pdebug(DEBUG_DETAIL, "calling tag_read_start() to get the next chunk.");
+                rc = tag_read_start(tag);
+            }
         } else {
             tag->offset = 0;
 
@@ -1542,6 +1703,7 @@ static int check_read_status_unconnected(ab_tag_p tag)
     uint8_t* data;
     uint8_t* data_end;
     int partial_data = 0;
+    int frag_bytes = 0;
     ab_request_p request = NULL;
 
     pdebug(DEBUG_SPEW, "Starting.");
@@ -1659,6 +1821,8 @@ static int check_read_status_unconnected(ab_tag_p tag)
             payload_size = (data_end - data);
 
             /* copy the data into the tag and realloc if we need more space. */
+            tag_data_change_begin((plc_tag_p)tag);
+
             if(payload_size + tag->offset > tag->size) {
                 tag->size = (int)payload_size + tag->offset;
                 tag->elem_size = tag->size / tag->elem_count;
@@ -1687,6 +1851,7 @@ static int check_read_status_unconnected(ab_tag_p tag)
 
             /* bump the byte offset */
             tag->offset += (int)payload_size;
+            frag_bytes = (int)payload_size;
         } else {
             pdebug(DEBUG_DETAIL, "Response returned no data and no error.");
         }
@@ -1716,9 +1881,15 @@ static int check_read_status_unconnected(ab_tag_p tag)
 
         /* skip if we are doing a pre-write read. */
         if (!tag->pre_write_read && partial_data) {
-            /* call read start again to get the next piece */
-            pdebug(DEBUG_DETAIL, "calling tag_read_start() to get the next chunk.");
-            rc = tag_read_start(tag);
+            if(read_frags_can_start(tag, frag_bytes)) {
+                /* the size is known, so ask for all the remaining pieces at once. */
+                pdebug(DEBUG_DETAIL, "starting parallel reads of the remaining chunks.");
+                rc = read_frags_start(tag, frag_bytes);
+            } else {
+                /* call read start again to get the next piece */
+                pdebug(DEBUG_DETAIL, "calling tag_read_start() to get the next chunk.");
+                rc = tag_read_start(tag);
+            }
         } else {
             tag->offset = 0;
 
@@ -1753,6 +1924,847 @@ static int check_read_status_unconnected(ab_tag_p tag)
 
 
 
+/*
+ * Parallel fragmented reads.
+ *
+ * A tag larger than the payload size is read with a chain of Read Fragmented
+ * requests.  Each request used to be built only after the previous response
+ * had been handed back through the tickler.  Once a read has completed, the
+ * size of the tag is known.  After the first response of a later read, we
+ * know how many bytes fit in one response, so the remaining pieces can be
+ * requested at once and the session sends them back to back.  Pieces are
+ * never packed together as each one already fills a response.
+ *
+ * Each piece is tracked by offset.  If a response comes back short, the
+ * rest of that piece is requested again.
+ *
+ * All of these must be called with the tag mutex held.
+ */
+
+int read_frags_can_start(ab_tag_p tag, int frag_size)
+{
+    /* the first read determines the size and type of the tag. */
+    if(tag->first_read || tag->pre_write_read) {
+        return 0;
+    }
+
+    if(tag->read_frag_window <= 1 || frag_size <= 0) {
+        return 0;
+    }
+
+    /* only worth it if more than one piece remains. */
+    return (tag->size - tag->offset) > frag_size;
+}
+
+
+
+int read_frags_start(ab_tag_p tag, int frag_size)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    tag->read_in_progress = 1;
+    tag->read_frags_active = 1;
+    tag->read_frag_size = frag_size;
+    tag->read_frag_next = tag->offset;
+
+    pdebug(DEBUG_DETAIL, "Reading %d bytes from offset %d in pieces of %d bytes.", tag->size - tag->offset, tag->offset, frag_size);
+
+    return read_frags_fill(tag);
+}
+
+
+
+int read_frags_fill(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    for(int i=0; i < tag->read_frag_window && tag->read_frag_next < tag->size; i++) {
+        ab_read_frag_t *frag = &(tag->read_frags[i]);
+
+        if(frag->req) {
+            continue;
+        }
+
+        frag->offset = tag->read_frag_next;
+        frag->end = frag->offset + tag->read_frag_size;
+        frag->last = (frag->end >= tag->size);
+
+        if(frag->last) {
+            frag->end = tag->size;
+        }
+
+        tag->read_frag_next = frag->end;
+
+        rc = read_frag_issue(tag, frag);
+        if(rc != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Unable to queue read of piece at offset %d!", frag->offset);
+            return rc;
+        }
+    }
+
+    return PLCTAG_STATUS_PENDING;
+}
+
+
+
+int read_frag_issue(ab_tag_p tag, ab_read_frag_t *frag)
+{
+    if(tag->use_connected_msg) {
+        return build_read_request_connected(tag, frag->offset, &(frag->req));
+    } else {
+        return build_read_request_unconnected(tag, frag->offset, &(frag->req));
+    }
+}
+
+
+
+/*
+ * Check one Read Fragmented response and find the data in it.  The type
+ * information is already known at this point, so it is skipped.
+ */
+
+int decode_read_frag_response(ab_tag_p tag, ab_request_p request, uint8_t **payload, int *payload_size, int *partial_data)
+{
+    uint16_t encap_command = 0;
+    uint32_t encap_status = 0;
+    uint8_t reply_service = 0;
+    uint8_t *status = NULL;
+    uint8_t *data = NULL;
+    uint8_t *data_end = NULL;
+
+    if(tag->use_connected_msg) {
+        eip_cip_co_resp *cip_resp = (eip_cip_co_resp *)(request->data);
+
+        encap_command = le2h16(cip_resp->encap_command);
+        encap_status = le2h32(cip_resp->encap_status);
+        reply_service = cip_resp->reply_service;
+        status = &(cip_resp->status);
+        data = request->data + sizeof(eip_cip_co_resp);
+        data_end = request->data + le2h16(cip_resp->encap_length) + sizeof(eip_encap);
+
+        if(encap_command != AB_EIP_CONNECTED_SEND) {
+            pdebug(DEBUG_WARN, "Unexpected EIP packet type received: %d!", encap_command);
+            return PLCTAG_ERR_BAD_DATA;
+        }
+    } else {
+        eip_cip_uc_resp *cip_resp = (eip_cip_uc_resp *)(request->data);
+
+        encap_command = le2h16(cip_resp->encap_command);
+        encap_status = le2h32(cip_resp->encap_status);
+        reply_service = cip_resp->reply_service;
+        status = &(cip_resp->status);
+        data = request->data + sizeof(eip_cip_uc_resp);
+        data_end = request->data + le2h16(cip_resp->encap_length) + sizeof(eip_encap);
+
+        if(encap_command != AB_EIP_UNCONNECTED_SEND) {
+            pdebug(DEBUG_WARN, "Unexpected EIP packet type received: %d!", encap_command);
+            return PLCTAG_ERR_BAD_DATA;
+        }
+    }
+
+    if(encap_status != AB_EIP_OK) {
+        pdebug(DEBUG_WARN, "EIP command failed, response code: %d", encap_status);
+        return PLCTAG_ERR_REMOTE_ERR;
+    }
+
+    if(reply_service != (AB_EIP_CMD_CIP_READ_FRAG | AB_EIP_CMD_CIP_OK)) {
+        pdebug(DEBUG_WARN, "CIP response reply service unexpected: %d", reply_service);
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    if(*status != AB_CIP_STATUS_OK && *status != AB_CIP_STATUS_FRAG) {
+        pdebug(DEBUG_WARN, "CIP read failed with status: 0x%x %s", *status, decode_cip_error_short(status));
+        pdebug(DEBUG_INFO, decode_cip_error_long(status));
+        return decode_cip_error_code(status);
+    }
+
+    *partial_data = (*status == AB_CIP_STATUS_FRAG);
+
+    if(!symbol_instance_type_ok(tag, data, (int)(data_end - data))) {
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    /* skip past the type data */
+    data += tag->encoded_type_info_size;
+
+    if(data > data_end) {
+        pdebug(DEBUG_WARN, "Response is too short to hold the type information!");
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    *payload = data;
+    *payload_size = (int)(data_end - data);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int check_read_frags_status(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int in_flight = 0;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    for(int i=0; i < AB_MAX_READ_FRAGS && rc == PLCTAG_STATUS_OK; i++) {
+        ab_read_frag_t *frag = &(tag->read_frags[i]);
+        ab_request_p request = frag->req;
+        int resp_received = 0;
+        uint8_t *payload = NULL;
+        int payload_size = 0;
+        int partial_data = 0;
+
+        if(!request) {
+            continue;
+        }
+
+        spin_block(&request->lock) {
+            resp_received = request->resp_received;
+
+            if(resp_received && request->status != PLCTAG_STATUS_OK) {
+                rc = request->status;
+            }
+        }
+
+        if(!resp_received) {
+            in_flight++;
+            continue;
+        }
+
+        if(rc != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Session reported failure of request: %s.", plc_tag_decode_error(rc));
+            break;
+        }
+
+        rc = decode_read_frag_response(tag, request, &payload, &payload_size, &partial_data);
+        if(rc == PLCTAG_STATUS_OK) {
+            tag_data_change_begin((plc_tag_p)tag);
+
+            /* a later piece can run past the size we know if the tag grew. */
+            if(frag->offset + payload_size > tag->size) {
+                uint8_t *new_data = (uint8_t*)mem_realloc(tag->data, frag->offset + payload_size);
+
+                if(!new_data) {
+                    pdebug(DEBUG_WARN, "Unable to reallocate tag data memory!");
+                    rc = PLCTAG_ERR_NO_MEM;
+                } else {
+                    tag->data = new_data;
+                    tag->size = frag->offset + payload_size;
+                    tag->elem_size = tag->size / tag->elem_count;
+
+                    pdebug(DEBUG_DETAIL, "Increased tag buffer size to %d bytes.", tag->size);
+                }
+            }
+
+            if(rc == PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_DETAIL, "Got %d bytes of data at offset %d.", payload_size, frag->offset);
+
+                mem_copy(tag->data + frag->offset, payload, payload_size);
+                frag->offset += payload_size;
+
+                /* the read is done when the last piece arrives. */
+                if(request->time_received_us > tag->read_received_us) {
+                    tag->read_received_us = request->time_received_us;
+                }
+            }
+        }
+
+        /* done with this response. */
+        request->abort_request = 1;
+        frag->req = rc_dec(request);
+
+        if(rc != PLCTAG_STATUS_OK) {
+            break;
+        }
+
+        /* a short piece or the end of a tag that grew needs another request. */
+        if(partial_data && (frag->offset < frag->end || frag->last)) {
+            if(payload_size <= 0) {
+                pdebug(DEBUG_WARN, "Partial response without any data!");
+                rc = PLCTAG_ERR_BAD_REPLY;
+                break;
+            }
+
+            rc = read_frag_issue(tag, frag);
+            if(rc == PLCTAG_STATUS_OK) {
+                in_flight++;
+            }
+        }
+    }
+
+    /* start more pieces if there is room. */
+    if(rc == PLCTAG_STATUS_OK && tag->read_frag_next < tag->size) {
+        rc = read_frags_fill(tag);
+
+        if(rc == PLCTAG_STATUS_PENDING) {
+            rc = PLCTAG_STATUS_OK;
+            in_flight++;
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Parallel read failed with %s!", plc_tag_decode_error(rc));
+
+        /* clean up everything, this clears the rest of the pieces. */
+        ab_tag_abort(tag);
+
+        return rc;
+    }
+
+    if(in_flight) {
+        pdebug(DEBUG_SPEW, "Done.  Pieces still in flight.");
+        return PLCTAG_STATUS_PENDING;
+    }
+
+    /* all the pieces are in. */
+    tag->read_frags_active = 0;
+    tag->read_in_progress = 0;
+    tag->offset = 0;
+
+    pdebug(DEBUG_DETAIL, "Done.  Parallel read complete.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+
+/*
+ * Symbol instance addressing.
+ *
+ * A symbolic tag name can take a large part of a request.  When the tag
+ * asks for it, the base symbol is looked up in the session symbol table
+ * and reads address it as an instance of the symbol class, 0x6B, followed
+ * by the rest of the encoded name.  Until the instance is known, and for
+ * writes, the symbolic name is used.
+ *
+ * If a read by instance fails because the path is not found, or returns
+ * a different type than before, the controller project has probably
+ * changed.  The session table is thrown away and the read is tried again
+ * by name.  The tag then resolves its instance again.  If it gets the same
+ * instance back, instance addressing is given up for this tag.
+ *
+ * A renumbered instance of the same type would still read fine, so reads
+ * only go by instance while the session has recently checked that the
+ * controller change counters have not moved.
+ *
+ * Only controller scope symbols are resolved.  Program scope tags keep
+ * their symbolic names.
+ */
+
+#define MAX_SYMBOL_NAME (255)
+
+int symbol_instance_tickler(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    char name[MAX_SYMBOL_NAME + 1];
+    uint32_t instance = 0;
+    int must_load = 0;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(tag->symbol_checking) {
+        return symbol_changes_check_response(tag);
+    }
+
+    if(tag->symbol_state == AB_SYMBOL_LOADING) {
+        return symbol_list_check_response(tag);
+    }
+
+    if(symbol_instance_base_name(tag, name, (int)sizeof(name)) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_DETAIL, "Tag base name cannot be addressed by instance.");
+        tag->symbol_state = AB_SYMBOL_SYMBOLIC;
+        return PLCTAG_STATUS_OK;
+    }
+
+    rc = session_symbols_lookup(tag->session, tag->tag_id, name, &instance, &(tag->symbol_generation), &must_load);
+    if(rc == PLCTAG_STATUS_OK) {
+        if(tag->symbol_retried && instance == tag->symbol_instance) {
+            pdebug(DEBUG_WARN, "Symbol %s resolved to the same failing instance %u, using the symbolic name.", name, instance);
+            tag->symbol_state = AB_SYMBOL_SYMBOLIC;
+            return PLCTAG_STATUS_OK;
+        }
+
+        rc = symbol_instance_encode(tag, instance);
+        if(rc != PLCTAG_STATUS_OK) {
+            tag->symbol_state = AB_SYMBOL_SYMBOLIC;
+            return rc;
+        }
+
+        pdebug(DEBUG_INFO, "Symbol %s is instance %u.", name, instance);
+
+        tag->symbol_instance = instance;
+        tag->symbol_state = AB_SYMBOL_RESOLVED;
+    } else if(rc == PLCTAG_STATUS_PENDING) {
+        if(must_load) {
+            pdebug(DEBUG_DETAIL, "Loading the session symbol table.");
+
+            tag->symbol_state = AB_SYMBOL_LOADING;
+            tag->symbol_next_id = 0;
+
+            /* the change counters come first, the walk starts when they are in. */
+            tag->symbol_checking = 1;
+
+            rc = build_changes_request(tag, &(tag->symbol_req));
+            if(rc != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Unable to start loading the symbol table, error %s!", plc_tag_decode_error(rc));
+                session_symbols_load_done(tag->session, tag->tag_id, PLCTAG_ERR_ABORT);
+                tag->symbol_checking = 0;
+                tag->symbol_state = AB_SYMBOL_UNRESOLVED;
+            }
+        }
+    } else {
+        pdebug(DEBUG_DETAIL, "Symbol %s has no instance, using the symbolic name.", name);
+        tag->symbol_state = AB_SYMBOL_SYMBOLIC;
+    }
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * Get the base symbol name out of the encoded name.  It must be a
+ * symbolic segment and not a program name.
+ */
+
+int symbol_instance_base_name(ab_tag_p tag, char *name, int name_capacity)
+{
+    int name_len = 0;
+
+    if(tag->encoded_name_size < 3 || tag->encoded_name[1] != 0x91) {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    name_len = tag->encoded_name[2];
+
+    if(name_len <= 0 || name_len >= name_capacity || 3 + name_len > tag->encoded_name_size) {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    mem_copy(name, &(tag->encoded_name[3]), name_len);
+    name[name_len] = 0;
+
+    /* program scope, e.g. Program:MainProgram. */
+    for(int i=0; i < name_len; i++) {
+        if(name[i] == ':') {
+            return PLCTAG_ERR_UNSUPPORTED;
+        }
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * Build the instance form of the encoded name.  The base symbolic segment
+ * is replaced with a logical class and instance path.  Any member and
+ * array segments after it are kept.
+ */
+
+int symbol_instance_encode(ab_tag_p tag, uint32_t instance)
+{
+    int name_len = tag->encoded_name[2];
+    int base_size = 2 + name_len + (name_len & 0x01);
+    int rest_size = tag->encoded_name_size - 1 - base_size;
+    int index = 1;
+
+    if(!tag->instance_name) {
+        tag->instance_name = mem_alloc(MAX_TAG_NAME);
+        if(!tag->instance_name) {
+            pdebug(DEBUG_WARN, "Unable to allocate instance name buffer!");
+            return PLCTAG_ERR_NO_MEM;
+        }
+    }
+
+    tag->instance_name[index++] = 0x20; /* logical class segment, 8-bit. */
+    tag->instance_name[index++] = 0x6B; /* symbol class. */
+
+    if(instance <= 0xFF) {
+        tag->instance_name[index++] = 0x24; /* logical instance segment, 8-bit. */
+        tag->instance_name[index++] = (uint8_t)instance;
+    } else if(instance <= 0xFFFF) {
+        tag->instance_name[index++] = 0x25; /* logical instance segment, 16-bit. */
+        tag->instance_name[index++] = 0x00; /* padding */
+        tag->instance_name[index++] = (uint8_t)(instance & 0xFF);
+        tag->instance_name[index++] = (uint8_t)((instance >> 8) & 0xFF);
+    } else {
+        tag->instance_name[index++] = 0x26; /* logical instance segment, 32-bit. */
+        tag->instance_name[index++] = 0x00; /* padding */
+        tag->instance_name[index++] = (uint8_t)(instance & 0xFF);
+        tag->instance_name[index++] = (uint8_t)((instance >> 8) & 0xFF);
+        tag->instance_name[index++] = (uint8_t)((instance >> 16) & 0xFF);
+        tag->instance_name[index++] = (uint8_t)((instance >> 24) & 0xFF);
+    }
+
+    if(rest_size < 0 || index + rest_size > MAX_TAG_NAME) {
+        pdebug(DEBUG_WARN, "Encoded name does not fit with an instance segment!");
+        return PLCTAG_ERR_TOO_LARGE;
+    }
+
+    mem_copy(&(tag->instance_name[index]), &(tag->encoded_name[1 + base_size]), rest_size);
+    index += rest_size;
+
+    /* the first byte is the size in 16-bit words. */
+    tag->instance_name[0] = (uint8_t)((index - 1)/2);
+    tag->instance_name_size = index;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int symbol_instance_type_ok(ab_tag_p tag, uint8_t *type_info, int available)
+{
+    if(!tag->read_by_instance || tag->encoded_type_info_size <= 0) {
+        return 1;
+    }
+
+    if(available < tag->encoded_type_info_size) {
+        return 0;
+    }
+
+    if(mem_cmp(type_info, tag->encoded_type_info_size, tag->encoded_type_info, tag->encoded_type_info_size)) {
+        pdebug(DEBUG_WARN, "Type data changed for symbol instance %u!", tag->symbol_instance);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+
+/*
+ * Decide whether a failed read should be retried by name.  If so, the
+ * session symbol table is thrown away so it gets reloaded.
+ */
+
+int symbol_instance_fallback(ab_tag_p tag, int rc)
+{
+    if(tag->symbol_state != AB_SYMBOL_RESOLVED || !tag->read_by_instance) {
+        return 0;
+    }
+
+    /* errors a stale instance is likely to cause. */
+    if(rc != PLCTAG_ERR_NOT_FOUND && rc != PLCTAG_ERR_BAD_PARAM && rc != PLCTAG_ERR_BAD_DATA && rc != PLCTAG_ERR_OUT_OF_BOUNDS) {
+        return 0;
+    }
+
+    pdebug(DEBUG_WARN, "Read by symbol instance %u failed with %s, retrying by name.", tag->symbol_instance, plc_tag_decode_error(rc));
+
+    session_symbols_invalidate(tag->session, tag->symbol_generation);
+
+    tag->symbol_retried = 1;
+    tag->symbol_state = AB_SYMBOL_UNRESOLVED;
+
+    return 1;
+}
+
+
+
+/*
+ * Decide whether the next read can go by instance.  The session only
+ * vouches for the table while the controller change counters were checked
+ * recently.  If a check is due, this tag may have to start it, and the
+ * read goes by name until the counters are in.
+ */
+
+int symbol_instance_usable(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int must_check = 0;
+
+    if(tag->symbol_state != AB_SYMBOL_RESOLVED) {
+        return 0;
+    }
+
+    rc = session_symbols_current(tag->session, tag->tag_id, tag->symbol_generation, &must_check);
+    if(rc == PLCTAG_STATUS_OK) {
+        return 1;
+    }
+
+    if(rc == PLCTAG_ERR_BAD_STATUS) {
+        pdebug(DEBUG_DETAIL, "Symbol table generation %d is gone, resolving again.", tag->symbol_generation);
+        tag->symbol_state = AB_SYMBOL_UNRESOLVED;
+        return 0;
+    }
+
+    if(must_check) {
+        pdebug(DEBUG_DETAIL, "Checking the controller change counters.");
+
+        tag->symbol_checking = 1;
+
+        rc = build_changes_request(tag, &(tag->symbol_req));
+        if(rc != PLCTAG_STATUS_OK) {
+            tag->symbol_checking = 0;
+            session_symbols_check_done(tag->session, tag->tag_id, PLCTAG_ERR_ABORT, NULL, 0);
+        }
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Handle the change counter reply.  The loader saves it and starts walking
+ * the symbols.  Any other tag hands it to the session for comparison.
+ */
+
+int symbol_changes_check_response(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    ab_request_p request = tag->symbol_req;
+    uint8_t *changes = NULL;
+    int changes_size = 0;
+    int resp_received = 0;
+
+    if(!request) {
+        rc = PLCTAG_ERR_NULL_PTR;
+    } else {
+        spin_block(&request->lock) {
+            resp_received = request->resp_received;
+
+            if(resp_received && request->status != PLCTAG_STATUS_OK) {
+                rc = request->status;
+            }
+        }
+
+        if(!resp_received) {
+            return PLCTAG_STATUS_PENDING;
+        }
+    }
+
+    if(rc == PLCTAG_STATUS_OK) {
+        rc = check_changes_reply(request, &changes, &changes_size);
+    }
+
+    tag->symbol_checking = 0;
+
+    if(tag->symbol_state == AB_SYMBOL_LOADING) {
+        if(rc == PLCTAG_STATUS_OK) {
+            rc = session_symbols_set_changes(tag->session, tag->tag_id, changes, changes_size);
+        }
+
+        if(request) {
+            request->abort_request = 1;
+            tag->symbol_req = rc_dec(request);
+        }
+
+        if(rc == PLCTAG_STATUS_OK) {
+            rc = symbol_list_build_request(tag);
+        }
+
+        if(rc != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Unable to read the controller change counters, error %s!", plc_tag_decode_error(rc));
+            session_symbols_load_done(tag->session, tag->tag_id, rc);
+            tag->symbol_state = AB_SYMBOL_UNRESOLVED;
+        }
+
+        return rc;
+    }
+
+    session_symbols_check_done(tag->session, tag->tag_id, rc, changes, changes_size);
+
+    if(request) {
+        request->abort_request = 1;
+        tag->symbol_req = rc_dec(request);
+    }
+
+    return rc;
+}
+
+
+
+/*
+ * Ask for the names of the controller symbols starting at the next
+ * instance.  Only the name attribute is requested.
+ */
+
+int symbol_list_build_request(ab_tag_p tag)
+{
+    eip_cip_co_req* cip = NULL;
+    ab_request_p req = NULL;
+    int rc = PLCTAG_STATUS_OK;
+    uint8_t *data_start = NULL;
+    uint8_t *data = NULL;
+    uint16_le tmp_u16 = UINT16_LE_INIT(0);
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    rc = session_create_request(tag->session, tag->tag_id, &req);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to get new request.  rc=%d", rc);
+        return rc;
+    }
+
+    cip = (eip_cip_co_req*)(req->data);
+    data_start = data = (uint8_t*)(cip + 1);
+
+    *data = AB_EIP_CMD_CIP_LIST_TAGS;
+    data++;
+
+    /* request path size, in 16-bit words */
+    *data = 3;
+    data++;
+
+    data[0] = 0x20; /* class type */
+    data[1] = 0x6B; /* tag info/symbol class */
+    data[2] = 0x25; /* 16-bit instance ID type */
+    data[3] = 0x00; /* padding */
+    data += 4;
+
+    tmp_u16 = h2le16((uint16_t)tag->symbol_next_id);
+    mem_copy(data, &tmp_u16, (int)sizeof(tmp_u16));
+    data += (int)sizeof(tmp_u16);
+
+    /* one attribute, the symbol name. */
+    tmp_u16 = h2le16((uint16_t)1);
+    mem_copy(data, &tmp_u16, (int)sizeof(tmp_u16));
+    data += (int)sizeof(tmp_u16);
+
+    tmp_u16 = h2le16((uint16_t)0x01);
+    mem_copy(data, &tmp_u16, (int)sizeof(tmp_u16));
+    data += (int)sizeof(tmp_u16);
+
+    cip->encap_command = h2le16(AB_EIP_CONNECTED_SEND);
+    cip->router_timeout = h2le16(1);
+    cip->cpf_item_count = h2le16(2);
+    cip->cpf_cai_item_type = h2le16(AB_EIP_ITEM_CAI);
+    cip->cpf_cai_item_length = h2le16(4);
+    cip->cpf_cdi_item_type = h2le16(AB_EIP_ITEM_CDI);
+    cip->cpf_cdi_item_length = h2le16((uint16_t)((int)(data - data_start) + (int)sizeof(cip->cpf_conn_seq_num)));
+
+    req->request_size = (int)((int)sizeof(*cip) + (int)(data - data_start));
+
+    /* the reply fills the packet, so there is no point in packing it. */
+    req->allow_packing = 0;
+
+    rc = session_add_request(tag->session, req);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to add request to session! rc=%d", rc);
+        rc_dec(req);
+        return rc;
+    }
+
+    tag->symbol_req = req;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int symbol_list_check_response(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    ab_request_p request = tag->symbol_req;
+    eip_cip_co_resp *cip_resp = NULL;
+    uint8_t *data = NULL;
+    uint8_t *data_end = NULL;
+    int resp_received = 0;
+    int partial_data = 0;
+
+    if(!request) {
+        rc = PLCTAG_ERR_NULL_PTR;
+    } else {
+        spin_block(&request->lock) {
+            resp_received = request->resp_received;
+
+            if(resp_received && request->status != PLCTAG_STATUS_OK) {
+                rc = request->status;
+            }
+        }
+
+        if(!resp_received) {
+            return PLCTAG_STATUS_PENDING;
+        }
+    }
+
+    while(rc == PLCTAG_STATUS_OK) {
+        cip_resp = (eip_cip_co_resp*)(request->data);
+        data = request->data + sizeof(eip_cip_co_resp);
+        data_end = request->data + le2h16(cip_resp->encap_length) + sizeof(eip_encap);
+
+        if (le2h16(cip_resp->encap_command) != AB_EIP_CONNECTED_SEND || le2h32(cip_resp->encap_status) != AB_EIP_OK) {
+            pdebug(DEBUG_WARN, "Unexpected EIP response to symbol listing!");
+            rc = PLCTAG_ERR_BAD_REPLY;
+            break;
+        }
+
+        if (cip_resp->reply_service != (AB_EIP_CMD_CIP_LIST_TAGS | AB_EIP_CMD_CIP_OK)) {
+            pdebug(DEBUG_WARN, "CIP response reply service unexpected: %d", cip_resp->reply_service);
+            rc = PLCTAG_ERR_BAD_REPLY;
+            break;
+        }
+
+        if (cip_resp->status != AB_CIP_STATUS_OK && cip_resp->status != AB_CIP_STATUS_FRAG) {
+            pdebug(DEBUG_WARN, "Symbol listing failed with status: 0x%x %s", cip_resp->status, decode_cip_error_short((uint8_t *)&cip_resp->status));
+            rc = decode_cip_error_code((uint8_t *)&cip_resp->status);
+            break;
+        }
+
+        partial_data = (cip_resp->status == AB_CIP_STATUS_FRAG);
+
+        /* each entry is the instance ID followed by the counted name. */
+        while(rc == PLCTAG_STATUS_OK && (data_end - data) >= 6) {
+            uint32_le instance_le = UINT32_LE_INIT(0);
+            uint16_le name_len_le = UINT16_LE_INIT(0);
+            uint32_t instance = 0;
+            int name_len = 0;
+
+            mem_copy(&instance_le, data, (int)sizeof(instance_le));
+            mem_copy(&name_len_le, data + 4, (int)sizeof(name_len_le));
+
+            instance = le2h32(instance_le);
+            name_len = le2h16(name_len_le);
+
+            if((data_end - data) < 6 + name_len) {
+                pdebug(DEBUG_WARN, "Symbol entry runs past the end of the response!");
+                rc = PLCTAG_ERR_BAD_REPLY;
+                break;
+            }
+
+            rc = session_symbols_add(tag->session, tag->tag_id, (const char *)(data + 6), name_len, instance);
+
+            tag->symbol_next_id = instance + 1;
+            data += 6 + name_len;
+        }
+
+        break;
+    }
+
+    if(request) {
+        request->abort_request = 1;
+        tag->symbol_req = rc_dec(request);
+    }
+
+    if(rc == PLCTAG_STATUS_OK && partial_data) {
+        rc = symbol_list_build_request(tag);
+        if(rc == PLCTAG_STATUS_OK) {
+            return PLCTAG_STATUS_PENDING;
+        }
+    }
+
+    /* done, one way or another.  Resolve on the next pass. */
+    session_symbols_load_done(tag->session, tag->tag_id, rc);
+    tag->symbol_state = AB_SYMBOL_UNRESOLVED;
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to load the symbol table, error %s!", plc_tag_decode_error(rc));
+    }
+
+    return rc;
+}
+
+
+
+
 /*
  * check_write_status_connected
  *
@@ -1951,6 +2963,29 @@ static int check_write_status_unconnected(ab_tag_p tag)
 
 
 
+/*
+ * The PLC fills the reply to a read with as much data as fits.  If the rest
+ * of the tag does not fit in one reply, nothing packed after the read gets
+ * any room for its own reply.
+ *
+ * Besides the data, the packet holds the Multiple Service reply header with
+ * the offsets of the read reply and the one after it, the header of each of
+ * the two replies and the read's type info.  Structures have the longest
+ * type info, the type and the structure handle.
+ */
+
+#define READ_REPLY_TYPE_INFO_MAX_SIZE (4)
+#define READ_REPLY_OVERHEAD ((int)sizeof(cip_multi_resp_header) + (2 * (int)sizeof(uint16_le)) + (2 * (int)sizeof(cip_header)) + READ_REPLY_TYPE_INFO_MAX_SIZE)
+
+int read_reply_fills_packet(ab_tag_p tag)
+{
+    int max_payload = session_get_max_payload(tag->session);
+
+    return (tag->size - tag->offset) + READ_REPLY_OVERHEAD >= max_payload;
+}
+
+
+
 int calculate_write_data_per_packet(ab_tag_p tag)
 {
     int overhead = 0;
@@ -43,6 +43,7 @@
 #include <ab/eip_cip.h>  /* for the Logix decode types. */
 #include <ab/eip_cip_special.h>
 #include <ab/error_codes.h>
+#include <ab/udt_cache.h>
 #include <util/attr.h>
 #include <util/debug.h>
 #include <util/vector.h>
@@ -145,6 +146,9 @@ static int listing_tag_tickler(ab_tag_p tag);
 //static int listing_tag_write_start(ab_tag_p tag);
 static int listing_tag_check_read_status_connected(ab_tag_p tag);
 static int listing_tag_build_read_request_connected(ab_tag_p tag);
+static int listing_tag_process_page(ab_tag_p tag, uint8_t *data, uint8_t *data_end, int *num_entries);
+static int listing_tag_entry_matches(ab_tag_p tag, tag_list_entry *entry, uint8_t *name);
+static int listing_tag_stream_page(ab_tag_p tag, uint8_t *data, uint8_t *data_end, int num_matches, int name_bytes);
 
 
 
@@ -156,6 +160,14 @@ static int udt_tag_check_read_metadata_status_connected(ab_tag_p tag);
 static int udt_tag_build_read_metadata_request_connected(ab_tag_p tag);
 static int udt_tag_check_read_fields_status_connected(ab_tag_p tag);
 static int udt_tag_build_read_fields_request_connected(ab_tag_p tag);
+static int udt_tag_get_cached_fields(ab_tag_p tag);
+static int udt_tag_check_read_changes_status_connected(ab_tag_p tag);
+
+/* controller change counter tag functions. */
+static int changes_tag_read_start(ab_tag_p tag);
+static int changes_tag_tickler(ab_tag_p tag);
+static int changes_tag_check_read_status_connected(ab_tag_p tag);
+static int changes_tag_build_read_request_connected(ab_tag_p tag);
 
 
 /* define the vtable for raw tag type. */
@@ -171,7 +183,11 @@ struct tag_vtable_t raw_tag_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
 
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 /* define the vtable for listing tag type. */
@@ -187,7 +203,11 @@ struct tag_vtable_t listing_tag_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
 
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 
@@ -204,7 +224,32 @@ struct tag_vtable_t udt_tag_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
 
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
+};
+
+
+/* define the vtable for the controller change counter tag type. */
+struct tag_vtable_t changes_tag_vtable = {
+    (tag_vtable_func)ab_tag_abort, /* shared */
+    (tag_vtable_func)changes_tag_read_start,
+    (tag_vtable_func)ab_tag_status, /* shared */
+    (tag_vtable_func)changes_tag_tickler,
+    (tag_vtable_func)NULL, /* write */
+    (tag_vtable_func)NULL, /* wake_plc */
+
+    /* attribute accessors */
+    ab_get_int_attrib,
+    ab_set_int_attrib,
+
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 
@@ -448,6 +493,8 @@ static int raw_tag_check_write_status_connected(ab_tag_p tag)
     tag->write_in_progress = 0;
 
     if(rc == PLCTAG_STATUS_OK) {
+        tag_data_change_begin((plc_tag_p)tag);
+
         /* copy the data into the tag. */
         uint8_t *data_start = (uint8_t *)(&cip_resp->reply_service);
         uint8_t *data_end = request->data + (request->request_size);
@@ -555,6 +602,8 @@ static int raw_tag_check_write_status_unconnected(ab_tag_p tag)
     tag->write_in_progress = 0;
 
     if(rc == PLCTAG_STATUS_OK) {
+        tag_data_change_begin((plc_tag_p)tag);
+
         /* copy the data into the tag. */
         uint8_t *data_start = (uint8_t *)(&cip_resp->reply_service);
         uint8_t *data_end = data_start + le2h16(cip_resp->cpf_udi_item_length);
@@ -1082,50 +1131,16 @@ static int listing_tag_check_read_status_connected(ab_tag_p tag)
          * response, there might not be.
          */
         if(payload_size > 0) {
-            uint8_t *current_entry_data = data;
-            int new_size = (int)payload_size + tag->offset;
-
-            /* copy the data into the tag and realloc if we need more space. */
-
-            if(new_size > tag->size) {
-                uint8_t *new_buffer = NULL;
+            int num_entries = 0;
 
-                tag->elem_count = tag->size = new_size;
-
-                pdebug(DEBUG_DETAIL, "Increasing tag buffer size to %d bytes.", new_size);
-
-                new_buffer = (uint8_t*)mem_realloc(tag->data, new_size);
-                if(!new_buffer) {
-                    pdebug(DEBUG_WARN, "Unable to reallocate tag data memory!");
-                    rc = PLCTAG_ERR_NO_MEM;
-                    break;
-                }
-
-                tag->data = new_buffer;
-                tag->elem_count = tag->size = new_size;
+            rc = listing_tag_process_page(tag, data, data_end, &num_entries);
+            if(rc != PLCTAG_STATUS_OK) {
+                break;
             }
 
-            /* copy the data into the tag's data buffer. */
-            mem_copy(tag->data + tag->offset, data, (int)payload_size);
-
-            tag->offset += (int)payload_size;
-
-            pdebug(DEBUG_DETAIL, "current offset %d", tag->offset);
-
-            /* scan through the data to get the next ID to use. */
-            while((data_end - current_entry_data) > 0) {
-                tag_list_entry *current_entry = (tag_list_entry*)current_entry_data;
-
-                /* first element is the symbol instance ID */
-                tag->next_id = (uint16_t)(le2h32(current_entry->instance_id) + 1);
-
-                pdebug(DEBUG_DETAIL, "Next ID: %d", tag->next_id);
+            symbol_index += num_entries;
 
-                /* skip past to the next instance. */
-                current_entry_data += (sizeof(*current_entry) + le2h16(current_entry->string_len));
-
-                symbol_index++;
-            }
+            pdebug(DEBUG_DETAIL, "Next ID: %d, current offset %d", tag->next_id, tag->offset);
         } else {
             pdebug(DEBUG_DETAIL, "Response returned no data and no error.");
         }
@@ -1191,6 +1206,180 @@ static int listing_tag_check_read_status_connected(ab_tag_p tag)
 
 
 
+/*
+ * Go through one page of listing entries.  Matching entries are either
+ * added to the tag buffer or, if there is a listing callback, decoded
+ * and passed to it.  Either way, the next instance ID is updated.
+ */
+
+int listing_tag_process_page(ab_tag_p tag, uint8_t *data, uint8_t *data_end, int *num_entries)
+{
+    uint8_t *current_entry_data = data;
+    int num_matches = 0;
+    int match_bytes = 0;
+    int name_bytes = 0;
+
+    *num_entries = 0;
+
+    /* first pass, check the entries and size up the matches. */
+    while((data_end - current_entry_data) > 0) {
+        tag_list_entry *current_entry = (tag_list_entry*)current_entry_data;
+        int entry_size = 0;
+
+        if((data_end - current_entry_data) < (ptrdiff_t)sizeof(*current_entry)) {
+            pdebug(DEBUG_WARN, "Partial tag listing entry in response!");
+            return PLCTAG_ERR_BAD_REPLY;
+        }
+
+        entry_size = (int)sizeof(*current_entry) + le2h16(current_entry->string_len);
+
+        if((data_end - current_entry_data) < entry_size) {
+            pdebug(DEBUG_WARN, "Tag listing entry name runs past the end of the response!");
+            return PLCTAG_ERR_BAD_REPLY;
+        }
+
+        /* first element is the symbol instance ID */
+        tag->next_id = (uint16_t)(le2h32(current_entry->instance_id) + 1);
+
+        if(listing_tag_entry_matches(tag, current_entry, current_entry_data + sizeof(*current_entry))) {
+            num_matches++;
+            match_bytes += entry_size;
+            name_bytes += le2h16(current_entry->string_len) + 1;
+        }
+
+        (*num_entries)++;
+
+        current_entry_data += entry_size;
+    }
+
+    if(tag->listing_callback) {
+        return listing_tag_stream_page(tag, data, data_end, num_matches, name_bytes);
+    }
+
+    tag_data_change_begin((plc_tag_p)tag);
+
+    /* copy the matches into the tag and realloc if we need more space. */
+    if(tag->offset + match_bytes > tag->size) {
+        int new_size = tag->offset + match_bytes;
+        uint8_t *new_buffer = NULL;
+
+        pdebug(DEBUG_DETAIL, "Increasing tag buffer size to %d bytes.", new_size);
+
+        new_buffer = (uint8_t*)mem_realloc(tag->data, new_size);
+        if(!new_buffer) {
+            pdebug(DEBUG_WARN, "Unable to reallocate tag data memory!");
+            return PLCTAG_ERR_NO_MEM;
+        }
+
+        tag->data = new_buffer;
+        tag->elem_count = tag->size = new_size;
+    }
+
+    /* without filters, all the entries match. */
+    if(match_bytes == (int)(data_end - data)) {
+        mem_copy(tag->data + tag->offset, data, match_bytes);
+        tag->offset += match_bytes;
+    } else {
+        for(current_entry_data = data; current_entry_data < data_end; ) {
+            tag_list_entry *current_entry = (tag_list_entry*)current_entry_data;
+            int entry_size = (int)sizeof(*current_entry) + le2h16(current_entry->string_len);
+
+            if(listing_tag_entry_matches(tag, current_entry, current_entry_data + sizeof(*current_entry))) {
+                mem_copy(tag->data + tag->offset, current_entry_data, entry_size);
+                tag->offset += entry_size;
+            }
+
+            current_entry_data += entry_size;
+        }
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int listing_tag_entry_matches(ab_tag_p tag, tag_list_entry *entry, uint8_t *name)
+{
+    /* the array dimension bits are not part of the type filter. */
+    if(tag->listing_type >= 0 && (le2h16(entry->symbol_type) & 0x9FFF) != (tag->listing_type & 0x9FFF)) {
+        return 0;
+    }
+
+    if(tag->listing_prefix) {
+        int prefix_len = str_length(tag->listing_prefix);
+
+        if(le2h16(entry->string_len) < prefix_len || str_cmp_i_n((const char *)name, tag->listing_prefix, prefix_len) != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+
+/*
+ * Decode the matching entries of a page into one block with the names
+ * after the entry array and hand it to the listing callback.
+ */
+
+int listing_tag_stream_page(ab_tag_p tag, uint8_t *data, uint8_t *data_end, int num_matches, int name_bytes)
+{
+    plc_tag_listing_entry_t *entries = NULL;
+    char *names = NULL;
+    int index = 0;
+
+    if(num_matches == 0) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    entries = mem_alloc((int)(sizeof(*entries) * (size_t)num_matches) + name_bytes);
+    if(!entries) {
+        pdebug(DEBUG_WARN, "Unable to allocate memory for %d listing entries!", num_matches);
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    names = (char *)(entries + num_matches);
+
+    for(uint8_t *current_entry_data = data; current_entry_data < data_end && index < num_matches; ) {
+        tag_list_entry *current_entry = (tag_list_entry*)current_entry_data;
+        uint8_t *name = current_entry_data + sizeof(*current_entry);
+        int name_len = le2h16(current_entry->string_len);
+
+        if(listing_tag_entry_matches(tag, current_entry, name)) {
+            plc_tag_listing_entry_t *entry = &(entries[index]);
+
+            entry->instance_id = le2h32(current_entry->instance_id);
+            entry->symbol_type = le2h16(current_entry->symbol_type);
+            entry->elem_size = le2h16(current_entry->element_length);
+            entry->num_dimensions = (entry->symbol_type >> 13) & 0x03;
+
+            for(int dim = 0; dim < 3; dim++) {
+                entry->dimensions[dim] = le2h32(current_entry->array_dims[dim]);
+            }
+
+            mem_copy(names, name, name_len);
+            names[name_len] = 0;
+            entry->name = names;
+            names += name_len + 1;
+
+            index++;
+        }
+
+        current_entry_data += (int)sizeof(*current_entry) + name_len;
+    }
+
+    pdebug(DEBUG_DETAIL, "Passing %d listing entries to the callback.", num_matches);
+
+    tag->listing_callback(tag->tag_id, entries, num_matches, tag->listing_userdata);
+
+    mem_free(entries);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
 int listing_tag_build_read_request_connected(ab_tag_p tag)
 {
     eip_cip_co_req* cip = NULL;
@@ -1410,12 +1599,13 @@ int udt_tag_read_start(ab_tag_p tag)
     /* mark the tag read in progress */
     tag->read_in_progress = 1;
 
-    /* set up the state for the requests (there are two!) */
+    /* set up the state for the requests, the change counters come first. */
+    tag->udt_get_changes = 1;
     tag->udt_get_fields = 0;
     tag->offset = 0;
 
     /* build the new request */
-    rc = udt_tag_build_read_metadata_request_connected(tag);
+    rc = build_changes_request(tag, &(tag->req));
     if (rc != PLCTAG_STATUS_OK) {
         pdebug(DEBUG_WARN,"Unable to build read request!");
 
@@ -1444,7 +1634,9 @@ int udt_tag_tickler(ab_tag_p tag)
             tag->read_in_flight = 0;
         }
 
-        if(tag->udt_get_fields) {
+        if(tag->udt_get_changes) {
+            rc = udt_tag_check_read_changes_status_connected(tag);
+        } else if(tag->udt_get_fields) {
             rc = udt_tag_check_read_fields_status_connected(tag);
         } else {
             rc = udt_tag_check_read_metadata_status_connected(tag);
@@ -1578,6 +1770,8 @@ static int udt_tag_check_read_metadata_status_connected(ab_tag_p tag)
 
             pdebug(DEBUG_DETAIL, "Increasing tag buffer size to %d bytes.", new_size); /* MAGIC */
 
+            tag_data_change_begin((plc_tag_p)tag);
+
             new_buffer = (uint8_t*)mem_realloc(tag->data, new_size);
             if(!new_buffer) {
                 pdebug(DEBUG_WARN, "Unable to reallocate tag data memory!");
@@ -1644,10 +1838,18 @@ static int udt_tag_check_read_metadata_status_connected(ab_tag_p tag)
 
             tag->elem_count = 1;
             tag->offset = 0;
-            tag->udt_get_fields = 1;
 
-            pdebug(DEBUG_DETAIL, "calling udt_tag_build_read_fields_request_connected() to get field data.");
-            rc = udt_tag_build_read_fields_request_connected(tag);
+            /* the field data is usually already cached. */
+            if(udt_tag_get_cached_fields(tag) == PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_DETAIL, "Using cached field data.");
+
+                tag->read_in_progress = 0;
+            } else {
+                tag->udt_get_fields = 1;
+
+                pdebug(DEBUG_DETAIL, "calling udt_tag_build_read_fields_request_connected() to get field data.");
+                rc = udt_tag_build_read_fields_request_connected(tag);
+            }
         }
     }
 
@@ -1671,6 +1873,122 @@ static int udt_tag_check_read_metadata_status_connected(ab_tag_p tag)
 
 
 
+/*
+ * The controller change counters decide whether the cached template can
+ * be used without asking for the metadata.  A controller that cannot
+ * report them falls back to checking the metadata header.
+ */
+
+int udt_tag_check_read_changes_status_connected(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    uint8_t *changes = NULL;
+    int changes_size = 0;
+    uint8_t *data = NULL;
+    int data_size = 0;
+    ab_request_p request = NULL;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    /* guard against the request being deleted out from underneath us. */
+    request = rc_inc(tag->req);
+    rc = check_read_request_status(tag, request);
+    if(rc != PLCTAG_STATUS_OK)  {
+        pdebug(DEBUG_DETAIL, "Read request status is not OK.");
+        rc_dec(request);
+        return rc;
+    }
+
+    if(check_changes_reply(request, &changes, &changes_size) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_DETAIL, "No controller change counters, checking the template metadata instead.");
+        changes_size = 0;
+    }
+
+    if(tag->udt_changes) {
+        mem_free(tag->udt_changes);
+        tag->udt_changes = NULL;
+        tag->udt_changes_size = 0;
+    }
+
+    if(changes_size > 0) {
+        tag->udt_changes = mem_alloc(changes_size);
+        if(tag->udt_changes) {
+            mem_copy(tag->udt_changes, changes, changes_size);
+            tag->udt_changes_size = changes_size;
+        }
+    }
+
+    /* clean up the request */
+    request->abort_request = 1;
+    tag->req = rc_dec(request);
+
+    /* the second time for the reference taken above. */
+    rc_dec(request);
+
+    tag->udt_get_changes = 0;
+
+    if(tag->udt_changes_size > 0 && udt_cache_get(tag->udt_cache_file, tag->session->host, tag->session->path, tag->udt_id, tag->udt_changes, tag->udt_changes_size, NULL, &data, &data_size) == PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_DETAIL, "Controller unchanged, using the cached template.");
+
+        tag_data_change_begin((plc_tag_p)tag);
+
+        mem_free(tag->data);
+
+        tag->data = data;
+        tag->size = data_size;
+        tag->elem_size = data_size;
+        tag->elem_count = 1;
+
+        tag->read_in_progress = 0;
+
+        return PLCTAG_STATUS_OK;
+    }
+
+    rc = udt_tag_build_read_metadata_request_connected(tag);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to build the metadata request, error %s!", plc_tag_decode_error(rc));
+        ab_tag_abort(tag);
+        return rc;
+    }
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return PLCTAG_STATUS_PENDING;
+}
+
+
+
+/*
+ * Replace the tag buffer, which holds the header built from the metadata,
+ * with the cached header and fields if the cached header matches.
+ */
+
+int udt_tag_get_cached_fields(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    uint8_t *data = NULL;
+    int data_size = 0;
+
+    if(tag->size < UDT_CACHE_HEADER_SIZE) {
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    rc = udt_cache_get(tag->udt_cache_file, tag->session->host, tag->session->path, tag->udt_id, tag->udt_changes, tag->udt_changes_size, tag->data, &data, &data_size);
+    if(rc != PLCTAG_STATUS_OK) {
+        return rc;
+    }
+
+    mem_free(tag->data);
+
+    tag->data = data;
+    tag->size = data_size;
+    tag->elem_size = data_size;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
 int udt_tag_build_read_metadata_request_connected(ab_tag_p tag)
 {
     eip_cip_co_req* cip = NULL;
@@ -1894,6 +2212,8 @@ int udt_tag_check_read_fields_status_connected(ab_tag_p tag)
 
             pdebug(DEBUG_DETAIL, "Increasing tag buffer size to %d bytes.", new_size);
 
+            tag_data_change_begin((plc_tag_p)tag);
+
             new_buffer = (uint8_t*)mem_realloc(tag->data, new_size);
             if(!new_buffer) {
                 pdebug(DEBUG_WARN, "Unable to reallocate tag data memory!");
@@ -1946,6 +2266,9 @@ int udt_tag_check_read_fields_status_connected(ab_tag_p tag)
 
             tag->elem_count = 1;
 
+            /* failing to cache is not an error for the read. */
+            udt_cache_put(tag->udt_cache_file, tag->session->host, tag->session->path, tag->udt_id, tag->udt_changes, tag->udt_changes_size, tag->data, tag->size);
+
             /* this read is done. */
             tag->udt_get_fields = 0;
             tag->read_in_progress = 0;
@@ -2092,3 +2415,314 @@ int udt_tag_build_read_fields_request_connected(ab_tag_p tag)
 
     return PLCTAG_STATUS_OK;
 }
+
+
+
+
+
+
+
+
+
+/******************************************************************
+ ************ Controller change counter functions *****************
+ ******************************************************************/
+
+/*
+ * Logix controllers keep change counters in the controller object,
+ * class 0xAC instance 1.  They change when the symbol table or the
+ * templates change.  Reading them costs one small request, so a client
+ * can check them after reconnecting and skip its tag and UDT discovery
+ * when nothing changed.
+ *
+ * The tag data is the Get Attribute List reply as the controller sends
+ * it:
+ *
+ * Bytes   Meaning
+ * 0-1     16-bit number of attributes.
+ * then for each attribute:
+ *         16-bit attribute ID (1, 2, 3, 4 and 10 are requested).
+ *         16-bit attribute status, zero if the value follows.
+ *         the attribute value.
+ *
+ * The values only need to be compared with a saved copy, so the tag
+ * does not decode them.
+ */
+
+int setup_changes_tag(ab_tag_p tag)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    tag->special_tag = 1;
+    tag->elem_type = AB_TYPE_TAG_RAW;
+    tag->elem_count = 1;
+    tag->elem_size = 1;
+
+    tag->byte_order = &udt_tag_logix_byte_order;
+
+    tag->vtable = &changes_tag_vtable;
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int changes_tag_read_start(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting");
+
+    if(tag->read_in_progress) {
+        pdebug(DEBUG_WARN, "Read operation already in flight!");
+        return PLCTAG_ERR_BUSY;
+    }
+
+    /* mark the tag read in progress */
+    tag->read_in_progress = 1;
+
+    /* build the new request */
+    rc = changes_tag_build_read_request_connected(tag);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN,"Unable to build read request!");
+
+        tag->read_in_progress = 0;
+
+        return rc;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return PLCTAG_STATUS_PENDING;
+}
+
+
+
+int changes_tag_tickler(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_SPEW,"Starting.");
+
+    if (tag->read_in_progress) {
+        rc = changes_tag_check_read_status_connected(tag);
+
+        tag->status = (int8_t)rc;
+
+        /* if the operation completed, make a note so that the callback will be called. */
+        if(!tag->read_in_progress) {
+            pdebug(DEBUG_DETAIL, "Read complete.");
+            tag->read_complete = 1;
+        }
+
+        pdebug(DEBUG_SPEW,"Done.  Read in progress.");
+
+        return rc;
+    }
+
+    pdebug(DEBUG_SPEW, "Done.  No operation in progress.");
+
+    return tag->status;
+}
+
+
+
+int changes_tag_check_read_status_connected(ab_tag_p tag)
+{
+    int rc = PLCTAG_STATUS_OK;
+    uint8_t *data = NULL;
+    int payload_size = 0;
+    ab_request_p request = NULL;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    /* guard against the request being deleted out from underneath us. */
+    request = rc_inc(tag->req);
+    rc = check_read_request_status(tag, request);
+    if(rc != PLCTAG_STATUS_OK)  {
+        pdebug(DEBUG_DETAIL, "Read request status is not OK.");
+        rc_dec(request);
+        return rc;
+    }
+
+    do {
+        rc = check_changes_reply(request, &data, &payload_size);
+        if(rc != PLCTAG_STATUS_OK) {
+            break;
+        }
+
+        tag_data_change_begin((plc_tag_p)tag);
+
+        if(payload_size != tag->size) {
+            uint8_t *new_buffer = (uint8_t*)mem_realloc(tag->data, payload_size);
+
+            if(!new_buffer) {
+                pdebug(DEBUG_WARN, "Unable to reallocate tag data memory!");
+                rc = PLCTAG_ERR_NO_MEM;
+                break;
+            }
+
+            tag->data = new_buffer;
+            tag->size = payload_size;
+            tag->elem_size = payload_size;
+        }
+
+        mem_copy(tag->data, data, payload_size);
+
+        pdebug(DEBUG_DETAIL, "Controller change counters:");
+        pdebug_dump_bytes(DEBUG_DETAIL, tag->data, tag->size);
+
+        rc = PLCTAG_STATUS_OK;
+    } while(0);
+
+    /* clean up the request */
+    request->abort_request = 1;
+    tag->req = rc_dec(request);
+
+    /* the second time for the reference taken above. */
+    rc_dec(request);
+
+    if(rc == PLCTAG_STATUS_OK) {
+        tag->read_in_progress = 0;
+    } else {
+        pdebug(DEBUG_WARN, "Error received: %s!", plc_tag_decode_error(rc));
+
+        /* clean up everything. */
+        ab_tag_abort(tag);
+    }
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return rc;
+}
+
+
+
+int changes_tag_build_read_request_connected(ab_tag_p tag)
+{
+    return build_changes_request(tag, &(tag->req));
+}
+
+
+
+/*
+ * Queue a request for the controller change counters.  The symbol
+ * instance table uses this too, so the request is returned instead of
+ * being stored in the tag.
+ */
+
+int build_changes_request(ab_tag_p tag, ab_request_p *req_out)
+{
+    eip_cip_co_req* cip = NULL;
+    ab_request_p req = NULL;
+    int rc = PLCTAG_STATUS_OK;
+    uint8_t *data_start = NULL;
+    uint8_t *data = NULL;
+    uint16_le tmp_u16 = UINT16_LE_INIT(0);
+    const uint16_t attribs[] = { 0x01, 0x02, 0x03, 0x04, 0x0A };
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    rc = session_create_request(tag->session, tag->tag_id, &req);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to get new request.  rc=%d", rc);
+        return rc;
+    }
+
+    cip = (eip_cip_co_req*)(req->data);
+    data_start = data = (uint8_t*)(cip + 1);
+
+    *data = AB_EIP_CMD_CIP_GET_ATTR_LIST;
+    data++;
+
+    /* request path size, in 16-bit words */
+    *data = (uint8_t)(2);
+    data++;
+
+    data[0] = 0x20; /* class type */
+    data[1] = 0xAC; /* controller class */
+    data[2] = 0x24; /* 8-bit instance ID type */
+    data[3] = 0x01; /* instance 1 */
+    data += 4;
+
+    tmp_u16 = h2le16((uint16_t)(sizeof(attribs)/sizeof(attribs[0])));
+    mem_copy(data, &tmp_u16, (int)sizeof(tmp_u16));
+    data += (int)sizeof(tmp_u16);
+
+    for(size_t i=0; i < sizeof(attribs)/sizeof(attribs[0]); i++) {
+        tmp_u16 = h2le16(attribs[i]);
+        mem_copy(data, &tmp_u16, (int)sizeof(tmp_u16));
+        data += (int)sizeof(tmp_u16);
+    }
+
+    cip->encap_command = h2le16(AB_EIP_CONNECTED_SEND);
+    cip->router_timeout = h2le16(1);
+    cip->cpf_item_count = h2le16(2);
+    cip->cpf_cai_item_type = h2le16(AB_EIP_ITEM_CAI);
+    cip->cpf_cai_item_length = h2le16(4);
+    cip->cpf_cdi_item_type = h2le16(AB_EIP_ITEM_CDI);
+    cip->cpf_cdi_item_length = h2le16((uint16_t)((int)(data - data_start) + (int)sizeof(cip->cpf_conn_seq_num)));
+
+    req->request_size = (int)((int)sizeof(*cip) + (int)(data - data_start));
+    req->allow_packing = tag->allow_packing;
+
+    rc = session_add_request(tag->session, req);
+    if (rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to add request to session! rc=%d", rc);
+        *req_out = rc_dec(req);
+        return rc;
+    }
+
+    *req_out = req;
+
+    pdebug(DEBUG_INFO, "Done");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * Check the reply to a change counter request and find the attribute
+ * list in it.
+ */
+
+int check_changes_reply(ab_request_p request, uint8_t **payload, int *payload_size)
+{
+    eip_cip_co_resp* cip_resp = (eip_cip_co_resp*)(request->data);
+    uint8_t* data = (request->data) + sizeof(eip_cip_co_resp);
+    uint8_t* data_end = (request->data + le2h16(cip_resp->encap_length) + sizeof(eip_encap));
+
+    if (le2h16(cip_resp->encap_command) != AB_EIP_CONNECTED_SEND) {
+        pdebug(DEBUG_WARN, "Unexpected EIP packet type received: %d!", cip_resp->encap_command);
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    if (le2h32(cip_resp->encap_status) != AB_EIP_OK) {
+        pdebug(DEBUG_WARN, "EIP command failed, response code: %d", le2h32(cip_resp->encap_status));
+        return PLCTAG_ERR_REMOTE_ERR;
+    }
+
+    if (cip_resp->reply_service != (AB_EIP_CMD_CIP_GET_ATTR_LIST | AB_EIP_CMD_CIP_OK) ) {
+        pdebug(DEBUG_WARN, "CIP response reply service unexpected: %d", cip_resp->reply_service);
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    if (cip_resp->status != AB_CIP_STATUS_OK) {
+        pdebug(DEBUG_WARN, "CIP read failed with status: 0x%x %s", cip_resp->status, decode_cip_error_short((uint8_t *)&cip_resp->status));
+        pdebug(DEBUG_INFO, decode_cip_error_long((uint8_t *)&cip_resp->status));
+        return decode_cip_error_code((uint8_t *)&cip_resp->status);
+    }
+
+    if((data_end - data) < 2) {
+        pdebug(DEBUG_WARN, "Controller change counter reply is too short!");
+        return PLCTAG_ERR_TOO_SMALL;
+    }
+
+    *payload = data;
+    *payload_size = (int)(data_end - data);
+
+    return PLCTAG_STATUS_OK;
+}
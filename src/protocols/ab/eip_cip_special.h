@@ -44,4 +44,9 @@ extern tag_byte_order_t listing_tag_logix_byte_order;
 extern int setup_raw_tag(ab_tag_p tag);
 extern int setup_tag_listing_tag(ab_tag_p tag, const char *name);
 extern int setup_udt_tag(ab_tag_p tag, const char *name);
+extern int setup_changes_tag(ab_tag_p tag);
+
+/* controller change counter requests, shared with the symbol instance table. */
+extern int build_changes_request(ab_tag_p tag, ab_request_p *req_out);
+extern int check_changes_reply(ab_request_p request, uint8_t **payload, int *payload_size);
 
@@ -84,7 +84,11 @@ struct tag_vtable_t lgx_pccc_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
     
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 static int check_read_status(ab_tag_p tag);
@@ -462,6 +466,7 @@ static int check_read_status(ab_tag_p tag)
          * the user has set, possibly.
          */
         if(!tag->pre_write_read) {
+            tag_data_change_begin((plc_tag_p)tag);
             mem_copy(tag->data, data, (int)(data_end - data));
         }
 
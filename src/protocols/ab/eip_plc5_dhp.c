@@ -65,7 +65,11 @@ struct tag_vtable_t eip_plc5_dhp_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
     
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 
@@ -323,7 +327,7 @@ int tag_read_start(ab_tag_p tag)
     /* PCCC Command */
     pccc->pccc_command = AB_EIP_PCCC_TYPED_CMD;
     pccc->pccc_status = 0;  /* STS 0 in request */
-    pccc->pccc_seq_num = /*h2le16(conn_seq_id)*/ h2le16((uint16_t)(intptr_t)(tag->session));
+    pccc->pccc_seq_num = h2le16((uint16_t)session_get_new_seq_id(tag->session)); /* unique, DH+ requests can be pipelined. */
     pccc->pccc_function = AB_EIP_PLC5_RANGE_READ_FUNC;
     //pccc->pccc_transfer_offset = h2le16((uint16_t)0);
     //pccc->pccc_transfer_size = h2le16((uint16_t)((tag->size)/2));  /* size in 2-byte words */
@@ -615,6 +619,7 @@ static int check_read_status(ab_tag_p tag)
         }
 
         /* copy data into the tag. */
+        tag_data_change_begin((plc_tag_p)tag);
         mem_copy(tag->data, data, (int)(data_end - data));
 
         rc = PLCTAG_STATUS_OK;
@@ -60,7 +60,11 @@ struct tag_vtable_t plc5_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
     
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 
@@ -434,6 +438,7 @@ static int check_read_status(ab_tag_p tag)
         }
 
         /* copy data into the tag. */
+        tag_data_change_begin((plc_tag_p)tag);
         mem_copy(tag->data, data, (int)(data_end - data));
 
         rc = PLCTAG_STATUS_OK;
@@ -59,7 +59,11 @@ struct tag_vtable_t slc_vtable = {
     ab_get_int_attrib,
     ab_set_int_attrib,
     
-    ab_get_byte_array_attrib
+    ab_get_byte_array_attrib,
+
+    /* transaction batching */
+    (tag_vtable_func)ab_tag_batch_hold,
+    ab_tag_batch_release
 };
 
 
@@ -321,6 +325,17 @@ int tag_read_start(ab_tag_p tag)
     /* set the size of the request */
     req->request_size = (int)(data - (req->data));
 
+    /* reads of whole elements can be merged with other reads of the same data file. */
+    if(tag->pccc_addr.sub_element < 0 && tag->pccc_addr.file_type != PCCC_FILE_UNKNOWN) {
+        req->pccc_merge = 1;
+        req->pccc_file_type = (int)tag->pccc_addr.file_type;
+        req->pccc_file_num = tag->pccc_addr.file;
+        req->pccc_element = tag->pccc_addr.element;
+        req->pccc_elem_size = tag->elem_size;
+        req->pccc_elem_count = tag->elem_count;
+        req->pccc_size_offset = (int)((uint8_t *)(&pccc->pccc_transfer_size) - req->data);
+    }
+
     /* mark it as ready to send */
     //req->send_request = 1;
 
@@ -429,6 +444,7 @@ static int check_read_status(ab_tag_p tag)
         }
 
         /* copy data into the tag. */
+        tag_data_change_begin((plc_tag_p)tag);
         mem_copy(tag->data, data, (int)(data_end - data));
 
         rc = PLCTAG_STATUS_OK;
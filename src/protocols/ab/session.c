@@ -40,6 +40,8 @@
 #include <ab/tag.h>
 #include <util/atomic_int.h>
 #include <util/debug.h>
+#include <util/hash.h>
+#include <util/hashtable.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
@@ -66,6 +68,9 @@
 #define MAX_CIP_MLGX_MSG_SIZE (244)
 #define MAX_CIP_LGX_PCCC_MSG_SIZE (244)
 
+/* PCCC command, status and sequence number in front of the data in a read response. */
+#define PCCC_READ_RESP_OVERHEAD (4)
+
 /*
  * Number of milliseconds to wait to try to set up the session again
  * after a failure.
@@ -97,6 +102,7 @@ static int add_session_unsafe(ab_session_p n);
 static int remove_session_unsafe(ab_session_p n);
 static ab_session_p find_session_by_host_unsafe(const char *gateway, const char *path, int connection_group_id);
 static int session_match_valid(const char *host, const char *path, ab_session_p session);
+static int64_t session_index_key(const char *host, const char *path, int connection_group_id);
 static int session_add_request_unsafe(ab_session_p sess, ab_request_p req);
 static int session_open_socket(ab_session_p session);
 static void session_destroy(void *session);
@@ -106,8 +112,35 @@ static int session_unregister(ab_session_p session);
 static THREAD_FUNC(session_handler);
 static int purge_aborted_requests_unsafe(ab_session_p session);
 static int process_requests(ab_session_p session);
+static int process_pipelined_requests(ab_session_p session);
+static int can_pipeline_next_request_unsafe(ab_session_p session);
+static void wake_session_thread_unsafe(ab_session_p session);
+static int wait_for_response_or_request(ab_session_p session);
+static void fail_requests_in_flight(ab_session_p session, int status);
 //static int check_packing(ab_session_p session, ab_request_p request);
 static int get_payload_size(ab_request_p request);
+static int get_batch_payload_size_unsafe(ab_session_p session);
+
+/* sort key for a queued write and its place in the queue. */
+struct cip_write_pos {
+    ab_request_p request;
+    int pos;
+};
+
+static void merge_cip_writes_unsafe(ab_session_p session, int max_payload_size);
+static int merge_cip_write_run_unsafe(ab_session_p session, int start, int end, int max_payload_size);
+static int compare_cip_writes(const void *a, const void *b);
+static int cip_write_group_keeps_order(struct cip_write_pos *writes, int num_writes, int first, int last);
+static int different_cip_root_symbols(ab_request_p a, ab_request_p b);
+static int get_cip_root_symbol(ab_request_p request, uint8_t **name);
+static int same_cip_write_name(ab_request_p a, ab_request_p b);
+static int same_cip_write_target(ab_request_p a, ab_request_p b);
+static ab_request_p build_merged_cip_write(ab_request_p *requests, int num_requests, int capacity);
+static void complete_merged_cip_write(ab_request_p request);
+static int merge_pccc_reads_unsafe(ab_session_p session, ab_request_p *requests, int max_payload_size);
+static void get_pccc_read_range(ab_request_p *requests, int num_requests, int *start, int *end);
+static int pack_pccc_reads(ab_session_p session, ab_request_p *requests, int num_requests);
+static int unpack_pccc_reads(ab_session_p session, ab_request_p *requests, int num_requests);
 static int pack_requests(ab_session_p session, ab_request_p *requests, int num_requests);
 static int prepare_request(ab_session_p session);
 static int send_eip_request(ab_session_p session, int timeout);
@@ -128,10 +161,13 @@ static int send_extended_forward_open_request(ab_session_p session);
 static int receive_forward_open_response(ab_session_p session);
 static void request_destroy(void *req_arg);
 static int session_request_increase_buffer(ab_request_p request, int new_capacity);
+static void session_symbols_clear_unsafe(ab_session_p session);
+static int session_symbols_free_entry(hashtable_p table, int64_t key, void *data, void *context);
 
 
 static volatile mutex_p session_mutex = NULL;
 static volatile vector_p sessions = NULL;
+static volatile hashtable_p session_index = NULL;
 static atomic_int library_shutting_down = ATOMIC_INT_STATIC_INIT;
 
 
@@ -153,6 +189,11 @@ int session_startup()
         return PLCTAG_ERR_NO_MEM;
     }
 
+    if((session_index = hashtable_create(32)) == NULL) {
+        pdebug(DEBUG_ERROR, "Unable to create session index!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
     return rc;
 }
 
@@ -214,6 +255,11 @@ void session_teardown()
         sessions = NULL;
     }
 
+    if(session_index) {
+        hashtable_destroy(session_index);
+        session_index = NULL;
+    }
+
     pdebug(DEBUG_DETAIL, "Destroying session mutex.");
 
     if(session_mutex) {
@@ -286,6 +332,318 @@ int session_get_max_payload(ab_session_p session)
     return result;
 }
 
+/*
+ * Symbol instance table.
+ *
+ * Tags that use symbol instance addressing look up the instance ID of their
+ * base symbol here.  The table is filled once per session by one tag that
+ * walks the controller symbol list.  Every other tag waits until the table
+ * is loaded.  If an instance turns out to be stale, the table is thrown
+ * away and loaded again.  The generation number keeps a tag from clearing
+ * a table that has already been reloaded.
+ *
+ * Instances are renumbered when the controller project changes, so the
+ * loader reads the controller change counters before walking the symbols.
+ * A tag only reads by instance while a check of those counters is recent,
+ * see session_symbols_current().  If the counters moved, or the session
+ * reconnects, the table is thrown away.
+ *
+ * Entries are chained per name hash.  All of this is protected by the
+ * session mutex.
+ */
+
+struct ab_symbol_t {
+    struct ab_symbol_t *next;
+    uint32_t instance;
+    int name_len;
+    char name[];
+};
+
+typedef struct ab_symbol_t *ab_symbol_p;
+
+
+int session_symbols_lookup(ab_session_p session, int32_t tag_id, const char *name, uint32_t *instance, int *generation, int *must_load)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int name_len = str_length(name);
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    *must_load = 0;
+
+    critical_block(session->mutex) {
+        *generation = session->symbols_generation;
+
+        switch(session->symbols_state) {
+            case SESSION_SYMBOLS_EMPTY:
+                /* nobody has loaded the table, the caller gets to do it. */
+                session->symbols_state = SESSION_SYMBOLS_LOADING;
+                session->symbols_loader_id = tag_id;
+                *must_load = 1;
+                rc = PLCTAG_STATUS_PENDING;
+                break;
+
+            case SESSION_SYMBOLS_LOADING:
+                rc = PLCTAG_STATUS_PENDING;
+                break;
+
+            case SESSION_SYMBOLS_LOADED:
+                rc = PLCTAG_ERR_NOT_FOUND;
+
+                for(ab_symbol_p entry = hashtable_get(session->symbols, (int64_t)hash_str_i(name, 0)); entry; entry = entry->next) {
+                    if(entry->name_len == name_len && str_cmp_i_n(entry->name, name, name_len) == 0) {
+                        *instance = entry->instance;
+                        rc = PLCTAG_STATUS_OK;
+                        break;
+                    }
+                }
+                break;
+
+            default:
+                /* loading failed, the PLC probably does not support listing. */
+                rc = PLCTAG_ERR_NOT_FOUND;
+                break;
+        }
+    }
+
+    pdebug(DEBUG_SPEW, "Done with status %s.", plc_tag_decode_error(rc));
+
+    return rc;
+}
+
+
+
+int session_symbols_add(ab_session_p session, int32_t tag_id, const char *name, int name_len, uint32_t instance)
+{
+    int rc = PLCTAG_STATUS_OK;
+    ab_symbol_p entry = NULL;
+    int64_t key = 0;
+
+    if(name_len <= 0) {
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    entry = mem_alloc((int)sizeof(*entry) + name_len + 1);
+    if(!entry) {
+        pdebug(DEBUG_WARN, "Unable to allocate symbol entry!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    entry->instance = instance;
+    entry->name_len = name_len;
+    mem_copy(entry->name, (void *)name, name_len);
+    entry->name[name_len] = 0;
+
+    key = (int64_t)hash_str_i(entry->name, 0);
+
+    critical_block(session->mutex) {
+        /* only the loader adds entries. */
+        if(session->symbols_state != SESSION_SYMBOLS_LOADING || session->symbols_loader_id != tag_id) {
+            rc = PLCTAG_ERR_BAD_STATUS;
+            break;
+        }
+
+        if(!session->symbols) {
+            session->symbols = hashtable_create(256);
+            if(!session->symbols) {
+                rc = PLCTAG_ERR_NO_MEM;
+                break;
+            }
+        }
+
+        entry->next = hashtable_get(session->symbols, key);
+        rc = hashtable_put(session->symbols, key, entry);
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        mem_free(entry);
+    }
+
+    return rc;
+}
+
+
+
+void session_symbols_load_done(ab_session_p session, int32_t tag_id, int status)
+{
+    critical_block(session->mutex) {
+        if(session->symbols_state != SESSION_SYMBOLS_LOADING || session->symbols_loader_id != tag_id) {
+            break;
+        }
+
+        if(status == PLCTAG_STATUS_OK && !session->symbols_changes) {
+            pdebug(DEBUG_WARN, "Symbol table loaded without change counters!");
+            session_symbols_clear_unsafe(session);
+            session->symbols_state = SESSION_SYMBOLS_FAILED;
+        } else if(status == PLCTAG_STATUS_OK) {
+            /* the counters were read before the walk, check them again before trusting it. */
+            session->symbols_state = SESSION_SYMBOLS_LOADED;
+            session->symbols_checked_until_us = 0;
+        } else if(status == PLCTAG_ERR_ABORT) {
+            /* the loader went away, let another tag try. */
+            session_symbols_clear_unsafe(session);
+            session->symbols_state = SESSION_SYMBOLS_EMPTY;
+        } else {
+            session_symbols_clear_unsafe(session);
+            session->symbols_state = SESSION_SYMBOLS_FAILED;
+        }
+
+        session->symbols_loader_id = 0;
+    }
+
+    pdebug(DEBUG_DETAIL, "Symbol table load finished with status %s.", plc_tag_decode_error(status));
+}
+
+
+
+void session_symbols_invalidate(ab_session_p session, int generation)
+{
+    critical_block(session->mutex) {
+        /* someone else already threw this table away. */
+        if(session->symbols_generation != generation) {
+            break;
+        }
+
+        session_symbols_clear_unsafe(session);
+
+        session->symbols_state = SESSION_SYMBOLS_EMPTY;
+        session->symbols_loader_id = 0;
+        session->symbols_generation++;
+    }
+
+    pdebug(DEBUG_INFO, "Symbol table generation %d invalidated.", generation);
+}
+
+
+
+/*
+ * Check whether a tag can read by the instance it resolved.  That is only
+ * the case while the table of its generation is loaded and the change
+ * counters were checked less than SESSION_SYMBOLS_CHECK_MS ago.
+ *
+ * Returns PLCTAG_STATUS_PENDING while a check is due.  If nobody is
+ * checking, the caller is told to do it with must_check.  Returns
+ * PLCTAG_ERR_BAD_STATUS when the table the tag resolved against is gone.
+ */
+
+int session_symbols_current(ab_session_p session, int32_t tag_id, int generation, int *must_check)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    *must_check = 0;
+
+    critical_block(session->mutex) {
+        if(session->symbols_generation != generation || session->symbols_state != SESSION_SYMBOLS_LOADED) {
+            rc = PLCTAG_ERR_BAD_STATUS;
+            break;
+        }
+
+        if(time_monotonic_us() < session->symbols_checked_until_us) {
+            rc = PLCTAG_STATUS_OK;
+            break;
+        }
+
+        if(!session->symbols_checker_id) {
+            session->symbols_checker_id = tag_id;
+            *must_check = 1;
+        }
+
+        rc = PLCTAG_STATUS_PENDING;
+    }
+
+    return rc;
+}
+
+
+
+/*
+ * The loader saves the change counters before it walks the symbols.
+ */
+
+int session_symbols_set_changes(ab_session_p session, int32_t tag_id, const uint8_t *changes, int changes_size)
+{
+    int rc = PLCTAG_STATUS_OK;
+    uint8_t *copy = NULL;
+
+    if(!changes || changes_size <= 0) {
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    copy = mem_alloc(changes_size);
+    if(!copy) {
+        pdebug(DEBUG_WARN, "Unable to allocate memory for the change counters!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    mem_copy(copy, (void *)changes, changes_size);
+
+    critical_block(session->mutex) {
+        if(session->symbols_state != SESSION_SYMBOLS_LOADING || session->symbols_loader_id != tag_id) {
+            rc = PLCTAG_ERR_BAD_STATUS;
+            break;
+        }
+
+        if(session->symbols_changes) {
+            mem_free(session->symbols_changes);
+        }
+
+        session->symbols_changes = copy;
+        session->symbols_changes_size = changes_size;
+        copy = NULL;
+    }
+
+    if(copy) {
+        mem_free(copy);
+    }
+
+    return rc;
+}
+
+
+
+/*
+ * Compare the change counters a tag just read with the ones the table was
+ * loaded under.  If they moved, the table is thrown away.  If they cannot
+ * be read, nothing vouches for the instances and every tag stays symbolic.
+ */
+
+void session_symbols_check_done(ab_session_p session, int32_t tag_id, int status, const uint8_t *changes, int changes_size)
+{
+    critical_block(session->mutex) {
+        if(session->symbols_checker_id != tag_id) {
+            break;
+        }
+
+        session->symbols_checker_id = 0;
+
+        if(status == PLCTAG_ERR_ABORT || session->symbols_state != SESSION_SYMBOLS_LOADED) {
+            /* the checker went away, let another tag try. */
+            break;
+        }
+
+        if(status != PLCTAG_STATUS_OK) {
+            pdebug(DEBUG_WARN, "Unable to check the controller change counters, error %s!", plc_tag_decode_error(status));
+            session_symbols_clear_unsafe(session);
+            session->symbols_state = SESSION_SYMBOLS_FAILED;
+            session->symbols_generation++;
+            break;
+        }
+
+        if(changes_size != session->symbols_changes_size || mem_cmp((void *)changes, changes_size, session->symbols_changes, session->symbols_changes_size)) {
+            pdebug(DEBUG_INFO, "Controller change counters moved, throwing away the symbol table.");
+            session_symbols_clear_unsafe(session);
+            session->symbols_state = SESSION_SYMBOLS_EMPTY;
+            session->symbols_loader_id = 0;
+            session->symbols_generation++;
+            break;
+        }
+
+        session->symbols_checked_until_us = time_monotonic_us() + (SESSION_SYMBOLS_CHECK_MS * 1000);
+    }
+}
+
+
+
 int session_find_or_create(ab_session_p *tag_session, attr attribs)
 {
     /*int debug = attr_get_int(attribs,"debug",0);*/
@@ -302,9 +660,15 @@ int session_find_or_create(ab_session_p *tag_session, attr attribs)
     int auto_disconnect_timeout_ms = INT_MAX;
     int connection_group_id = attr_get_int(attribs, "connection_group_id", 0);
     int only_use_old_forward_open = attr_get_int(attribs, "conn_only_use_old_forward_open", 0);
+    int dhp_max_requests_in_flight = attr_get_int(attribs, "dhp_max_requests_in_flight", 1);
 
     pdebug(DEBUG_DETAIL, "Starting");
 
+    if(dhp_max_requests_in_flight < 1 || dhp_max_requests_in_flight > MAX_DHP_REQUESTS_IN_FLIGHT) {
+        pdebug(DEBUG_WARN, "DH+ requests in flight must be between 1 and %d, not %d!", MAX_DHP_REQUESTS_IN_FLIGHT, dhp_max_requests_in_flight);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
     auto_disconnect_timeout_ms = attr_get_int(attribs, "auto_disconnect_ms", INT_MAX);
     if(auto_disconnect_timeout_ms != INT_MAX) {
         pdebug(DEBUG_DETAIL, "Setting auto-disconnect after %dms.", auto_disconnect_timeout_ms);
@@ -376,6 +740,11 @@ int session_find_or_create(ab_session_p *tag_session, attr attribs)
                 pdebug(DEBUG_DETAIL, "Existing attribute to prohibit use of extended ForwardOpen is %d.", session->only_use_old_forward_open);
                 session->only_use_old_forward_open = (session->only_use_old_forward_open ? 1 : only_use_old_forward_open);
 
+                /* only DH+ bridged sessions have more than one request outstanding. */
+                if(session->is_dhp) {
+                    session->max_requests_in_flight = dhp_max_requests_in_flight;
+                }
+
                 new_session = 1;
             }
         } else {
@@ -384,6 +753,11 @@ int session_find_or_create(ab_session_p *tag_session, attr attribs)
                 session->auto_disconnect_enabled = auto_disconnect_enabled;
             }
 
+            /* the number of DH+ requests in flight only goes up. */
+            if(session->is_dhp && session->max_requests_in_flight < dhp_max_requests_in_flight) {
+                session->max_requests_in_flight = dhp_max_requests_in_flight;
+            }
+
             /* disconnect period always goes down. */
             if(session->auto_disconnect_enabled && session->auto_disconnect_timeout_ms > auto_disconnect_timeout_ms) {
                 session->auto_disconnect_timeout_ms = auto_disconnect_timeout_ms;
@@ -430,6 +804,14 @@ int add_session_unsafe(ab_session_p session)
 
     vector_put(sessions, vector_length(sessions), session);
 
+    /* push the session on the front of the chain for its key. */
+    session->index_key = session_index_key(session->host, session->path, session->connection_group_id);
+    session->index_next = hashtable_get(session_index, session->index_key);
+    if(hashtable_put(session_index, session->index_key, session) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to index session, it will not be shared!");
+        session->index_next = NULL;
+    }
+
     session->on_list = 1;
 
     pdebug(DEBUG_DETAIL, "Done");
@@ -474,6 +856,28 @@ int remove_session_unsafe(ab_session_p session)
         }
     }
 
+    /* unlink the session from its index chain. */
+    if(session_index) {
+        ab_session_p head = hashtable_get(session_index, session->index_key);
+
+        if(head == session) {
+            if(session->index_next) {
+                hashtable_put(session_index, session->index_key, session->index_next);
+            } else {
+                hashtable_remove(session_index, session->index_key);
+            }
+        } else {
+            for(ab_session_p tmp = head; tmp; tmp = tmp->index_next) {
+                if(tmp->index_next == session) {
+                    tmp->index_next = session->index_next;
+                    break;
+                }
+            }
+        }
+
+        session->index_next = NULL;
+    }
+
     pdebug(DEBUG_DETAIL, "Done");
 
     return PLCTAG_STATUS_OK;
@@ -530,13 +934,35 @@ int session_match_valid(const char *host, const char *path, ab_session_p session
 }
 
 
+/*
+ * Build the index key for a session.  Host and path are compared without
+ * regard to case, so they are hashed the same way.  Different hosts can
+ * share a key, so the index holds a chain of sessions per key and every
+ * candidate is still checked with session_match_valid().
+ */
+
+int64_t session_index_key(const char *host, const char *path, int connection_group_id)
+{
+    uint32_t host_hash = hash_str_i(host, (uint32_t)connection_group_id);
+    uint32_t path_hash = hash_str_i(path, host_hash);
+
+    return (int64_t)(((uint64_t)host_hash << 32) | (uint64_t)path_hash);
+}
+
+
 ab_session_p find_session_by_host_unsafe(const char *host, const char *path, int connection_group_id)
 {
-    for(int i=0; i < vector_length(sessions); i++) {
-        ab_session_p session = vector_get(sessions, i);
+    ab_session_p chain = NULL;
+
+    if(!session_index) {
+        return NULL;
+    }
 
+    chain = hashtable_get(session_index, session_index_key(host, path, connection_group_id));
+
+    for(; chain; chain = chain->index_next) {
         /* is this session in the process of destruction? */
-        session = rc_inc(session);
+        ab_session_p session = rc_inc(chain);
         if(session) {
             if(session->connection_group_id == connection_group_id && session_match_valid(host, path, session)) {
                 return session;
@@ -867,6 +1293,8 @@ ab_session_p session_create_unsafe(int max_payload_capacity, bool data_buffer_is
     pdebug(DEBUG_DETAIL, "Setting connection_group_id to %d.", connection_group_id);
     session->connection_group_id = connection_group_id;
 
+    metrics_register_session(&(session->metrics), session->host, session->path, connection_group_id);
+
     /*
      * Why is connection_id global?  Because it looks like the PLC might
      * be treating it globally.  I am seeing ForwardOpen errors that seem
@@ -983,6 +1411,8 @@ int session_open_socket(ab_session_p session)
         return rc;
     }
 
+    capture_conn_open(&(session->capture), port);
+
     if(server_port) {
         mem_free(server_port);
     }
@@ -1120,6 +1550,9 @@ void session_destroy(void *session_arg)
     /* so remove the session from the list so no one else can reference it. */
     remove_session(session);
 
+    /* the metrics point at our host and path strings. */
+    metrics_unregister_session(&(session->metrics));
+
     pdebug(DEBUG_INFO, "Session sent %" PRId64 " packets.", session->packet_count);
 
     /* terminate the session thread first. */
@@ -1167,10 +1600,16 @@ void session_destroy(void *session_arg)
             session_close_socket(session);
         }
 
+        /* release any DH+ requests that never got a response. */
+        fail_requests_in_flight(session, PLCTAG_ERR_ABORT);
+
         /* release all the requests that are in the queue. */
         if (session->requests) {
             for (int i = 0; i < vector_length(session->requests); i++) {
-                rc_dec(vector_get(session->requests, i));
+                ab_request_p request = vector_get(session->requests, i);
+
+                complete_merged_cip_write(request);
+                rc_dec(request);
             }
 
             vector_destroy(session->requests);
@@ -1196,6 +1635,8 @@ void session_destroy(void *session_arg)
         mem_free(session->data);
     }
 
+    session_symbols_clear_unsafe(session);
+
     /* these are all allocated in one large block. */
 
     // pdebug(DEBUG_DETAIL, "Cleaning up allocated memory for paths and host name.");
@@ -1247,9 +1688,17 @@ int session_add_request_unsafe(ab_session_p session, ab_request_p req)
 
     /* make sure the request points to the session */
 
+    /* note when the request was queued for the queue wait statistics. */
+    req->time_queued_us = time_monotonic_us();
+    metrics_session_add(&(session->metrics), requests_queued, 1);
+
     /* insert into the requests vector */
     vector_put(session->requests, vector_length(session->requests), req);
 
+    if(req->cip_write_merge) {
+        session->cip_write_merge_pending = 1;
+    }
+
     pdebug(DEBUG_DETAIL, "Total requests in the queue: %d", vector_length(session->requests));
 
     pdebug(DEBUG_DETAIL, "Done.");
@@ -1270,6 +1719,7 @@ int session_add_request(ab_session_p sess, ab_request_p req)
 
     critical_block(sess->mutex) {
         rc = session_add_request_unsafe(sess, req);
+        wake_session_thread_unsafe(sess);
     }
 
     cond_signal(sess->wait_cond);
@@ -1281,50 +1731,164 @@ int session_add_request(ab_session_p sess, ab_request_p req)
 
 
 /*
- * session_remove_request_unsafe
+ * session_batch_hold
  *
- * You must hold the mutex before calling this!
+ * Stop the session thread from sending anything until session_batch_release()
+ * is called the same number of times.  This lets a transaction queue all of
+ * its requests before any of them are packed.
  */
-int session_remove_request_unsafe(ab_session_p session, ab_request_p req)
+int session_batch_hold(ab_session_p session)
 {
-    int rc = PLCTAG_STATUS_OK;
-//    ab_request_p cur, prev;
-
-    pdebug(DEBUG_INFO, "Starting.");
+    pdebug(DEBUG_DETAIL, "Starting.");
 
-    if(session == NULL || req == NULL) {
-        return rc;
+    if(!session) {
+        pdebug(DEBUG_WARN, "Session is null!");
+        return PLCTAG_ERR_NULL_PTR;
     }
 
-    for(int i=0; i < vector_length(session->requests); i++) {
-        if(vector_get(session->requests, i) == req) {
-            vector_remove(session->requests, i);
-            break;
-        }
+    critical_block(session->mutex) {
+        session->batch_hold++;
     }
 
-    /* release the request refcount */
-    rc_dec(req);
-
-    cond_signal(session->wait_cond);
-
-    pdebug(DEBUG_INFO, "Done.");
+    pdebug(DEBUG_DETAIL, "Done.");
 
-    return rc;
+    return PLCTAG_STATUS_OK;
 }
 
 
+/*
+ * session_batch_add_request
+ *
+ * Mark a queued request as part of the batch and move it up behind the
+ * other requests of the batch so that process_requests() sees them together.
+ */
+int session_batch_add_request(ab_session_p session, ab_request_p req, int32_t batch_id)
+{
+    int rc = PLCTAG_ERR_NOT_FOUND;
 
-/*****************************************************************
- **************** Session handling functions *********************
- ****************************************************************/
+    pdebug(DEBUG_DETAIL, "Starting.");
 
+    if(!session || !req) {
+        pdebug(DEBUG_WARN, "Session or request is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
 
-typedef enum { SESSION_OPEN_SOCKET_START, SESSION_OPEN_SOCKET_WAIT, SESSION_REGISTER,
-               SESSION_SEND_FORWARD_OPEN, SESSION_RECEIVE_FORWARD_OPEN, SESSION_IDLE,
-               SESSION_DISCONNECT, SESSION_UNREGISTER, SESSION_CLOSE_SOCKET,
-               SESSION_START_RETRY, SESSION_WAIT_RETRY, SESSION_WAIT_RECONNECT
-             } session_state_t;
+    critical_block(session->mutex) {
+        int req_index = -1;
+        int last_index = -1;
+
+        for(int i=0; i < vector_length(session->requests); i++) {
+            ab_request_p queued = vector_get(session->requests, i);
+
+            if(queued == req) {
+                req_index = i;
+            } else if(queued->batch_id == batch_id && req_index < 0) {
+                last_index = i;
+            }
+        }
+
+        if(req_index < 0) {
+            /* already sent, or aborted. */
+            break;
+        }
+
+        req->batch_id = batch_id;
+
+        /* shift the requests in between down one slot. */
+        if(last_index >= 0 && req_index > last_index + 1) {
+            for(int i=req_index; i > last_index + 1; i--) {
+                vector_put(session->requests, i, vector_get(session->requests, i - 1));
+            }
+
+            vector_put(session->requests, last_index + 1, req);
+        }
+
+        rc = PLCTAG_STATUS_OK;
+    }
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return rc;
+}
+
+
+/*
+ * session_batch_release
+ *
+ * Undo one call to session_batch_hold().
+ */
+int session_batch_release(ab_session_p session)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!session) {
+        pdebug(DEBUG_WARN, "Session is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    critical_block(session->mutex) {
+        if(session->batch_hold > 0) {
+            session->batch_hold--;
+        }
+
+        if(!session->batch_hold) {
+            wake_session_thread_unsafe(session);
+        }
+    }
+
+    cond_signal(session->wait_cond);
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*
+ * session_remove_request_unsafe
+ *
+ * You must hold the mutex before calling this!
+ */
+int session_remove_request_unsafe(ab_session_p session, ab_request_p req)
+{
+    int rc = PLCTAG_STATUS_OK;
+//    ab_request_p cur, prev;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(session == NULL || req == NULL) {
+        return rc;
+    }
+
+    for(int i=0; i < vector_length(session->requests); i++) {
+        if(vector_get(session->requests, i) == req) {
+            vector_remove(session->requests, i);
+            break;
+        }
+    }
+
+    /* release the request refcount */
+    rc_dec(req);
+
+    cond_signal(session->wait_cond);
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+/*****************************************************************
+ **************** Session handling functions *********************
+ ****************************************************************/
+
+
+typedef enum { SESSION_OPEN_SOCKET_START, SESSION_OPEN_SOCKET_WAIT, SESSION_REGISTER,
+               SESSION_SEND_FORWARD_OPEN, SESSION_RECEIVE_FORWARD_OPEN, SESSION_IDLE,
+               SESSION_DISCONNECT, SESSION_UNREGISTER, SESSION_CLOSE_SOCKET,
+               SESSION_START_RETRY, SESSION_WAIT_RETRY, SESSION_WAIT_RECONNECT
+             } session_state_t;
 
 
 THREAD_FUNC(session_handler)
@@ -1336,6 +1900,7 @@ THREAD_FUNC(session_handler)
     int64_t wait_until_time = 0;
     int64_t auto_disconnect_time = time_ms() + SESSION_DISCONNECT_TIMEOUT;
     int auto_disconnect = 0;
+    int use_pipelining = 0;
 
 
     pdebug(DEBUG_INFO, "Starting thread for session %p", session);
@@ -1433,6 +1998,7 @@ THREAD_FUNC(session_handler)
 
             if((rc = send_forward_open_request(session)) != PLCTAG_STATUS_OK) {
                 pdebug(DEBUG_WARN, "Send Forward Open failed %s!", plc_tag_decode_error(rc));
+                metrics_session_add(&(session->metrics), forward_open_failures, 1);
                 state = SESSION_UNREGISTER;
             } else {
                 pdebug(DEBUG_DETAIL, "Send Forward Open succeeded, going to SESSION_RECEIVE_FORWARD_OPEN state.");
@@ -1445,6 +2011,8 @@ THREAD_FUNC(session_handler)
             pdebug(DEBUG_DETAIL, "in SESSION_RECEIVE_FORWARD_OPEN state.");
 
             if((rc = receive_forward_open_response(session)) != PLCTAG_STATUS_OK) {
+                metrics_session_add(&(session->metrics), forward_open_failures, 1);
+
                 if(rc == PLCTAG_ERR_DUPLICATE) {
                     pdebug(DEBUG_DETAIL, "Duplicate connection error received, trying again with different connection ID.");
                     state = SESSION_SEND_FORWARD_OPEN;
@@ -1473,13 +2041,23 @@ THREAD_FUNC(session_handler)
             /* if there is work to do, make sure we do not disconnect. */
             critical_block(session->mutex) {
                 int num_reqs = vector_length(session->requests);
-                if(num_reqs > 0) {
+                if(num_reqs > 0 || session->num_requests_in_flight > 0) {
                     pdebug(DEBUG_DETAIL, "There are %d requests pending before cleanup and sending.", num_reqs);
                     auto_disconnect_time = time_ms() + SESSION_DISCONNECT_TIMEOUT;
                 }
             }
 
-            if((rc = process_requests(session)) != PLCTAG_STATUS_OK) {
+            critical_block(session->mutex) {
+                use_pipelining = (session->max_requests_in_flight > 1 || session->num_requests_in_flight > 0 || can_pipeline_next_request_unsafe(session));
+            }
+
+            if(use_pipelining) {
+                rc = process_pipelined_requests(session);
+            } else {
+                rc = process_requests(session);
+            }
+
+            if(rc != PLCTAG_STATUS_OK) {
                 pdebug(DEBUG_WARN, "Error while processing requests %s!", plc_tag_decode_error(rc));
                 if(session->use_connected_msg) {
                     state = SESSION_DISCONNECT;
@@ -1506,7 +2084,7 @@ THREAD_FUNC(session_handler)
             /* if there is work to do, make sure we signal the condition var. */
             critical_block(session->mutex) {
                 int num_reqs = vector_length(session->requests);
-                if(num_reqs > 0) {
+                if((num_reqs > 0 && !session->batch_hold) || session->num_requests_in_flight > 0) {
                     pdebug(DEBUG_DETAIL, "There are %d requests still pending after abort purge and sending.", num_reqs);
                     cond_signal(session->wait_cond);
                 }
@@ -1543,6 +2121,14 @@ THREAD_FUNC(session_handler)
                 pdebug(DEBUG_WARN, "Closing session socket failed %s!", plc_tag_decode_error(rc));
             }
 
+            /* the controller may be a different project when we get back. */
+            critical_block(session->mutex) {
+                session_symbols_clear_unsafe(session);
+                session->symbols_state = SESSION_SYMBOLS_EMPTY;
+                session->symbols_loader_id = 0;
+                session->symbols_generation++;
+            }
+
             if(auto_disconnect) {
                 state = SESSION_WAIT_RECONNECT;
             } else {
@@ -1557,6 +2143,8 @@ THREAD_FUNC(session_handler)
             /* FIXME - make this a tag attribute. */
             timeout_time = time_ms() + RETRY_WAIT_MS;
 
+            metrics_session_add(&(session->metrics), retries, 1);
+
             /* start waiting. */
             state = SESSION_WAIT_RETRY;
 
@@ -1568,6 +2156,7 @@ THREAD_FUNC(session_handler)
 
             if(timeout_time < time_ms()) {
                 pdebug(DEBUG_DETAIL, "Transitioning to SESSION_OPEN_SOCKET_START.");
+                metrics_session_add(&(session->metrics), reconnects, 1);
                 state = SESSION_OPEN_SOCKET_START;
                 cond_signal(session->wait_cond);
             }
@@ -1586,6 +2175,7 @@ THREAD_FUNC(session_handler)
                 if(vector_length(session->requests) > 0) {
                     pdebug(DEBUG_DETAIL, "There are requests waiting, reopening connection to PLC.");
 
+                    metrics_session_add(&(session->metrics), reconnects, 1);
                     state = SESSION_OPEN_SOCKET_START;
                     cond_signal(session->wait_cond);
                 }
@@ -1665,6 +2255,8 @@ int purge_aborted_requests_unsafe(ab_session_p session)
             request->request_size = 0;
             request->resp_received = 1;
 
+            complete_merged_cip_write(request);
+
             /* release our hold on it. */
             request = rc_dec(request);
 
@@ -1690,6 +2282,7 @@ int process_requests(ab_session_p session)
     ab_request_p bundled_requests[MAX_REQUESTS] = {NULL};
     int num_bundled_requests = 0;
     int remaining_space = 0;
+    int merged_pccc = 0;
 
     debug_set_tag_id(0);
 
@@ -1714,13 +2307,19 @@ int process_requests(ab_session_p session)
         // FIXME - no logging in a mutex!
         //pdebug(DEBUG_DETAIL, "FIXME: max payload size %d", max_payload_size);
 
-        /* is there anything to do? */
-        if(vector_length(session->requests)) {
+        /* is there anything to do?  Wait if a transaction is still queuing requests. */
+        if(vector_length(session->requests) && !session->batch_hold) {
             /* get rid of all aborted requests. */
             purge_aborted_requests_unsafe(session);
 
             /* if there are still requests after purging all the aborted requests, process them. */
 
+            /* turn writes to neighbouring array elements into one write. */
+            if(session->cip_write_merge_pending) {
+                merge_cip_writes_unsafe(session, max_payload_size);
+                session->cip_write_merge_pending = 0;
+            }
+
             /* how much space do we have to work with. */
             remaining_space = max_payload_size - (int)sizeof(cip_multi_req_header);
 
@@ -1728,6 +2327,15 @@ int process_requests(ab_session_p session)
                 do {
                     request = vector_get(session->requests, 0);
 
+                    /* start a batch in a new packet rather than split it, unless it is too big anyway. */
+                    if(num_bundled_requests > 0 && request->batch_id && request->batch_id != bundled_requests[num_bundled_requests - 1]->batch_id) {
+                        int batch_size = get_batch_payload_size_unsafe(session);
+
+                        if(batch_size > remaining_space && batch_size <= max_payload_size - (int)sizeof(cip_multi_req_header)) {
+                            break;
+                        }
+                    }
+
                     remaining_space = remaining_space - get_payload_size(request);
 
                     /*
@@ -1740,10 +2348,18 @@ int process_requests(ab_session_p session)
                         bundled_requests[num_bundled_requests] = request;
                         num_bundled_requests++;
 
+                        metrics_session_record(&(session->metrics), queue_wait_us, time_monotonic_us() - request->time_queued_us);
+
                         /* remove it from the queue. */
                         vector_remove(session->requests, 0);
                     }
                 } while(vector_length(session->requests) && remaining_space > 0 && num_bundled_requests < MAX_REQUESTS && request->allow_packing);
+
+                /* PCCC requests cannot be packed, but reads of the same data file can be merged into one. */
+                if(num_bundled_requests == 1 && bundled_requests[0]->pccc_merge) {
+                    num_bundled_requests = merge_pccc_reads_unsafe(session, bundled_requests, max_payload_size);
+                    merged_pccc = (num_bundled_requests > 1);
+                }
             } else {
                 pdebug(DEBUG_DETAIL, "All requests in queue were aborted, nothing to do.");
             }
@@ -1757,9 +2373,15 @@ int process_requests(ab_session_p session)
 
         pdebug(DEBUG_INFO, "%d requests to process.", num_bundled_requests);
 
+        metrics_session_record(&(session->metrics), services_per_packet, num_bundled_requests);
+
         do {
             /* copy and pack the requests into the session buffer. */
-            rc = pack_requests(session, bundled_requests, num_bundled_requests);
+            if(merged_pccc) {
+                rc = pack_pccc_reads(session, bundled_requests, num_bundled_requests);
+            } else {
+                rc = pack_requests(session, bundled_requests, num_bundled_requests);
+            }
             if(rc != PLCTAG_STATUS_OK) {
                 pdebug(DEBUG_WARN, "Error while packing requests, %s!", plc_tag_decode_error(rc));
                 break;
@@ -1777,245 +2399,1285 @@ int process_requests(ab_session_p session)
                 break;
             }
 
-            /* wait for the response */
-            if((rc = recv_eip_response(session, SESSION_DEFAULT_TIMEOUT)) != PLCTAG_STATUS_OK) {
-                pdebug(DEBUG_WARN, "Error receiving packet response %s!", plc_tag_decode_error(rc));
-                break;
+            /* wait for the response */
+            if((rc = recv_eip_response(session, SESSION_DEFAULT_TIMEOUT)) != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Error receiving packet response %s!", plc_tag_decode_error(rc));
+                break;
+            }
+
+            /* hand each merged read its part of the data. */
+            if(merged_pccc) {
+                rc = unpack_pccc_reads(session, bundled_requests, num_bundled_requests);
+                break;
+            }
+
+            /*
+             * check the CIP status, but only if this is a bundled
+             * response.   If it is a singleton, then we pass the
+             * status back to the tag.
+             */
+            if(num_bundled_requests > 1) {
+                if(le2h16(((eip_encap *)(session->data))->encap_command) == AB_EIP_UNCONNECTED_SEND) {
+                    eip_cip_uc_resp *resp = (eip_cip_uc_resp *)(session->data);
+                    pdebug(DEBUG_INFO, "Received unconnected packet with session sequence ID %llx", resp->encap_sender_context);
+
+                    /* punt if we got an overall error or it is not a partial/bundled error. */
+                    if(resp->status != AB_EIP_OK && resp->status != AB_CIP_ERR_PARTIAL_ERROR) {
+                        rc = decode_cip_error_code(&(resp->status));
+                        pdebug(DEBUG_WARN, "Command failed! (%d/%d) %s", resp->status, rc, plc_tag_decode_error(rc));
+                        break;
+                    }
+                } else if(le2h16(((eip_encap *)(session->data))->encap_command) == AB_EIP_CONNECTED_SEND) {
+                    eip_cip_co_resp *resp = (eip_cip_co_resp *)(session->data);
+                    pdebug(DEBUG_INFO, "Received connected packet with connection ID %x and sequence ID %u(%x)", le2h32(resp->cpf_orig_conn_id), le2h16(resp->cpf_conn_seq_num), le2h16(resp->cpf_conn_seq_num));
+
+                    /* punt if we got an overall error or it is not a partial/bundled error. */
+                    if(resp->status != AB_EIP_OK && resp->status != AB_CIP_ERR_PARTIAL_ERROR) {
+                        rc = decode_cip_error_code(&(resp->status));
+                        pdebug(DEBUG_WARN, "Command failed! (%d/%d) %s", resp->status, rc, plc_tag_decode_error(rc));
+                        break;
+                    }
+                }
+            }
+
+            /* copy the results back out. Every request gets a copy. */
+            for(int i=0; i < num_bundled_requests; i++) {
+                debug_set_tag_id(bundled_requests[i]->tag_id);
+
+                rc = unpack_response(session, bundled_requests[i], i);
+                if(rc != PLCTAG_STATUS_OK) {
+                    pdebug(DEBUG_WARN, "Unable to unpack response!");
+                    break;
+                }
+
+                /* release our reference */
+                bundled_requests[i] = rc_dec(bundled_requests[i]);
+            }
+
+            rc = PLCTAG_STATUS_OK;
+        } while(0);
+
+        /* problem? clean up the pending requests and dump everything. */
+        if(rc != PLCTAG_STATUS_OK) {
+            for(int i=0; i < num_bundled_requests; i++) {
+                if(bundled_requests[i]) {
+                    bundled_requests[i]->status = rc;
+                    bundled_requests[i]->request_size = 0;
+                    bundled_requests[i]->resp_received = 1;
+
+                    complete_merged_cip_write(bundled_requests[i]);
+
+                    bundled_requests[i] = rc_dec(bundled_requests[i]);
+                }
+            }
+        }
+
+        /* tickle the main tickler thread to note that we have responses. */
+        plc_tag_tickler_wake();
+    }
+
+    debug_set_tag_id(0);
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return rc;
+}
+
+
+/*
+ * process_pipelined_requests
+ *
+ * Used for DH+ bridged sessions.  The DH+ module forwards requests to the
+ * node while we wait, so up to max_requests_in_flight requests are sent
+ * before waiting for a response.  Responses are matched to their request
+ * by connection sequence number.  Each request is sent on its own, PCCC
+ * requests cannot be packed.
+ *
+ * Other connected sessions come here while the requests at the front of
+ * the queue allow pipelining, such as the pieces of a large Logix read.
+ * The normal packing resumes once those have been answered.
+ */
+int process_pipelined_requests(ab_session_p session)
+{
+    int rc = PLCTAG_STATUS_OK;
+    eip_cip_co_resp *resp = NULL;
+    ab_request_p request = NULL;
+    uint16_t seq_num = 0;
+    int index = 0;
+
+    debug_set_tag_id(0);
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    /* fill the window. */
+    while(session->num_requests_in_flight < MAX_REQUESTS_IN_FLIGHT) {
+        request = NULL;
+
+        critical_block(session->mutex) {
+            if(vector_length(session->requests) && !session->batch_hold) {
+                purge_aborted_requests_unsafe(session);
+
+                if(can_pipeline_next_request_unsafe(session)) {
+                    request = vector_remove(session->requests, 0);
+
+                    metrics_session_record(&(session->metrics), queue_wait_us, time_monotonic_us() - request->time_queued_us);
+                }
+            }
+        }
+
+        if(!request) {
+            break;
+        }
+
+        debug_set_tag_id(request->tag_id);
+
+        metrics_session_record(&(session->metrics), services_per_packet, 1);
+
+        do {
+            if((rc = pack_requests(session, &request, 1)) != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Error while packing request, %s!", plc_tag_decode_error(rc));
+                break;
+            }
+
+            if((rc = prepare_request(session)) != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Unable to prepare request, %s!", plc_tag_decode_error(rc));
+                break;
+            }
+
+            if((rc = send_eip_request(session, SESSION_DEFAULT_TIMEOUT)) != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Error sending packet %s!", plc_tag_decode_error(rc));
+                break;
+            }
+        } while(0);
+
+        if(rc != PLCTAG_STATUS_OK) {
+            spin_block(&request->lock) {
+                request->status = rc;
+                request->request_size = 0;
+                request->resp_received = 1;
+            }
+
+            complete_merged_cip_write(request);
+
+            rc_dec(request);
+
+            fail_requests_in_flight(session, rc);
+            plc_tag_tickler_wake();
+
+            return rc;
+        }
+
+        if(session->num_requests_in_flight == 0) {
+            session->in_flight_since_us = time_monotonic_us();
+        }
+
+        session->requests_in_flight[session->num_requests_in_flight] = request;
+        session->requests_in_flight_seq[session->num_requests_in_flight] = session->conn_seq_num;
+        session->num_requests_in_flight++;
+    }
+
+    debug_set_tag_id(0);
+
+    if(session->num_requests_in_flight == 0) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    pdebug(DEBUG_INFO, "%d requests in flight.", session->num_requests_in_flight);
+
+    /* with room in the window, do not block in the read while new requests are queued. */
+    if((rc = wait_for_response_or_request(session)) != PLCTAG_STATUS_OK) {
+        if(rc == PLCTAG_STATUS_PENDING) {
+            return PLCTAG_STATUS_OK;
+        }
+
+        fail_requests_in_flight(session, rc);
+        plc_tag_tickler_wake();
+        return rc;
+    }
+
+    /* wait for the next response. */
+    if((rc = recv_eip_response(session, SESSION_DEFAULT_TIMEOUT)) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Error receiving packet response %s!", plc_tag_decode_error(rc));
+        fail_requests_in_flight(session, rc);
+        plc_tag_tickler_wake();
+        return rc;
+    }
+
+    resp = (eip_cip_co_resp *)(session->data);
+    seq_num = le2h16(resp->cpf_conn_seq_num);
+
+    for(index = 0; index < session->num_requests_in_flight; index++) {
+        if(session->requests_in_flight_seq[index] == seq_num) {
+            break;
+        }
+    }
+
+    if(le2h16(resp->encap_command) != AB_EIP_CONNECTED_SEND || index >= session->num_requests_in_flight) {
+        pdebug(DEBUG_WARN, "Response with sequence number %u does not match a request in flight, dropping it.", (unsigned int)seq_num);
+        return PLCTAG_STATUS_OK;
+    }
+
+    request = session->requests_in_flight[index];
+
+    /* close the gap in the window. */
+    for(int i = index; i < session->num_requests_in_flight - 1; i++) {
+        session->requests_in_flight[i] = session->requests_in_flight[i + 1];
+        session->requests_in_flight_seq[i] = session->requests_in_flight_seq[i + 1];
+    }
+
+    session->num_requests_in_flight--;
+    session->requests_in_flight[session->num_requests_in_flight] = NULL;
+
+    debug_set_tag_id(request->tag_id);
+
+    rc = unpack_response(session, request, 0);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to unpack response!");
+
+        spin_block(&request->lock) {
+            request->status = rc;
+            request->request_size = 0;
+            request->resp_received = 1;
+        }
+
+        complete_merged_cip_write(request);
+
+        /* the response was received, so the session is still good. */
+        rc = PLCTAG_STATUS_OK;
+    }
+
+    rc_dec(request);
+
+    debug_set_tag_id(0);
+
+    /* tickle the main tickler thread to note that we have responses. */
+    plc_tag_tickler_wake();
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * can_pipeline_next_request_unsafe
+ *
+ * Check if the request at the front of the queue can be sent without
+ * waiting for the requests in flight.  DH+ sessions send everything up to
+ * their limit.  Other sessions only send requests that allow pipelining,
+ * and only over a connection.  You must hold the session mutex.
+ */
+int can_pipeline_next_request_unsafe(ab_session_p session)
+{
+    ab_request_p request = NULL;
+
+    if(session->batch_hold || session->num_requests_in_flight >= MAX_REQUESTS_IN_FLIGHT || !vector_length(session->requests)) {
+        return 0;
+    }
+
+    if(session->max_requests_in_flight > 1) {
+        return (session->num_requests_in_flight < session->max_requests_in_flight);
+    }
+
+    request = vector_get(session->requests, 0);
+
+    return (session->use_connected_msg && request && request->allow_pipelining);
+}
+
+
+
+/*
+ * wait_for_response_or_request
+ *
+ * If there is room in the window, wait a short time for the socket to
+ * have data.  A request queued in the meantime wakes the wait up early.
+ * Returns PLCTAG_STATUS_OK if a response can be read, or
+ * PLCTAG_STATUS_PENDING to go around and fill the window again.
+ */
+int wait_for_response_or_request(ab_session_p session)
+{
+    int window_size = (session->max_requests_in_flight > 1 ? session->max_requests_in_flight : MAX_REQUESTS_IN_FLIGHT);
+    int queued = 0;
+    int events = 0;
+    int64_t last_progress_us = 0;
+
+    if(session->num_requests_in_flight >= window_size) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    critical_block(session->mutex) {
+        queued = can_pipeline_next_request_unsafe(session);
+
+        if(!queued) {
+            session->wake_on_request = 1;
+        }
+    }
+
+    if(queued) {
+        return PLCTAG_STATUS_PENDING;
+    }
+
+    events = socket_wait_event(session->sock, SOCK_EVENT_DEFAULT_MASK | SOCK_EVENT_CAN_READ, SOCKET_WAIT_TIMEOUT_MS);
+
+    critical_block(session->mutex) {
+        session->wake_on_request = 0;
+    }
+
+    if(events & SOCK_EVENT_CAN_READ) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(events < 0 || (events & (SOCK_EVENT_ERROR | SOCK_EVENT_DISCONNECT))) {
+        pdebug(DEBUG_WARN, "Error waiting for the socket, events %x!", (unsigned int)events);
+        return PLCTAG_ERR_READ;
+    }
+
+    if(session->terminating) {
+        return PLCTAG_ERR_ABORT;
+    }
+
+    /* the same limit as the blocking read. */
+    last_progress_us = (session->resp_time_us > session->in_flight_since_us ? session->resp_time_us : session->in_flight_since_us);
+    if(time_monotonic_us() - last_progress_us > (int64_t)SESSION_DEFAULT_TIMEOUT * 1000) {
+        pdebug(DEBUG_WARN, "Timed out waiting for a response!");
+        return PLCTAG_ERR_TIMEOUT;
+    }
+
+    return PLCTAG_STATUS_PENDING;
+}
+
+
+
+/*
+ * wake_session_thread_unsafe
+ *
+ * Wake the session thread if it is waiting on the socket with room to
+ * send more.  You must hold the session mutex.
+ */
+void wake_session_thread_unsafe(ab_session_p session)
+{
+    if(session->wake_on_request && session->sock) {
+        socket_wake(session->sock);
+        session->wake_on_request = 0;
+    }
+}
+
+
+
+void fail_requests_in_flight(ab_session_p session, int status)
+{
+    for(int i = 0; i < session->num_requests_in_flight; i++) {
+        ab_request_p request = session->requests_in_flight[i];
+
+        spin_block(&request->lock) {
+            request->status = status;
+            request->request_size = 0;
+            request->resp_received = 1;
+        }
+
+        complete_merged_cip_write(request);
+
+        session->requests_in_flight[i] = rc_dec(request);
+    }
+
+    session->num_requests_in_flight = 0;
+}
+
+
+
+int unpack_response(ab_session_p session, ab_request_p request, int sub_packet)
+{
+    int rc = PLCTAG_STATUS_OK;
+    eip_cip_co_resp *packed_resp = (eip_cip_co_resp *)(session->data);
+    eip_cip_co_resp *unpacked_resp = NULL;
+    uint8_t *pkt_start = NULL;
+    uint8_t *pkt_end = NULL;
+    int new_eip_len = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    /* clear out the request data. */
+    mem_set(request->data, 0, request->request_capacity);
+
+    /* change what we do depending on the type. */
+    if(packed_resp->reply_service != (AB_EIP_CMD_CIP_MULTI | AB_EIP_CMD_CIP_OK)) {
+        /* copy the data back into the request buffer. */
+        new_eip_len = (int)session->data_size;
+        pdebug(DEBUG_INFO, "Got single response packet.  Copying %d bytes unchanged.", new_eip_len);
+
+        if(new_eip_len > request->request_capacity) {
+            int request_capacity = 0;
+
+            pdebug(DEBUG_INFO, "Request buffer too small, allocating larger buffer.");
+
+            critical_block(session->mutex) {
+                int max_payload_size = GET_MAX_PAYLOAD_SIZE(session);
+
+                // FIXME - no logging in a mutex!
+                // pdebug(DEBUG_DETAIL, "FIXME: max payload size %d", max_payload_size);
+
+                request_capacity = (int)(max_payload_size + EIP_CIP_PREFIX_SIZE);
+            }
+
+            /* make sure it will fit. */
+            if(new_eip_len > request_capacity) {
+                pdebug(DEBUG_WARN, "something is very wrong, packet length is %d but allowable capacity is %d!", new_eip_len, request_capacity);
+                return PLCTAG_ERR_TOO_LARGE;
+            }
+
+            rc = session_request_increase_buffer(request, request_capacity);
+            if(rc != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Unable to increase request buffer size to %d bytes!", request_capacity);
+                return rc;
+            }
+        }
+
+        mem_copy(request->data, session->data, new_eip_len);
+    } else {
+        cip_multi_resp_header *multi = (cip_multi_resp_header *)(&packed_resp->reply_service);
+        uint16_t total_responses = le2h16(multi->request_count);
+        int pkt_len = 0;
+
+        /* this is a packed response. */
+        pdebug(DEBUG_INFO, "Got multiple response packet, subpacket %d", sub_packet);
+
+        pdebug(DEBUG_INFO, "Our result offset is %d bytes.", (int)le2h16(multi->request_offsets[sub_packet]));
+
+        pkt_start = ((uint8_t *)(&multi->request_count) + le2h16(multi->request_offsets[sub_packet]));
+
+        /* calculate the end of the data. */
+        if((sub_packet + 1) < total_responses) {
+            /* not the last response */
+            pkt_end = (uint8_t *)(&multi->request_count) + le2h16(multi->request_offsets[sub_packet + 1]);
+        } else {
+            pkt_end = (session->data + le2h16(packed_resp->encap_length) + sizeof(eip_encap));
+        }
+
+        pkt_len = (int)(pkt_end - pkt_start);
+
+        /* replace the request buffer if it is not big enough. */
+        new_eip_len = pkt_len + (int)sizeof(eip_cip_co_generic_response);
+        if(new_eip_len > request->request_capacity) {
+            int request_capacity = 0;
+
+            pdebug(DEBUG_INFO, "Request buffer too small, allocating larger buffer.");
+
+            critical_block(session->mutex) {
+                int max_payload_size = GET_MAX_PAYLOAD_SIZE(session);
+
+                // FIXME: no logging in a mutex!
+                // pdebug(DEBUG_DETAIL, "max payload size %d", max_payload_size);
+
+                request_capacity = (int)(max_payload_size + EIP_CIP_PREFIX_SIZE);
+            }
+
+            /* make sure it will fit. */
+            if(new_eip_len > request_capacity) {
+                pdebug(DEBUG_WARN, "something is very wrong, packet length is %d but allowable capacity is %d!", new_eip_len, request_capacity);
+                return PLCTAG_ERR_TOO_LARGE;
+            }
+
+            rc = session_request_increase_buffer(request, request_capacity);
+            if(rc != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Unable to increase request buffer size to %d bytes!", request_capacity);
+                return rc;
+            }
+        }
+
+        /* point to the response buffer in a structured way. */
+        unpacked_resp = (eip_cip_co_resp *)(request->data);
+
+        /* copy the header down */
+        mem_copy(request->data, session->data, (int)sizeof(eip_cip_co_resp));
+
+        /* size of the new packet */
+        new_eip_len = (uint16_t)(((uint8_t *)(&unpacked_resp->reply_service) + pkt_len) /* end of the packet */
+                                 - (uint8_t *)(request->data));                         /* start of the packet */
+
+        /* now copy the packet over that. */
+        mem_copy(&unpacked_resp->reply_service, pkt_start, pkt_len);
+
+        /* stitch up the packet sizes. */
+        unpacked_resp->cpf_cdi_item_length = h2le16((uint16_t)(pkt_len + (int)sizeof(uint16_le))); /* extra for the connection sequence */
+        unpacked_resp->encap_length = h2le16((uint16_t)(new_eip_len - (uint16_t)sizeof(eip_encap)));
+    }
+
+    pdebug(DEBUG_INFO, "Unpacked packet:");
+    pdebug_dump_bytes(DEBUG_INFO, request->data, new_eip_len);
+
+    /* notify the reading thread that the request is ready */
+    spin_block(&request->lock) {
+        request->status = PLCTAG_STATUS_OK;
+        request->request_size = new_eip_len;
+        request->time_received_us = session->resp_time_us;
+        request->resp_received = 1;
+    }
+
+    complete_merged_cip_write(request);
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int get_payload_size(ab_request_p request)
+{
+    int request_data_size = 0;
+    eip_encap *header = (eip_encap *)(request->data);
+    eip_cip_co_req *co_req = NULL;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(le2h16(header->encap_command) == AB_EIP_CONNECTED_SEND) {
+        co_req = (eip_cip_co_req *)(request->data);
+        /* get length of new request */
+        request_data_size = le2h16(co_req->cpf_cdi_item_length)
+                            - 2  /* for connection sequence ID */
+                            + 2  /* for multipacket offset */
+                            ;
+    } else {
+        pdebug(DEBUG_DETAIL, "Not a supported type EIP packet type %d to get the payload size.", le2h16(header->encap_command));
+        request_data_size = INT_MAX;
+    }
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return request_data_size;
+}
+
+
+
+
+/*
+ * merge_cip_writes_unsafe
+ *
+ * Merge queued writes to neighbouring elements of the same array into
+ * writes of whole ranges.  Only writes of the same batch are merged and no
+ * write is moved past another request for the same tag.  You must hold
+ * the session mutex.
+ */
+void merge_cip_writes_unsafe(ab_session_p session, int max_payload_size)
+{
+    int start = 0;
+
+    while(start < vector_length(session->requests)) {
+        ab_request_p first = vector_get(session->requests, start);
+        int end = start + 1;
+
+        if(!first->cip_write_merge || first->abort_request) {
+            start++;
+            continue;
+        }
+
+        /*
+         * take in the rest of the batch.  Other requests can stay in the run as
+         * long as they do not touch the same tags as the writes around them.
+         */
+        while(end < vector_length(session->requests)) {
+            ab_request_p request = vector_get(session->requests, end);
+            int conflict = 0;
+
+            if(request->abort_request || request->batch_id != first->batch_id) {
+                break;
+            }
+
+            for(int i=start; i < end && !conflict; i++) {
+                ab_request_p other = vector_get(session->requests, i);
+
+                if(!other->cip_write_merge != !request->cip_write_merge) {
+                    conflict = !different_cip_root_symbols(request, other);
+                }
+            }
+
+            if(conflict) {
+                break;
+            }
+
+            end++;
+        }
+
+        if(end - start > 1) {
+            end = merge_cip_write_run_unsafe(session, start, end, max_payload_size);
+        }
+
+        start = end;
+    }
+}
+
+
+
+/*
+ * different_cip_root_symbols
+ *
+ * Check that two connected CIP requests name different controller or
+ * program tags.  Anything we cannot tell about is treated as the same.
+ */
+int different_cip_root_symbols(ab_request_p a, ab_request_p b)
+{
+    uint8_t *name_a = NULL;
+    uint8_t *name_b = NULL;
+    int len_a = get_cip_root_symbol(a, &name_a);
+    int len_b = get_cip_root_symbol(b, &name_b);
+
+    if(len_a <= 0 || len_b <= 0) {
+        return 0;
+    }
+
+    return mem_cmp(name_a, len_a, name_b, len_b) != 0;
+}
+
+
+
+/*
+ * get_cip_root_symbol
+ *
+ * Find the first symbolic segment in the path of a connected CIP request.
+ *
+ * Returns the length of the name or zero if there is none.
+ */
+int get_cip_root_symbol(ab_request_p request, uint8_t **name)
+{
+    eip_encap *header = (eip_encap *)(request->data);
+    int path_offset = (int)sizeof(eip_cip_co_req) + 1; /* skip the service code. */
+    int name_len = 0;
+
+    if(le2h16(header->encap_command) != AB_EIP_CONNECTED_SEND || request->request_size < path_offset + 3) {
+        return 0;
+    }
+
+    if(request->data[path_offset + 1] != 0x91) {
+        return 0;
+    }
+
+    name_len = request->data[path_offset + 2];
+
+    if(path_offset + 3 + name_len > request->request_size) {
+        return 0;
+    }
+
+    *name = &request->data[path_offset + 3];
+
+    return name_len;
+}
+
+
+
+/*
+ * merge_cip_write_run_unsafe
+ *
+ * Merge the writes in queue slots start to end.  Each merged write takes
+ * the queue slot of its earliest member.  Other requests keep their order.
+ *
+ * Returns the new end of the run.
+ */
+int merge_cip_write_run_unsafe(ab_session_p session, int start, int end, int max_payload_size)
+{
+    int num_requests = end - start;
+    int num_writes = 0;
+    struct cip_write_pos *sorted = NULL;
+    ab_request_p *owner = NULL;
+    ab_request_p *placed = NULL;
+    int max_space = max_payload_size - (int)sizeof(cip_multi_req_header);
+    int capacity = max_payload_size + EIP_CIP_PREFIX_SIZE;
+    int num_merged = 0;
+    int out = start;
+
+    sorted = mem_alloc((int)(sizeof(*sorted) * (size_t)num_requests));
+    owner = mem_alloc((int)(sizeof(*owner) * (size_t)num_requests));
+    placed = mem_alloc((int)(sizeof(*placed) * (size_t)num_requests));
+    if(!sorted || !owner || !placed) {
+        mem_free(sorted);
+        mem_free(owner);
+        mem_free(placed);
+        return end;
+    }
+
+    for(int i=0; i < num_requests; i++) {
+        ab_request_p request = vector_get(session->requests, start + i);
+
+        if(request->cip_write_merge) {
+            sorted[num_writes].request = request;
+            sorted[num_writes].pos = i;
+            num_writes++;
+        }
+    }
+
+    qsort(sorted, (size_t)num_writes, sizeof(*sorted), compare_cip_writes);
+
+    /* find ranges of elements with nothing missing in between. */
+    for(int i=0; i < num_writes; ) {
+        ab_request_p first = sorted[i].request;
+        int space = get_payload_size(first);
+        int count = first->cip_elem_count;
+        int j = i + 1;
+
+        while(j < num_writes) {
+            ab_request_p prev = sorted[j - 1].request;
+            ab_request_p next = sorted[j].request;
+            int data_size = next->cip_elem_count * next->cip_elem_size;
+
+            if(!same_cip_write_target(prev, next)
+               || next->cip_index != prev->cip_index + (uint32_t)prev->cip_elem_count
+               || space + data_size > max_space
+               || count + next->cip_elem_count > UINT16_MAX
+               || !cip_write_group_keeps_order(sorted, num_writes, i, j)) {
+                break;
+            }
+
+            space += data_size;
+            count += next->cip_elem_count;
+            j++;
+        }
+
+        if(j - i > 1) {
+            ab_request_p merged = NULL;
+            ab_request_p *members = mem_alloc((int)(sizeof(*members) * (size_t)(j - i)));
+
+            if(members) {
+                for(int k=0; k < j - i; k++) {
+                    members[k] = sorted[i + k].request;
+                }
+
+                merged = build_merged_cip_write(members, j - i, capacity);
+
+                mem_free(members);
+            }
+
+            if(merged) {
+                int first_pos = sorted[i].pos;
+
+                for(int k=i; k < j; k++) {
+                    owner[sorted[k].pos] = merged;
+
+                    if(sorted[k].pos < first_pos) {
+                        first_pos = sorted[k].pos;
+                    }
+
+                    if(sorted[k].request->time_queued_us < merged->time_queued_us) {
+                        merged->time_queued_us = sorted[k].request->time_queued_us;
+                    }
+                }
+
+                placed[first_pos] = merged;
+                num_merged++;
+            }
+        }
+
+        i = j;
+    }
+
+    mem_free(sorted);
+
+    /* put the merged writes where their first member was. */
+    for(int i=0; num_merged && i < num_requests; i++) {
+        ab_request_p request = vector_get(session->requests, start + i);
+
+        if(placed[i]) {
+            vector_put(session->requests, out++, placed[i]);
+        } else if(!owner[i]) {
+            vector_put(session->requests, out++, request);
+        }
+    }
+
+    mem_free(owner);
+    mem_free(placed);
+
+    if(!num_merged) {
+        return end;
+    }
+
+    for(int i = end; i > out; i--) {
+        vector_remove(session->requests, out);
+    }
+
+    return out;
+}
+
+
+
+int compare_cip_writes(const void *a, const void *b)
+{
+    ab_request_p ra = ((const struct cip_write_pos *)a)->request;
+    ab_request_p rb = ((const struct cip_write_pos *)b)->request;
+    int size_a = ra->cip_index_offset - ra->cip_name_offset;
+    int size_b = rb->cip_index_offset - rb->cip_name_offset;
+    int rc = 0;
+
+    if(size_a != size_b) {
+        return (size_a < size_b) ? -1 : 1;
+    }
+
+    /* the name without the path size byte, which changes with the index size. */
+    rc = mem_cmp(ra->data + ra->cip_name_offset + 1, size_a - 1, rb->data + rb->cip_name_offset + 1, size_b - 1);
+    if(rc) {
+        return rc;
+    }
+
+    rc = mem_cmp(ra->data + ra->cip_type_offset, 2, rb->data + rb->cip_type_offset, 2);
+    if(rc) {
+        return rc;
+    }
+
+    if(ra->cip_index != rb->cip_index) {
+        return (ra->cip_index < rb->cip_index) ? -1 : 1;
+    }
+
+    /* qsort is not stable, keep writes of the same element in queue order. */
+    return ((const struct cip_write_pos *)a)->pos - ((const struct cip_write_pos *)b)->pos;
+}
+
+
+
+/*
+ * cip_write_group_keeps_order
+ *
+ * The merged write of sorted writes first to last takes the queue slot of
+ * its earliest member, so the later members move ahead of the writes
+ * queued in between.  Check that none of those touch the same elements.
+ * Other requests in the run never name the same tag, see
+ * merge_cip_writes_unsafe().
+ */
+int cip_write_group_keeps_order(struct cip_write_pos *writes, int num_writes, int first, int last)
+{
+    int first_pos = writes[first].pos;
+
+    for(int k=first + 1; k <= last; k++) {
+        if(writes[k].pos < first_pos) {
+            first_pos = writes[k].pos;
+        }
+    }
+
+    for(int k=first; k <= last; k++) {
+        ab_request_p member = writes[k].request;
+
+        for(int w=0; w < num_writes; w++) {
+            ab_request_p other = writes[w].request;
+
+            if((w >= first && w <= last) || writes[w].pos < first_pos || writes[w].pos > writes[k].pos) {
+                continue;
+            }
+
+            if(same_cip_write_name(member, other)
+               && member->cip_index < other->cip_index + (uint32_t)other->cip_elem_count
+               && other->cip_index < member->cip_index + (uint32_t)member->cip_elem_count) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+
+int same_cip_write_name(ab_request_p a, ab_request_p b)
+{
+    int size = a->cip_index_offset - a->cip_name_offset;
+
+    if(size != b->cip_index_offset - b->cip_name_offset) {
+        return 0;
+    }
+
+    return !mem_cmp(a->data + a->cip_name_offset + 1, size - 1, b->data + b->cip_name_offset + 1, size - 1);
+}
+
+
+
+int same_cip_write_target(ab_request_p a, ab_request_p b)
+{
+    if(!same_cip_write_name(a, b) || a->cip_elem_size != b->cip_elem_size) {
+        return 0;
+    }
+
+    return !mem_cmp(a->data + a->cip_type_offset, 2, b->data + b->cip_type_offset, 2);
+}
+
+
+
+/*
+ * build_merged_cip_write
+ *
+ * The requests are sorted by element.  The first one supplies the name
+ * and type, the element count covers all of them and their data follows
+ * in order.  The new request holds the references to the requests until
+ * complete_merged_cip_write() is called.
+ */
+ab_request_p build_merged_cip_write(ab_request_p *requests, int num_requests, int capacity)
+{
+    ab_request_p first = requests[0];
+    ab_request_p res = NULL;
+    eip_cip_co_req *co_req = NULL;
+    int count_offset = first->cip_type_offset + 2;
+    int data_offset = count_offset + 2;
+    int count = 0;
+    int size = data_offset;
+
+    for(int i=0; i < num_requests; i++) {
+        count += requests[i]->cip_elem_count;
+        size += requests[i]->cip_elem_count * requests[i]->cip_elem_size;
+    }
+
+    if(size > capacity) {
+        return NULL;
+    }
+
+    res = (ab_request_p)rc_alloc((int)sizeof(struct ab_request_t), request_destroy);
+    if(!res) {
+        return NULL;
+    }
+
+    res->data = (uint8_t *)mem_alloc(capacity);
+    res->merged = (ab_request_p *)mem_alloc((int)(sizeof(ab_request_p) * (size_t)num_requests));
+    if(!res->data || !res->merged) {
+        mem_free(res->merged);
+        res->merged = NULL;
+        rc_dec(res);
+        return NULL;
+    }
+
+    res->lock = LOCK_INIT;
+    res->tag_id = first->tag_id;
+    res->request_capacity = capacity;
+    res->allow_packing = 1;
+    res->batch_id = first->batch_id;
+    res->time_queued_us = first->time_queued_us;
+
+    mem_copy(res->data, first->data, count_offset);
+    res->data[count_offset] = (uint8_t)(count & 0xFF);
+    res->data[count_offset + 1] = (uint8_t)((count >> 8) & 0xFF);
+
+    size = data_offset;
+
+    for(int i=0; i < num_requests; i++) {
+        ab_request_p request = requests[i];
+        int request_data_offset = request->cip_type_offset + 4;
+        int data_size = request->cip_elem_count * request->cip_elem_size;
+
+        mem_copy(res->data + size, request->data + request_data_offset, data_size);
+        size += data_size;
+
+        /* the queue reference moves to the merged write. */
+        res->merged[i] = request;
+    }
+
+    res->num_merged = num_requests;
+    res->request_size = size;
+
+    co_req = (eip_cip_co_req *)(res->data);
+    co_req->cpf_cdi_item_length = h2le16((uint16_t)(size - (int)((uint8_t *)(&co_req->cpf_conn_seq_num) - res->data)));
+
+    return res;
+}
+
+
+
+/*
+ * complete_merged_cip_write
+ *
+ * Hand the result of a merged write on to the writes it stood in for and
+ * release them.  Call this when the merged write gets its result.  Other
+ * requests are left alone.
+ */
+void complete_merged_cip_write(ab_request_p request)
+{
+    int size = 0;
+
+    if(!request->merged) {
+        return;
+    }
+
+    if(request->resp_received && request->data) {
+        size = request->request_size;
+    }
+
+    for(int i=0; i < request->num_merged; i++) {
+        ab_request_p member = request->merged[i];
+        int member_size = (size > member->request_capacity ? 0 : size);
+
+        spin_block(&member->lock) {
+            if(member_size > 0) {
+                mem_copy(member->data, request->data, member_size);
             }
 
-            /*
-             * check the CIP status, but only if this is a bundled
-             * response.   If it is a singleton, then we pass the
-             * status back to the tag.
-             */
-            if(num_bundled_requests > 1) {
-                if(le2h16(((eip_encap *)(session->data))->encap_command) == AB_EIP_UNCONNECTED_SEND) {
-                    eip_cip_uc_resp *resp = (eip_cip_uc_resp *)(session->data);
-                    pdebug(DEBUG_INFO, "Received unconnected packet with session sequence ID %llx", resp->encap_sender_context);
+            member->status = (request->resp_received ? request->status : PLCTAG_ERR_ABORT);
+            member->request_size = member_size;
+            member->time_received_us = request->time_received_us;
+            member->resp_received = 1;
+        }
 
-                    /* punt if we got an overall error or it is not a partial/bundled error. */
-                    if(resp->status != AB_EIP_OK && resp->status != AB_CIP_ERR_PARTIAL_ERROR) {
-                        rc = decode_cip_error_code(&(resp->status));
-                        pdebug(DEBUG_WARN, "Command failed! (%d/%d) %s", resp->status, rc, plc_tag_decode_error(rc));
-                        break;
-                    }
-                } else if(le2h16(((eip_encap *)(session->data))->encap_command) == AB_EIP_CONNECTED_SEND) {
-                    eip_cip_co_resp *resp = (eip_cip_co_resp *)(session->data);
-                    pdebug(DEBUG_INFO, "Received connected packet with connection ID %x and sequence ID %u(%x)", le2h32(resp->cpf_orig_conn_id), le2h16(resp->cpf_conn_seq_num), le2h16(resp->cpf_conn_seq_num));
+        rc_dec(member);
+    }
 
-                    /* punt if we got an overall error or it is not a partial/bundled error. */
-                    if(resp->status != AB_EIP_OK && resp->status != AB_CIP_ERR_PARTIAL_ERROR) {
-                        rc = decode_cip_error_code(&(resp->status));
-                        pdebug(DEBUG_WARN, "Command failed! (%d/%d) %s", resp->status, rc, plc_tag_decode_error(rc));
-                        break;
-                    }
-                }
-            }
+    mem_free(request->merged);
+    request->merged = NULL;
+    request->num_merged = 0;
+}
 
-            /* copy the results back out. Every request gets a copy. */
-            for(int i=0; i < num_bundled_requests; i++) {
-                debug_set_tag_id(bundled_requests[i]->tag_id);
 
-                rc = unpack_response(session, bundled_requests[i], i);
-                if(rc != PLCTAG_STATUS_OK) {
-                    pdebug(DEBUG_WARN, "Unable to unpack response!");
-                    break;
-                }
 
-                /* release our reference */
-                bundled_requests[i] = rc_dec(bundled_requests[i]);
-            }
+/*
+ * merge_pccc_reads_unsafe
+ *
+ * The first request is a read of whole elements of an SLC/MicroLogix data
+ * file.  Take the queued reads of the same file that fit with it into one
+ * range read.  The gaps between them are read too.  You must hold the
+ * session mutex.
+ *
+ * Returns the number of requests in the merged read.
+ */
+int merge_pccc_reads_unsafe(ab_session_p session, ab_request_p *requests, int max_payload_size)
+{
+    ab_request_p first = requests[0];
+    int num_requests = 1;
+    int start = first->pccc_element;
+    int end = first->pccc_element + first->pccc_elem_count;
+    int max_elements = 0;
+
+    if(first->pccc_elem_size <= 0) {
+        return num_requests;
+    }
 
-            rc = PLCTAG_STATUS_OK;
-        } while(0);
+    max_elements = (max_payload_size - PCCC_READ_RESP_OVERHEAD) / first->pccc_elem_size;
 
-        /* problem? clean up the pending requests and dump everything. */
-        if(rc != PLCTAG_STATUS_OK) {
-            for(int i=0; i < num_bundled_requests; i++) {
-                if(bundled_requests[i]) {
-                    bundled_requests[i]->status = rc;
-                    bundled_requests[i]->request_size = 0;
-                    bundled_requests[i]->resp_received = 1;
+    for(int i=0; i < vector_length(session->requests) && num_requests < MAX_REQUESTS; ) {
+        ab_request_p request = vector_get(session->requests, i);
+        int new_start = start;
+        int new_end = end;
 
-                    bundled_requests[i] = rc_dec(bundled_requests[i]);
-                }
-            }
+        if(!request->pccc_merge
+           || request->abort_request
+           || request->pccc_file_type != first->pccc_file_type
+           || request->pccc_file_num != first->pccc_file_num
+           || request->pccc_elem_size != first->pccc_elem_size) {
+            i++;
+            continue;
         }
 
-        /* tickle the main tickler thread to note that we have responses. */
-        plc_tag_tickler_wake();
+        if(request->pccc_element < new_start) {
+            new_start = request->pccc_element;
+        }
+
+        if(request->pccc_element + request->pccc_elem_count > new_end) {
+            new_end = request->pccc_element + request->pccc_elem_count;
+        }
+
+        if(new_end - new_start > max_elements) {
+            i++;
+            continue;
+        }
+
+        start = new_start;
+        end = new_end;
+
+        requests[num_requests] = request;
+        num_requests++;
+
+        metrics_session_record(&(session->metrics), queue_wait_us, time_monotonic_us() - request->time_queued_us);
+
+        vector_remove(session->requests, i);
     }
 
-    debug_set_tag_id(0);
+    return num_requests;
+}
 
-    pdebug(DEBUG_SPEW, "Done.");
 
-    return rc;
+
+void get_pccc_read_range(ab_request_p *requests, int num_requests, int *start, int *end)
+{
+    *start = requests[0]->pccc_element;
+    *end = requests[0]->pccc_element + requests[0]->pccc_elem_count;
+
+    for(int i=1; i < num_requests; i++) {
+        if(requests[i]->pccc_element < *start) {
+            *start = requests[i]->pccc_element;
+        }
+
+        if(requests[i]->pccc_element + requests[i]->pccc_elem_count > *end) {
+            *end = requests[i]->pccc_element + requests[i]->pccc_elem_count;
+        }
+    }
 }
 
 
-int unpack_response(ab_session_p session, ab_request_p request, int sub_packet)
+
+/*
+ * pack_pccc_reads
+ *
+ * Build one range read for the merged requests.  The first request is
+ * copied up to its transfer size, then the size and address are replaced.
+ */
+int pack_pccc_reads(ab_session_p session, ab_request_p *requests, int num_requests)
 {
+    ab_request_p first = requests[0];
+    eip_cip_uc_req *uc_req = (eip_cip_uc_req *)(session->data);
+    pccc_addr_t address;
+    int start = 0;
+    int end = 0;
+    int addr_offset = first->pccc_size_offset + 1;
+    int addr_size = 0;
     int rc = PLCTAG_STATUS_OK;
-    eip_cip_co_resp *packed_resp = (eip_cip_co_resp *)(session->data);
-    eip_cip_co_resp *unpacked_resp = NULL;
-    uint8_t *pkt_start = NULL;
-    uint8_t *pkt_end = NULL;
-    int new_eip_len = 0;
 
     pdebug(DEBUG_INFO, "Starting.");
 
-    /* clear out the request data. */
-    mem_set(request->data, 0, request->request_capacity);
+    get_pccc_read_range(requests, num_requests, &start, &end);
 
-    /* change what we do depending on the type. */
-    if(packed_resp->reply_service != (AB_EIP_CMD_CIP_MULTI | AB_EIP_CMD_CIP_OK)) {
-        /* copy the data back into the request buffer. */
-        new_eip_len = (int)session->data_size;
-        pdebug(DEBUG_INFO, "Got single response packet.  Copying %d bytes unchanged.", new_eip_len);
+    pdebug(DEBUG_DETAIL, "Merged %d reads of data file %d into elements %d to %d.", num_requests, first->pccc_file_num, start, end - 1);
 
-        if(new_eip_len > request->request_capacity) {
-            int request_capacity = 0;
+    mem_copy(session->data, first->data, first->pccc_size_offset);
+    session->data[first->pccc_size_offset] = (uint8_t)((end - start) * first->pccc_elem_size);
 
-            pdebug(DEBUG_INFO, "Request buffer too small, allocating larger buffer.");
+    mem_set(&address, 0, (int)sizeof(address));
+    address.file_type = (pccc_file_t)first->pccc_file_type;
+    address.file = first->pccc_file_num;
+    address.element = start;
+    address.sub_element = -1;
 
-            critical_block(session->mutex) {
-                int max_payload_size = GET_MAX_PAYLOAD_SIZE(session);
+    rc = slc_encode_address(session->data + addr_offset, &addr_size, (int)session->data_capacity - addr_offset, &address);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to encode merged read address, error %s!", plc_tag_decode_error(rc));
+        return rc;
+    }
 
-                // FIXME - no logging in a mutex!
-                // pdebug(DEBUG_DETAIL, "FIXME: max payload size %d", max_payload_size);
+    session->data_size = (uint32_t)(addr_offset + addr_size);
 
-                request_capacity = (int)(max_payload_size + EIP_CIP_PREFIX_SIZE);
-            }
+    uc_req->cpf_udi_item_length = h2le16((uint16_t)((int)session->data_size - (int)((uint8_t *)(&uc_req->cm_service_code) - session->data)));
 
-            /* make sure it will fit. */
-            if(new_eip_len > request_capacity) {
-                pdebug(DEBUG_WARN, "something is very wrong, packet length is %d but allowable capacity is %d!", new_eip_len, request_capacity);
-                return PLCTAG_ERR_TOO_LARGE;
-            }
+    pdebug(DEBUG_INFO, "Done.");
 
-            rc = session_request_increase_buffer(request, request_capacity);
-            if(rc != PLCTAG_STATUS_OK) {
-                pdebug(DEBUG_WARN, "Unable to increase request buffer size to %d bytes!", request_capacity);
-                return rc;
-            }
-        }
+    return PLCTAG_STATUS_OK;
+}
 
-        mem_copy(request->data, session->data, new_eip_len);
-    } else {
-        cip_multi_resp_header *multi = (cip_multi_resp_header *)(&packed_resp->reply_service);
-        uint16_t total_responses = le2h16(multi->request_count);
-        int pkt_len = 0;
 
-        /* this is a packed response. */
-        pdebug(DEBUG_INFO, "Got multiple response packet, subpacket %d", sub_packet);
 
-        pdebug(DEBUG_INFO, "Our result offset is %d bytes.", (int)le2h16(multi->request_offsets[sub_packet]));
+/*
+ * unpack_pccc_reads
+ *
+ * Give each merged request a response holding just its elements.  If the
+ * merged read failed, put the requests back at the front of the queue to
+ * be sent on their own so that one bad address does not fail the rest.
+ *
+ * The requests are always consumed.
+ */
+int unpack_pccc_reads(ab_session_p session, ab_request_p *requests, int num_requests)
+{
+    pccc_resp *resp = (pccc_resp *)(session->data);
+    int header_size = (int)sizeof(pccc_resp);
+    int data_size = (int)session->data_size - header_size;
+    int start = 0;
+    int end = 0;
 
-        pkt_start = ((uint8_t *)(&multi->request_count) + le2h16(multi->request_offsets[sub_packet]));
+    pdebug(DEBUG_INFO, "Starting.");
 
-        /* calculate the end of the data. */
-        if((sub_packet + 1) < total_responses) {
-            /* not the last response */
-            pkt_end = (uint8_t *)(&multi->request_count) + le2h16(multi->request_offsets[sub_packet + 1]);
-        } else {
-            pkt_end = (session->data + le2h16(packed_resp->encap_length) + sizeof(eip_encap));
-        }
+    get_pccc_read_range(requests, num_requests, &start, &end);
 
-        pkt_len = (int)(pkt_end - pkt_start);
+    if(le2h16(resp->encap_command) != AB_EIP_UNCONNECTED_SEND
+       || le2h32(resp->encap_status) != AB_EIP_OK
+       || resp->general_status != AB_EIP_OK
+       || resp->pccc_status != AB_EIP_OK
+       || data_size != (end - start) * requests[0]->pccc_elem_size) {
+        pdebug(DEBUG_WARN, "Merged read of data file %d failed, sending the reads separately.", requests[0]->pccc_file_num);
 
-        /* replace the request buffer if it is not big enough. */
-        new_eip_len = pkt_len + (int)sizeof(eip_cip_co_generic_response);
-        if(new_eip_len > request->request_capacity) {
-            int request_capacity = 0;
+        critical_block(session->mutex) {
+            for(int i=num_requests-1; i >= 0; i--) {
+                int len = vector_length(session->requests);
 
-            pdebug(DEBUG_INFO, "Request buffer too small, allocating larger buffer.");
+                requests[i]->pccc_merge = 0;
 
-            critical_block(session->mutex) {
-                int max_payload_size = GET_MAX_PAYLOAD_SIZE(session);
+                /* shift the queue up one slot and put the request at the front. */
+                for(int j=len; j > 0; j--) {
+                    vector_put(session->requests, j, vector_get(session->requests, j - 1));
+                }
 
-                // FIXME: no logging in a mutex!
-                // pdebug(DEBUG_DETAIL, "max payload size %d", max_payload_size);
+                vector_put(session->requests, 0, requests[i]);
 
-                request_capacity = (int)(max_payload_size + EIP_CIP_PREFIX_SIZE);
+                /* the queue has our reference now. */
+                requests[i] = NULL;
             }
+        }
 
-            /* make sure it will fit. */
-            if(new_eip_len > request_capacity) {
-                pdebug(DEBUG_WARN, "something is very wrong, packet length is %d but allowable capacity is %d!", new_eip_len, request_capacity);
-                return PLCTAG_ERR_TOO_LARGE;
-            }
+        return PLCTAG_STATUS_OK;
+    }
 
-            rc = session_request_increase_buffer(request, request_capacity);
-            if(rc != PLCTAG_STATUS_OK) {
-                pdebug(DEBUG_WARN, "Unable to increase request buffer size to %d bytes!", request_capacity);
-                return rc;
-            }
-        }
+    for(int i=0; i < num_requests; i++) {
+        ab_request_p request = requests[i];
+        int offset = (request->pccc_element - start) * request->pccc_elem_size;
+        int size = request->pccc_elem_count * request->pccc_elem_size;
+        int new_len = header_size + size;
+        pccc_resp *new_resp = NULL;
 
-        /* point to the response buffer in a structured way. */
-        unpacked_resp = (eip_cip_co_resp *)(request->data);
+        debug_set_tag_id(request->tag_id);
 
-        /* copy the header down */
-        mem_copy(request->data, session->data, (int)sizeof(eip_cip_co_resp));
+        if(new_len > request->request_capacity) {
+            if(session_request_increase_buffer(request, new_len) != PLCTAG_STATUS_OK) {
+                pdebug(DEBUG_WARN, "Unable to increase request buffer size to %d bytes!", new_len);
 
-        /* size of the new packet */
-        new_eip_len = (uint16_t)(((uint8_t *)(&unpacked_resp->reply_service) + pkt_len) /* end of the packet */
-                                 - (uint8_t *)(request->data));                         /* start of the packet */
+                spin_block(&request->lock) {
+                    request->status = PLCTAG_ERR_NO_MEM;
+                    request->request_size = 0;
+                    request->resp_received = 1;
+                }
 
-        /* now copy the packet over that. */
-        mem_copy(&unpacked_resp->reply_service, pkt_start, pkt_len);
+                requests[i] = rc_dec(request);
+                continue;
+            }
+        }
 
-        /* stitch up the packet sizes. */
-        unpacked_resp->cpf_cdi_item_length = h2le16((uint16_t)(pkt_len + (int)sizeof(uint16_le))); /* extra for the connection sequence */
-        unpacked_resp->encap_length = h2le16((uint16_t)(new_eip_len - (uint16_t)sizeof(eip_encap)));
-    }
+        mem_set(request->data, 0, request->request_capacity);
+        mem_copy(request->data, session->data, header_size);
+        mem_copy(request->data + header_size, session->data + header_size + offset, size);
 
-    pdebug(DEBUG_INFO, "Unpacked packet:");
-    pdebug_dump_bytes(DEBUG_INFO, request->data, new_eip_len);
+        new_resp = (pccc_resp *)(request->data);
+        new_resp->encap_length = h2le16((uint16_t)(new_len - (int)sizeof(eip_encap)));
+        new_resp->cpf_udi_item_length = h2le16((uint16_t)(new_len - (int)((uint8_t *)(&new_resp->reply_code) - request->data)));
 
-    /* notify the reading thread that the request is ready */
-    spin_block(&request->lock) {
-        request->status = PLCTAG_STATUS_OK;
-        request->request_size = new_eip_len;
-        request->resp_received = 1;
+        spin_block(&request->lock) {
+            request->status = PLCTAG_STATUS_OK;
+            request->request_size = new_len;
+            request->time_received_us = session->resp_time_us;
+            request->resp_received = 1;
+        }
+
+        requests[i] = rc_dec(request);
     }
 
-    pdebug(DEBUG_DETAIL, "Done.");
+    debug_set_tag_id(0);
+
+    pdebug(DEBUG_INFO, "Done.");
 
     return PLCTAG_STATUS_OK;
 }
 
 
 
-int get_payload_size(ab_request_p request)
+/*
+ * get_batch_payload_size_unsafe
+ *
+ * The payload size of the batch at the front of the queue.  You must
+ * hold the session mutex.
+ */
+int get_batch_payload_size_unsafe(ab_session_p session)
 {
-    int request_data_size = 0;
-    eip_encap *header = (eip_encap *)(request->data);
-    eip_cip_co_req *co_req = NULL;
+    ab_request_p first = vector_get(session->requests, 0);
+    int total = 0;
 
-    pdebug(DEBUG_DETAIL, "Starting.");
+    for(int i=0; first && i < vector_length(session->requests); i++) {
+        ab_request_p request = vector_get(session->requests, i);
 
-    if(le2h16(header->encap_command) == AB_EIP_CONNECTED_SEND) {
-        co_req = (eip_cip_co_req *)(request->data);
-        /* get length of new request */
-        request_data_size = le2h16(co_req->cpf_cdi_item_length)
-                            - 2  /* for connection sequence ID */
-                            + 2  /* for multipacket offset */
-                            ;
-    } else {
-        pdebug(DEBUG_DETAIL, "Not a supported type EIP packet type %d to get the payload size.", le2h16(header->encap_command));
-        request_data_size = INT_MAX;
-    }
+        if(request->batch_id != first->batch_id) {
+            break;
+        }
 
-    pdebug(DEBUG_DETAIL, "Done.");
+        total += get_payload_size(request);
+    }
 
-    return request_data_size;
+    return total;
 }
 
 
 
-
 int pack_requests(ab_session_p session, ab_request_p *requests, int num_requests)
 {
     eip_cip_co_req *new_req = NULL;
@@ -2247,6 +3909,12 @@ int send_eip_request(ab_session_p session, int timeout)
         return PLCTAG_ERR_TIMEOUT;
     }
 
+    /* round trip time is measured from the end of the send. */
+    session->last_send_time_us = time_monotonic_us();
+    capture_frame(&(session->capture), 0, session->data, (int)session->data_size);
+    metrics_session_add(&(session->metrics), packets_sent, 1);
+    metrics_session_add(&(session->metrics), bytes_sent, session->data_size);
+
     pdebug(DEBUG_INFO, "Done.");
 
     return PLCTAG_STATUS_OK;
@@ -2335,6 +4003,12 @@ int recv_eip_response(ab_session_p session, int timeout)
 
     session->resp_seq_id = le2h64(((eip_encap *)(session->data))->encap_sender_context);
     session->data_size = data_needed;
+    session->resp_time_us = time_monotonic_us();
+    capture_frame(&(session->capture), 1, session->data, (int)data_needed);
+
+    metrics_session_add(&(session->metrics), packets_received, 1);
+    metrics_session_add(&(session->metrics), bytes_received, data_needed);
+    metrics_session_record(&(session->metrics), rtt_us, time_monotonic_us() - session->last_send_time_us);
 
     rc = PLCTAG_STATUS_OK;
 
@@ -2819,6 +4493,17 @@ void request_destroy(void *req_arg)
 
     req->abort_request = 1;
 
+    /* the session completes merged writes, this only drops the references left. */
+    if(req->merged) {
+        for(int i=0; i < req->num_merged; i++) {
+            rc_dec(req->merged[i]);
+        }
+
+        mem_free(req->merged);
+        req->merged = NULL;
+        req->num_merged = 0;
+    }
+
     if(req->data) {
         mem_free(req->data);
         req->data = NULL;
@@ -2853,3 +4538,42 @@ int session_request_increase_buffer(ab_request_p request, int new_capacity)
 
     return PLCTAG_STATUS_OK;
 }
+
+
+
+void session_symbols_clear_unsafe(ab_session_p session)
+{
+    if(session->symbols) {
+        hashtable_on_each(session->symbols, session_symbols_free_entry, NULL);
+        hashtable_destroy(session->symbols);
+        session->symbols = NULL;
+    }
+
+    if(session->symbols_changes) {
+        mem_free(session->symbols_changes);
+        session->symbols_changes = NULL;
+    }
+
+    session->symbols_changes_size = 0;
+    session->symbols_checker_id = 0;
+    session->symbols_checked_until_us = 0;
+}
+
+
+int session_symbols_free_entry(hashtable_p table, int64_t key, void *data, void *context)
+{
+    ab_symbol_p entry = data;
+
+    (void)table;
+    (void)key;
+    (void)context;
+
+    while(entry) {
+        ab_symbol_p next = entry->next;
+
+        mem_free(entry);
+        entry = next;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
@@ -38,6 +38,9 @@
 
 #include <ab/ab_common.h>
 #include <ab/defs.h>
+#include <lib/capture.h>
+#include <util/hashtable.h>
+#include <util/metrics.h>
 #include <util/rc.h>
 #include <util/vector.h>
 
@@ -51,14 +54,34 @@
 #define SESSION_INC_REQUESTS    (10)
 
 #define MAX_CONN_PATH       (260)   /* 256 plus padding. */
+
+/* upper limit on requests sent but not yet answered in one session. */
+#define MAX_REQUESTS_IN_FLIGHT (8)
+
+/* upper limit for the dhp_max_requests_in_flight attribute. */
+#define MAX_DHP_REQUESTS_IN_FLIGHT (MAX_REQUESTS_IN_FLIGHT)
+
 #define MAX_IP_ADDR_SEG_LEN (16)
 
+/* states of the session symbol instance table. */
+#define SESSION_SYMBOLS_EMPTY   (0)
+#define SESSION_SYMBOLS_LOADING (1)
+#define SESSION_SYMBOLS_LOADED  (2)
+#define SESSION_SYMBOLS_FAILED  (3)
+
+/* how long a check of the controller change counters vouches for the symbol table. */
+#define SESSION_SYMBOLS_CHECK_MS (1000)
+
 
 struct ab_session_t {
 //    int status;
     int failed;
     int on_list;
 
+    /* hashed session index linkage, see find_session_by_host_unsafe(). */
+    int64_t index_key;
+    struct ab_session_t *index_next;
+
     /* gateway connection related info */
     char *host;
     int port;
@@ -96,8 +119,27 @@ struct ab_session_t {
     /* list of outstanding requests for this session */
     vector_p requests;
 
+    /* while non-zero, nothing is sent.  See session_batch_hold(). */
+    int batch_hold;
+
+    /* set when a write that could be merged is queued. */
+    int cip_write_merge_pending;
+
+    /* requests sent but not yet answered.  See process_pipelined_requests(). */
+    int max_requests_in_flight;
+    int num_requests_in_flight;
+    ab_request_p requests_in_flight[MAX_REQUESTS_IN_FLIGHT];
+    uint16_t requests_in_flight_seq[MAX_REQUESTS_IN_FLIGHT];
+    int64_t in_flight_since_us;
+
+    /* set while the session thread waits for a response with room to send more. */
+    int wake_on_request;
+
     uint64_t resp_seq_id;
 
+    /* monotonic time the last response was received, see time_monotonic_us(). */
+    int64_t resp_time_us;
+
     /* data for receiving messages */
     uint32_t data_offset;
     uint32_t data_capacity;
@@ -108,6 +150,25 @@ struct ab_session_t {
 
     uint64_t packet_count;
 
+    /* symbol name to instance table, see session_symbols_lookup(). */
+    hashtable_p symbols;
+    int symbols_state;
+    int symbols_generation;
+    int32_t symbols_loader_id;
+
+    /* controller change counters the table was loaded under, see session_symbols_check_done(). */
+    uint8_t *symbols_changes;
+    int symbols_changes_size;
+    int32_t symbols_checker_id;
+    int64_t symbols_checked_until_us;
+
+    /* runtime statistics */
+    metrics_session_t metrics;
+    int64_t last_send_time_us;
+
+    /* wire capture identity, see plc_tag_capture_start(). */
+    capture_conn_t capture;
+
     thread_p handler_thread;
     volatile int terminating;
     mutex_p mutex;
@@ -136,9 +197,43 @@ struct ab_request_t {
     int allow_packing;
     int packing_num;
 
+    /* connected requests that may be sent before the one ahead is answered. */
+    int allow_pipelining;
+
+    /* requests with the same non-zero batch ID are kept in one packet if they fit. */
+    int32_t batch_id;
+
+    /* SLC/MicroLogix whole element reads of a data file, merged by the session. */
+    int pccc_merge;
+    int pccc_file_type;
+    int pccc_file_num;
+    int pccc_element;
+    int pccc_elem_size;
+    int pccc_elem_count;
+    int pccc_size_offset; /* offset of the transfer size byte, the address follows it. */
+
+    /* Logix writes of array elements, merged by the session. */
+    int cip_write_merge;
+    int cip_name_offset;  /* the encoded name, starting with the path size byte. */
+    int cip_index_offset; /* the element segment at the end of the name. */
+    int cip_type_offset;  /* the type info, followed by the element count and data. */
+    uint32_t cip_index;
+    int cip_elem_count;
+    int cip_elem_size;
+
+    /* the writes a merged write stands in for, see complete_merged_cip_write(). */
+    ab_request_p *merged;
+    int num_merged;
+
     /* time stamp for debugging output */
     int64_t time_sent;
 
+    /* time stamp for queue wait statistics */
+    int64_t time_queued_us;
+
+    /* monotonic time the response was received, for tag read histories. */
+    int64_t time_received_us;
+
     /* used by the background thread for incrementally getting data */
     int request_size; /* total bytes, not just data */
     int request_capacity;
@@ -157,5 +252,16 @@ extern int session_find_or_create(ab_session_p *session, attr attribs);
 extern int session_get_max_payload(ab_session_p session);
 extern int session_create_request(ab_session_p session, int tag_id, ab_request_p *request);
 extern int session_add_request(ab_session_p sess, ab_request_p req);
+extern int session_batch_hold(ab_session_p session);
+extern int session_batch_add_request(ab_session_p session, ab_request_p req, int32_t batch_id);
+extern int session_batch_release(ab_session_p session);
+
+extern int session_symbols_lookup(ab_session_p session, int32_t tag_id, const char *name, uint32_t *instance, int *generation, int *must_load);
+extern int session_symbols_add(ab_session_p session, int32_t tag_id, const char *name, int name_len, uint32_t instance);
+extern void session_symbols_load_done(ab_session_p session, int32_t tag_id, int status);
+extern void session_symbols_invalidate(ab_session_p session, int generation);
+extern int session_symbols_current(ab_session_p session, int32_t tag_id, int generation, int *must_check);
+extern int session_symbols_set_changes(ab_session_p session, int32_t tag_id, const uint8_t *changes, int changes_size);
+extern void session_symbols_check_done(ab_session_p session, int32_t tag_id, int status, const uint8_t *changes, int changes_size);
 
 #endif
@@ -65,6 +65,24 @@ typedef enum {
 } elem_type_t;
 
 
+/* states of symbol instance addressing for a tag. */
+#define AB_SYMBOL_UNRESOLVED  (0)   /* waiting for the session symbol table. */
+#define AB_SYMBOL_LOADING     (1)   /* this tag is loading the session symbol table. */
+#define AB_SYMBOL_RESOLVED    (2)   /* reads use the instance encoded name. */
+#define AB_SYMBOL_SYMBOLIC    (3)   /* the name could not be resolved, stay symbolic. */
+
+/* maximum number of fragment requests a large read keeps in flight. */
+#define AB_MAX_READ_FRAGS (8)
+
+/* one in-flight piece of a parallel fragmented read. */
+typedef struct {
+    ab_request_p req;
+    int offset;     /* next byte this fragment will read. */
+    int end;        /* first byte past this fragment. */
+    int last;       /* set if this fragment reaches the end of the tag. */
+} ab_read_frag_t;
+
+
 struct ab_tag_t {
     /*struct plc_tag_t p_tag;*/
     TAG_BASE_STRUCT;
@@ -88,6 +106,7 @@ struct ab_tag_t {
 
     /* number of elements and size of each in the tag. */
     pccc_file_t file_type;
+    pccc_addr_t pccc_addr;
     elem_type_t elem_type;
 
     int elem_count;
@@ -100,10 +119,16 @@ struct ab_tag_t {
 
     /* used for listing tags. */
     uint32_t next_id;
+    char *listing_prefix;
+    char *udt_cache_file;
+    int listing_type;
 
     /* used for UDT tags. */
     uint8_t udt_get_fields;
+    uint8_t udt_get_changes;
     uint16_t udt_id;
+    uint8_t *udt_changes;
+    int udt_changes_size;
 
     /* requests */
     int pre_write_read;
@@ -111,6 +136,26 @@ struct ab_tag_t {
     ab_request_p req;
     int offset;
 
+    /* symbol instance addressing for reads. */
+    int use_symbol_instance;
+    int symbol_state;
+    int symbol_generation;
+    int symbol_retried;
+    int symbol_checking;
+    int read_by_instance;
+    uint32_t symbol_instance;
+    uint32_t symbol_next_id;
+    ab_request_p symbol_req;
+    uint8_t *instance_name;
+    int instance_name_size;
+
+    /* parallel fragmented reads of large tags. */
+    int read_frag_window;
+    int read_frag_size;
+    int read_frag_next;
+    int read_frags_active;
+    ab_read_frag_t read_frags[AB_MAX_READ_FRAGS];
+
     int allow_packing;
 
     /* flags for operations */
@@ -0,0 +1,963 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <lib/libplctag.h>
+#include <platform.h>
+#include <ab/udt_cache.h>
+#include <util/debug.h>
+#include <util/hash.h>
+#include <util/hashtable.h>
+
+
+#define UDT_CACHE_MAGIC "LPTUDTC2"
+#define UDT_CACHE_MAGIC_SIZE (8)
+#define UDT_CACHE_MAX_DATA_SIZE (0x100000)
+#define UDT_CACHE_TMP_SUFFIX ".tmp"
+#define UDT_CACHE_SAVE_INTERVAL_MS (1000)
+
+typedef struct udt_cache_entry_t udt_cache_entry_t;
+
+struct udt_cache_entry_t {
+    udt_cache_entry_t *next;
+    char *host;
+    char *path;
+    uint16_t udt_id;
+    int changes_size;
+    uint8_t *changes;
+    int data_size;
+    uint8_t *data;
+};
+
+/* one table per cache file, tags without a file share the first one. */
+typedef struct udt_cache_t udt_cache_t;
+
+struct udt_cache_t {
+    udt_cache_t *next;
+    char *file_name;
+    hashtable_p entries;
+    int dirty;
+    int64_t next_save_ms;
+};
+
+
+static mutex_p udt_cache_mutex = NULL;
+static udt_cache_t *udt_caches = NULL;
+
+
+static udt_cache_t *find_cache_unsafe(const char *file_name);
+static udt_cache_t *create_cache_unsafe(const char *file_name);
+static void destroy_cache(udt_cache_t *cache);
+static int64_t make_key(const char *host, const char *path, uint16_t udt_id);
+static udt_cache_entry_t *find_entry_unsafe(udt_cache_t *cache, const char *host, const char *path, uint16_t udt_id);
+static int put_entry_unsafe(udt_cache_t *cache, const char *host, const char *path, uint16_t udt_id, uint8_t *changes, int changes_size, uint8_t *data, int data_size, int *is_new);
+static void remove_entry_unsafe(udt_cache_t *cache, udt_cache_entry_t *entry);
+static void free_entry(udt_cache_entry_t *entry);
+static int free_entries(hashtable_p table, int64_t key, void *data, void *context);
+static int load_file_unsafe(udt_cache_t *cache);
+static void mark_dirty_unsafe(udt_cache_t *cache);
+static void flush_file_unsafe(udt_cache_t *cache, int force);
+static int save_file_unsafe(udt_cache_t *cache);
+static int write_entry(FILE *file, udt_cache_entry_t *entry);
+static int count_entries(hashtable_p table, int64_t key, void *data, void *context);
+static int write_entries(hashtable_p table, int64_t key, void *data, void *context);
+static int read_uint16(FILE *file, uint16_t *val);
+static int read_uint32(FILE *file, uint32_t *val);
+static int read_str(FILE *file, char **str);
+static int read_bytes(FILE *file, uint8_t **bytes, int *size);
+static int write_uint16(FILE *file, uint16_t val);
+static int write_uint32(FILE *file, uint32_t val);
+static int write_str(FILE *file, const char *str);
+static int write_bytes(FILE *file, uint8_t *bytes, int size);
+
+
+
+int udt_cache_startup(void)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    rc = mutex_create(&udt_cache_mutex);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_ERROR, "Unable to create UDT cache mutex!");
+        return rc;
+    }
+
+    /* the table for tags that do not use a file. */
+    udt_caches = create_cache_unsafe(NULL);
+    if(!udt_caches) {
+        pdebug(DEBUG_ERROR, "Unable to create UDT cache table!");
+        mutex_destroy(&udt_cache_mutex);
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    return rc;
+}
+
+
+
+void udt_cache_teardown(void)
+{
+    pdebug(DEBUG_INFO, "Starting.");
+
+    while(udt_caches) {
+        udt_cache_t *next = udt_caches->next;
+
+        /* nothing else uses the caches now. */
+        flush_file_unsafe(udt_caches, 1);
+
+        destroy_cache(udt_caches);
+        udt_caches = next;
+    }
+
+    if(udt_cache_mutex) {
+        mutex_destroy(&udt_cache_mutex);
+        udt_cache_mutex = NULL;
+    }
+
+    pdebug(DEBUG_INFO, "Done.");
+}
+
+
+
+/*
+ * Make sure the table for a cache file exists.  The file is loaded the
+ * first time any tag names it.  Tags that name different files each get
+ * their own table and file.
+ */
+
+int udt_cache_open_file(const char *file_name)
+{
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!file_name || str_length(file_name) == 0) {
+        pdebug(DEBUG_WARN, "UDT cache file name is missing or empty!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    critical_block(udt_cache_mutex) {
+        udt_cache_t *cache = find_cache_unsafe(file_name);
+
+        if(cache) {
+            break;
+        }
+
+        cache = create_cache_unsafe(file_name);
+        if(!cache) {
+            rc = PLCTAG_ERR_NO_MEM;
+            break;
+        }
+
+        /* a missing or bad file is not fatal, it will be rewritten. */
+        load_file_unsafe(cache);
+    }
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * Look up a template.  When the caller has the controller change counters,
+ * the entry must have been stored under the same counters.  An entry from
+ * before the counters moved is thrown away.  Without counters, the header
+ * must match the cached header exactly.
+ *
+ * On a hit, a copy of the whole cached buffer is returned and the caller
+ * owns it.
+ */
+
+int udt_cache_get(const char *file_name, const char *host, const char *path, uint16_t udt_id, uint8_t *changes, int changes_size, uint8_t *header, uint8_t **data, int *data_size)
+{
+    int rc = PLCTAG_ERR_NOT_FOUND;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    *data = NULL;
+    *data_size = 0;
+
+    critical_block(udt_cache_mutex) {
+        udt_cache_t *cache = find_cache_unsafe(file_name);
+        udt_cache_entry_t *entry = NULL;
+
+        if(!cache) {
+            break;
+        }
+
+        entry = find_entry_unsafe(cache, host, path, udt_id);
+        if(!entry) {
+            break;
+        }
+
+        if(changes_size > 0) {
+            if(mem_cmp(entry->changes, entry->changes_size, changes, changes_size) != 0) {
+                pdebug(DEBUG_INFO, "Controller changed since template %u was cached, dropping it.", udt_id);
+
+                remove_entry_unsafe(cache, entry);
+                mark_dirty_unsafe(cache);
+
+                break;
+            }
+        } else if(!header || mem_cmp(entry->data, UDT_CACHE_HEADER_SIZE, header, UDT_CACHE_HEADER_SIZE) != 0) {
+            pdebug(DEBUG_INFO, "Cached template %u does not match the controller metadata.", udt_id);
+            break;
+        }
+
+        *data = mem_alloc(entry->data_size);
+        if(!*data) {
+            rc = PLCTAG_ERR_NO_MEM;
+            break;
+        }
+
+        mem_copy(*data, entry->data, entry->data_size);
+        *data_size = entry->data_size;
+
+        rc = PLCTAG_STATUS_OK;
+    }
+
+    pdebug(DEBUG_DETAIL, "Done with status %s.", plc_tag_decode_error(rc));
+
+    return rc;
+}
+
+
+
+int udt_cache_put(const char *file_name, const char *host, const char *path, uint16_t udt_id, uint8_t *changes, int changes_size, uint8_t *data, int data_size)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int is_new = 0;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    if(!data || data_size < UDT_CACHE_HEADER_SIZE || data_size > UDT_CACHE_MAX_DATA_SIZE || changes_size < 0 || changes_size > UINT16_MAX) {
+        pdebug(DEBUG_WARN, "Bad UDT data for the cache!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    critical_block(udt_cache_mutex) {
+        udt_cache_t *cache = find_cache_unsafe(file_name);
+
+        if(!cache) {
+            rc = PLCTAG_ERR_NOT_FOUND;
+            break;
+        }
+
+        rc = put_entry_unsafe(cache, host, path, udt_id, changes, changes_size, data, data_size, &is_new);
+
+        if(rc == PLCTAG_STATUS_OK && is_new) {
+            mark_dirty_unsafe(cache);
+        }
+    }
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return rc;
+}
+
+
+
+/*
+ * Write out a cache file with changes that have not been saved yet.  This
+ * is called when a tag that names the file is destroyed.
+ */
+
+void udt_cache_flush(const char *file_name)
+{
+    if(!file_name) {
+        return;
+    }
+
+    critical_block(udt_cache_mutex) {
+        udt_cache_t *cache = find_cache_unsafe(file_name);
+
+        if(cache) {
+            flush_file_unsafe(cache, 1);
+        }
+    }
+}
+
+
+
+/*
+ * Helpers.
+ */
+
+udt_cache_t *find_cache_unsafe(const char *file_name)
+{
+    udt_cache_t *cache = udt_caches;
+
+    for(; cache; cache = cache->next) {
+        if(!file_name && !cache->file_name) {
+            break;
+        }
+
+        if(file_name && cache->file_name && str_cmp(cache->file_name, file_name) == 0) {
+            break;
+        }
+    }
+
+    return cache;
+}
+
+
+
+udt_cache_t *create_cache_unsafe(const char *file_name)
+{
+    udt_cache_t *cache = mem_alloc((int)sizeof(*cache));
+
+    if(!cache) {
+        return NULL;
+    }
+
+    if(file_name) {
+        cache->file_name = str_dup(file_name);
+        if(!cache->file_name) {
+            mem_free(cache);
+            return NULL;
+        }
+    }
+
+    cache->entries = hashtable_create(64);
+    if(!cache->entries) {
+        if(cache->file_name) mem_free(cache->file_name);
+        mem_free(cache);
+        return NULL;
+    }
+
+    /* the shared table stays first. */
+    if(udt_caches) {
+        cache->next = udt_caches->next;
+        udt_caches->next = cache;
+    }
+
+    return cache;
+}
+
+
+
+void destroy_cache(udt_cache_t *cache)
+{
+    hashtable_on_each(cache->entries, free_entries, NULL);
+    hashtable_destroy(cache->entries);
+
+    if(cache->file_name) {
+        mem_free(cache->file_name);
+    }
+
+    mem_free(cache);
+}
+
+
+
+int64_t make_key(const char *host, const char *path, uint16_t udt_id)
+{
+    uint32_t host_hash = hash_str_i(host, (uint32_t)udt_id);
+
+    return (int64_t)(((uint64_t)host_hash << 32) | (uint64_t)hash_str_i(path, host_hash));
+}
+
+
+
+udt_cache_entry_t *find_entry_unsafe(udt_cache_t *cache, const char *host, const char *path, uint16_t udt_id)
+{
+    udt_cache_entry_t *entry = hashtable_get(cache->entries, make_key(host, path, udt_id));
+
+    for(; entry; entry = entry->next) {
+        if(entry->udt_id == udt_id && str_cmp_i(entry->host, host ? host : "") == 0 && str_cmp_i(entry->path, path ? path : "") == 0) {
+            break;
+        }
+    }
+
+    return entry;
+}
+
+
+
+/* add or replace an entry.  is_new is set if the data or the change counters changed. */
+int put_entry_unsafe(udt_cache_t *cache, const char *host, const char *path, uint16_t udt_id, uint8_t *changes, int changes_size, uint8_t *data, int data_size, int *is_new)
+{
+    int64_t key = make_key(host, path, udt_id);
+    udt_cache_entry_t *entry = find_entry_unsafe(cache, host, path, udt_id);
+    uint8_t *new_data = NULL;
+    uint8_t *new_changes = NULL;
+
+    *is_new = 0;
+
+    if(entry && mem_cmp(entry->data, entry->data_size, data, data_size) == 0 && mem_cmp(entry->changes, entry->changes_size, changes, changes_size) == 0) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    new_data = mem_alloc(data_size);
+    if(!new_data) {
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    mem_copy(new_data, data, data_size);
+
+    if(changes_size > 0) {
+        new_changes = mem_alloc(changes_size);
+        if(!new_changes) {
+            mem_free(new_data);
+            return PLCTAG_ERR_NO_MEM;
+        }
+
+        mem_copy(new_changes, changes, changes_size);
+    }
+
+    if(!entry) {
+        entry = mem_alloc((int)sizeof(*entry));
+        if(!entry) {
+            if(new_changes) mem_free(new_changes);
+            mem_free(new_data);
+            return PLCTAG_ERR_NO_MEM;
+        }
+
+        entry->host = str_dup(host ? host : "");
+        entry->path = str_dup(path ? path : "");
+        entry->udt_id = udt_id;
+
+        if(!entry->host || !entry->path) {
+            if(entry->host) mem_free(entry->host);
+            if(entry->path) mem_free(entry->path);
+            mem_free(entry);
+            if(new_changes) mem_free(new_changes);
+            mem_free(new_data);
+            return PLCTAG_ERR_NO_MEM;
+        }
+
+        entry->next = hashtable_get(cache->entries, key);
+
+        if(hashtable_put(cache->entries, key, entry) != PLCTAG_STATUS_OK) {
+            mem_free(entry->host);
+            mem_free(entry->path);
+            mem_free(entry);
+            if(new_changes) mem_free(new_changes);
+            mem_free(new_data);
+            return PLCTAG_ERR_NO_MEM;
+        }
+    } else {
+        mem_free(entry->data);
+
+        if(entry->changes) {
+            mem_free(entry->changes);
+        }
+    }
+
+    entry->data = new_data;
+    entry->data_size = data_size;
+    entry->changes = new_changes;
+    entry->changes_size = changes_size;
+
+    *is_new = 1;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+void remove_entry_unsafe(udt_cache_t *cache, udt_cache_entry_t *entry)
+{
+    int64_t key = make_key(entry->host, entry->path, entry->udt_id);
+    udt_cache_entry_t *head = hashtable_get(cache->entries, key);
+
+    if(head == entry) {
+        if(entry->next) {
+            hashtable_put(cache->entries, key, entry->next);
+        } else {
+            hashtable_remove(cache->entries, key);
+        }
+    } else {
+        for(; head && head->next != entry; head = head->next) { }
+
+        if(head) {
+            head->next = entry->next;
+        }
+    }
+
+    free_entry(entry);
+}
+
+
+
+void free_entry(udt_cache_entry_t *entry)
+{
+    mem_free(entry->host);
+    mem_free(entry->path);
+    mem_free(entry->data);
+
+    if(entry->changes) {
+        mem_free(entry->changes);
+    }
+
+    mem_free(entry);
+}
+
+
+
+int free_entries(hashtable_p table, int64_t key, void *data, void *context)
+{
+    udt_cache_entry_t *entry = (udt_cache_entry_t *)data;
+
+    (void)table;
+    (void)key;
+    (void)context;
+
+    while(entry) {
+        udt_cache_entry_t *next = entry->next;
+
+        free_entry(entry);
+
+        entry = next;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+/*
+ * Cache file format, all integers little endian:
+ *
+ * Bytes    Meaning
+ * 0-7      magic, "LPTUDTC2".
+ * then any number of records:
+ *          16-bit host length, host characters.
+ *          16-bit path length, path characters.
+ *          16-bit UDT ID.
+ *          16-bit change counter size, change counter bytes.
+ *          32-bit data size, data bytes.
+ *
+ * Later records replace earlier ones.  The file is always written whole
+ * to a temporary file next to it and renamed over it, so a crash or a
+ * second process never sees a half written file.  The temporary file name
+ * has the process ID in it so that two processes do not write the same
+ * one.
+ *
+ * Changes only mark the table dirty.  While the templates of a large
+ * controller are read, the file is written at most once per
+ * UDT_CACHE_SAVE_INTERVAL_MS, and the rest goes out when a tag using the
+ * file is destroyed or at teardown.
+ */
+
+int load_file_unsafe(udt_cache_t *cache)
+{
+    const char *file_name = cache->file_name;
+    FILE *file = NULL;
+    char magic[UDT_CACHE_MAGIC_SIZE];
+    int records = 0;
+    int entries = 0;
+    int rc = PLCTAG_STATUS_OK;
+
+    pdebug(DEBUG_INFO, "Loading UDT cache file %s.", file_name);
+
+    file = fopen(file_name, "rb");
+    if(!file) {
+        pdebug(DEBUG_INFO, "UDT cache file %s does not exist yet.", file_name);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    if(fread(magic, 1, sizeof(magic), file) != sizeof(magic) || mem_cmp(magic, (int)sizeof(magic), UDT_CACHE_MAGIC, UDT_CACHE_MAGIC_SIZE) != 0) {
+        pdebug(DEBUG_WARN, "File %s is not a UDT cache file!", file_name);
+        fclose(file);
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    while(rc == PLCTAG_STATUS_OK) {
+        char *host = NULL;
+        char *path = NULL;
+        uint16_t udt_id = 0;
+        uint8_t *changes = NULL;
+        int changes_size = 0;
+        uint32_t data_size = 0;
+        uint8_t *data = NULL;
+        int is_new = 0;
+
+        /* a clean end of file between records. */
+        if(read_str(file, &host) != PLCTAG_STATUS_OK) {
+            if(!feof(file)) {
+                rc = PLCTAG_ERR_BAD_DATA;
+            }
+
+            break;
+        }
+
+        do {
+            if(read_str(file, &path) != PLCTAG_STATUS_OK || read_uint16(file, &udt_id) != PLCTAG_STATUS_OK
+               || read_bytes(file, &changes, &changes_size) != PLCTAG_STATUS_OK || read_uint32(file, &data_size) != PLCTAG_STATUS_OK) {
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
+            if(data_size < UDT_CACHE_HEADER_SIZE || data_size > UDT_CACHE_MAX_DATA_SIZE) {
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
+            data = mem_alloc((int)data_size);
+            if(!data) {
+                rc = PLCTAG_ERR_NO_MEM;
+                break;
+            }
+
+            if(fread(data, 1, data_size, file) != data_size) {
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
+            rc = put_entry_unsafe(cache, host, path, udt_id, changes, changes_size, data, (int)data_size, &is_new);
+
+            records++;
+        } while(0);
+
+        mem_free(host);
+        if(path) mem_free(path);
+        if(changes) mem_free(changes);
+        if(data) mem_free(data);
+    }
+
+    fclose(file);
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "UDT cache file %s is damaged after %d records, error %s!", file_name, records, plc_tag_decode_error(rc));
+    }
+
+    hashtable_on_each(cache->entries, count_entries, &entries);
+
+    pdebug(DEBUG_INFO, "Loaded %d records for %d templates from %s.", records, entries, file_name);
+
+    /* rewrite the file if it has replaced records or damage. */
+    if(rc != PLCTAG_STATUS_OK || records != entries) {
+        mark_dirty_unsafe(cache);
+    }
+
+    return rc;
+}
+
+
+
+void mark_dirty_unsafe(udt_cache_t *cache)
+{
+    if(!cache->file_name) {
+        return;
+    }
+
+    cache->dirty = 1;
+
+    flush_file_unsafe(cache, 0);
+}
+
+
+
+/* write the file if it is dirty and, unless forced, the save interval is up. */
+void flush_file_unsafe(udt_cache_t *cache, int force)
+{
+    int64_t now = 0;
+
+    if(!cache->file_name || !cache->dirty) {
+        return;
+    }
+
+    now = time_ms();
+
+    if(!force && now < cache->next_save_ms) {
+        return;
+    }
+
+    /* a failed write is tried again with the next change or flush. */
+    if(save_file_unsafe(cache) == PLCTAG_STATUS_OK) {
+        cache->dirty = 0;
+    }
+
+    cache->next_save_ms = now + UDT_CACHE_SAVE_INTERVAL_MS;
+}
+
+
+
+int save_file_unsafe(udt_cache_t *cache)
+{
+    int rc = PLCTAG_STATUS_OK;
+    int tmp_name_size = str_length(cache->file_name) + str_length(UDT_CACHE_TMP_SUFFIX) + 22; /* MAGIC, a dot and a 64-bit ID. */
+    char *tmp_name = NULL;
+    FILE *file = NULL;
+
+    tmp_name = mem_alloc(tmp_name_size);
+    if(!tmp_name) {
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    snprintf_platform(tmp_name, (size_t)(unsigned int)tmp_name_size, "%s.%" PRId64 "%s", cache->file_name, process_id(), UDT_CACHE_TMP_SUFFIX);
+
+    file = fopen(tmp_name, "wb");
+    if(!file) {
+        pdebug(DEBUG_WARN, "Unable to open UDT cache file %s!", tmp_name);
+        mem_free(tmp_name);
+        return PLCTAG_ERR_OPEN;
+    }
+
+    if(fwrite(UDT_CACHE_MAGIC, 1, UDT_CACHE_MAGIC_SIZE, file) != UDT_CACHE_MAGIC_SIZE) {
+        rc = PLCTAG_ERR_WRITE;
+    }
+
+    if(rc == PLCTAG_STATUS_OK) {
+        hashtable_on_each(cache->entries, write_entries, file);
+
+        if(ferror(file)) {
+            rc = PLCTAG_ERR_WRITE;
+        }
+    }
+
+    if(fclose(file) != 0 && rc == PLCTAG_STATUS_OK) {
+        rc = PLCTAG_ERR_WRITE;
+    }
+
+    if(rc == PLCTAG_STATUS_OK && rename(tmp_name, cache->file_name) != 0) {
+        /* Windows will not rename over an existing file. */
+        remove(cache->file_name);
+
+        if(rename(tmp_name, cache->file_name) != 0) {
+            rc = PLCTAG_ERR_WRITE;
+        }
+    }
+
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to write UDT cache file %s!", cache->file_name);
+        remove(tmp_name);
+    }
+
+    mem_free(tmp_name);
+
+    return rc;
+}
+
+
+
+int write_entry(FILE *file, udt_cache_entry_t *entry)
+{
+    if(write_str(file, entry->host) != PLCTAG_STATUS_OK
+       || write_str(file, entry->path) != PLCTAG_STATUS_OK
+       || write_uint16(file, entry->udt_id) != PLCTAG_STATUS_OK
+       || write_bytes(file, entry->changes, entry->changes_size) != PLCTAG_STATUS_OK
+       || write_uint32(file, (uint32_t)entry->data_size) != PLCTAG_STATUS_OK
+       || fwrite(entry->data, 1, (size_t)entry->data_size, file) != (size_t)entry->data_size) {
+        return PLCTAG_ERR_WRITE;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int count_entries(hashtable_p table, int64_t key, void *data, void *context)
+{
+    (void)table;
+    (void)key;
+
+    for(udt_cache_entry_t *entry = data; entry; entry = entry->next) {
+        (*(int *)context)++;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int write_entries(hashtable_p table, int64_t key, void *data, void *context)
+{
+    (void)table;
+    (void)key;
+
+    for(udt_cache_entry_t *entry = data; entry; entry = entry->next) {
+        write_entry((FILE *)context, entry);
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int read_uint16(FILE *file, uint16_t *val)
+{
+    uint8_t buf[2];
+
+    if(fread(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+        return PLCTAG_ERR_READ;
+    }
+
+    *val = (uint16_t)(buf[0] | (buf[1] << 8));
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int read_uint32(FILE *file, uint32_t *val)
+{
+    uint8_t buf[4];
+
+    if(fread(buf, 1, sizeof(buf), file) != sizeof(buf)) {
+        return PLCTAG_ERR_READ;
+    }
+
+    *val = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int read_str(FILE *file, char **str)
+{
+    uint16_t len = 0;
+
+    *str = NULL;
+
+    if(read_uint16(file, &len) != PLCTAG_STATUS_OK) {
+        return PLCTAG_ERR_READ;
+    }
+
+    *str = mem_alloc(len + 1);
+    if(!*str) {
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    if(fread(*str, 1, len, file) != len) {
+        mem_free(*str);
+        *str = NULL;
+        return PLCTAG_ERR_READ;
+    }
+
+    (*str)[len] = 0;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+
+/* a 16-bit length and that many bytes.  Zero bytes gives a NULL buffer. */
+int read_bytes(FILE *file, uint8_t **bytes, int *size)
+{
+    uint16_t len = 0;
+
+    *bytes = NULL;
+    *size = 0;
+
+    if(read_uint16(file, &len) != PLCTAG_STATUS_OK) {
+        return PLCTAG_ERR_READ;
+    }
+
+    if(len == 0) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    *bytes = mem_alloc(len);
+    if(!*bytes) {
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    if(fread(*bytes, 1, len, file) != len) {
+        mem_free(*bytes);
+        *bytes = NULL;
+        return PLCTAG_ERR_READ;
+    }
+
+    *size = len;
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int write_uint16(FILE *file, uint16_t val)
+{
+    uint8_t buf[2];
+
+    buf[0] = (uint8_t)(val & 0xFF);
+    buf[1] = (uint8_t)((val >> 8) & 0xFF);
+
+    return (fwrite(buf, 1, sizeof(buf), file) == sizeof(buf) ? PLCTAG_STATUS_OK : PLCTAG_ERR_WRITE);
+}
+
+
+
+int write_uint32(FILE *file, uint32_t val)
+{
+    uint8_t buf[4];
+
+    buf[0] = (uint8_t)(val & 0xFF);
+    buf[1] = (uint8_t)((val >> 8) & 0xFF);
+    buf[2] = (uint8_t)((val >> 16) & 0xFF);
+    buf[3] = (uint8_t)((val >> 24) & 0xFF);
+
+    return (fwrite(buf, 1, sizeof(buf), file) == sizeof(buf) ? PLCTAG_STATUS_OK : PLCTAG_ERR_WRITE);
+}
+
+
+
+int write_str(FILE *file, const char *str)
+{
+    int len = str_length(str);
+
+    if(len > UINT16_MAX) {
+        return PLCTAG_ERR_TOO_LARGE;
+    }
+
+    if(write_uint16(file, (uint16_t)len) != PLCTAG_STATUS_OK) {
+        return PLCTAG_ERR_WRITE;
+    }
+
+    return (fwrite(str, 1, (size_t)len, file) == (size_t)len ? PLCTAG_STATUS_OK : PLCTAG_ERR_WRITE);
+}
+
+
+
+int write_bytes(FILE *file, uint8_t *bytes, int size)
+{
+    if(size < 0 || size > UINT16_MAX) {
+        return PLCTAG_ERR_TOO_LARGE;
+    }
+
+    if(write_uint16(file, (uint16_t)size) != PLCTAG_STATUS_OK) {
+        return PLCTAG_ERR_WRITE;
+    }
+
+    return (size == 0 || fwrite(bytes, 1, (size_t)size, file) == (size_t)size ? PLCTAG_STATUS_OK : PLCTAG_ERR_WRITE);
+}
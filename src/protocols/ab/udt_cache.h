@@ -0,0 +1,66 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Process-wide cache of UDT template definitions.
+ *
+ * Entries are keyed by the controller (gateway host and path) and the
+ * template ID.  An entry holds the whole @udt tag buffer: the 14-byte
+ * header built from the template metadata and the raw field definitions.
+ * Each entry also keeps the controller change counters (see @changes) it
+ * was read under.  A lookup with the current counters hits without asking
+ * for the metadata, and drops the entry if the counters moved.  Without
+ * counters, the header, which includes the structure handle (CRC) and
+ * sizes, must match what the controller reports now.
+ *
+ * The cache can be backed by files.  Each file name gets its own table,
+ * loaded the first time a tag names the file.  New entries mark the table
+ * dirty.  Its file is rewritten through a temporary file and a rename at
+ * most once a second, when a tag that names it is destroyed and at
+ * teardown.  Tags without a file share one table that is never written
+ * out.
+ */
+
+#define UDT_CACHE_HEADER_SIZE (14)
+
+extern int udt_cache_startup(void);
+extern void udt_cache_teardown(void);
+
+extern int udt_cache_open_file(const char *file_name);
+extern void udt_cache_flush(const char *file_name);
+extern int udt_cache_get(const char *file_name, const char *host, const char *path, uint16_t udt_id, uint8_t *changes, int changes_size, uint8_t *header, uint8_t **data, int *data_size);
+extern int udt_cache_put(const char *file_name, const char *host, const char *path, uint16_t udt_id, uint8_t *changes, int changes_size, uint8_t *data, int data_size);
@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <platform.h>
 #include <lib/libplctag.h>
+#include <lib/capture.h>
 #include <mb/modbus.h>
 #include <util/atomic_int.h>
 #include <util/attr.h>
@@ -119,11 +120,15 @@ struct modbus_plc_t {
     int read_data_len;
     uint8_t read_data[PLC_READ_DATA_LEN];
     int32_t response_tag_id;
+    int64_t response_time_us;
 
     int write_data_len;
     int write_data_offset;
     uint8_t write_data[PLC_WRITE_DATA_LEN];
     int32_t request_tag_id;
+
+    /* wire capture identity, see plc_tag_capture_start(). */
+    capture_conn_t capture;
 };
 
 typedef struct modbus_plc_t *modbus_plc_p;
@@ -265,7 +270,11 @@ struct tag_vtable_t modbus_vtable = {
     mb_get_int_attrib,
     mb_set_int_attrib,
 
-    NULL /* no buffer attribute handler */
+    NULL, /* no buffer attribute handler */
+
+    /* no transaction batching */
+    (tag_vtable_func)NULL,
+    NULL
 };
 
 
@@ -460,6 +469,8 @@ void modbus_tag_destructor(void *tag_arg)
         tag->byte_order = NULL;
     }
 
+    plc_tag_generic_destroy_data_pub((plc_tag_p)tag);
+
     pdebug(DEBUG_INFO, "Done.");
 }
 
@@ -1008,6 +1019,8 @@ int connect_plc(modbus_plc_p plc)
         server_port = NULL;
     }
 
+    capture_conn_open(&(plc->capture), port);
+
     /* clear the state for reading and writing. */
     plc->flags.request_ready = 0;
     plc->flags.response_ready = 0;
@@ -1466,6 +1479,8 @@ int receive_response(modbus_plc_p plc)
         /* we got our packet. */
         pdebug(DEBUG_DETAIL, "Received full packet.");
         pdebug_dump_bytes(DEBUG_DETAIL, plc->read_data, plc->read_data_len);
+        plc->response_time_us = time_monotonic_us();
+        capture_frame(&(plc->capture), 1, plc->read_data, plc->read_data_len);
         plc->flags.response_ready = 1;
 
         rc = PLCTAG_STATUS_OK;
@@ -1528,6 +1543,7 @@ int send_request(modbus_plc_p plc)
     if(data_left == 0) {
         pdebug(DEBUG_DETAIL, "Full packet written.");
         pdebug_dump_bytes(DEBUG_DETAIL, plc->write_data, plc->write_data_len);
+        capture_frame(&(plc->capture), 0, plc->write_data, plc->write_data_len);
 
         // plc->flags.request_ready = 0;
         plc->write_data_len = 0;
@@ -1698,7 +1714,9 @@ int check_read_response(modbus_plc_p plc, modbus_tag_p tag)
             pdebug(DEBUG_DETAIL, "byte_offset = %d", byte_offset);
             pdebug(DEBUG_DETAIL, "copy_size = %d", copy_size);
 
+            tag_data_change_begin((plc_tag_p)tag);
             mem_copy(tag->data + byte_offset, &plc->read_data[9], copy_size);
+            tag->read_received_us = plc->response_time_us;
 
             /* are we done? */
             if(tag->size > (byte_offset + copy_size)) {
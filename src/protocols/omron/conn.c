@@ -38,6 +38,8 @@
 #include <omron/conn.h>
 #include <omron/tag.h>
 #include <util/debug.h>
+#include <util/hash.h>
+#include <util/hashtable.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
@@ -95,6 +97,7 @@ static int add_conn_unsafe(omron_conn_p n);
 static int remove_conn_unsafe(omron_conn_p n);
 static omron_conn_p find_conn_by_host_unsafe(const char *gateway, const char *path, int connection_group_id);
 static int conn_match_valid(const char *host, const char *path, omron_conn_p conn);
+static int64_t conn_index_key(const char *host, const char *path, int connection_group_id);
 static int conn_add_request_unsafe(omron_conn_p conn, omron_request_p req);
 static int conn_open_socket(omron_conn_p conn);
 static void conn_destroy(void *conn);
@@ -130,6 +133,7 @@ static int conn_request_increase_buffer(omron_request_p request, int new_capacit
 
 static volatile mutex_p conn_mutex = NULL;
 static volatile vector_p conns = NULL;
+static volatile hashtable_p conn_index = NULL;
 
 
 
@@ -148,6 +152,11 @@ int conn_startup()
         return PLCTAG_ERR_NO_MEM;
     }
 
+    if((conn_index = hashtable_create(32)) == NULL) {
+        pdebug(DEBUG_ERROR, "Unable to create conn index!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
     return rc;
 }
 
@@ -181,6 +190,11 @@ void conn_teardown()
         conns = NULL;
     }
 
+    if(conn_index) {
+        hashtable_destroy(conn_index);
+        conn_index = NULL;
+    }
+
     pdebug(DEBUG_DETAIL, "Destroying conn mutex.");
 
     if(conn_mutex) {
@@ -361,6 +375,14 @@ int add_conn_unsafe(omron_conn_p conn)
 
     vector_put(conns, vector_length(conns), conn);
 
+    /* push the conn on the front of the chain for its key. */
+    conn->index_key = conn_index_key(conn->host, conn->path, conn->connection_group_id);
+    conn->index_next = hashtable_get(conn_index, conn->index_key);
+    if(hashtable_put(conn_index, conn->index_key, conn) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to index conn, it will not be shared!");
+        conn->index_next = NULL;
+    }
+
     conn->on_list = 1;
 
     pdebug(DEBUG_DETAIL, "Done");
@@ -405,6 +427,28 @@ int remove_conn_unsafe(omron_conn_p conn)
         }
     }
 
+    /* unlink the conn from its index chain. */
+    if(conn_index) {
+        omron_conn_p head = hashtable_get(conn_index, conn->index_key);
+
+        if(head == conn) {
+            if(conn->index_next) {
+                hashtable_put(conn_index, conn->index_key, conn->index_next);
+            } else {
+                hashtable_remove(conn_index, conn->index_key);
+            }
+        } else {
+            for(omron_conn_p tmp = head; tmp; tmp = tmp->index_next) {
+                if(tmp->index_next == conn) {
+                    tmp->index_next = conn->index_next;
+                    break;
+                }
+            }
+        }
+
+        conn->index_next = NULL;
+    }
+
     pdebug(DEBUG_DETAIL, "Done");
 
     return PLCTAG_STATUS_OK;
@@ -461,13 +505,34 @@ int conn_match_valid(const char *host, const char *path, omron_conn_p conn)
 }
 
 
+/*
+ * Build the index key for a conn.  Host and path are compared without
+ * regard to case, so they are hashed the same way.  Keys can collide, so
+ * each key holds a chain of conns that are checked with conn_match_valid().
+ */
+
+int64_t conn_index_key(const char *host, const char *path, int connection_group_id)
+{
+    uint32_t host_hash = hash_str_i(host, (uint32_t)connection_group_id);
+    uint32_t path_hash = hash_str_i(path, host_hash);
+
+    return (int64_t)(((uint64_t)host_hash << 32) | (uint64_t)path_hash);
+}
+
+
 omron_conn_p find_conn_by_host_unsafe(const char *host, const char *path, int connection_group_id)
 {
-    for(int i=0; i < vector_length(conns); i++) {
-        omron_conn_p conn = vector_get(conns, i);
+    omron_conn_p chain = NULL;
+
+    if(!conn_index) {
+        return NULL;
+    }
+
+    chain = hashtable_get(conn_index, conn_index_key(host, path, connection_group_id));
 
+    for(; chain; chain = chain->index_next) {
         /* is this conn in the process of destruction? */
-        conn = rc_inc(conn);
+        omron_conn_p conn = rc_inc(chain);
         if(conn) {
             if(conn->connection_group_id == connection_group_id && conn_match_valid(host, path, conn)) {
                 return conn;
@@ -760,6 +825,8 @@ int conn_open_socket(omron_conn_p conn)
         return rc;
     }
 
+    capture_conn_open(&(conn->capture), port);
+
     if(server_port) {
         mem_free(server_port);
     }
@@ -2042,6 +2109,8 @@ int send_eip_request(omron_conn_p conn, int timeout)
         return PLCTAG_ERR_TIMEOUT;
     }
 
+    capture_frame(&(conn->capture), 0, conn->data, (int)conn->data_size);
+
     pdebug(DEBUG_INFO, "Done.");
 
     return PLCTAG_STATUS_OK;
@@ -2130,6 +2199,7 @@ int recv_eip_response(omron_conn_p conn, int timeout)
 
     conn->resp_seq_id = le2h64(((eip_encap *)(conn->data))->encap_sender_context);
     conn->data_size = data_needed;
+    capture_frame(&(conn->capture), 1, conn->data, (int)data_needed);
 
     rc = PLCTAG_STATUS_OK;
 
@@ -38,6 +38,7 @@
 
 #include <omron/omron_common.h>
 #include <omron/defs.h>
+#include <lib/capture.h>
 #include <util/rc.h>
 #include <util/vector.h>
 
@@ -59,6 +60,10 @@ struct omron_conn_t {
     int failed;
     int on_list;
 
+    /* hashed connection index linkage, see find_conn_by_host_unsafe(). */
+    int64_t index_key;
+    struct omron_conn_t *index_next;
+
     /* gateway connection related info */
     char *host;
     int port;
@@ -108,6 +113,9 @@ struct omron_conn_t {
 
     uint64_t packet_count;
 
+    /* wire capture identity, see plc_tag_capture_start(). */
+    capture_conn_t capture;
+
     thread_p handler_thread;
     volatile int terminating;
     mutex_p mutex;
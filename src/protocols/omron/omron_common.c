@@ -108,7 +108,11 @@ static struct tag_vtable_t default_vtable = {
     omron_get_int_attrib,
     omron_set_int_attrib,
 
-    omron_get_byte_array_attrib
+    omron_get_byte_array_attrib,
+
+    /* no transaction batching */
+    (tag_vtable_func)NULL,
+    NULL
 };
 
 
@@ -596,6 +600,8 @@ void omron_tag_destroy(omron_tag_p tag)
         tag->data = NULL;
     }
 
+    plc_tag_generic_destroy_data_pub((plc_tag_p)tag);
+
     pdebug(DEBUG_INFO,"Finished releasing all tag resources.");
 
     pdebug(DEBUG_INFO, "done");
@@ -72,7 +72,11 @@ static struct tag_vtable_t omron_raw_tag_vtable = {
     omron_get_int_attrib,
     omron_set_int_attrib,
 
-    omron_get_byte_array_attrib
+    omron_get_byte_array_attrib,
+
+    /* no transaction batching */
+    (tag_vtable_func)NULL,
+    NULL
 };
 
 // tag_byte_order_t omron_tag_listing_byte_order = {
@@ -288,6 +292,8 @@ static int raw_tag_check_write_status_connected(omron_tag_p tag)
     tag->write_in_progress = 0;
 
     if(rc == PLCTAG_STATUS_OK) {
+        tag_data_change_begin((plc_tag_p)tag);
+
         /* copy the data into the tag. */
         uint8_t *data_start = (uint8_t *)(&cip_resp->reply_service);
         uint8_t *data_end = request->data + (request->request_size);
@@ -395,6 +401,8 @@ static int raw_tag_check_write_status_unconnected(omron_tag_p tag)
     tag->write_in_progress = 0;
 
     if(rc == PLCTAG_STATUS_OK) {
+        tag_data_change_begin((plc_tag_p)tag);
+
         /* copy the data into the tag. */
         uint8_t *data_start = (uint8_t *)(&cip_resp->reply_service);
         uint8_t *data_end = data_start + le2h16(cip_resp->cpf_udi_item_length);
@@ -77,7 +77,11 @@ struct tag_vtable_t omron_standard_tag_vtable = {
     omron_get_int_attrib,
     omron_set_int_attrib,
 
-    omron_get_byte_array_attrib
+    omron_get_byte_array_attrib,
+
+    /* no transaction batching */
+    (tag_vtable_func)NULL,
+    NULL
 };
 
 // /* default string types used for ControlLogix-class PLCs. */
@@ -1395,6 +1399,8 @@ static int check_read_status_connected(omron_tag_p tag)
             payload_size = (data_end - data);
 
             /* copy the data into the tag and realloc if we need more space. */
+            tag_data_change_begin((plc_tag_p)tag);
+
             if(payload_size + tag->offset > tag->size) {
                 tag->size = (int)payload_size + tag->offset;
                 tag->elem_size = tag->size / tag->elem_count;
@@ -1605,6 +1611,8 @@ static int check_read_status_unconnected(omron_tag_p tag)
             payload_size = (data_end - data);
 
             /* copy the data into the tag and realloc if we need more space. */
+            tag_data_change_begin((plc_tag_p)tag);
+
             if(payload_size + tag->offset > tag->size) {
                 tag->size = (int)payload_size + tag->offset;
                 tag->elem_size = tag->size / tag->elem_count;
@@ -39,6 +39,7 @@
 #include <lib/version.h>
 #include <system/tag.h>
 #include <lib/init.h>
+#include <util/metrics.h>
 #include <util/rc.h>
 
 
@@ -50,6 +51,7 @@ static int system_tag_abort(plc_tag_p tag);
 static int system_tag_read(plc_tag_p tag);
 static int system_tag_status(plc_tag_p tag);
 static int system_tag_write(plc_tag_p tag);
+static int read_metrics_snapshot(system_tag_p tag);
 
 struct tag_vtable_t system_tag_vtable = {
     /* abort */     system_tag_abort,
@@ -64,7 +66,11 @@ struct tag_vtable_t system_tag_vtable = {
     /* get_int_attrib */ NULL,
     /* set_int_attrib */ NULL,
 
-    /* get_byte_array_attrib */ NULL
+    /* get_byte_array_attrib */ NULL,
+
+    /* no transaction batching */
+    (tag_vtable_func)NULL,
+    NULL
 };
 
 tag_byte_order_t system_tag_byte_order = {
@@ -143,6 +149,7 @@ plc_tag_p system_tag_create(attr attribs, void (*tag_callback_func)(int32_t tag_
     /* point data at the backing store. */
     tag->data = &tag->backing_data[0];
     tag->size = (int)sizeof(tag->backing_data);
+    tag->data_capacity = tag->size;
 
     pdebug(DEBUG_INFO,"Done");
 
@@ -184,6 +191,13 @@ static void system_tag_destroy(plc_tag_p ptag)
         tag->byte_order = NULL;
     }
 
+    if(tag->data && tag->data != &tag->backing_data[0]) {
+        mem_free(tag->data);
+        tag->data = NULL;
+    }
+
+    plc_tag_generic_destroy_data_pub((plc_tag_p)tag);
+
     return;
 }
 
@@ -199,6 +213,8 @@ static int system_tag_read(plc_tag_p ptag)
         return PLCTAG_ERR_NULL_PTR;
     }
 
+    tag_data_change_begin((plc_tag_p)tag);
+
     if(str_cmp_i(&tag->name[0],"version") == 0) {
         pdebug(DEBUG_DETAIL,"Version is %s",VERSION);
         str_copy((char *)(&tag->data[0]), MAX_SYSTEM_TAG_SIZE , VERSION);
@@ -211,9 +227,19 @@ static int system_tag_read(plc_tag_p ptag)
         tag->data[2] = (uint8_t)((debug_level >> 16) & 0xFF);
         tag->data[3] = (uint8_t)((debug_level >> 24) & 0xFF);
         rc = PLCTAG_STATUS_OK;
+    } else if(str_cmp_i(&tag->name[0],"tags/count") == 0) {
+        int tag_count = plc_tag_generic_get_tag_count();
+        tag->data[0] = (uint8_t)(tag_count & 0xFF);
+        tag->data[1] = (uint8_t)((tag_count >> 8) & 0xFF);
+        tag->data[2] = (uint8_t)((tag_count >> 16) & 0xFF);
+        tag->data[3] = (uint8_t)((tag_count >> 24) & 0xFF);
+        tag->size = 4;
+        rc = PLCTAG_STATUS_OK;
     } else {
-        pdebug(DEBUG_WARN, "Unsupported system tag %s!", tag->name);
-        rc = PLCTAG_ERR_UNSUPPORTED;
+        rc = read_metrics_snapshot(tag);
+        if(rc == PLCTAG_ERR_UNSUPPORTED) {
+            pdebug(DEBUG_WARN, "Unsupported system tag %s!", tag->name);
+        }
     }
 
     /* safe here because we are still within the API mutex. */
@@ -270,3 +296,47 @@ static int system_tag_write(plc_tag_p ptag)
 
     return rc;
 }
+
+
+
+/*
+ * read_metrics_snapshot
+ *
+ * Copy a packed metrics snapshot into the tag.  The tag size changes
+ * to the size of the snapshot, so sessions coming and going will change it.
+ */
+
+int read_metrics_snapshot(system_tag_p tag)
+{
+    int snapshot_size = 0;
+
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    /* the snapshot may grow between calls, so loop until it fits. */
+    while((snapshot_size = metrics_snapshot(&tag->name[0], tag->data, tag->data_capacity)) > tag->data_capacity) {
+        uint8_t *new_data = (uint8_t *)mem_alloc(snapshot_size);
+
+        if(!new_data) {
+            pdebug(DEBUG_ERROR, "Unable to allocate %d bytes for metrics snapshot!", snapshot_size);
+            return PLCTAG_ERR_NO_MEM;
+        }
+
+        if(tag->data != &tag->backing_data[0]) {
+            mem_free(tag->data);
+        }
+
+        tag->data = new_data;
+        tag->data_capacity = snapshot_size;
+    }
+
+    if(snapshot_size < 0) {
+        pdebug(DEBUG_DETAIL, "Unable to get metrics snapshot, error %s.", plc_tag_decode_error(snapshot_size));
+        return snapshot_size;
+    }
+
+    tag->size = snapshot_size;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
@@ -38,7 +38,7 @@
 #include <platform.h>
 #include <lib/tag.h>
 
-#define MAX_SYSTEM_TAG_NAME (20)
+#define MAX_SYSTEM_TAG_NAME (128)
 #define MAX_SYSTEM_TAG_SIZE (30)
 
 struct system_tag_t {
@@ -47,6 +47,9 @@ struct system_tag_t {
 
     char name[MAX_SYSTEM_TAG_NAME];
     uint8_t backing_data[MAX_SYSTEM_TAG_SIZE];
+
+    /* metrics snapshots can outgrow the backing data. */
+    int data_capacity;
 };
 
 typedef struct system_tag_t *system_tag_p;
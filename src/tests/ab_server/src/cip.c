@@ -57,6 +57,7 @@ const uint8_t CIP_PCCC_EXECUTE[] = { 0x4B, 0x02, 0x20, 0x67, 0x24, 0x01, 0x07, 0
 const uint8_t CIP_FORWARD_CLOSE[] = { 0x4E, 0x02, 0x20, 0x06, 0x24, 0x01 };
 const uint8_t CIP_FORWARD_OPEN[] = { 0x54, 0x02, 0x20, 0x06, 0x24, 0x01 };
 const uint8_t CIP_LIST_TAGS[] = { 0x55, 0x02, 0x20, 0x02, 0x24, 0x01 };
+const uint8_t CIP_CONTROLLER_ATTRS[] = { 0x03, 0x02, 0x20, 0xAC, 0x24, 0x01 };
 const uint8_t CIP_FORWARD_OPEN_EX[] = { 0x5B, 0x02, 0x20, 0x06, 0x24, 0x01 };
 
 /* path to match. */
@@ -66,6 +67,7 @@ const uint8_t CIP_FORWARD_OPEN_EX[] = { 0x5B, 0x02, 0x20, 0x06, 0x24, 0x01 };
 #define CIP_DONE               ((uint8_t)0x80)
 
 #define CIP_SYMBOLIC_SEGMENT_MARKER ((uint8_t)0x91)
+#define CIP_SYMBOL_CLASS ((uint8_t)0x6B)
 
 /* CIP Errors */
 
@@ -73,6 +75,7 @@ const uint8_t CIP_FORWARD_OPEN_EX[] = { 0x5B, 0x02, 0x20, 0x06, 0x24, 0x01 };
 #define CIP_ERR_0x01            ((uint8_t)0x01)
 #define CIP_ERR_FRAG            ((uint8_t)0x06)
 #define CIP_ERR_UNSUPPORTED     ((uint8_t)0x08)
+#define CIP_ERR_PARTIAL         ((uint8_t)0x1E)
 #define CIP_ERR_EXTENDED        ((uint8_t)0xff)
 
 #define CIP_ERR_EX_TOO_LONG     ((uint16_t)0x2105)
@@ -87,6 +90,9 @@ static slice_s handle_forward_open(slice_s input, slice_s output, plc_s *plc);
 static slice_s handle_forward_close(slice_s input, slice_s output, plc_s *plc);
 static slice_s handle_read_request(slice_s input, slice_s output, plc_s *plc);
 static slice_s handle_write_request(slice_s input, slice_s output, plc_s *plc);
+static slice_s handle_list_tags_request(slice_s input, slice_s output, plc_s *plc);
+static slice_s handle_controller_attrs_request(slice_s input, slice_s output, plc_s *plc);
+static slice_s handle_multi_request(slice_s input, slice_s output, plc_s *plc);
 
 static bool process_tag_segment(plc_s *plc, slice_s input, tag_def_s **tag, size_t *start_read_offset);
 static slice_s make_cip_error(slice_s output, uint8_t cip_cmd, uint8_t cip_err, bool extend, uint16_t extended_error);
@@ -119,9 +125,18 @@ slice_s cip_dispatch_request(slice_s input, slice_s output, plc_s *plc)
     } else if(slice_match_bytes(input, CIP_FORWARD_CLOSE, sizeof(CIP_FORWARD_CLOSE))) {
         info("Case CIP_FORWARD_CLOSE");
         return handle_forward_close(input, output, plc);
+    } else if(slice_match_bytes(input, CIP_MULTI, sizeof(CIP_MULTI)) && plc->plc_type == PLC_CONTROL_LOGIX) {
+        info("Case CIP_MULTI");
+        return handle_multi_request(input, output, plc);
     } else if(slice_match_bytes(input, CIP_PCCC_EXECUTE, sizeof(CIP_PCCC_EXECUTE))) {
         info("Case CIP_PCCC_EXECUTE");
         return dispatch_pccc_request(input, output, plc);
+    } else if(slice_match_bytes(input, CIP_CONTROLLER_ATTRS, sizeof(CIP_CONTROLLER_ATTRS)) && plc->plc_type == PLC_CONTROL_LOGIX) {
+        info("Case CIP_CONTROLLER_ATTRS");
+        return handle_controller_attrs_request(input, output, plc);
+    } else if(slice_get_uint8(input, 0) == CIP_LIST_TAGS[0] && plc->plc_type == PLC_CONTROL_LOGIX) {
+        info("Case CIP_LIST_TAGS");
+        return handle_list_tags_request(input, output, plc);
     } else {
         info("Case NOT EXPECTED!");
             return make_cip_error(output, (uint8_t)(slice_get_uint8(input, 0) | (uint8_t)CIP_DONE), (uint8_t)CIP_ERR_UNSUPPORTED, false, (uint16_t)0);
@@ -494,7 +509,7 @@ slice_s handle_read_request(slice_s input, slice_s output, plc_s *plc)
 
     /* FIXME - use memcpy */
     for(size_t i=0; i < amount_to_copy; i++) {
-        slice_set_uint8(output, offset + i, tag->data[byte_offset + i]);
+        slice_set_uint8(output, offset + i, tag->data[read_start_offset + byte_offset + i]);
     }
 
     offset += amount_to_copy;
@@ -577,6 +592,9 @@ slice_s handle_write_request(slice_s input, slice_s output, plc_s *plc)
 
     info("total_request_size = %d", total_request_size);
 
+    /* the element in the tag path is where the write starts. */
+    byte_offset += (uint32_t)write_start_offset;
+
     /* check the amount */
     if(byte_offset + total_request_size > tag_data_length) {
         info("request tries to write too much data!");
@@ -611,6 +629,309 @@ slice_s handle_write_request(slice_s input, slice_s output, plc_s *plc)
  * tag dimensions.
  */
 
+/*
+ * List the symbol instances starting at the instance in the request path.
+ * Only a few attributes are supported:
+ *   1 - symbol name, UINT count followed by the characters.
+ *   2 - symbol type, UINT.
+ *   7 - element size, UINT.
+ *   8 - array dimensions, 3x UDINT.
+ */
+
+#define CIP_LIST_TAGS_MIN_SIZE (10)
+#define CIP_LIST_TAGS_MAX_ATTRS (8)
+
+slice_s handle_list_tags_request(slice_s input, slice_s output, plc_s *plc)
+{
+    uint8_t list_cmd = slice_get_uint8(input, 0);
+    size_t offset = 1;
+    size_t path_size = 0;
+    uint32_t next_id = 0;
+    uint16_t attr_count = 0;
+    uint16_t attrs[CIP_LIST_TAGS_MAX_ATTRS];
+    bool more = false;
+
+    if(slice_len(input) < CIP_LIST_TAGS_MIN_SIZE) {
+        info("Insufficient data in list tags request!");
+        return make_cip_error(output, list_cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    path_size = (size_t)slice_get_uint8(input, offset) * 2; offset++;
+
+    if(slice_get_uint8(input, offset) != 0x20 || slice_get_uint8(input, offset + 1) != CIP_SYMBOL_CLASS) {
+        info("List tags request is not for the symbol class!");
+        return make_cip_error(output, list_cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    switch(slice_get_uint8(input, offset + 2)) {
+        case 0x24:
+            next_id = slice_get_uint8(input, offset + 3);
+            break;
+
+        case 0x25:
+            next_id = slice_get_uint16_le(input, offset + 4);
+            break;
+
+        case 0x26:
+            next_id = slice_get_uint32_le(input, offset + 4);
+            break;
+
+        default:
+            info("Unexpected instance segment marker %x!", slice_get_uint8(input, offset + 2));
+            return make_cip_error(output, list_cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+            break;
+    }
+
+    offset += path_size;
+
+    attr_count = slice_get_uint16_le(input, offset); offset += 2;
+    if(attr_count > CIP_LIST_TAGS_MAX_ATTRS || offset + (size_t)(attr_count * 2) > slice_len(input)) {
+        info("Bad attribute count %d in list tags request!", attr_count);
+        return make_cip_error(output, list_cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    for(size_t i=0; i < attr_count; i++) {
+        attrs[i] = slice_get_uint16_le(input, offset); offset += 2;
+
+        if(attrs[i] != 1 && attrs[i] != 2 && attrs[i] != 7 && attrs[i] != 8) {
+            info("Unsupported attribute %d in list tags request!", attrs[i]);
+            return make_cip_error(output, list_cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+        }
+    }
+
+    /* the tag list is not in instance order, so pick the next instance each time. */
+    offset = 4;
+
+    while(true) {
+        tag_def_s *tag = NULL;
+        size_t entry_size = 4;
+
+        for(tag_def_s *candidate = plc->tags; candidate; candidate = candidate->next_tag) {
+            if(candidate->instance_id >= next_id && (!tag || candidate->instance_id < tag->instance_id)) {
+                tag = candidate;
+            }
+        }
+
+        if(!tag) {
+            break;
+        }
+
+        for(size_t i=0; i < attr_count; i++) {
+            switch(attrs[i]) {
+                case 1: entry_size += 2 + strlen(tag->name); break;
+                case 2: entry_size += 2; break;
+                case 7: entry_size += 2; break;
+                case 8: entry_size += 12; break;
+                default: break;
+            }
+        }
+
+        if(offset + entry_size > slice_len(output)) {
+            more = true;
+            break;
+        }
+
+        slice_set_uint32_le(output, offset, tag->instance_id); offset += 4;
+
+        for(size_t i=0; i < attr_count; i++) {
+            switch(attrs[i]) {
+                case 1:
+                    slice_set_uint16_le(output, offset, (uint16_t)strlen(tag->name)); offset += 2;
+                    memcpy(slice_get_bytes(output, offset), tag->name, strlen(tag->name));
+                    offset += strlen(tag->name);
+                    break;
+
+                case 2:
+                    slice_set_uint16_le(output, offset, (uint16_t)(tag->tag_type | (uint16_t)(tag->num_dimensions << 13))); offset += 2;
+                    break;
+
+                case 7:
+                    slice_set_uint16_le(output, offset, (uint16_t)tag->elem_size); offset += 2;
+                    break;
+
+                case 8:
+                    for(size_t dim=0; dim < 3; dim++) {
+                        slice_set_uint32_le(output, offset, (uint32_t)tag->dimensions[dim]); offset += 4;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        next_id = tag->instance_id + 1;
+    }
+
+    slice_set_uint8(output, 0, list_cmd | CIP_DONE);
+    slice_set_uint8(output, 1, 0);
+    slice_set_uint8(output, 2, (more ? CIP_ERR_FRAG : CIP_OK));
+    slice_set_uint8(output, 3, 0);
+
+    return slice_from_slice(output, 0, offset);
+}
+
+
+
+
+/*
+ * Multiple Service Packet.  The request has a count and offsets, relative
+ * to the count, of each embedded request.  Each one is dispatched as if it
+ * came on its own and the replies are collected the same way.
+ *
+ * The reply is built over the request, so work from a copy.
+ */
+
+#define CIP_MULTI_MAX_SIZE (4200)
+
+slice_s handle_multi_request(slice_s input, slice_s output, plc_s *plc)
+{
+    uint8_t req_buf[CIP_MULTI_MAX_SIZE];
+    uint8_t resp_buf[CIP_MULTI_MAX_SIZE];
+    slice_s req = slice_make(req_buf, (ssize_t)slice_len(input));
+    size_t count_offset = sizeof(CIP_MULTI);
+    uint16_t count = 0;
+    size_t out_offset = 0;
+    bool partial = false;
+
+    if(slice_len(input) > sizeof(req_buf) || slice_len(input) < count_offset + 2) {
+        info("Bad Multiple Service Packet size %d!", (int)slice_len(input));
+        return make_cip_error(output, CIP_MULTI[0] | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    memcpy(req_buf, slice_get_bytes(input, 0), slice_len(input));
+
+    count = slice_get_uint16_le(req, count_offset);
+    if(count == 0 || count_offset + 2 + (size_t)count * 2 > slice_len(req)) {
+        info("Bad service count %d in Multiple Service Packet!", count);
+        return make_cip_error(output, CIP_MULTI[0] | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    /* reply header, count and offsets. */
+    out_offset = 4 + 2 + (size_t)count * 2;
+
+    for(size_t i=0; i < count; i++) {
+        size_t start = count_offset + slice_get_uint16_le(req, count_offset + 2 + i * 2);
+        size_t end = (i + 1 < count ? count_offset + slice_get_uint16_le(req, count_offset + 2 + (i + 1) * 2) : slice_len(req));
+        size_t space = (out_offset < slice_len(output) ? slice_len(output) - out_offset : 0);
+        slice_s sub_resp;
+
+        if(start >= end || end > slice_len(req)) {
+            info("Bad offset for service %d in Multiple Service Packet!", (int)i);
+            return make_cip_error(output, CIP_MULTI[0] | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+        }
+
+        sub_resp = cip_dispatch_request(slice_from_slice(req, start, end - start),
+                                        slice_make(resp_buf, (ssize_t)(space < sizeof(resp_buf) ? space : sizeof(resp_buf))),
+                                        plc);
+
+        if(slice_has_err(sub_resp) || slice_len(sub_resp) > space) {
+            info("Unable to fit the reply to service %d in the Multiple Service Packet reply!", (int)i);
+            return make_cip_error(output, CIP_MULTI[0] | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+        }
+
+        if(slice_get_uint8(sub_resp, 2) != CIP_OK) {
+            partial = true;
+        }
+
+        memcpy(slice_get_bytes(output, out_offset), slice_get_bytes(sub_resp, 0), slice_len(sub_resp));
+        slice_set_uint16_le(output, 4 + 2 + i * 2, (uint16_t)(out_offset - 4));
+        out_offset += slice_len(sub_resp);
+    }
+
+    slice_set_uint8(output, 0, CIP_MULTI[0] | CIP_DONE);
+    slice_set_uint8(output, 1, 0);
+    slice_set_uint8(output, 2, (partial ? CIP_ERR_PARTIAL : CIP_OK));
+    slice_set_uint8(output, 3, 0);
+    slice_set_uint16_le(output, 4, count);
+
+    return slice_from_slice(output, 0, out_offset);
+}
+
+
+
+/*
+ * Get Attribute List on the controller object, class 0xAC instance 1.
+ * Clients read attributes 1, 2, 3, 4 and 10 to see whether the symbol
+ * table or templates changed.  The tag list is fixed once the server is
+ * running, so the values are derived from it and never change.
+ *
+ *   1, 2 - UINT.
+ *   3, 4, 10 - UDINT.
+ */
+
+#define CIP_CONTROLLER_ATTRS_MIN_SIZE (8)
+#define CIP_CONTROLLER_ATTRS_MAX_ATTRS (8)
+
+slice_s handle_controller_attrs_request(slice_s input, slice_s output, plc_s *plc)
+{
+    uint8_t cmd = slice_get_uint8(input, 0);
+    size_t offset = sizeof(CIP_CONTROLLER_ATTRS);
+    uint16_t attr_count = 0;
+    uint16_t attrs[CIP_CONTROLLER_ATTRS_MAX_ATTRS];
+    uint32_t tag_count = 0;
+    uint32_t name_total = 0;
+    size_t out_offset = 0;
+
+    if(slice_len(input) < CIP_CONTROLLER_ATTRS_MIN_SIZE) {
+        info("Insufficient data in controller attribute request!");
+        return make_cip_error(output, cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    attr_count = slice_get_uint16_le(input, offset); offset += 2;
+    if(attr_count > CIP_CONTROLLER_ATTRS_MAX_ATTRS || offset + (size_t)(attr_count * 2) > slice_len(input)) {
+        info("Bad attribute count %d in controller attribute request!", attr_count);
+        return make_cip_error(output, cmd | CIP_DONE, CIP_ERR_UNSUPPORTED, false, 0);
+    }
+
+    /* the reply is built over the request, so pick up the attribute IDs first. */
+    for(size_t i=0; i < attr_count; i++) {
+        attrs[i] = slice_get_uint16_le(input, offset); offset += 2;
+    }
+
+    for(tag_def_s *tag = plc->tags; tag; tag = tag->next_tag) {
+        tag_count++;
+        name_total += (uint32_t)strlen(tag->name);
+    }
+
+    slice_set_uint8(output, 0, cmd | CIP_DONE);
+    slice_set_uint8(output, 1, 0);
+    slice_set_uint8(output, 2, CIP_OK);
+    slice_set_uint8(output, 3, 0);
+    slice_set_uint16_le(output, 4, attr_count);
+    out_offset = 6;
+
+    for(size_t i=0; i < attr_count; i++) {
+        uint16_t attr = attrs[i];
+
+        slice_set_uint16_le(output, out_offset, attr); out_offset += 2;
+
+        switch(attr) {
+            case 1:
+            case 2:
+                slice_set_uint16_le(output, out_offset, 0); out_offset += 2;
+                slice_set_uint16_le(output, out_offset, (uint16_t)(attr == 1 ? tag_count : 1)); out_offset += 2;
+                break;
+
+            case 3:
+            case 4:
+            case 10:
+                slice_set_uint16_le(output, out_offset, 0); out_offset += 2;
+                slice_set_uint32_le(output, out_offset, (attr == 3 ? name_total : tag_count + (uint32_t)attr)); out_offset += 4;
+                break;
+
+            default:
+                /* attribute not supported. */
+                slice_set_uint16_le(output, out_offset, CIP_ERR_UNSUPPORTED); out_offset += 2;
+                break;
+        }
+    }
+
+    return slice_from_slice(output, 0, out_offset);
+}
+
+
+
 bool process_tag_segment(plc_s *plc, slice_s input, tag_def_s **tag, size_t *start_read_offset)
 {
     size_t offset = 0;
@@ -620,32 +941,77 @@ bool process_tag_segment(plc_s *plc, slice_s input, tag_def_s **tag, size_t *sta
     size_t dimensions[3] = { 0, 0, 0};
     size_t dimension_index = 0;
 
-    if(symbolic_marker != CIP_SYMBOLIC_SEGMENT_MARKER)  {
-        info("Expected symbolic segment but found %x!", symbolic_marker);
-        return false;
-    }
+    if(symbolic_marker == CIP_SYMBOLIC_SEGMENT_MARKER)  {
+        /* get and check the length of the symbolic name part. */
+        name_len = slice_get_uint8(input, offset); offset++;
+        if(name_len >= slice_len(input)) {
+            info("Insufficient space in symbolic segment for name.   Needed %d bytes but only had %d bytes!", name_len, slice_len(input)-1);
+            return false;
+        }
 
-    /* get and check the length of the symbolic name part. */
-    name_len = slice_get_uint8(input, offset); offset++;
-    if(name_len >= slice_len(input)) {
-        info("Insufficient space in symbolic segment for name.   Needed %d bytes but only had %d bytes!", name_len, slice_len(input)-1);
-        return false;
-    }
+        /* bump the offset.   Must be 16-bit aligned, so pad if needed. */
+        offset += (size_t)(name_len + ((name_len & 0x01) ? 1 : 0));
 
-    /* bump the offset.   Must be 16-bit aligned, so pad if needed. */
-    offset += (size_t)(name_len + ((name_len & 0x01) ? 1 : 0));
+        /* try to find the tag. */
+        tag_name = slice_from_slice(input, 2, name_len);
+        *tag = plc->tags;
 
-    /* try to find the tag. */
-    tag_name = slice_from_slice(input, 2, name_len);
-    *tag = plc->tags;
+        while(*tag) {
+            if(slice_match_string(tag_name, (*tag)->name)) {
+                info("Found tag %s", (*tag)->name);
+                break;
+            }
 
-    while(*tag) {
-        if(slice_match_string(tag_name, (*tag)->name)) {
-            info("Found tag %s", (*tag)->name);
-            break;
+            (*tag) = (*tag)->next_tag;
+        }
+    } else if(symbolic_marker == 0x20 && slice_get_uint8(input, offset) == CIP_SYMBOL_CLASS) {
+        /* symbol instance path. */
+        uint32_t instance_id = 0;
+        uint8_t instance_type = 0;
+
+        offset++;
+        instance_type = slice_get_uint8(input, offset);
+
+        switch(instance_type) {
+            case 0x24: /* single byte instance. */
+                instance_id = slice_get_uint8(input, offset + 1);
+                offset += 2;
+                break;
+
+            case 0x25: /* two byte instance, padded. */
+                instance_id = slice_get_uint16_le(input, offset + 2);
+                offset += 4;
+                break;
+
+            case 0x26: /* four byte instance, padded. */
+                instance_id = slice_get_uint32_le(input, offset + 2);
+                offset += 6;
+                break;
+
+            default:
+                info("Unexpected instance segment marker %x!", instance_type);
+                return false;
+                break;
+        }
+
+        if(offset > slice_len(input)) {
+            info("Insufficient space in request for symbol instance!");
+            return false;
         }
 
-        (*tag) = (*tag)->next_tag;
+        *tag = plc->tags;
+
+        while(*tag) {
+            if((*tag)->instance_id == instance_id) {
+                info("Found tag %s for instance %u", (*tag)->name, instance_id);
+                break;
+            }
+
+            (*tag) = (*tag)->next_tag;
+        }
+    } else {
+        info("Expected symbolic segment but found %x!", symbolic_marker);
+        return false;
     }
 
     if(*tag) {
@@ -35,6 +35,7 @@
 #include "cip.h"
 #include "cpf.h"
 #include "eip.h"
+#include "pccc.h"
 #include "utils.h"
 
 #define CPF_ITEM_NAI ((uint16_t)0x0000) /* NULL Address Item */
@@ -207,20 +208,28 @@ slice_s handle_cpf_connected(slice_s input, slice_s output, plc_s *plc)
     /* do we care about the sequence ID?   Should check. */
     plc->server_connection_seq = header.conn_seq;
 
-    /* dispatch and handle the result. */
-    result = cip_dispatch_request(slice_from_slice(input,  (size_t)CPF_CONN_HEADER_SIZE, (size_t)((uint16_t)slice_len(input) - CPF_CONN_HEADER_SIZE)),
-                                  slice_from_slice(output, (size_t)CPF_CONN_HEADER_SIZE, (size_t)((uint16_t)slice_len(output) - CPF_CONN_HEADER_SIZE)),
-                                  plc);
+    /* dispatch and handle the result.  DH+ requests have no CIP header. */
+    if(plc->dhp_port) {
+        result = dispatch_dhp_request(slice_from_slice(input,  (size_t)CPF_CONN_HEADER_SIZE, (size_t)((uint16_t)slice_len(input) - CPF_CONN_HEADER_SIZE)),
+                                      slice_from_slice(output, (size_t)CPF_CONN_HEADER_SIZE, (size_t)((uint16_t)slice_len(output) - CPF_CONN_HEADER_SIZE)),
+                                      plc);
+    } else {
+        result = cip_dispatch_request(slice_from_slice(input,  (size_t)CPF_CONN_HEADER_SIZE, (size_t)((uint16_t)slice_len(input) - CPF_CONN_HEADER_SIZE)),
+                                      slice_from_slice(output, (size_t)CPF_CONN_HEADER_SIZE, (size_t)((uint16_t)slice_len(output) - CPF_CONN_HEADER_SIZE)),
+                                      plc);
+    }
 
     if(!slice_has_err(result)) {
         /* build outbound header. */
-        slice_set_uint16_le(output, 0, 2); /* two items. */
-        slice_set_uint16_le(output, 2, CPF_ITEM_CAI); /* connected address type. */
-        slice_set_uint16_le(output, 4, 4); /* connection ID is 4 bytes. */
-        slice_set_uint32_le(output, 6, plc->client_connection_id);
-        slice_set_uint16_le(output, 10, CPF_ITEM_CDI); /* connected data type */
-        slice_set_uint16_le(output, 12, (uint16_t)(slice_len(result) + 2)); /* result from CIP processing downstream.  Plus 2 bytes for sequence number. */
-        slice_set_uint16_le(output, 14, plc->client_connection_seq);
+        slice_set_uint32_le(output, 0, header.interface_handle);
+        slice_set_uint16_le(output, 4, header.router_timeout);
+        slice_set_uint16_le(output, 6, 2); /* two items. */
+        slice_set_uint16_le(output, 8, CPF_ITEM_CAI); /* connected address type. */
+        slice_set_uint16_le(output, 10, 4); /* connection ID is 4 bytes. */
+        slice_set_uint32_le(output, 12, plc->client_connection_id);
+        slice_set_uint16_le(output, 16, CPF_ITEM_CDI); /* connected data type */
+        slice_set_uint16_le(output, 18, (uint16_t)(slice_len(result) + 2)); /* result from CIP processing downstream.  Plus 2 bytes for sequence number. */
+        slice_set_uint16_le(output, 20, header.conn_seq); /* the response carries the sequence number of its request. */
 
         /* create a new slice with the CPF header and the response packet in it. */
         result = slice_from_slice(output, (size_t)0, (size_t)(slice_len(result) + CPF_CONN_HEADER_SIZE));
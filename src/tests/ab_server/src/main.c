@@ -50,6 +50,7 @@
 
 #include "eip.h"
 #include "plc.h"
+#include "replay.h"
 #include "slice.h"
 #include "tcp_server.h"
 #include "utils.h"
@@ -57,9 +58,10 @@
 static void usage(void);
 static void process_args(int argc, const char **argv, plc_s *plc);
 static void parse_path(const char *path, plc_s *plc);
+static void parse_dhp(const char *dhp_str, plc_s *plc);
 static void parse_pccc_tag(const char *tag, plc_s *plc);
 static void parse_cip_tag(const char *tag, plc_s *plc);
-static slice_s request_handler(slice_s input, slice_s output, void *plc);
+static slice_s request_handler(slice_s input, slice_s output, size_t *input_used, void *plc);
 
 
 #ifdef IS_WINDOWS
@@ -146,8 +148,10 @@ void setup_break_handler(void)
 int main(int argc, const char **argv)
 {
     tcp_server_p server = NULL;
-    uint8_t buf[4200];  /* CIP only allows 4002 for the CIP request, but there is overhead. */
-    slice_s server_buf = slice_make(buf, sizeof(buf));
+    uint8_t in_buf[4200];  /* CIP only allows 4002 for the CIP request, but there is overhead. */
+    uint8_t out_buf[4200];
+    slice_s server_in_buf = slice_make(in_buf, sizeof(in_buf));
+    slice_s server_out_buf = slice_make(out_buf, sizeof(out_buf));
     plc_s plc;
 
     /* set up handler for ^C etc. */
@@ -164,19 +168,24 @@ int main(int argc, const char **argv)
     process_args(argc, argv, &plc);
 
     /* open a server connection and listen on the right port. */
-    server = tcp_server_create("0.0.0.0", (plc.port_str ? plc.port_str : "44818"), server_buf, request_handler, &plc);
+    server = tcp_server_create("0.0.0.0", (plc.port_str ? plc.port_str : "44818"), server_in_buf, server_out_buf, request_handler, &plc);
 
     tcp_server_start(server, &done);
 
     tcp_server_destroy(server);
 
+    if(plc.replay) {
+        replay_report(plc.replay);
+        replay_destroy(plc.replay);
+    }
+
     return 0;
 }
 
 
 void usage(void)
 {
-    fprintf(stderr, "Usage: ab_server --plc=<plc_type> [--path=<path>] [--port=<port>] --tag=<tag>\n"
+    fprintf(stderr, "Usage: ab_server --plc=<plc_type> [--path=<path>] [--port=<port>] [--dhp=<dhp>] [--replay=<file>] --tag=<tag>\n"
                     "   <plc type> = one of the CIP PLCs: \"ControlLogix\", \"Micro800\" or \"Omron\",\n"
                     "                or one of the PCCC PLCs: \"PLC/5\", \"SLC500\" or \"Micrologix\".\n"
                     "\n"
@@ -185,6 +194,16 @@ void usage(void)
                     "   <port> = (required for ControlLogix) internal path to CPU in PLC.  E.g. \"1,0\".\n"
                     "            Defaults to 44818.\n"
                     "\n"
+                    "   <dhp> = (PCCC PLCs only) act as a PLC on DH+ behind a bridge.  The format is\n"
+                    "           <channel>:<node>, e.g. \"A:5\".  The channel is A or B (2 or 3).  Use\n"
+                    "           the path \"<channel>:<any>:<node>\" in the tag attributes.\n"
+                    "\n"
+                    "   <file> = a pcap capture of EtherNet/IP traffic, e.g. from plc_tag_capture_start().\n"
+                    "            Requests that match a recorded request get the recorded response after\n"
+                    "            the recorded delay.  Everything else, including session setup and\n"
+                    "            Forward Open, is handled normally.  Use the same PLC type and path as\n"
+                    "            the captured PLC.  Tags are optional when replaying.\n"
+                    "\n"
                     "    PCCC-based PLC tags are in the format: <file>[<size>] where:\n"
                     "        <file> is the data file, only the following are supported:\n"
                     "            N7   - 2-byte signed integer.\n"
@@ -328,6 +347,10 @@ void process_args(int argc, const char **argv, plc_s *plc)
             has_path = true;
         }
 
+        if(strncmp(argv[i],"--dhp=",6) == 0) {
+            parse_dhp(&(argv[i][6]), plc);
+        }
+
         if(strncmp(argv[i],"--port=",7) == 0) {
             plc->port_str = &(argv[i][7]);
         }
@@ -352,6 +375,15 @@ void process_args(int argc, const char **argv, plc_s *plc)
             }
         }
 
+        if(strncmp(argv[i],"--replay=", 9) == 0) {
+            if(plc->replay) {
+                fprintf(stderr, "Only one replay file can be used!\n");
+                usage();
+            }
+
+            plc->replay = replay_load(&(argv[i][9]));
+        }
+
         if(strncmp(argv[i],"--delay=", 8) == 0) {
             if(plc) {
                 info("Setting response delay to %dms.", atoi(&argv[i][8]));
@@ -370,10 +402,61 @@ void process_args(int argc, const char **argv, plc_s *plc)
         usage();
     }
 
-    if(!has_tag) {
+    if(!has_tag && !plc->replay) {
         fprintf(stderr, "You must define at least one tag.\n");
         usage();
     }
+
+    if(plc->dhp_port) {
+        if(plc->plc_type != PLC_PLC5 && plc->plc_type != PLC_SLC && plc->plc_type != PLC_MICROLOGIX) {
+            fprintf(stderr, "Only PCCC PLCs can be on DH+.\n");
+            usage();
+        }
+
+        /* the connection goes to the DH+ bridge, not the PLC CPU. */
+        plc->path[0] = (uint8_t)0x20;
+        plc->path[1] = (uint8_t)0xA6;
+        plc->path[2] = (uint8_t)0x24;
+        plc->path[3] = plc->dhp_port;
+        plc->path[4] = (uint8_t)0x2C;
+        plc->path[5] = (uint8_t)0x01;
+        plc->path_len = 6;
+    }
+}
+
+
+void parse_dhp(const char *dhp_str, plc_s *plc)
+{
+    char channel = 0;
+    int node = 0;
+
+    if(str_scanf(dhp_str, "%c:%d", &channel, &node) != 2 || node < 0 || node > 255) {
+        fprintf(stderr, "Unable to parse DH+ argument \"%s\"!\n", dhp_str);
+        usage();
+    }
+
+    switch(channel) {
+        case 'A':
+        case 'a':
+        case '2':
+            plc->dhp_port = 1;
+            break;
+
+        case 'B':
+        case 'b':
+        case '3':
+            plc->dhp_port = 2;
+            break;
+
+        default:
+            fprintf(stderr, "DH+ channel must be A or B, not '%c'!\n", channel);
+            usage();
+            break;
+    }
+
+    plc->dhp_node = (uint16_t)node;
+
+    info("Acting as DH+ node %d on channel %c.", node, channel);
 }
 
 
@@ -533,7 +616,8 @@ void parse_pccc_tag(const char *tag_str, plc_s *plc)
 
     info("Processed \"%s\" into tag %s of type %x with dimensions (%d, %d, %d).", tag_str, tag->name, tag->tag_type, tag->dimensions[0], tag->dimensions[1], tag->dimensions[2]);
 
-    /* add the tag to the list. */
+    /* add the tag to the list, numbering the symbol instances as we go. */
+    tag->instance_id = (plc->tags ? plc->tags->instance_id + 1 : 1);
     tag->next_tag = plc->tags;
     plc->tags = tag;
 }
@@ -717,7 +801,8 @@ void parse_cip_tag(const char *tag_str, plc_s *plc)
 
     info("Processed \"%s\" into tag %s of type %x with dimensions (%d, %d, %d).", tag_str, tag->name, tag->tag_type, tag->dimensions[0], tag->dimensions[1], tag->dimensions[2]);
 
-    /* add the tag to the list. */
+    /* add the tag to the list, numbering the symbol instances as we go. */
+    tag->instance_id = (plc->tags ? plc->tags->instance_id + 1 : 1);
     tag->next_tag = plc->tags;
     plc->tags = tag;
 }
@@ -728,7 +813,7 @@ void parse_cip_tag(const char *tag_str, plc_s *plc)
  * request type handler.
  */
 
-slice_s request_handler(slice_s input, slice_s output, void *plc_arg)
+slice_s request_handler(slice_s input, slice_s output, size_t *input_used, void *plc_arg)
 {
     plc_s *plc = (plc_s*)plc_arg;
 
@@ -737,7 +822,20 @@ slice_s request_handler(slice_s input, slice_s output, void *plc_arg)
         uint16_t eip_len = slice_get_uint16_le(input, 2);
 
         if(slice_len(input) >= (size_t)(EIP_HEADER_SIZE + eip_len)) {
-            slice_s resp = eip_dispatch_request(input, output, plc);
+            slice_s resp = slice_make_err(TCP_SERVER_UNSUPPORTED);
+
+            /* only handle the first packet, the client may have sent more. */
+            *input_used = (size_t)(EIP_HEADER_SIZE + eip_len);
+            input = slice_from_slice(input, 0, *input_used);
+
+            /* recorded responses first, then the live handlers. */
+            if(plc->replay) {
+                resp = replay_response(input, output, plc);
+            }
+
+            if(slice_has_err(resp)) {
+                resp = eip_dispatch_request(input, output, plc);
+            }
 
             /* if there is a response delay requested, then wait a bit. */
             if(plc->response_delay > 0) {
@@ -57,6 +57,10 @@ const uint8_t PCCC_ERR_UNSUPPORTED_COMMAND = (uint8_t)0x0e;
 // 4f f0 fa da 07 - file is wrong size.
 // 4f f0 a6 b3 0e - command could not be decoded
 
+/* DH+ destination link and node, then source link and node, in front of the PCCC command. */
+#define DHP_ROUTING_SIZE (8)
+
+static slice_s dispatch_pccc_command(slice_s pccc_input, slice_s pccc_output, plc_s *plc);
 static slice_s handle_plc5_read_request(slice_s input, slice_s output, plc_s *plc);
 static slice_s handle_plc5_write_request(slice_s input, slice_s output, plc_s *plc);
 static slice_s handle_slc_read_request(slice_s input, slice_s output, plc_s *plc);
@@ -85,34 +89,90 @@ slice_s dispatch_pccc_request(slice_s input, slice_s output, plc_s *plc)
         slice_set_uint8(output, i, PCCC_RESP_PREFIX[i]);
     }
 
+    pccc_output = dispatch_pccc_command(pccc_input, pccc_output, plc);
+
+    return slice_from_slice(output, 0, 11 + slice_len(pccc_output));
+}
+
+
+/*
+ * DH+ requests come over the connection without a CIP header.  The DH+
+ * routing is in front of the PCCC command and the response swaps it.
+ */
+slice_s dispatch_dhp_request(slice_s input, slice_s output, plc_s *plc)
+{
+    uint16_t dest_link = 0;
+    uint16_t dest_node = 0;
+    uint16_t src_link = 0;
+    uint16_t src_node = 0;
+    slice_s pccc_input;
+    slice_s pccc_output;
+
+    info("Got DH+ packet:");
+    slice_dump(input);
+
+    if(slice_len(input) < DHP_ROUTING_SIZE + 5) {
+        info("DH+ packet too short!");
+        return slice_make_err(EIP_ERR_BAD_REQUEST);
+    }
+
+    dest_link = slice_get_uint16_le(input, 0);
+    dest_node = slice_get_uint16_le(input, 2);
+    src_link = slice_get_uint16_le(input, 4);
+    src_node = slice_get_uint16_le(input, 6);
+
+    if(dest_node != plc->dhp_node) {
+        info("DH+ request is for node %u but this PLC is node %u!", (unsigned int)dest_node, (unsigned int)plc->dhp_node);
+        return slice_make_err(EIP_ERR_BAD_REQUEST);
+    }
+
+    slice_set_uint16_le(output, 0, src_link);
+    slice_set_uint16_le(output, 2, src_node);
+    slice_set_uint16_le(output, 4, dest_link);
+    slice_set_uint16_le(output, 6, dest_node);
+
+    pccc_input = slice_from_slice(input, DHP_ROUTING_SIZE, slice_len(input) - DHP_ROUTING_SIZE);
+    pccc_output = slice_from_slice(output, DHP_ROUTING_SIZE, slice_len(output) - DHP_ROUTING_SIZE);
+
+    pccc_output = dispatch_pccc_command(pccc_input, pccc_output, plc);
+
+    return slice_from_slice(output, 0, DHP_ROUTING_SIZE + slice_len(pccc_output));
+}
+
+
+slice_s dispatch_pccc_command(slice_s pccc_input, slice_s pccc_output, plc_s *plc)
+{
+    slice_s pccc_command;
+
     info("PCCC packet:");
     slice_dump(pccc_input);
 
-    if(slice_match_bytes(pccc_input, PCCC_PREFIX, sizeof(PCCC_PREFIX))) {
-        slice_s pccc_command;
+    if(!slice_match_bytes(pccc_input, PCCC_PREFIX, sizeof(PCCC_PREFIX))) {
+        info("Unsupported PCCC prefix!");
+        return make_pccc_error(pccc_output, PCCC_ERR_UNSUPPORTED_COMMAND, plc);
+    }
 
-        info("Matched valid PCCC prefix.");
+    info("Matched valid PCCC prefix.");
 
-        plc->pccc_seq_id = slice_get_uint16_le(pccc_input, 2);
+    plc->pccc_seq_id = slice_get_uint16_le(pccc_input, 2);
 
-        pccc_command = slice_from_slice(pccc_input, 4, slice_len(pccc_input) - 4);
+    pccc_command = slice_from_slice(pccc_input, 4, slice_len(pccc_input) - 4);
 
-        /* match the command. */
-        if(plc->plc_type == PLC_PLC5 && slice_match_bytes(pccc_command, PLC5_READ, sizeof(PLC5_READ))) {
-            pccc_output = handle_plc5_read_request(pccc_command, pccc_output, plc);
-        } else if(plc->plc_type == PLC_PLC5 && slice_match_bytes(pccc_command, PLC5_WRITE, sizeof(PLC5_WRITE))) {
-            pccc_output = handle_plc5_write_request(pccc_command, pccc_output, plc);
-        } else if((plc->plc_type == PLC_SLC || plc->plc_type == PLC_MICROLOGIX) && slice_match_bytes(pccc_command, SLC_READ, sizeof(SLC_READ))) {
-            pccc_output = handle_slc_read_request(pccc_command, pccc_output, plc);
-        } else if((plc->plc_type == PLC_SLC || plc->plc_type == PLC_MICROLOGIX) && slice_match_bytes(pccc_command, SLC_WRITE, sizeof(SLC_WRITE))) {
-            pccc_output = handle_slc_write_request(pccc_command, pccc_output, plc);
-        } else {
-            info("Unsupported PCCC command!");
-            pccc_output = make_pccc_error(pccc_output, PCCC_ERR_UNSUPPORTED_COMMAND, plc);
-        }
+    /* match the command. */
+    if(plc->plc_type == PLC_PLC5 && slice_match_bytes(pccc_command, PLC5_READ, sizeof(PLC5_READ))) {
+        pccc_output = handle_plc5_read_request(pccc_command, pccc_output, plc);
+    } else if(plc->plc_type == PLC_PLC5 && slice_match_bytes(pccc_command, PLC5_WRITE, sizeof(PLC5_WRITE))) {
+        pccc_output = handle_plc5_write_request(pccc_command, pccc_output, plc);
+    } else if((plc->plc_type == PLC_SLC || plc->plc_type == PLC_MICROLOGIX) && slice_match_bytes(pccc_command, SLC_READ, sizeof(SLC_READ))) {
+        pccc_output = handle_slc_read_request(pccc_command, pccc_output, plc);
+    } else if((plc->plc_type == PLC_SLC || plc->plc_type == PLC_MICROLOGIX) && slice_match_bytes(pccc_command, SLC_WRITE, sizeof(SLC_WRITE))) {
+        pccc_output = handle_slc_write_request(pccc_command, pccc_output, plc);
+    } else {
+        info("Unsupported PCCC command!");
+        pccc_output = make_pccc_error(pccc_output, PCCC_ERR_UNSUPPORTED_COMMAND, plc);
     }
 
-    return slice_from_slice(output, 0, 11 + slice_len(pccc_output));
+    return pccc_output;
 }
 
 
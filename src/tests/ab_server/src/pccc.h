@@ -37,3 +37,4 @@
 #include "slice.h"
 
 extern slice_s dispatch_pccc_request(slice_s input, slice_s output, plc_s *context);
+extern slice_s dispatch_dhp_request(slice_s input, slice_s output, plc_s *context);
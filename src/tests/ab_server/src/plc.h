@@ -62,6 +62,7 @@ typedef uint16_t tag_type_t;
 struct tag_def_s {
     struct tag_def_s *next_tag;
     char *name;
+    uint32_t instance_id;
     tag_type_t tag_type;
     size_t elem_size;
     size_t elem_count;
@@ -108,12 +109,19 @@ typedef struct {
     /* PCCC info */
     uint16_t pccc_seq_id;
 
+    /* DH+ bridging, see dispatch_dhp_request().  The port is zero without DH+. */
+    uint8_t dhp_port;
+    uint16_t dhp_node;
+
     /* debugging. */
     int reject_fo_count;
 
     /* response delay */
     int response_delay;
 
+    /* recorded responses, see replay.c. */
+    struct replay_s *replay;
+
     /* list of tags served by this "PLC" */
     struct tag_def_s *tags;
 } plc_s;
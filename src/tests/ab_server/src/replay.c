@@ -0,0 +1,735 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eip.h"
+#include "plc.h"
+#include "replay.h"
+#include "slice.h"
+#include "tcp_server.h"
+#include "utils.h"
+
+
+/*
+ * Replay of captured EtherNet/IP traffic.
+ *
+ * The capture is a pcap file, either one written by the library (see
+ * plc_tag_capture_start()) or one taken with tcpdump or Wireshark.  The
+ * TCP streams are put back together and cut into EIP packets.  Each
+ * response from the PLC is paired with the request it answers: by the
+ * sender context for unconnected messages and by the connection sequence
+ * number for connected ones.
+ *
+ * When a request comes in whose CIP part is byte for byte the same as a
+ * recorded one, the recorded response is sent back after waiting as long
+ * as the PLC took.  The session handle, sender context, connection ID
+ * and sequence number are patched to match the live connection.  The
+ * search starts after the last response used, so repeated reads of the
+ * same tag get the recorded values in order.  It wraps at the end.
+ *
+ * Session registration, Forward Open and Forward Close, and anything
+ * that was not recorded, go to the normal handlers.
+ */
+
+#define PCAP_MAGIC_US           ((uint32_t)0xA1B2C3D4)
+#define PCAP_MAGIC_NS           ((uint32_t)0xA1B23C4D)
+#define PCAP_MAGIC_US_SWAPPED   ((uint32_t)0xD4C3B2A1)
+#define PCAP_MAGIC_NS_SWAPPED   ((uint32_t)0x4D3CB2A1)
+#define PCAP_FILE_HEADER_SIZE   (24)
+#define PCAP_RECORD_HEADER_SIZE (16)
+
+#define LINKTYPE_NULL           (0)
+#define LINKTYPE_ETHERNET       (1)
+#define LINKTYPE_RAW            (101)
+#define LINKTYPE_LINUX_SLL      (113)
+
+#define EIP_PORT                ((uint16_t)44818)
+#define EIP_UNCONNECTED_SEND    ((uint16_t)0x006F)
+#define EIP_CONNECTED_SEND      ((uint16_t)0x0070)
+
+/* offsets into the whole EIP packet. */
+#define EIP_SESSION_HANDLE_OFFSET   (4)
+#define EIP_SENDER_CONTEXT_OFFSET   (12)
+#define UCONN_CIP_OFFSET            (40)
+#define CONN_ID_OFFSET              (36)
+#define CONN_SEQ_OFFSET             (44)
+#define CONN_CIP_OFFSET             (46)
+
+#define CIP_FORWARD_CLOSE       ((uint8_t)0x4E)
+#define CIP_FORWARD_OPEN        ((uint8_t)0x54)
+#define CIP_FORWARD_OPEN_EX     ((uint8_t)0x5B)
+
+#define INITIAL_CAPACITY        (64)
+
+
+typedef struct {
+    bool synced;
+    uint32_t next_seq;
+    uint8_t *buf;
+    size_t len;
+    size_t capacity;
+} replay_stream_s;
+
+typedef struct {
+    uint32_t client_addr;
+    uint16_t client_port;
+    uint16_t server_port;
+    size_t first_unanswered;
+    replay_stream_s streams[2]; /* indexed by from_server. */
+} replay_conn_s;
+
+typedef struct {
+    size_t conn;
+    bool from_server;
+    bool answered;
+    int64_t time_us;
+    size_t len;
+    uint8_t *data;
+} replay_frame_s;
+
+typedef struct {
+    size_t request;
+    size_t response;
+    int64_t latency_us;
+} replay_exchange_s;
+
+struct replay_s {
+    replay_conn_s *conns;
+    size_t num_conns;
+    size_t conn_capacity;
+
+    replay_frame_s *frames;
+    size_t num_frames;
+    size_t frame_capacity;
+
+    replay_exchange_s *exchanges;
+    size_t num_exchanges;
+    size_t exchange_capacity;
+
+    size_t next_exchange;
+    size_t hits;
+    size_t misses;
+};
+
+
+static uint8_t *read_file(const char *file_name, size_t *file_len);
+static void add_packet(replay_s *replay, const uint8_t *data, size_t len, uint32_t link_type, int64_t time_us);
+static size_t find_conn(replay_s *replay, uint32_t client_addr, uint16_t client_port, uint16_t server_port);
+static void add_segment(replay_s *replay, size_t conn, bool from_server, uint32_t seq, const uint8_t *data, size_t len, int64_t time_us);
+static void add_frame(replay_s *replay, size_t conn, bool from_server, const uint8_t *data, size_t len, int64_t time_us);
+static void pair_frames(replay_s *replay);
+static bool is_connection_service(const replay_frame_s *frame);
+static size_t cip_offset(uint16_t command);
+static void *grow(void *array, size_t *capacity, size_t needed, size_t elem_size);
+static uint16_t get_uint16_be(const uint8_t *data);
+static uint32_t get_uint32_be(const uint8_t *data);
+static uint16_t get_uint16_le(const uint8_t *data);
+static uint32_t get_uint32_le(const uint8_t *data);
+static uint32_t get_uint32(const uint8_t *data, bool swapped);
+
+
+
+replay_s *replay_load(const char *file_name)
+{
+    replay_s *replay = calloc(1, sizeof(*replay));
+    uint8_t *file_data = NULL;
+    size_t file_len = 0;
+    size_t offset = 0;
+    uint32_t magic = 0;
+    uint32_t link_type = 0;
+    bool swapped = false;
+    bool nanoseconds = false;
+
+    if(!replay) {
+        error("Unable to allocate replay state!");
+    }
+
+    file_data = read_file(file_name, &file_len);
+
+    if(file_len < PCAP_FILE_HEADER_SIZE) {
+        error("Replay file \"%s\" is too short to be a pcap file!", file_name);
+    }
+
+    magic = get_uint32_le(file_data);
+
+    switch(magic) {
+        case PCAP_MAGIC_US: swapped = false; nanoseconds = false; break;
+        case PCAP_MAGIC_NS: swapped = false; nanoseconds = true; break;
+        case PCAP_MAGIC_US_SWAPPED: swapped = true; nanoseconds = false; break;
+        case PCAP_MAGIC_NS_SWAPPED: swapped = true; nanoseconds = true; break;
+        default:
+            error("Replay file \"%s\" is not a pcap file, magic number is %08x!", file_name, magic);
+            break;
+    }
+
+    link_type = get_uint32(file_data + 20, swapped) & 0xFFFF;
+
+    if(link_type != LINKTYPE_NULL && link_type != LINKTYPE_ETHERNET && link_type != LINKTYPE_RAW && link_type != LINKTYPE_LINUX_SLL) {
+        error("Unsupported pcap link type %u in \"%s\"!", link_type, file_name);
+    }
+
+    offset = PCAP_FILE_HEADER_SIZE;
+
+    while(offset + PCAP_RECORD_HEADER_SIZE <= file_len) {
+        const uint8_t *record = file_data + offset;
+        int64_t time_us = (int64_t)get_uint32(record, swapped) * 1000000;
+        uint32_t frac = get_uint32(record + 4, swapped);
+        size_t incl_len = get_uint32(record + 8, swapped);
+        size_t orig_len = get_uint32(record + 12, swapped);
+
+        time_us += (nanoseconds ? (int64_t)(frac / 1000) : (int64_t)frac);
+
+        offset += PCAP_RECORD_HEADER_SIZE;
+
+        if(incl_len > file_len - offset) {
+            fprintf(stderr, "Replay file \"%s\" ends in the middle of a packet, ignoring it.\n", file_name);
+            break;
+        }
+
+        /* packets cut short by the snap length cannot be used. */
+        if(incl_len == orig_len) {
+            add_packet(replay, file_data + offset, incl_len, link_type, time_us);
+        } else {
+            info("Skipping truncated packet of %zu bytes.", orig_len);
+        }
+
+        offset += incl_len;
+    }
+
+    free(file_data);
+
+    pair_frames(replay);
+
+    fprintf(stderr, "Loaded %zu recorded responses from %zu EIP packets on %zu connections.\n", replay->num_exchanges, replay->num_frames, replay->num_conns);
+
+    return replay;
+}
+
+
+
+void replay_destroy(replay_s *replay)
+{
+    if(!replay) {
+        return;
+    }
+
+    for(size_t i=0; i < replay->num_conns; i++) {
+        free(replay->conns[i].streams[0].buf);
+        free(replay->conns[i].streams[1].buf);
+    }
+
+    for(size_t i=0; i < replay->num_frames; i++) {
+        free(replay->frames[i].data);
+    }
+
+    free(replay->conns);
+    free(replay->frames);
+    free(replay->exchanges);
+    free(replay);
+}
+
+
+
+void replay_report(replay_s *replay)
+{
+    if(replay) {
+        fprintf(stderr, "Replayed %zu recorded responses, %zu requests had no recording.\n", replay->hits, replay->misses);
+    }
+}
+
+
+
+slice_s replay_response(slice_s input, slice_s output, plc_s *plc)
+{
+    replay_s *replay = plc->replay;
+    uint16_t command = slice_get_uint16_le(input, 0);
+    size_t offset = cip_offset(command);
+    size_t cip_len = 0;
+    uint32_t session_handle = 0;
+    uint64_t sender_context = 0;
+    uint16_t conn_seq = 0;
+    replay_exchange_s *exchange = NULL;
+    replay_frame_s *response = NULL;
+    size_t index = 0;
+
+    if(!replay || replay->num_exchanges == 0 || offset == 0 || slice_len(input) <= offset) {
+        return slice_make_err(TCP_SERVER_UNSUPPORTED);
+    }
+
+    switch(slice_get_uint8(input, offset)) {
+        case CIP_FORWARD_OPEN:
+        case CIP_FORWARD_OPEN_EX:
+        case CIP_FORWARD_CLOSE:
+            return slice_make_err(TCP_SERVER_UNSUPPORTED);
+
+        default:
+            break;
+    }
+
+    cip_len = slice_len(input) - offset;
+
+    for(size_t i=0; i < replay->num_exchanges; i++) {
+        replay_frame_s *request = NULL;
+
+        index = (replay->next_exchange + i) % replay->num_exchanges;
+        request = &(replay->frames[replay->exchanges[index].request]);
+
+        if(get_uint16_le(request->data) == command
+           && request->len - offset == cip_len
+           && memcmp(request->data + offset, slice_get_bytes(input, offset), cip_len) == 0) {
+            exchange = &(replay->exchanges[index]);
+            break;
+        }
+    }
+
+    if(!exchange) {
+        info("No recorded response for this request.");
+        replay->misses++;
+        return slice_make_err(TCP_SERVER_UNSUPPORTED);
+    }
+
+    response = &(replay->frames[exchange->response]);
+
+    if(response->len > slice_len(output)) {
+        info("Recorded response of %zu bytes does not fit in the output buffer.", response->len);
+        replay->misses++;
+        return slice_make_err(TCP_SERVER_UNSUPPORTED);
+    }
+
+    /* the input and output share a buffer, get what we need first. */
+    session_handle = slice_get_uint32_le(input, EIP_SESSION_HANDLE_OFFSET);
+    sender_context = slice_get_uint64_le(input, EIP_SENDER_CONTEXT_OFFSET);
+    conn_seq = slice_get_uint16_le(input, CONN_SEQ_OFFSET);
+
+    if(exchange->latency_us > 0) {
+        util_sleep_us(exchange->latency_us);
+    }
+
+    memcpy(slice_get_bytes(output, 0), response->data, response->len);
+    output = slice_from_slice(output, 0, response->len);
+
+    slice_set_uint32_le(output, EIP_SESSION_HANDLE_OFFSET, session_handle);
+    slice_set_uin64_le(output, EIP_SENDER_CONTEXT_OFFSET, sender_context);
+
+    if(command == EIP_CONNECTED_SEND) {
+        slice_set_uint32_le(output, CONN_ID_OFFSET, plc->client_connection_id);
+        slice_set_uint16_le(output, CONN_SEQ_OFFSET, conn_seq);
+    }
+
+    info("Replaying recorded response %zu after %lldus.", index, (long long)exchange->latency_us);
+    slice_dump(output);
+
+    replay->next_exchange = (index + 1) % replay->num_exchanges;
+    replay->hits++;
+
+    return output;
+}
+
+
+
+
+uint8_t *read_file(const char *file_name, size_t *file_len)
+{
+    FILE *file = fopen(file_name, "rb");
+    uint8_t *data = NULL;
+    size_t capacity = 0;
+    size_t len = 0;
+
+    if(!file) {
+        error("Unable to open replay file \"%s\"!", file_name);
+    }
+
+    do {
+        if(len == capacity) {
+            data = grow(data, &capacity, len + 1, 1);
+        }
+
+        len += fread(data + len, 1, capacity - len, file);
+    } while(!feof(file) && !ferror(file));
+
+    if(ferror(file)) {
+        error("Error reading replay file \"%s\"!", file_name);
+    }
+
+    fclose(file);
+
+    *file_len = len;
+
+    return data;
+}
+
+
+
+/*
+ * Strip the link layer, IP and TCP headers and hand the payload to the
+ * connection it belongs to.  Anything that is not TCP over IPv4 is
+ * ignored.  The PLC side of a connection is the one using the EIP port,
+ * or the lower port if neither does.
+ */
+
+void add_packet(replay_s *replay, const uint8_t *data, size_t len, uint32_t link_type, int64_t time_us)
+{
+    size_t ip_offset = 0;
+    size_t ip_header_len = 0;
+    size_t ip_total_len = 0;
+    size_t tcp_header_len = 0;
+    const uint8_t *ip = NULL;
+    const uint8_t *tcp = NULL;
+    uint16_t src_port = 0;
+    uint16_t dst_port = 0;
+    bool from_server = false;
+    size_t conn = 0;
+
+    switch(link_type) {
+        case LINKTYPE_NULL:
+            ip_offset = 4;
+            break;
+
+        case LINKTYPE_ETHERNET:
+            if(len < 14 || get_uint16_be(data + 12) != 0x0800) {
+                return;
+            }
+            ip_offset = 14;
+            break;
+
+        case LINKTYPE_LINUX_SLL:
+            if(len < 16 || get_uint16_be(data + 14) != 0x0800) {
+                return;
+            }
+            ip_offset = 16;
+            break;
+
+        default:
+            ip_offset = 0;
+            break;
+    }
+
+    if(len < ip_offset + 20) {
+        return;
+    }
+
+    ip = data + ip_offset;
+
+    if((ip[0] >> 4) != 4 || ip[9] != 6) {
+        return;
+    }
+
+    ip_header_len = (size_t)(ip[0] & 0x0F) * 4;
+    ip_total_len = get_uint16_be(ip + 2);
+
+    if(ip_total_len > len - ip_offset || ip_total_len < ip_header_len + 20) {
+        return;
+    }
+
+    tcp = ip + ip_header_len;
+    tcp_header_len = (size_t)(tcp[12] >> 4) * 4;
+
+    if(ip_total_len < ip_header_len + tcp_header_len) {
+        return;
+    }
+
+    src_port = get_uint16_be(tcp);
+    dst_port = get_uint16_be(tcp + 2);
+
+    if(src_port == EIP_PORT) {
+        from_server = true;
+    } else if(dst_port == EIP_PORT) {
+        from_server = false;
+    } else {
+        from_server = (src_port < dst_port);
+    }
+
+    if(from_server) {
+        conn = find_conn(replay, get_uint32_be(ip + 16), dst_port, src_port);
+    } else {
+        conn = find_conn(replay, get_uint32_be(ip + 12), src_port, dst_port);
+    }
+
+    add_segment(replay, conn, from_server, get_uint32_be(tcp + 4),
+                tcp + tcp_header_len, ip_total_len - ip_header_len - tcp_header_len, time_us);
+}
+
+
+
+size_t find_conn(replay_s *replay, uint32_t client_addr, uint16_t client_port, uint16_t server_port)
+{
+    replay_conn_s *conn = NULL;
+
+    for(size_t i=0; i < replay->num_conns; i++) {
+        conn = &(replay->conns[i]);
+
+        if(conn->client_addr == client_addr && conn->client_port == client_port && conn->server_port == server_port) {
+            return i;
+        }
+    }
+
+    replay->conns = grow(replay->conns, &replay->conn_capacity, replay->num_conns + 1, sizeof(*replay->conns));
+
+    conn = &(replay->conns[replay->num_conns]);
+    memset(conn, 0, sizeof(*conn));
+    conn->client_addr = client_addr;
+    conn->client_port = client_port;
+    conn->server_port = server_port;
+    conn->first_unanswered = replay->num_frames;
+
+    return replay->num_conns++;
+}
+
+
+
+/*
+ * Put a TCP stream back together and cut it into EIP packets.
+ * Retransmitted data is dropped.  After a gap in the stream, the
+ * next segment is assumed to start a new packet.
+ */
+
+void add_segment(replay_s *replay, size_t conn, bool from_server, uint32_t seq, const uint8_t *data, size_t len, int64_t time_us)
+{
+    replay_stream_s *stream = &(replay->conns[conn].streams[from_server ? 1 : 0]);
+
+    if(len == 0) {
+        return;
+    }
+
+    if(stream->synced) {
+        int32_t diff = (int32_t)(seq - stream->next_seq);
+
+        if(diff < 0) {
+            if((size_t)(-(int64_t)diff) >= len) {
+                return;
+            }
+
+            data += (size_t)(-(int64_t)diff);
+            len -= (size_t)(-(int64_t)diff);
+            seq = stream->next_seq;
+        } else if(diff > 0) {
+            info("Lost %d bytes of a TCP stream, dropping %zu buffered bytes.", diff, stream->len);
+            stream->len = 0;
+        }
+    }
+
+    stream->synced = true;
+    stream->next_seq = seq + (uint32_t)len;
+
+    stream->buf = grow(stream->buf, &stream->capacity, stream->len + len, 1);
+    memcpy(stream->buf + stream->len, data, len);
+    stream->len += len;
+
+    while(stream->len >= EIP_HEADER_SIZE) {
+        size_t frame_len = EIP_HEADER_SIZE + get_uint16_le(stream->buf + 2);
+
+        if(stream->len < frame_len) {
+            break;
+        }
+
+        add_frame(replay, conn, from_server, stream->buf, frame_len, time_us);
+
+        memmove(stream->buf, stream->buf + frame_len, stream->len - frame_len);
+        stream->len -= frame_len;
+    }
+}
+
+
+
+void add_frame(replay_s *replay, size_t conn, bool from_server, const uint8_t *data, size_t len, int64_t time_us)
+{
+    replay_frame_s *frame = NULL;
+
+    replay->frames = grow(replay->frames, &replay->frame_capacity, replay->num_frames + 1, sizeof(*replay->frames));
+
+    frame = &(replay->frames[replay->num_frames]);
+    frame->conn = conn;
+    frame->from_server = from_server;
+    frame->answered = false;
+    frame->time_us = time_us;
+    frame->len = len;
+    frame->data = malloc(len);
+
+    if(!frame->data) {
+        error("Unable to allocate %zu bytes for a recorded packet!", len);
+    }
+
+    memcpy(frame->data, data, len);
+
+    replay->num_frames++;
+}
+
+
+
+/*
+ * Match each response to the oldest unanswered request on the same
+ * connection with the same sender context (unconnected) or the same
+ * connection sequence number (connected).
+ */
+
+void pair_frames(replay_s *replay)
+{
+    for(size_t i=0; i < replay->num_frames; i++) {
+        replay_frame_s *response = &(replay->frames[i]);
+        replay_conn_s *conn = &(replay->conns[response->conn]);
+        uint16_t command = get_uint16_le(response->data);
+        size_t offset = cip_offset(command);
+
+        if(!response->from_server || offset == 0 || response->len <= offset) {
+            continue;
+        }
+
+        for(size_t j = conn->first_unanswered; j < i; j++) {
+            replay_frame_s *request = &(replay->frames[j]);
+            replay_exchange_s *exchange = NULL;
+
+            if(request->conn != response->conn || request->from_server || request->answered) {
+                continue;
+            }
+
+            if(get_uint16_le(request->data) != command || request->len <= offset) {
+                continue;
+            }
+
+            if(command == EIP_UNCONNECTED_SEND) {
+                if(memcmp(request->data + EIP_SENDER_CONTEXT_OFFSET, response->data + EIP_SENDER_CONTEXT_OFFSET, 8) != 0) {
+                    continue;
+                }
+            } else {
+                if(get_uint16_le(request->data + CONN_SEQ_OFFSET) != get_uint16_le(response->data + CONN_SEQ_OFFSET)) {
+                    continue;
+                }
+            }
+
+            request->answered = true;
+
+            if(!is_connection_service(request)) {
+                replay->exchanges = grow(replay->exchanges, &replay->exchange_capacity, replay->num_exchanges + 1, sizeof(*replay->exchanges));
+
+                exchange = &(replay->exchanges[replay->num_exchanges++]);
+                exchange->request = j;
+                exchange->response = i;
+                exchange->latency_us = (response->time_us > request->time_us ? response->time_us - request->time_us : 0);
+            }
+
+            break;
+        }
+
+        /* skip over the requests that have been answered or never will be. */
+        while(conn->first_unanswered < i) {
+            replay_frame_s *frame = &(replay->frames[conn->first_unanswered]);
+
+            if(frame->conn == response->conn && !frame->from_server && !frame->answered && cip_offset(get_uint16_le(frame->data)) != 0) {
+                break;
+            }
+
+            conn->first_unanswered++;
+        }
+    }
+}
+
+
+
+bool is_connection_service(const replay_frame_s *frame)
+{
+    uint8_t service = frame->data[cip_offset(get_uint16_le(frame->data))];
+
+    return (service == CIP_FORWARD_OPEN || service == CIP_FORWARD_OPEN_EX || service == CIP_FORWARD_CLOSE);
+}
+
+
+
+size_t cip_offset(uint16_t command)
+{
+    switch(command) {
+        case EIP_UNCONNECTED_SEND: return UCONN_CIP_OFFSET;
+        case EIP_CONNECTED_SEND: return CONN_CIP_OFFSET;
+        default: return 0;
+    }
+}
+
+
+
+void *grow(void *array, size_t *capacity, size_t needed, size_t elem_size)
+{
+    size_t new_capacity = (*capacity ? *capacity : INITIAL_CAPACITY);
+    void *new_array = NULL;
+
+    if(needed <= *capacity) {
+        return array;
+    }
+
+    while(new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    new_array = realloc(array, new_capacity * elem_size);
+    if(!new_array) {
+        error("Unable to allocate memory for the replay data!");
+    }
+
+    *capacity = new_capacity;
+
+    return new_array;
+}
+
+
+
+uint16_t get_uint16_be(const uint8_t *data)
+{
+    return (uint16_t)(((uint16_t)data[0] << 8) | (uint16_t)data[1]);
+}
+
+
+uint32_t get_uint32_be(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+
+uint16_t get_uint16_le(const uint8_t *data)
+{
+    return (uint16_t)((uint16_t)data[0] | ((uint16_t)data[1] << 8));
+}
+
+
+uint32_t get_uint32_le(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+
+uint32_t get_uint32(const uint8_t *data, bool swapped)
+{
+    return (swapped ? get_uint32_be(data) : get_uint32_le(data));
+}
@@ -41,6 +41,7 @@
     #include <errno.h>
     #include <netdb.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <sys/socket.h>
     #include <sys/time.h>
     #include <sys/types.h>
@@ -243,7 +244,15 @@ int socket_accept(int sock)
     if (num_accept_ready > 0) {
         info("Ready to accept on %d sockets.", num_accept_ready);
         if (FD_ISSET(sock, &accept_fd_set)) {
-            return (int)accept(sock, NULL, NULL);
+            int client = (int)accept(sock, NULL, NULL);
+            int sock_opt = 1;
+
+            /* answer pipelined requests at once instead of waiting on the client's ACK. */
+            if(client >= 0 && setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (char*)&sock_opt, sizeof(sock_opt))) {
+                info("WARN: Setting TCP_NODELAY on the client socket failed.");
+            }
+
+            return client;
         }
     } else if (num_accept_ready < 0) {
         info("Error selecting the listen socket!");
@@ -265,16 +274,20 @@ slice_s socket_read(int sock, slice_s in_buf)
     if(rc < 0) {
 #ifdef IS_WINDOWS
         rc = WSAGetLastError();
-        if(rc == WSAEWOULDBLOCK) {
+        if(rc == WSAEWOULDBLOCK || rc == WSAETIMEDOUT) {
 #else
         rc = errno;
         if(rc == EAGAIN || rc == EWOULDBLOCK) {
 #endif
+            /* no data yet or the receive timed out, the caller tries again. */
             rc = 0;
         } else {
             info("Socket read error rc=%d.\n", rc);
             rc = SOCKET_ERR_READ;
         }
+    } else if(rc == 0 && in_buf.len > 0) {
+        /* recv() only returns zero when the other end closed the socket. */
+        rc = SOCKET_ERR_CLOSED;
     }
 
     return ((rc>=0) ? slice_from_slice(in_buf, 0, (size_t)(unsigned int)rc) : slice_make_err(rc));
@@ -46,7 +46,8 @@ typedef enum {
     SOCKET_ERR_READ     = -8,
     SOCKET_ERR_WRITE    = -9,
     SOCKET_ERR_SELECT   = -10,
-    SOCKET_ERR_ACCEPT   = -11
+    SOCKET_ERR_ACCEPT   = -11,
+    SOCKET_ERR_CLOSED   = -12
 } socket_err_t;
 
 extern int socket_open(const char *host, const char *port);
@@ -42,13 +42,14 @@
 
 struct tcp_server {
     int sock_fd;
-    slice_s buffer;
-    slice_s (*handler)(slice_s input, slice_s output, void *context);
+    slice_s in_buffer;
+    slice_s out_buffer;
+    slice_s (*handler)(slice_s input, slice_s output, size_t *input_used, void *context);
     void *context;
 };
 
 
-tcp_server_p tcp_server_create(const char *host, const char *port, slice_s buffer, slice_s (*handler)(slice_s input, slice_s output, void *context), void *context)
+tcp_server_p tcp_server_create(const char *host, const char *port, slice_s in_buffer, slice_s out_buffer, slice_s (*handler)(slice_s input, slice_s output, size_t *input_used, void *context), void *context)
 {
     tcp_server_p server = calloc(1, sizeof(*server));
 
@@ -59,7 +60,8 @@ tcp_server_p tcp_server_create(const char *host, const char *port, slice_s buffe
             error("ERROR: Unable to open TCP socket, error code %d!", server->sock_fd);
         }
 
-        server->buffer = buffer;
+        server->in_buffer = in_buffer;
+        server->out_buffer = out_buffer;
         server->handler = handler;
         server->context = context;
     }
@@ -70,7 +72,6 @@ tcp_server_p tcp_server_create(const char *host, const char *port, slice_s buffe
 void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate)
 {
     int client_fd;
-    bool done = false;
 
     info("Waiting for new client connection.");
 
@@ -78,26 +79,44 @@ void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate)
         client_fd = socket_accept(server->sock_fd);
 
         if(client_fd >= 0) {
-            slice_s tmp_input = server->buffer;
-            slice_s tmp_output;
-            int rc;
+            size_t buffered = 0;
+            int rc = TCP_SERVER_PROCESSED;
 
             info("Got new client connection, going into processing loop.");
 
             do {
-                rc = TCP_SERVER_PROCESSED;
+                slice_s tmp_input;
+                slice_s tmp_output;
+                size_t input_used = 0;
+
+                /* get more data unless the last read had more than one request in it. */
+                if(rc != TCP_SERVER_PROCESSED || buffered == 0) {
+                    tmp_input = socket_read(client_fd, slice_from_slice(server->in_buffer, buffered, slice_len(server->in_buffer) - buffered));
+
+                    if(slice_has_err(tmp_input)) {
+                        if(slice_get_err(tmp_input) == SOCKET_ERR_CLOSED) {
+                            info("The client closed the connection.");
+                        } else {
+                            info("WARN: error response reading socket! error %d", slice_get_err(tmp_input));
+                        }
 
-                /* get an incoming packet or a partial packet. */
-                tmp_input = socket_read(client_fd, tmp_input);
+                        rc = TCP_SERVER_DONE;
+                        break;
+                    }
 
-                if((rc = slice_has_err(tmp_input))) {
-                    info("WARN: error response reading socket! error %d", rc);
-                    rc = TCP_SERVER_DONE;
-                    break;
+                    /* nothing yet or the read timed out, an idle client keeps its connection. */
+                    if(slice_len(tmp_input) == 0) {
+                        rc = TCP_SERVER_INCOMPLETE;
+                        continue;
+                    }
+
+                    buffered += slice_len(tmp_input);
                 }
 
-                /* try to process the packet. */
-                tmp_output = server->handler(tmp_input, server->buffer, server->context);
+                rc = TCP_SERVER_PROCESSED;
+
+                /* try to process the first packet. */
+                tmp_output = server->handler(slice_from_slice(server->in_buffer, 0, buffered), server->out_buffer, &input_used, server->context);
 
                 /* check the response. */
                 if(!slice_has_err(tmp_output)) {
@@ -110,19 +129,24 @@ void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate)
                         rc = TCP_SERVER_DONE;
                         break;
                     } else {
-                        /* all good. Reset the buffers etc. */
-                        tmp_input = server->buffer;
+                        /* all good.  Keep any data after the request for the next pass. */
+                        if(input_used < buffered) {
+                            memmove(server->in_buffer.data, server->in_buffer.data + input_used, buffered - input_used);
+                            buffered -= input_used;
+                        } else {
+                            buffered = 0;
+                        }
+
                         rc = TCP_SERVER_PROCESSED;
                     }
                 } else {
                     /* there was some sort of error or exceptional condition. */
-                    switch((rc = slice_get_err(tmp_input))) {
+                    switch((rc = slice_get_err(tmp_output))) {
                         case TCP_SERVER_DONE:
-                            done = true;
+                            /* the client unregistered, wait for the next one. */
                             break;
 
                         case TCP_SERVER_INCOMPLETE:
-                            tmp_input = slice_from_slice(server->buffer, slice_len(tmp_input), slice_len(server->buffer) - slice_len(tmp_input));
                             break;
 
                         case TCP_SERVER_PROCESSED:
@@ -130,7 +154,7 @@ void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate)
 
                         case TCP_SERVER_UNSUPPORTED:
                             info("WARN: Unsupported packet!");
-                            slice_dump(tmp_input);
+                            slice_dump(slice_from_slice(server->in_buffer, 0, buffered));
                             break;
 
                         default:
@@ -138,7 +162,7 @@ void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate)
                             break;
                     }
                 }
-            } while(rc == TCP_SERVER_INCOMPLETE || rc == TCP_SERVER_PROCESSED);
+            } while((rc == TCP_SERVER_INCOMPLETE || rc == TCP_SERVER_PROCESSED) && !*terminate);
 
             /* done with the socket */
             socket_close(client_fd);
@@ -149,7 +173,7 @@ void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate)
 
         /* wait a bit to give back the CPU. */
         util_sleep_ms(1);
-    } while(!done && !*terminate);
+    } while(!*terminate);
 }
 
 
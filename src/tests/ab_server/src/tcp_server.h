@@ -47,7 +47,13 @@ typedef enum {
 
 typedef struct tcp_server *tcp_server_p;
 
-extern tcp_server_p tcp_server_create(const char *host, const char *port, slice_s buffer, slice_s (*handler)(slice_s input, slice_s output, void *context), void *context);
+/*
+ * The handler is passed all of the data read so far.  It returns the
+ * response to the first request in it and sets *input_used to the size of
+ * that request.  Any data after it is passed again on the next call, so
+ * clients can send requests without waiting for each response.
+ */
+extern tcp_server_p tcp_server_create(const char *host, const char *port, slice_s in_buffer, slice_s out_buffer, slice_s (*handler)(slice_s input, slice_s output, size_t *input_used, void *context), void *context);
 extern void tcp_server_start(tcp_server_p server, volatile sig_atomic_t *terminate);
 extern void tcp_server_destroy(tcp_server_p server);
 
@@ -73,6 +73,13 @@ int util_sleep_ms(int ms)
     return 1;
 }
 
+int util_sleep_us(int64_t us)
+{
+    /* Windows only sleeps in milliseconds, round up. */
+    Sleep((DWORD)((us + 999) / 1000));
+    return 1;
+}
+
 #else
 
 int util_sleep_ms(int ms)
@@ -85,6 +92,16 @@ int util_sleep_ms(int ms)
     return select(0,NULL,NULL,NULL, &tv);
 }
 
+int util_sleep_us(int64_t us)
+{
+    struct timeval tv;
+
+    tv.tv_sec = (time_t)(us/1000000);
+    tv.tv_usec = (suseconds_t)(us % 1000000);
+
+    return select(0,NULL,NULL,NULL, &tv);
+}
+
 #endif
 
 
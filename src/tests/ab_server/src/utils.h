@@ -38,6 +38,7 @@
 #include "slice.h"
 
 extern int util_sleep_ms(int ms);
+extern int util_sleep_us(int64_t us);
 extern int64_t util_time_ms(void);
 
 /* string helpers */
@@ -0,0 +1,147 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Microbenchmark for util/hashtable.
+ *
+ * Times insert, lookup of present keys, lookup of missing keys and remove
+ * at table sizes from 1k to 1M entries.  Keys are sequential like tag IDs
+ * and also scrambled to stress the hash.
+ *
+ * Link against the static library since the hashtable functions are not
+ * exported from the shared library.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "../../lib/libplctag.h"
+#include "../../platform/posix/platform.h"
+#include "../../util/hashtable.h"
+#include "../../util/debug.h"
+
+#define START_CAPACITY (10)
+#define MIN_ENTRIES (1000)
+#define MAX_ENTRIES (1000000)
+
+
+static int64_t make_key(int i, int scrambled)
+{
+    if(scrambled) {
+        return (int64_t)((uint64_t)i * (uint64_t)0x9E3779B97F4A7C15ULL);
+    }
+
+    return (int64_t)i + 1;
+}
+
+
+static double ns_per_op(int64_t start_us, int64_t end_us, int ops)
+{
+    return ((double)(end_us - start_us) * 1000.0) / (double)ops;
+}
+
+
+static void run_bench(int num_entries, int scrambled)
+{
+    hashtable_p table = NULL;
+    int64_t start = 0;
+    double insert_ns = 0.0;
+    double hit_ns = 0.0;
+    double miss_ns = 0.0;
+    double remove_ns = 0.0;
+    intptr_t checksum = 0;
+
+    table = hashtable_create(START_CAPACITY);
+    assert(table != NULL);
+
+    start = time_monotonic_us();
+    for(int i=0; i < num_entries; i++) {
+        int rc = hashtable_put(table, make_key(i, scrambled), (void *)(intptr_t)(i + 1));
+        assert(rc == PLCTAG_STATUS_OK);
+    }
+    insert_ns = ns_per_op(start, time_monotonic_us(), num_entries);
+
+    assert(hashtable_entries(table) == num_entries);
+
+    start = time_monotonic_us();
+    for(int i=0; i < num_entries; i++) {
+        checksum += (intptr_t)hashtable_get(table, make_key(i, scrambled));
+    }
+    hit_ns = ns_per_op(start, time_monotonic_us(), num_entries);
+
+    start = time_monotonic_us();
+    for(int i=num_entries; i < num_entries * 2; i++) {
+        checksum += (intptr_t)hashtable_get(table, make_key(i, scrambled));
+    }
+    miss_ns = ns_per_op(start, time_monotonic_us(), num_entries);
+
+    start = time_monotonic_us();
+    for(int i=0; i < num_entries; i++) {
+        void *res = hashtable_remove(table, make_key(i, scrambled));
+        assert(res == (void *)(intptr_t)(i + 1));
+        (void)res;
+    }
+    remove_ns = ns_per_op(start, time_monotonic_us(), num_entries);
+
+    assert(hashtable_entries(table) == 0);
+
+    printf("%9d %-10s %10.1f %10.1f %10.1f %10.1f %10d  (%ld)\n",
+           num_entries,
+           (scrambled ? "scrambled" : "sequential"),
+           insert_ns,
+           hit_ns,
+           miss_ns,
+           remove_ns,
+           hashtable_capacity(table),
+           (long)checksum);
+
+    hashtable_destroy(table);
+}
+
+
+int main(int argc, const char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    plc_tag_set_debug_level(PLCTAG_DEBUG_NONE);
+
+    printf("  entries keys       insert(ns)    hit(ns)   miss(ns) remove(ns)   capacity\n");
+
+    for(int num_entries = MIN_ENTRIES; num_entries <= MAX_ENTRIES; num_entries *= 10) {
+        run_bench(num_entries, 0);
+        run_bench(num_entries, 1);
+    }
+
+    return 0;
+}
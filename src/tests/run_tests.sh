@@ -17,7 +17,7 @@ if [[ ! -d $TEST_DIR ]]; then
 fi
 
 # test for the executables.
-EXECUTABLES="ab_server string_non_standard_udt string_standard tag_rw2 list_tags_logix test_auto_sync test_callback test_callback_ex test_callback_ex_logix test_callback_ex_modbus test_many_tag_perf test_raw_cip test_reconnect test_shutdown test_special test_string test_tag_attributes test_tag_type_attribute thread_stress"
+EXECUTABLES="ab_server string_non_standard_udt string_standard tag_rw2 list_tags_logix test_auto_sync test_callback test_callback_ex test_callback_ex_logix test_callback_ex_modbus test_many_tag_perf test_raw_cip test_reconnect test_shutdown test_special test_string test_tag_attributes test_tag_type_attribute test_pccc_merge test_dhp_pipeline test_write_merge test_on_change test_view test_double_buffer test_poller test_image test_history test_txn_readback test_capture thread_stress"
 # echo -n "  Checking for executables..."
 for EXECUTABLE in $EXECUTABLES
 do
@@ -291,6 +291,102 @@ else
 fi
 
 
+let TEST++
+echo -n "Test $TEST: merged array element writes keep their order... "
+$TEST_DIR/test_write_merge > "${TEST}_write_merge_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: automatic reads with on_change... "
+$TEST_DIR/test_on_change > "${TEST}_on_change_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: tag data views... "
+$TEST_DIR/test_view > "${TEST}_view_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: double-buffered tag data... "
+$TEST_DIR/test_double_buffer > "${TEST}_double_buffer_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: tag poller... "
+$TEST_DIR/test_poller > "${TEST}_poller_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: shared memory tag images... "
+$TEST_DIR/test_image > "${TEST}_image_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: tag read histories... "
+$TEST_DIR/test_history > "${TEST}_history_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+let TEST++
+echo -n "Test $TEST: wire capture... "
+$TEST_DIR/test_capture test_capture.pcap > "${TEST}_capture_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
 let TEST++
 echo -n "Test $TEST: hard library shutdown... "
 $TEST_DIR/test_shutdown > "${TEST}_shutdown.log" 2>&1
@@ -303,6 +399,62 @@ else
 fi
 
 
+# echo "  Killing AB emulator."
+killall -TERM ab_server > /dev/null 2>&1
+
+
+# echo -n "  Starting AB emulator for transaction tests... "
+$TEST_DIR/ab_server --debug --plc=ControlLogix --path=1,0 --tag=TestDINT1:DINT[1] --tag=TestDINT2:DINT[1] --tag=TestDINT3:DINT[1] > txn_emulator.log 2>&1 &
+EMULATOR_PID=$!
+if [ $? != 0 ]; then
+    # echo "FAILURE"
+    echo "Unable to start AB/ControlLogix emulator for transactions!"
+    exit 1
+# else
+    # echo "OK"
+fi
+
+
+let TEST++
+echo -n "Test $TEST: transaction write readbacks... "
+$TEST_DIR/test_txn_readback > "${TEST}_txn_readback_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
+# echo "  Killing AB emulator."
+killall -TERM ab_server > /dev/null 2>&1
+
+
+# echo -n "  Starting AB emulator replaying the wire capture... "
+$TEST_DIR/ab_server --debug --plc=ControlLogix --path=1,0 --replay=test_capture.pcap > replay_emulator.log 2>&1 &
+EMULATOR_PID=$!
+if [ $? != 0 ]; then
+    # echo "FAILURE"
+    echo "Unable to start AB/ControlLogix emulator for replay!"
+    exit 1
+# else
+    # echo "OK"
+fi
+
+
+let TEST++
+echo -n "Test $TEST: wire capture replay... "
+$TEST_DIR/test_capture test_capture_replay.pcap > "${TEST}_capture_replay_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+
 # echo "  Killing AB emulator."
 killall -TERM ab_server > /dev/null 2>&1
 
@@ -360,6 +512,65 @@ fi
 # echo "  Killing Omron emulator."
 killall -TERM ab_server > /dev/null 2>&1
 
+
+# echo -n "  Starting AB emulator for SLC 500 tests... "
+$TEST_DIR/ab_server --debug --plc=SLC500 --tag=N7[10] --delay=50 > slc_emulator.log 2>&1 &
+EMULATOR_PID=$!
+if [ $? != 0 ]; then
+    # echo "FAILURE"
+    echo "Unable to start SLC 500 emulator!"
+    exit 1
+# else
+    # echo "OK"
+fi
+
+
+let TEST++
+echo -n "Test $TEST: SLC 500 read merging... "
+$TEST_DIR/test_pccc_merge > "${TEST}_pccc_merge_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+# echo "  Killing SLC 500 emulator."
+killall -TERM ab_server > /dev/null 2>&1
+
+# wait for the old emulator to let go of the port.
+wait $EMULATOR_PID > /dev/null 2>&1
+
+
+# echo -n "  Starting AB emulator for SLC 500 on DH+ tests... "
+$TEST_DIR/ab_server --debug --plc=SLC500 --dhp=A:5 --tag=N7[10] > slc_dhp_emulator.log 2>&1 &
+EMULATOR_PID=$!
+if [ $? != 0 ]; then
+    # echo "FAILURE"
+    echo "Unable to start SLC 500 on DH+ emulator!"
+    exit 1
+else
+    # sleep to let the emulator start up all the way
+    sleep 2
+    # echo "OK"
+fi
+
+
+let TEST++
+echo -n "Test $TEST: pipelined DH+ requests... "
+$TEST_DIR/test_dhp_pipeline > "${TEST}_dhp_pipeline_test.log" 2>&1
+if [ $? != 0 ]; then
+    echo "FAILURE"
+    let FAILURES++
+else
+    echo "OK"
+    let SUCCESSES++
+fi
+
+# echo "  Killing SLC 500 emulator."
+killall -TERM ab_server > /dev/null 2>&1
+
 # echo -n "  Starting Modbus emulator... "
 $SCRIPT_DIR/modbus_server.py > modbus_emulator.log 2>&1 &
 MODBUS_PID=$!
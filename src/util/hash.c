@@ -219,3 +219,39 @@ uint32_t hash( uint8_t *k, size_t length, uint32_t initval)
 #endif
 
 
+
+/*
+ * hash_str_i() -- hash a nul-terminated string ignoring ASCII case.
+ *
+ * The string is folded to lower case in small blocks and each block is
+ * chained through hash().  A NULL string hashes like an empty one.
+ */
+
+uint32_t hash_str_i(const char *str, uint32_t initval)
+{
+    uint8_t block[64];
+    size_t len = 0;
+    uint32_t h = initval;
+
+    if(!str) {
+        return hash(block, 0, h);
+    }
+
+    do {
+        len = 0;
+
+        while(len < sizeof(block) && str[len]) {
+            uint8_t c = (uint8_t)str[len];
+
+            block[len] = (uint8_t)((c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c);
+            len++;
+        }
+
+        h = hash(block, len, h);
+        str += len;
+    } while(len == sizeof(block));
+
+    return h;
+}
+
+
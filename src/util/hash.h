@@ -46,3 +46,4 @@
 #include <stdint.h>
 
 extern uint32_t hash(uint8_t *k, size_t length, uint32_t initval);
+extern uint32_t hash_str_i(const char *str, uint32_t initval);
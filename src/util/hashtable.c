@@ -31,30 +31,43 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#include <limits.h>
 #include <lib/libplctag.h>
 #include <platform.h>
 #include <util/debug.h>
-#include <util/hash.h>
 #include <util/hashtable.h>
-#include <util/vector.h>
 
 /*
- * This implements a simple linear probing hash table.
+ * This implements a robin hood hash table with backward shift deletion.
  *
- * Note that it will readjust its size if enough entries are made.
+ * The capacity is always a power of two so that the home slot of a key
+ * is a mask of its hash.  Entries are kept ordered by their distance from
+ * their home slot.  This keeps probe sequences short and lets a lookup
+ * stop as soon as it passes the point where the key would have been.
+ * Removing an entry shifts the following entries back so there are no
+ * tombstones.
+ *
+ * The table doubles in size when it passes the maximum load factor.
+ *
+ * Empty slots have NULL data, so NULL cannot be stored.
  */
 
-#define MAX_ITERATIONS  (10)
-#define MAX_INCREMENT (10000)
+#define MIN_CAPACITY (8)
+
+/* maximum load factor of 7/8. */
+#define MAX_LOAD_NUM (7)
+#define MAX_LOAD_DENOM (8)
 
 struct hashtable_entry_t {
     void *data;
     int64_t key;
+    uint32_t hash;
 };
 
 struct hashtable_t {
     int total_entries;
     int used_entries;
+    uint32_t mask;
     uint32_t hash_salt;
     struct hashtable_entry_t *entries;
 };
@@ -62,15 +75,16 @@ struct hashtable_t {
 
 typedef struct hashtable_entry_t *hashtable_entry_p;
 
-//static int next_highest_prime(int x);
-static int find_key(hashtable_p table, int64_t key);
-static int find_empty(hashtable_p table, int64_t key);
+static uint32_t hash_key(hashtable_p table, int64_t key);
+static int find_key(hashtable_p table, int64_t key, uint32_t hash);
+static void insert_entry(hashtable_p table, struct hashtable_entry_t entry);
 static int expand_table(hashtable_p table);
 
 
 hashtable_p hashtable_create(int initial_capacity)
 {
     hashtable_p tab = NULL;
+    int capacity = MIN_CAPACITY;
 
     pdebug(DEBUG_INFO,"Starting");
 
@@ -79,17 +93,23 @@ hashtable_p hashtable_create(int initial_capacity)
         return NULL;
     }
 
+    /* round up to a power of two. */
+    while(capacity < initial_capacity && capacity < (INT_MAX / 2)) {
+        capacity *= 2;
+    }
+
     tab = mem_alloc(sizeof(struct hashtable_t));
     if(!tab) {
         pdebug(DEBUG_ERROR,"Unable to allocate memory for hash table!");
         return NULL;
     }
 
-    tab->total_entries = initial_capacity;
+    tab->total_entries = capacity;
     tab->used_entries = 0;
+    tab->mask = (uint32_t)capacity - 1;
     tab->hash_salt = (uint32_t)(time_ms()) + (uint32_t)(intptr_t)(tab);
 
-    tab->entries = mem_alloc(initial_capacity * (int)sizeof(struct hashtable_entry_t));
+    tab->entries = mem_alloc(capacity * (int)sizeof(struct hashtable_entry_t));
     if(!tab->entries) {
         pdebug(DEBUG_ERROR,"Unable to allocate entry array!");
         hashtable_destroy(tab);
@@ -114,7 +134,7 @@ void *hashtable_get(hashtable_p table, int64_t key)
         return NULL;
     }
 
-    index = find_key(table, key);
+    index = find_key(table, key, hash_key(table, key));
     if(index != PLCTAG_ERR_NOT_FOUND) {
         result = table->entries[index].data;
         pdebug(DEBUG_SPEW,"found data %p", result);
@@ -128,10 +148,18 @@ void *hashtable_get(hashtable_p table, int64_t key)
 }
 
 
+/*
+ * hashtable_put
+ *
+ * Insert the data under the key.  If the key is already in the table,
+ * its data is replaced.
+ */
+
 int hashtable_put(hashtable_p table, int64_t key, void  *data)
 {
     int rc = PLCTAG_STATUS_OK;
     int index = 0;
+    struct hashtable_entry_t entry;
 
     pdebug(DEBUG_SPEW,"Starting");
 
@@ -140,22 +168,32 @@ int hashtable_put(hashtable_p table, int64_t key, void  *data)
         return PLCTAG_ERR_NULL_PTR;
     }
 
-    /* try to find a slot to put the new entry */
-    index = find_empty(table, key);
-    while(index == PLCTAG_ERR_NOT_FOUND) {
+    if(!data) {
+        pdebug(DEBUG_WARN, "Data pointer must not be null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    entry.key = key;
+    entry.data = data;
+    entry.hash = hash_key(table, key);
+
+    index = find_key(table, key, entry.hash);
+    if(index != PLCTAG_ERR_NOT_FOUND) {
+        pdebug(DEBUG_SPEW, "Replacing value at index %d", index);
+        table->entries[index].data = data;
+        return PLCTAG_STATUS_OK;
+    }
+
+    /* make room if this would push us past the load factor. */
+    if(((int64_t)table->used_entries + 1) * MAX_LOAD_DENOM > (int64_t)table->total_entries * MAX_LOAD_NUM) {
         rc = expand_table(table);
         if(rc != PLCTAG_STATUS_OK) {
-            pdebug(DEBUG_WARN, "Unable to expand table to make entry unique!");
+            pdebug(DEBUG_WARN, "Unable to expand table to add entry!");
             return rc;
         }
-
-        index = find_empty(table, key);
     }
 
-    pdebug(DEBUG_SPEW, "Putting value at index %d", index);
-
-    table->entries[index].key = key;
-    table->entries[index].data = data;
+    insert_entry(table, entry);
     table->used_entries++;
 
     pdebug(DEBUG_SPEW, "Done.");
@@ -164,6 +202,13 @@ int hashtable_put(hashtable_p table, int64_t key, void  *data)
 }
 
 
+/*
+ * hashtable_get_index
+ *
+ * Get the data at a raw slot index, NULL if the slot is empty.   Note that
+ * removing an entry can shift other entries back by one slot.
+ */
+
 void *hashtable_get_index(hashtable_p table, int index)
 {
     if(!table) {
@@ -211,6 +256,7 @@ int hashtable_on_each(hashtable_p table, int (*callback_func)(hashtable_p table,
 
     if(!table) {
         pdebug(DEBUG_WARN,"Hashtable pointer null or invalid");
+        return PLCTAG_ERR_NULL_PTR;
     }
 
     for(int i=0; i < table->total_entries && rc == PLCTAG_STATUS_OK; i++) {
@@ -227,6 +273,7 @@ int hashtable_on_each(hashtable_p table, int (*callback_func)(hashtable_p table,
 void *hashtable_remove(hashtable_p table, int64_t key)
 {
     int index = 0;
+    uint32_t next = 0;
     void *result = NULL;
 
     pdebug(DEBUG_DETAIL,"Starting");
@@ -236,14 +283,24 @@ void *hashtable_remove(hashtable_p table, int64_t key)
         return result;
     }
 
-    index = find_key(table, key);
+    index = find_key(table, key, hash_key(table, key));
     if(index == PLCTAG_ERR_NOT_FOUND) {
         pdebug(DEBUG_SPEW,"Not found.");
         return result;
     }
 
     result = table->entries[index].data;
+
+    /* shift back the following entries until one is empty or already in its home slot. */
+    next = ((uint32_t)index + 1) & table->mask;
+    while(table->entries[next].data && (table->entries[next].hash & table->mask) != next) {
+        table->entries[index] = table->entries[next];
+        index = (int)next;
+        next = (next + 1) & table->mask;
+    }
+
     table->entries[index].key = 0;
+    table->entries[index].hash = 0;
     table->entries[index].data = NULL;
     table->used_entries--;
 
@@ -264,8 +321,10 @@ int hashtable_destroy(hashtable_p table)
         return PLCTAG_ERR_NULL_PTR;
     }
 
-    mem_free(table->entries);
-    table->entries = NULL;
+    if(table->entries) {
+        mem_free(table->entries);
+        table->entries = NULL;
+    }
 
     mem_free(table);
 
@@ -283,74 +342,84 @@ int hashtable_destroy(hashtable_p table)
  **********************************************************************/
 
 
-#define KEY_TO_INDEX(t, k) (uint32_t)((hash((uint8_t*)&k, sizeof(k), t->hash_salt)) % (uint32_t)(t->total_entries))
+/* how far the entry in the slot is from its home slot. */
+#define PROBE_DISTANCE(t, h, i) (((i) - ((h) & (t)->mask)) & (t)->mask)
+
 
+/*
+ * hash_key
+ *
+ * Mix the salted key with the 64-bit finalizer from MurmurHash3.  Keys
+ * are usually small sequential integers so every bit needs to be mixed.
+ */
 
-int find_key(hashtable_p table, int64_t key)
+uint32_t hash_key(hashtable_p table, int64_t key)
 {
-    uint32_t initial_index = KEY_TO_INDEX(table, key);
-    int index = 0;
-    int iteration = 0;
+    uint64_t x = (uint64_t)key ^ (uint64_t)table->hash_salt;
 
-    pdebug(DEBUG_SPEW, "Starting.");
+    x ^= x >> 33;
+    x *= (uint64_t)0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= (uint64_t)0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+
+    return (uint32_t)x;
+}
+
+
+
+int find_key(hashtable_p table, int64_t key, uint32_t hash)
+{
+    uint32_t index = hash & table->mask;
+    uint32_t distance = 0;
 
     /*
-     * search for the hash value.
-     *
-     * Note: do NOT stop if we find a NULL entry.  That might be the result
-     * of a removed entry and there could still be entries past that point
-     * that are for the initial slot.
+     * Stop at an empty slot or when the entries are closer to their home than
+     * we are to ours.  Robin hood ordering means the key cannot be past that point.
      */
-    for(iteration=0; iteration < MAX_ITERATIONS; iteration++) {
-        index = ((int)initial_index + iteration) % table->total_entries;
-
-        if(table->entries[index].key == key) {
-            break;
+    while(table->entries[index].data && PROBE_DISTANCE(table, table->entries[index].hash, index) >= distance) {
+        if(table->entries[index].hash == hash && table->entries[index].key == key) {
+            return (int)index;
         }
-    }
 
-    if(iteration >= MAX_ITERATIONS) {
-        /* FIXME - does not work on Windows. */
-        //pdebug(DEBUG_SPEW, "Key %ld not found.", key);
-        return PLCTAG_ERR_NOT_FOUND;
-    } else {
-        //pdebug(DEBUG_SPEW, "Key %d found at index %d.", (int)table->entries[index].key, index);
+        index = (index + 1) & table->mask;
+        distance++;
     }
 
-    pdebug(DEBUG_SPEW, "Done.");
-
-    return index;
+    return PLCTAG_ERR_NOT_FOUND;
 }
 
 
 
+/*
+ * insert_entry
+ *
+ * Insert an entry that is not already in the table.  There must be
+ * at least one empty slot.
+ */
 
-int find_empty(hashtable_p table, int64_t key)
+void insert_entry(hashtable_p table, struct hashtable_entry_t entry)
 {
-    uint32_t initial_index = KEY_TO_INDEX(table, key);
-    int index = 0;
-    int iteration = 0;
+    uint32_t index = entry.hash & table->mask;
+    uint32_t distance = 0;
 
-    pdebug(DEBUG_SPEW, "Starting.");
+    while(table->entries[index].data) {
+        uint32_t existing_distance = PROBE_DISTANCE(table, table->entries[index].hash, index);
 
-    /* search for the hash value. */
-    for(iteration=0; iteration < MAX_ITERATIONS; iteration++) {
-        index = ((int)initial_index + iteration) % table->total_entries;
+        /* take the slot from an entry that is closer to home, then keep placing that one. */
+        if(existing_distance < distance) {
+            struct hashtable_entry_t tmp = table->entries[index];
 
-        pdebug(DEBUG_SPEW, "Trying index %d for key %ld.", index, key);
-        if(table->entries[index].data == NULL) {
-            break;
+            table->entries[index] = entry;
+            entry = tmp;
+            distance = existing_distance;
         }
-    }
 
-    if(iteration >= MAX_ITERATIONS) {
-        pdebug(DEBUG_SPEW,"No empty entry found in %d iterations!", MAX_ITERATIONS);
-        return PLCTAG_ERR_NOT_FOUND;
+        index = (index + 1) & table->mask;
+        distance++;
     }
 
-    pdebug(DEBUG_SPEW, "Done.");
-
-    return index;
+    table->entries[index] = entry;
 }
 
 
@@ -358,53 +427,39 @@ int find_empty(hashtable_p table, int64_t key)
 
 int expand_table(hashtable_p table)
 {
-    struct hashtable_t new_table;
-    int total_entries = table->total_entries;
-    int index = PLCTAG_ERR_NOT_FOUND;
+    struct hashtable_entry_t *old_entries = table->entries;
+    int old_total_entries = table->total_entries;
+    int total_entries = 0;
 
     pdebug(DEBUG_SPEW, "Starting.");
 
     pdebug(DEBUG_SPEW, "Table using %d entries of %d.", table->used_entries, table->total_entries);
 
-    do {
-        /* double entries unless already at max doubling, then increment. */
-        total_entries += (total_entries < MAX_INCREMENT ? total_entries : MAX_INCREMENT);
+    if(old_total_entries >= (INT_MAX / 2) / (int)sizeof(struct hashtable_entry_t)) {
+        pdebug(DEBUG_ERROR, "Table is already at its maximum size!");
+        return PLCTAG_ERR_TOO_LARGE;
+    }
 
-        new_table.total_entries = total_entries;
-        new_table.used_entries = 0;
-        new_table.hash_salt = table->hash_salt;
+    total_entries = old_total_entries * 2;
 
-        pdebug(DEBUG_SPEW, "trying new size = %d", total_entries);
+    table->entries = mem_alloc(total_entries * (int)sizeof(struct hashtable_entry_t));
+    if(!table->entries) {
+        pdebug(DEBUG_ERROR, "Unable to allocate new entry array!");
+        table->entries = old_entries;
+        return PLCTAG_ERR_NO_MEM;
+    }
 
-        new_table.entries = mem_alloc(total_entries * (int)sizeof(struct hashtable_entry_t));
-        if(!new_table.entries) {
-            pdebug(DEBUG_ERROR, "Unable to allocate new entry array!");
-            return PLCTAG_ERR_NO_MEM;
-        }
+    table->total_entries = total_entries;
+    table->mask = (uint32_t)total_entries - 1;
 
-        /* copy the old entries.  Only copy ones that are used. */
-        for(int i=0; i < table->total_entries; i++) {
-            if(table->entries[i].data) {
-                index = find_empty(&new_table, table->entries[i].key);
-                if(index == PLCTAG_ERR_NOT_FOUND) {
-                    /* oops, still cannot insert all the entries! Try again. */
-                    pdebug(DEBUG_DETAIL, "Unable to insert existing entry into expanded table. Retrying.");
-                    mem_free(new_table.entries);
-                    break;
-                } else {
-                    /* store the entry into the new table. */
-                    new_table.entries[index] = table->entries[i];
-                    new_table.used_entries++;
-                }
-            }
+    /* the hashes are stored, so reinserting does not need to hash again. */
+    for(int i=0; i < old_total_entries; i++) {
+        if(old_entries[i].data) {
+            insert_entry(table, old_entries[i]);
         }
-    } while(index == PLCTAG_ERR_NOT_FOUND);
+    }
 
-    /* success! */
-    mem_free(table->entries);
-    table->entries = new_table.entries;
-    table->total_entries = new_table.total_entries;
-    table->used_entries = new_table.used_entries;
+    mem_free(old_entries);
 
     pdebug(DEBUG_SPEW, "Done.");
 
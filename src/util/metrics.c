@@ -0,0 +1,550 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include <limits.h>
+#include <lib/libplctag.h>
+#include <platform.h>
+#include <util/debug.h>
+#include <util/metrics.h>
+
+
+#define METRICS_PREFIX "metrics."
+
+#define METRICS_HIST_SNAPSHOT_SIZE (8 + 8 + 8 + (METRICS_HIST_BUCKETS * 8))
+#define METRICS_SESSION_RECORD_SIZE (8 + (2 * METRICS_SNAPSHOT_NAME_LEN) + (METRICS_SNAPSHOT_NUM_COUNTERS * 8) + (6 * 8))
+
+metrics_session_t metrics_all_sessions;
+metrics_tickler_t metrics_tickler;
+
+/* registered sessions, protected by the spin lock. */
+static lock_t registry_lock = LOCK_INIT;
+static metrics_session_t *registry = NULL;
+
+
+static int saturate(int64_t val);
+static int get_counter_attrib(const char *name, const char **names, volatile int64_t **counters, int num_counters, int *value);
+static int get_hist_attrib(const char *name, const char *hist_name, metrics_hist_t *hist, int *value);
+static int snapshot_sessions(uint8_t *buffer, int buffer_size);
+static int snapshot_session_by_host(const char *name, uint8_t *buffer, int buffer_size);
+static int snapshot_hist(metrics_hist_t *hist, uint8_t *buffer, int buffer_size);
+static void sum_hist(metrics_hist_t *total, metrics_hist_t *hist);
+static int encode_counters(metrics_session_t *metrics, uint8_t *buffer, int offset);
+static int encode_int32(uint8_t *buffer, int offset, int32_t val);
+static int encode_int64(uint8_t *buffer, int offset, int64_t val);
+static int encode_name(uint8_t *buffer, int offset, const char *name);
+
+
+
+void metrics_hist_record(metrics_hist_t *hist, int64_t value)
+{
+    int bucket = 0;
+
+    if(value < 0) {
+        value = 0;
+    }
+
+    /* find the power of two bucket. */
+    for(int64_t tmp = value; tmp > 0 && bucket < (METRICS_HIST_BUCKETS - 1); tmp >>= 1) {
+        bucket++;
+    }
+
+    atomic_counter_add(&(hist->buckets[bucket]), 1);
+    atomic_counter_add(&(hist->sum), value);
+    atomic_counter_add(&(hist->count), 1);
+}
+
+
+
+/*
+ * metrics_hist_percentile
+ *
+ * Returns the upper bound of the bucket holding the requested
+ * percentile.   The buckets are read one at a time without a lock
+ * so the result is approximate if values are being recorded.
+ */
+
+int64_t metrics_hist_percentile(metrics_hist_t *hist, int percentile)
+{
+    int64_t total = 0;
+    int64_t target = 0;
+    int64_t seen = 0;
+
+    for(int i=0; i < METRICS_HIST_BUCKETS; i++) {
+        total += atomic_counter_get(&(hist->buckets[i]));
+    }
+
+    if(total == 0) {
+        return 0;
+    }
+
+    target = (total * percentile + 99) / 100;
+    if(target < 1) {
+        target = 1;
+    }
+
+    for(int i=0; i < METRICS_HIST_BUCKETS; i++) {
+        seen += atomic_counter_get(&(hist->buckets[i]));
+
+        if(seen >= target) {
+            return (i == 0 ? 0 : (((int64_t)1 << i) - 1));
+        }
+    }
+
+    return (((int64_t)1 << (METRICS_HIST_BUCKETS - 1)) - 1);
+}
+
+
+
+int metrics_get_session_attrib(metrics_session_t *metrics, const char *attrib_name, int *value)
+{
+    const char *names[] = { "requests_queued", "packets_sent", "packets_received", "bytes_sent", "bytes_received",
+                            "retries", "reconnects", "forward_open_failures" };
+    volatile int64_t *counters[] = { &(metrics->requests_queued), &(metrics->packets_sent), &(metrics->packets_received),
+                                     &(metrics->bytes_sent), &(metrics->bytes_received), &(metrics->retries),
+                                     &(metrics->reconnects), &(metrics->forward_open_failures) };
+    const char *name = NULL;
+
+    if(!attrib_name || str_cmp_i_n(attrib_name, METRICS_PREFIX, str_length(METRICS_PREFIX)) != 0) {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    name = attrib_name + str_length(METRICS_PREFIX);
+
+    if(get_counter_attrib(name, names, counters, (int)(sizeof(names)/sizeof(names[0])), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(get_hist_attrib(name, "services_per_packet", &(metrics->services_per_packet), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(get_hist_attrib(name, "rtt_us", &(metrics->rtt_us), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(get_hist_attrib(name, "queue_wait_us", &(metrics->queue_wait_us), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    return PLCTAG_ERR_UNSUPPORTED;
+}
+
+
+
+int metrics_get_library_attrib(const char *attrib_name, int *value)
+{
+    const char *tickler_names[] = { "tickler_read_misses" };
+    volatile int64_t *tickler_counters[] = { &(metrics_tickler.read_misses) };
+    const char *name = NULL;
+
+    if(!attrib_name || str_cmp_i_n(attrib_name, METRICS_PREFIX, str_length(METRICS_PREFIX)) != 0) {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    name = attrib_name + str_length(METRICS_PREFIX);
+
+    if(get_hist_attrib(name, "tickler_loop_us", &(metrics_tickler.loop_us), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(get_hist_attrib(name, "tickler_lag_us", &(metrics_tickler.lag_us), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(get_hist_attrib(name, "tickler_read_late_us", &(metrics_tickler.read_late_us), value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    if(get_counter_attrib(name, tickler_names, tickler_counters, 1, value) == PLCTAG_STATUS_OK) {
+        return PLCTAG_STATUS_OK;
+    }
+
+    /* the rest are totals across all sessions. */
+    return metrics_get_session_attrib(&metrics_all_sessions, attrib_name, value);
+}
+
+
+
+void metrics_register_session(metrics_session_t *metrics, const char *host, const char *path, int connection_group_id)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    metrics->host = host;
+    metrics->path = path;
+    metrics->connection_group_id = connection_group_id;
+
+    spin_block(&registry_lock) {
+        metrics->next = registry;
+        registry = metrics;
+    }
+
+    pdebug(DEBUG_DETAIL, "Done.");
+}
+
+
+
+void metrics_unregister_session(metrics_session_t *metrics)
+{
+    pdebug(DEBUG_DETAIL, "Starting.");
+
+    spin_block(&registry_lock) {
+        metrics_session_t **walker = &registry;
+
+        while(*walker && *walker != metrics) {
+            walker = &((*walker)->next);
+        }
+
+        if(*walker) {
+            *walker = metrics->next;
+        }
+    }
+
+    metrics->next = NULL;
+
+    pdebug(DEBUG_DETAIL, "Done.");
+}
+
+
+
+int metrics_snapshot(const char *name, uint8_t *buffer, int buffer_size)
+{
+    int rc = PLCTAG_ERR_UNSUPPORTED;
+
+    pdebug(DEBUG_DETAIL, "Starting for snapshot \"%s\".", name);
+
+    if(!name) {
+        pdebug(DEBUG_WARN, "Snapshot name is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(str_cmp_i(name, "sessions") == 0) {
+        rc = snapshot_sessions(buffer, buffer_size);
+    } else if(str_cmp_i_n(name, "session/", 8) == 0) {
+        rc = snapshot_session_by_host(name + 8, buffer, buffer_size);
+    } else if(str_cmp_i(name, "tickler/loop_us") == 0) {
+        rc = snapshot_hist(&(metrics_tickler.loop_us), buffer, buffer_size);
+    } else if(str_cmp_i(name, "tickler/lag_us") == 0) {
+        rc = snapshot_hist(&(metrics_tickler.lag_us), buffer, buffer_size);
+    } else if(str_cmp_i(name, "tickler/read_late_us") == 0) {
+        rc = snapshot_hist(&(metrics_tickler.read_late_us), buffer, buffer_size);
+    } else {
+        pdebug(DEBUG_DETAIL, "Unsupported snapshot \"%s\".", name);
+    }
+
+    pdebug(DEBUG_DETAIL, "Done with result %d.", rc);
+
+    return rc;
+}
+
+
+
+
+/***********************************************************************
+ *************************** Helper Functions **************************
+ **********************************************************************/
+
+
+int saturate(int64_t val)
+{
+    if(val > INT_MAX) {
+        return INT_MAX;
+    }
+
+    if(val < INT_MIN) {
+        return INT_MIN;
+    }
+
+    return (int)val;
+}
+
+
+int get_counter_attrib(const char *name, const char **names, volatile int64_t **counters, int num_counters, int *value)
+{
+    for(int i=0; i < num_counters; i++) {
+        if(str_cmp_i(name, names[i]) == 0) {
+            *value = saturate(atomic_counter_get(counters[i]));
+            return PLCTAG_STATUS_OK;
+        }
+    }
+
+    return PLCTAG_ERR_UNSUPPORTED;
+}
+
+
+/*
+ * get_hist_attrib
+ *
+ * Histogram attributes have the form <hist_name>.<field> where the
+ * field is one of count, sum, avg, p50, p90, p99 or bucket_<n>.
+ */
+
+int get_hist_attrib(const char *name, const char *hist_name, metrics_hist_t *hist, int *value)
+{
+    int hist_name_len = str_length(hist_name);
+    const char *field = NULL;
+    int bucket = 0;
+
+    if(str_cmp_i_n(name, hist_name, hist_name_len) != 0 || name[hist_name_len] != '.') {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    field = name + hist_name_len + 1;
+
+    if(str_cmp_i(field, "count") == 0) {
+        *value = saturate(atomic_counter_get(&(hist->count)));
+    } else if(str_cmp_i(field, "sum") == 0) {
+        *value = saturate(atomic_counter_get(&(hist->sum)));
+    } else if(str_cmp_i(field, "avg") == 0) {
+        int64_t count = atomic_counter_get(&(hist->count));
+
+        *value = (count > 0 ? saturate(atomic_counter_get(&(hist->sum)) / count) : 0);
+    } else if(str_cmp_i(field, "p50") == 0) {
+        *value = saturate(metrics_hist_percentile(hist, 50));
+    } else if(str_cmp_i(field, "p90") == 0) {
+        *value = saturate(metrics_hist_percentile(hist, 90));
+    } else if(str_cmp_i(field, "p99") == 0) {
+        *value = saturate(metrics_hist_percentile(hist, 99));
+    } else if(str_cmp_i_n(field, "bucket_", 7) == 0 && str_to_int(field + 7, &bucket) == 0 && bucket >= 0 && bucket < METRICS_HIST_BUCKETS) {
+        *value = saturate(atomic_counter_get(&(hist->buckets[bucket])));
+    } else {
+        pdebug(DEBUG_DETAIL, "Unsupported histogram field \"%s\".", field);
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+int snapshot_sessions(uint8_t *buffer, int buffer_size)
+{
+    int num_sessions = 0;
+    int total_size = 0;
+
+    spin_block(&registry_lock) {
+        for(metrics_session_t *metrics = registry; metrics; metrics = metrics->next) {
+            num_sessions++;
+        }
+
+        total_size = 8 + (num_sessions * METRICS_SESSION_RECORD_SIZE);
+
+        if(total_size <= buffer_size) {
+            int offset = 0;
+
+            offset = encode_int32(buffer, offset, (int32_t)num_sessions);
+            offset = encode_int32(buffer, offset, (int32_t)METRICS_SESSION_RECORD_SIZE);
+
+            for(metrics_session_t *metrics = registry; metrics; metrics = metrics->next) {
+                offset = encode_int32(buffer, offset, (int32_t)metrics->connection_group_id);
+                offset = encode_int32(buffer, offset, 0);
+                offset = encode_name(buffer, offset, metrics->host);
+                offset = encode_name(buffer, offset, metrics->path);
+                offset = encode_counters(metrics, buffer, offset);
+                offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->services_per_packet.count)));
+                offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->services_per_packet.sum)));
+                offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->rtt_us.count)));
+                offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->rtt_us.sum)));
+                offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->queue_wait_us.count)));
+                offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->queue_wait_us.sum)));
+            }
+        }
+    }
+
+    return total_size;
+}
+
+
+
+/*
+ * snapshot_session_by_host
+ *
+ * The name is <host>/<snapshot>.  All sessions to the host are summed
+ * as they can differ by path or connection group.
+ */
+
+int snapshot_session_by_host(const char *name, uint8_t *buffer, int buffer_size)
+{
+    metrics_session_t total;
+    int host_len = 0;
+    const char *field = NULL;
+    int found = 0;
+    int rc = PLCTAG_STATUS_OK;
+
+    /* the snapshot name is after the last slash. */
+    for(int i=0; name[i]; i++) {
+        if(name[i] == '/') {
+            host_len = i;
+        }
+    }
+
+    if(host_len == 0) {
+        pdebug(DEBUG_WARN, "Session snapshot name must be session/<host>/<snapshot>!");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    field = name + host_len + 1;
+
+    mem_set(&total, 0, (int)sizeof(total));
+
+    spin_block(&registry_lock) {
+        for(metrics_session_t *metrics = registry; metrics; metrics = metrics->next) {
+            if(metrics->host && str_length(metrics->host) == host_len && str_cmp_i_n(metrics->host, name, host_len) == 0) {
+                found = 1;
+
+                total.requests_queued += atomic_counter_get(&(metrics->requests_queued));
+                total.packets_sent += atomic_counter_get(&(metrics->packets_sent));
+                total.packets_received += atomic_counter_get(&(metrics->packets_received));
+                total.bytes_sent += atomic_counter_get(&(metrics->bytes_sent));
+                total.bytes_received += atomic_counter_get(&(metrics->bytes_received));
+                total.retries += atomic_counter_get(&(metrics->retries));
+                total.reconnects += atomic_counter_get(&(metrics->reconnects));
+                total.forward_open_failures += atomic_counter_get(&(metrics->forward_open_failures));
+
+                sum_hist(&(total.services_per_packet), &(metrics->services_per_packet));
+                sum_hist(&(total.rtt_us), &(metrics->rtt_us));
+                sum_hist(&(total.queue_wait_us), &(metrics->queue_wait_us));
+            }
+        }
+    }
+
+    if(!found) {
+        pdebug(DEBUG_WARN, "No session found for host in \"%s\"!", name);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    if(str_cmp_i(field, "counters") == 0) {
+        rc = METRICS_SNAPSHOT_NUM_COUNTERS * 8;
+
+        if(rc <= buffer_size) {
+            encode_counters(&total, buffer, 0);
+        }
+    } else if(str_cmp_i(field, "rtt_hist") == 0) {
+        rc = snapshot_hist(&(total.rtt_us), buffer, buffer_size);
+    } else if(str_cmp_i(field, "queue_wait_hist") == 0) {
+        rc = snapshot_hist(&(total.queue_wait_us), buffer, buffer_size);
+    } else if(str_cmp_i(field, "services_hist") == 0) {
+        rc = snapshot_hist(&(total.services_per_packet), buffer, buffer_size);
+    } else {
+        pdebug(DEBUG_WARN, "Unsupported session snapshot \"%s\"!", field);
+        rc = PLCTAG_ERR_UNSUPPORTED;
+    }
+
+    return rc;
+}
+
+
+int snapshot_hist(metrics_hist_t *hist, uint8_t *buffer, int buffer_size)
+{
+    int offset = 0;
+
+    if(METRICS_HIST_SNAPSHOT_SIZE > buffer_size) {
+        return METRICS_HIST_SNAPSHOT_SIZE;
+    }
+
+    offset = encode_int32(buffer, offset, METRICS_HIST_BUCKETS);
+    offset = encode_int32(buffer, offset, 0);
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(hist->count)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(hist->sum)));
+
+    for(int i=0; i < METRICS_HIST_BUCKETS; i++) {
+        offset = encode_int64(buffer, offset, atomic_counter_get(&(hist->buckets[i])));
+    }
+
+    return offset;
+}
+
+
+/* the total is private to the caller so plain adds are fine. */
+void sum_hist(metrics_hist_t *total, metrics_hist_t *hist)
+{
+    total->count += atomic_counter_get(&(hist->count));
+    total->sum += atomic_counter_get(&(hist->sum));
+
+    for(int i=0; i < METRICS_HIST_BUCKETS; i++) {
+        total->buckets[i] += atomic_counter_get(&(hist->buckets[i]));
+    }
+}
+
+
+int encode_counters(metrics_session_t *metrics, uint8_t *buffer, int offset)
+{
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->requests_queued)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->packets_sent)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->packets_received)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->bytes_sent)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->bytes_received)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->retries)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->reconnects)));
+    offset = encode_int64(buffer, offset, atomic_counter_get(&(metrics->forward_open_failures)));
+
+    return offset;
+}
+
+
+int encode_int32(uint8_t *buffer, int offset, int32_t val)
+{
+    for(int i=0; i < 4; i++) {
+        buffer[offset + i] = (uint8_t)(((uint32_t)val >> (8 * i)) & 0xFF);
+    }
+
+    return offset + 4;
+}
+
+
+int encode_int64(uint8_t *buffer, int offset, int64_t val)
+{
+    for(int i=0; i < 8; i++) {
+        buffer[offset + i] = (uint8_t)(((uint64_t)val >> (8 * i)) & 0xFF);
+    }
+
+    return offset + 8;
+}
+
+
+/* names are zero padded and always zero terminated. */
+int encode_name(uint8_t *buffer, int offset, const char *name)
+{
+    int name_len = (name ? str_length(name) : 0);
+
+    if(name_len > METRICS_SNAPSHOT_NAME_LEN - 1) {
+        name_len = METRICS_SNAPSHOT_NAME_LEN - 1;
+    }
+
+    mem_set(buffer + offset, 0, METRICS_SNAPSHOT_NAME_LEN);
+
+    if(name_len > 0) {
+        mem_copy(buffer + offset, (void *)name, name_len);
+    }
+
+    return offset + METRICS_SNAPSHOT_NAME_LEN;
+}
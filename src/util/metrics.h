@@ -0,0 +1,144 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#pragma once
+
+#include <platform.h>
+
+/*
+ * Runtime metrics.
+ *
+ * All counters are plain 64-bit integers updated with lock-free atomic adds.
+ * Histograms use power-of-two buckets: bucket 0 counts values of zero, bucket
+ * n counts values in [2^(n-1), 2^n).  The last bucket also counts everything
+ * larger.  With microsecond values the top bucket starts at about 4 seconds.
+ */
+
+#define METRICS_HIST_BUCKETS (24)
+
+typedef struct {
+    volatile int64_t count;
+    volatile int64_t sum;
+    volatile int64_t buckets[METRICS_HIST_BUCKETS];
+} metrics_hist_t;
+
+
+/* per connection to a PLC. */
+typedef struct metrics_session_t metrics_session_t;
+
+struct metrics_session_t {
+    volatile int64_t requests_queued;
+    volatile int64_t packets_sent;
+    volatile int64_t packets_received;
+    volatile int64_t bytes_sent;
+    volatile int64_t bytes_received;
+    volatile int64_t retries;
+    volatile int64_t reconnects;
+    volatile int64_t forward_open_failures;
+
+    metrics_hist_t services_per_packet;
+    metrics_hist_t rtt_us;
+    metrics_hist_t queue_wait_us;
+
+    /* identification for snapshots, set by metrics_register_session(). */
+    metrics_session_t *next;
+    const char *host;
+    const char *path;
+    int connection_group_id;
+};
+
+
+/* for the tag tickler thread. */
+typedef struct {
+    volatile int64_t read_misses;
+
+    metrics_hist_t loop_us;
+    metrics_hist_t lag_us;
+    metrics_hist_t read_late_us;
+} metrics_tickler_t;
+
+
+/* library-wide totals.  Sessions update these along with their own counters. */
+extern metrics_session_t metrics_all_sessions;
+extern metrics_tickler_t metrics_tickler;
+
+#define metrics_session_add(m, counter, amount) \
+    do { \
+        atomic_counter_add(&((m)->counter), (int64_t)(amount)); \
+        atomic_counter_add(&(metrics_all_sessions.counter), (int64_t)(amount)); \
+    } while(0)
+
+#define metrics_session_record(m, hist, value) \
+    do { \
+        metrics_hist_record(&((m)->hist), (int64_t)(value)); \
+        metrics_hist_record(&(metrics_all_sessions.hist), (int64_t)(value)); \
+    } while(0)
+
+extern void metrics_hist_record(metrics_hist_t *hist, int64_t value);
+extern int64_t metrics_hist_percentile(metrics_hist_t *hist, int percentile);
+
+/* attribute lookup, names start with "metrics.".  Values saturate at INT_MAX. */
+extern int metrics_get_session_attrib(metrics_session_t *metrics, const char *attrib_name, int *value);
+extern int metrics_get_library_attrib(const char *attrib_name, int *value);
+
+/* sessions must be registered to show up in snapshots.  The strings must outlive the registration. */
+extern void metrics_register_session(metrics_session_t *metrics, const char *host, const char *path, int connection_group_id);
+extern void metrics_unregister_session(metrics_session_t *metrics);
+
+/*
+ * Packed binary snapshots, all integers are little endian.
+ *
+ * "sessions"                   uint32 record count, uint32 record size, then one record per session:
+ *                                  int32 connection group ID, int32 reserved,
+ *                                  char host[METRICS_SNAPSHOT_NAME_LEN], char path[METRICS_SNAPSHOT_NAME_LEN],
+ *                                  int64 counters[METRICS_SNAPSHOT_NUM_COUNTERS],
+ *                                  int64 count and sum of services per packet, RTT and queue wait.
+ * "session/<host>/counters"    int64 counters[METRICS_SNAPSHOT_NUM_COUNTERS], summed over sessions to the host.
+ * "session/<host>/<hist>"      histogram, summed over sessions to the host.  <hist> is one of
+ *                              rtt_hist, queue_wait_hist or services_hist.
+ * "tickler/loop_us"            histogram of the tag tickler loop time.
+ * "tickler/lag_us"             histogram of how late the tag tickler woke up.
+ * "tickler/read_late_us"       histogram of how late automatic reads started.
+ *
+ * Counters are in struct order: requests queued, packets sent, packets received, bytes sent,
+ * bytes received, retries, reconnects and Forward Open failures.  Histograms are uint32 bucket
+ * count, uint32 reserved, int64 count, int64 sum, int64 buckets[].
+ *
+ * Returns the number of bytes in the snapshot.   Nothing is written if that is larger than
+ * buffer_size.  Returns PLCTAG_ERR_UNSUPPORTED if the name is not known.
+ */
+
+#define METRICS_SNAPSHOT_NAME_LEN (64)
+#define METRICS_SNAPSHOT_NUM_COUNTERS (8)
+
+extern int metrics_snapshot(const char *name, uint8_t *buffer, int buffer_size);
@@ -1,55 +1,633 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Header-only C++17 wrapper for libplctag.
+ *
+ * plctag::tag is a move-only handle that owns one library tag.  There is no
+ * lock in the wrapper, each call goes straight to the library, so different
+ * tags can be used from different threads at the same time.
+ *
+ * get<T>() and set<T>() move sizeof(T) bytes with one library call and decode
+ * them in the tag's byte order, which is fetched once when the tag is created.
+ * view() pins the whole tag buffer for zero copy access with the same typed
+ * decoding.  read_async() and write_async() return futures that are completed
+ * from the library's callback.  plctag_udt.hpp adds whole-struct decoding.
+ *
+ * Errors are thrown as plctag::error, which carries the library status.
+ */
+
 #ifndef PLCTAG_HPP
 #define PLCTAG_HPP
 
-#include <boost/thread/mutex.hpp>
-
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
-#include <vector>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
 #include <libplctag.h>
-#include "logging.hpp"
 
-class plctag
+
+namespace plctag {
+
+#if defined(__cpp_lib_span)
+template <typename T>
+using span = std::span<T>;
+#else
+/* the part of std::span that the wrapper uses. */
+template <typename T>
+class span {
+public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr T *data() const noexcept { return data_; }
+    constexpr std::size_t size() const noexcept { return size_; }
+    constexpr std::size_t size_bytes() const noexcept { return size_ * sizeof(T); }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr T &operator[](std::size_t index) const noexcept { return data_[index]; }
+    constexpr T *begin() const noexcept { return data_; }
+    constexpr T *end() const noexcept { return data_ + size_; }
+
+    constexpr span subspan(std::size_t offset, std::size_t count) const noexcept { return span(data_ + offset, count); }
+
+private:
+    T *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+#endif
+
+
+class error : public std::runtime_error {
+public:
+    error(int status, const std::string &what) : std::runtime_error(what + ": " + plc_tag_decode_error(status)), status_(status) {}
+
+    int status() const noexcept { return status_; }
+
+private:
+    int status_;
+};
+
+
+namespace detail {
+
+/* throw on any error, pass the status or count through otherwise. */
+inline int check(int rc, const char *what)
+{
+    if(rc < 0) {
+        throw error(rc, what);
+    }
+
+    return rc;
+}
+
+}
+
+
+/*
+ * Where each byte of a value lives.  Byte i of the value, least significant
+ * first, is at offset + int32[i] and so on.  The defaults are little endian.
+ */
+struct byte_order {
+    std::array<std::uint8_t, 2> int16 = {{0, 1}};
+    std::array<std::uint8_t, 4> int32 = {{0, 1, 2, 3}};
+    std::array<std::uint8_t, 8> int64 = {{0, 1, 2, 3, 4, 5, 6, 7}};
+    std::array<std::uint8_t, 4> float32 = {{0, 1, 2, 3}};
+    std::array<std::uint8_t, 8> float64 = {{0, 1, 2, 3, 4, 5, 6, 7}};
+};
+
+
+/* the integer and floating point types that map onto PLC data. */
+template <typename T>
+struct is_tag_value : std::bool_constant<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>> {};
+
+template <typename T>
+inline constexpr bool is_tag_value_v = is_tag_value<T>::value;
+
+
+namespace detail {
+
+template <typename T>
+constexpr const std::uint8_t *order_for(const byte_order &order) noexcept
 {
+    if constexpr (std::is_floating_point_v<T>) {
+        static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Only 32 and 64-bit floating point values are supported!");
+
+        if constexpr (sizeof(T) == 4) {
+            return order.float32.data();
+        } else {
+            return order.float64.data();
+        }
+    } else if constexpr (sizeof(T) == 2) {
+        return order.int16.data();
+    } else if constexpr (sizeof(T) == 4) {
+        return order.int32.data();
+    } else if constexpr (sizeof(T) == 8) {
+        return order.int64.data();
+    } else {
+        static_assert(sizeof(T) == 1, "Unsupported integer size!");
+        return nullptr;
+    }
+}
+
+template <std::size_t N>
+struct uint_of_size;
+
+template <> struct uint_of_size<1> { using type = std::uint8_t; };
+template <> struct uint_of_size<2> { using type = std::uint16_t; };
+template <> struct uint_of_size<4> { using type = std::uint32_t; };
+template <> struct uint_of_size<8> { using type = std::uint64_t; };
+
+inline void check_bounds(std::size_t size, std::size_t offset, std::size_t length)
+{
+    if(offset > size || length > size - offset) {
+        throw error(PLCTAG_ERR_OUT_OF_BOUNDS, "plctag::decode");
+    }
+}
+
+}
+
+
+/*
+ * Decode a T at offset in data.  The size of T picks the byte order map at
+ * compile time and the loop has a constant trip count, so this comes down
+ * to a handful of loads and shifts.
+ */
+template <typename T>
+T decode(span<const std::uint8_t> data, std::size_t offset, const byte_order &order)
+{
+    static_assert(is_tag_value_v<T>, "decode() only handles integer and floating point types!");
+
+    using uint_t = typename detail::uint_of_size<sizeof(T)>::type;
+
+    detail::check_bounds(data.size(), offset, sizeof(T));
+
+    const std::uint8_t *bytes = data.data() + offset;
+    uint_t uval = 0;
+
+    if constexpr (sizeof(T) == 1) {
+        uval = bytes[0];
+    } else {
+        const std::uint8_t *map = detail::order_for<T>(order);
+
+        for(std::size_t i = 0; i < sizeof(T); i++) {
+            uval = static_cast<uint_t>(uval | (static_cast<uint_t>(bytes[map[i]]) << (i * 8)));
+        }
+    }
+
+    T val;
+    std::memcpy(&val, &uval, sizeof(val));
+
+    return val;
+}
+
+
+/* the inverse of decode(). */
+template <typename T>
+void encode(span<std::uint8_t> data, std::size_t offset, const byte_order &order, T val)
+{
+    static_assert(is_tag_value_v<T>, "encode() only handles integer and floating point types!");
+
+    using uint_t = typename detail::uint_of_size<sizeof(T)>::type;
+
+    detail::check_bounds(data.size(), offset, sizeof(T));
+
+    std::uint8_t *bytes = data.data() + offset;
+    uint_t uval = 0;
+
+    std::memcpy(&uval, &val, sizeof(uval));
+
+    if constexpr (sizeof(T) == 1) {
+        bytes[0] = uval;
+    } else {
+        const std::uint8_t *map = detail::order_for<T>(order);
+
+        for(std::size_t i = 0; i < sizeof(T); i++) {
+            bytes[map[i]] = static_cast<std::uint8_t>(uval >> (i * 8));
+        }
+    }
+}
+
+
+
+/*
+ * A pinned, read-only view of the tag buffer from plc_tag_view_acquire().
+ * The tag is locked against the library until the view is released or
+ * destroyed, which must happen on the thread that made it.  Keep views short.
+ */
+class data_view {
+public:
+    data_view(const data_view &) = delete;
+    data_view &operator=(const data_view &) = delete;
+
+    data_view(data_view &&other) noexcept
+        : id_(std::exchange(other.id_, 0)), data_(other.data_), seq_(other.seq_), order_(other.order_) {}
+
+    data_view &operator=(data_view &&other) noexcept
+    {
+        if(this != &other) {
+            release();
+
+            id_ = std::exchange(other.id_, 0);
+            data_ = other.data_;
+            seq_ = other.seq_;
+            order_ = other.order_;
+        }
+
+        return *this;
+    }
+
+    ~data_view() { release(); }
+
+    span<const std::uint8_t> data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return data_.size(); }
+
+    /* odd while the library was part way through changing the data. */
+    std::uint32_t seq() const noexcept { return seq_; }
+
+    const byte_order &order() const noexcept { return *order_; }
+
+    template <typename T>
+    T get(std::size_t offset) const { return decode<T>(data_, offset, *order_); }
+
+    void release() noexcept
+    {
+        if(id_ > 0) {
+            plc_tag_view_release(id_);
+            id_ = 0;
+            data_ = span<const std::uint8_t>();
+        }
+    }
+
+private:
+    friend class tag;
+
+    data_view(std::int32_t id, const byte_order &order) : order_(&order)
+    {
+        const std::uint8_t *data = nullptr;
+        int size = 0;
+
+        detail::check(plc_tag_view_acquire(id, &data, &size, &seq_), "plc_tag_view_acquire");
+
+        id_ = id;
+        data_ = span<const std::uint8_t>(data, static_cast<std::size_t>(size));
+    }
+
+    std::int32_t id_ = 0;
+    span<const std::uint8_t> data_;
+    std::uint32_t seq_ = 0;
+    const byte_order *order_ = nullptr;
+};
+
+
+
+class tag {
 public:
-	plctag(int plc_prot, std::string ip_address, bool debug);
-	~plctag();
-
-	// Read
-	std::vector<float> read_tag(int tag_num, int timeout, int element_size, int element_count);
-	std::vector<std::string> read_tag_str(int tag_num, int timeout, int element_size, int element_count);
-
-	// Write
-	void write_tag(int tag_num, int timeout, int element_size, std::vector<float> fvec);
-	void write_tag_str(int tag_num, int timeout, int element_size, std::vector<std::string> fvec);
-
-	// Variables
-	enum PLC_PROT // Protocols, see "check_cpu" in ab_common.c (https://github.com/kyle-github/libplctag/blob/b9e29c13a89df7b70de2f7880a770a70437cc958/src/protocols/ab/ab_common.c#L658)
-	{
-		PROT_AB_PLC = 1,	 // PLC, PLC5, SLC, SLC500
-		PROT_AB_MLGX800 = 2, // MicroLogix 800
-		PROT_AB_MLGX = 3,	 // MicroLogix 1000-1400
-		PROT_AB_LGX = 4,	 // CompactLogix, ControlLogix, FlexLogix
-	};
-	enum ELE_SIZE // element size
-	{
-		ELE_BOOL = 1,
-		ELE_INT = 2,
-		ELE_DINT_ = 4,
-		ELE_FLOAT = 4,
-		ELE_STRING = 88,
-	};
+    using event_callback = std::function<void(int event, int status)>;
+
+    tag() noexcept = default;
+
+    /*
+     * Create the tag.  With a zero timeout, creation finishes in the
+     * background and the PLCTAG_EVENT_CREATED event says when.
+     */
+    explicit tag(const std::string &attribs, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+        : state_(std::make_unique<state>())
+    {
+        std::int32_t id = plc_tag_create_ex(attribs.c_str(), &tag::dispatch, state_.get(), static_cast<int>(timeout.count()));
+
+        detail::check(id, "plc_tag_create_ex");
+
+        state_->id = id;
+
+        load_byte_order(id, "int16_byte_order", state_->order.int16);
+        load_byte_order(id, "int32_byte_order", state_->order.int32);
+        load_byte_order(id, "int64_byte_order", state_->order.int64);
+        load_byte_order(id, "float32_byte_order", state_->order.float32);
+        load_byte_order(id, "float64_byte_order", state_->order.float64);
+    }
+
+    tag(const tag &) = delete;
+    tag &operator=(const tag &) = delete;
+
+    tag(tag &&other) noexcept = default;
+
+    tag &operator=(tag &&other) noexcept
+    {
+        if(this != &other) {
+            reset();
+            state_ = std::move(other.state_);
+        }
+
+        return *this;
+    }
+
+    ~tag() { reset(); }
+
+    /* destroy the tag.  Outstanding futures fail with PLCTAG_ERR_ABORT. */
+    void reset() noexcept
+    {
+        if(!state_) {
+            return;
+        }
+
+        /* after this no callback can be running or start. */
+        plc_tag_unregister_callback(state_->id);
+        plc_tag_destroy(state_->id);
+
+        settle(state_->read_done, PLCTAG_ERR_ABORT, "plc_tag_read");
+        settle(state_->write_done, PLCTAG_ERR_ABORT, "plc_tag_write");
+
+        state_.reset();
+    }
+
+    explicit operator bool() const noexcept { return static_cast<bool>(state_); }
+
+    std::int32_t id() const noexcept { return state_ ? state_->id : 0; }
+    const byte_order &order() const { return checked_state().order; }
+
+    int status() const { return plc_tag_status(checked_state().id); }
+    int size() const { return detail::check(plc_tag_get_size(checked_state().id), "plc_tag_get_size"); }
+
+    int get_int_attribute(const char *name, int default_value) const { return plc_tag_get_int_attribute(checked_state().id, name, default_value); }
+    void set_int_attribute(const char *name, int value) { detail::check(plc_tag_set_int_attribute(checked_state().id, name, value), "plc_tag_set_int_attribute"); }
+
+    void read(std::chrono::milliseconds timeout) { detail::check(plc_tag_read(checked_state().id, static_cast<int>(timeout.count())), "plc_tag_read"); }
+    void write(std::chrono::milliseconds timeout) { detail::check(plc_tag_write(checked_state().id, static_cast<int>(timeout.count())), "plc_tag_write"); }
+    void abort() { detail::check(plc_tag_abort(checked_state().id), "plc_tag_abort"); }
+
+    /*
+     * Start a read or write and return a future that is ready when it is
+     * done.  Only one of each can be outstanding per tag, another fails with
+     * PLCTAG_ERR_BUSY.  With auto_sync_read_ms set, a read future may be
+     * completed by the automatic read that finishes first.
+     */
+    std::future<void> read_async() { return start_async(&state::read_done, &plc_tag_read, "plc_tag_read"); }
+    std::future<void> write_async() { return start_async(&state::write_done, &plc_tag_write, "plc_tag_write"); }
+
+    template <typename T>
+    T get(int offset) const
+    {
+        static_assert(is_tag_value_v<T>, "get() only handles integer and floating point types!");
+
+        std::array<std::uint8_t, sizeof(T)> buf;
+        const state &s = checked_state();
+
+        detail::check(plc_tag_get_raw_bytes(s.id, offset, buf.data(), static_cast<int>(buf.size())), "plc_tag_get_raw_bytes");
+
+        return decode<T>(span<const std::uint8_t>(buf.data(), buf.size()), 0, s.order);
+    }
+
+    template <typename T>
+    void set(int offset, T val)
+    {
+        static_assert(is_tag_value_v<T>, "set() only handles integer and floating point types!");
+
+        std::array<std::uint8_t, sizeof(T)> buf;
+        const state &s = checked_state();
+
+        encode<T>(span<std::uint8_t>(buf.data(), buf.size()), 0, s.order, val);
+
+        detail::check(plc_tag_set_raw_bytes(s.id, offset, buf.data(), static_cast<int>(buf.size())), "plc_tag_set_raw_bytes");
+    }
+
+    bool get_bit(int offset_bit) const { return detail::check(plc_tag_get_bit(checked_state().id, offset_bit), "plc_tag_get_bit") != 0; }
+    void set_bit(int offset_bit, bool val) { detail::check(plc_tag_set_bit(checked_state().id, offset_bit, val ? 1 : 0), "plc_tag_set_bit"); }
+
+    std::string get_string(int offset) const
+    {
+        std::int32_t id = checked_state().id;
+        int length = detail::check(plc_tag_get_string_length(id, offset), "plc_tag_get_string_length");
+        std::string str(static_cast<std::size_t>(length) + 1, '\0');
+
+        detail::check(plc_tag_get_string(id, offset, str.data(), length + 1), "plc_tag_get_string");
+        str.resize(static_cast<std::size_t>(length));
+
+        return str;
+    }
+
+    void set_string(int offset, const std::string &str) { detail::check(plc_tag_set_string(checked_state().id, offset, str.c_str()), "plc_tag_set_string"); }
+
+    /* a struct described by plctag::udt_layout, see plctag_udt.hpp. */
+    template <typename S>
+    S get_udt(int offset) const;
+
+    template <typename S>
+    void set_udt(int offset, const S &val);
+
+    data_view view() const
+    {
+        const state &s = checked_state();
+
+        return data_view(s.id, s.order);
+    }
+
+    /* called for every event from the library's thread, with the tag locked. */
+    void on_event(event_callback callback)
+    {
+        state &s = checked_state();
+        auto shared = callback ? std::make_shared<const event_callback>(std::move(callback)) : nullptr;
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        s.callback = std::move(shared);
+    }
 
 private:
-	// Connection
-	void create_tag(int tag_num, int plc_prot, int timeout, std::string ip_address, std::string element_name, int element_size, int element_count);
-
-	// Variables
-	bool debug;
-	boost::mutex mutex;
-	std::string plc_protocol = "ab_eip";
-	int share_session = 1; // 1: shares TCP connection with other tags at same IP address; 0: off
-	int str_data_size = 82;
-	std::vector<int32_t> tag;
+    /* on the heap so that the library's userdata pointer survives moves. */
+    struct state {
+        std::int32_t id = 0;
+        byte_order order;
+        std::mutex mutex;
+        std::optional<std::promise<void>> read_done;
+        std::optional<std::promise<void>> write_done;
+        std::shared_ptr<const event_callback> callback;
+    };
+
+    state &checked_state() const
+    {
+        if(!state_) {
+            throw error(PLCTAG_ERR_NULL_PTR, "plctag::tag");
+        }
+
+        return *state_;
+    }
+
+    template <std::size_t N>
+    static void load_byte_order(std::int32_t id, const char *name, std::array<std::uint8_t, N> &order)
+    {
+        std::array<std::uint8_t, N> buf;
+
+        /* keep the default if the library cannot tell us. */
+        if(plc_tag_get_byte_array_attribute(id, name, buf.data(), static_cast<int>(buf.size())) == static_cast<int>(N)) {
+            order = buf;
+        }
+    }
+
+    static void settle(std::optional<std::promise<void>> &done, int status, const char *what)
+    {
+        if(!done) {
+            return;
+        }
+
+        if(status == PLCTAG_STATUS_OK) {
+            done->set_value();
+        } else {
+            done->set_exception(std::make_exception_ptr(error(status, what)));
+        }
+
+        done.reset();
+    }
+
+    std::future<void> start_async(std::optional<std::promise<void>> state::*slot, int (*op)(std::int32_t, int), const char *what)
+    {
+        state &s = checked_state();
+        std::promise<void> promise;
+        std::future<void> future = promise.get_future();
+        std::optional<std::promise<void>> done;
+        int rc = PLCTAG_STATUS_OK;
+
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+
+            if(s.*slot) {
+                promise.set_exception(std::make_exception_ptr(error(PLCTAG_ERR_BUSY, what)));
+                return future;
+            }
+
+            /* in place before the operation starts as the callback can beat us back. */
+            s.*slot = std::move(promise);
+        }
+
+        rc = op(s.id, 0);
+        if(rc == PLCTAG_STATUS_PENDING) {
+            return future;
+        }
+
+        /* finished or failed right away.  The callback may have settled it already. */
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+
+            done = std::move(s.*slot);
+            (s.*slot).reset();
+        }
+
+        settle(done, rc, what);
+
+        return future;
+    }
+
+    static void dispatch(std::int32_t tag_id, int event, int status, void *userdata)
+    {
+        state *s = static_cast<state *>(userdata);
+        std::optional<std::promise<void>> read_done;
+        std::optional<std::promise<void>> write_done;
+        std::shared_ptr<const event_callback> callback;
+        int op_status = status;
+
+        (void)tag_id;
+
+        if(!s) {
+            return;
+        }
+
+        if((event == PLCTAG_EVENT_ABORTED || event == PLCTAG_EVENT_DESTROYED) && op_status == PLCTAG_STATUS_OK) {
+            op_status = PLCTAG_ERR_ABORT;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+
+            if(event == PLCTAG_EVENT_READ_COMPLETED || event == PLCTAG_EVENT_ABORTED || event == PLCTAG_EVENT_DESTROYED) {
+                read_done = std::move(s->read_done);
+                s->read_done.reset();
+            }
+
+            if(event == PLCTAG_EVENT_WRITE_COMPLETED || event == PLCTAG_EVENT_ABORTED || event == PLCTAG_EVENT_DESTROYED) {
+                write_done = std::move(s->write_done);
+                s->write_done.reset();
+            }
+
+            callback = s->callback;
+        }
+
+        settle(read_done, op_status, "plc_tag_read");
+        settle(write_done, op_status, "plc_tag_write");
+
+        /* nothing may be thrown back into the library. */
+        if(callback) {
+            try {
+                (*callback)(event, status);
+            } catch(...) {
+            }
+        }
+    }
+
+    std::unique_ptr<state> state_;
 };
 
+
+
+/* library wide helpers. */
+
+inline void check_lib_version(int major, int minor, int patch)
+{
+    detail::check(plc_tag_check_lib_version(major, minor, patch), "plc_tag_check_lib_version");
+}
+
+inline void set_debug_level(int level)
+{
+    plc_tag_set_debug_level(level);
+}
+
+inline void shutdown()
+{
+    plc_tag_shutdown();
+}
+
+}
+
 #endif
@@ -0,0 +1,435 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Compile-time UDT layouts for the C++ wrapper.
+ *
+ * Describe where each member of a C++ struct lives in the PLC data by
+ * specializing plctag::udt_layout:
+ *
+ *     struct motor {
+ *         std::int32_t speed;
+ *         float current;
+ *         bool running;
+ *     };
+ *
+ *     template <>
+ *     struct plctag::udt_layout<motor> {
+ *         static constexpr std::size_t size = 12;
+ *         static constexpr auto fields = std::make_tuple(
+ *             plctag::field("Speed", &motor::speed, plctag::cip_type::DINT, 0),
+ *             plctag::field("Current", &motor::current, plctag::cip_type::REAL, 4),
+ *             plctag::field("Running", &motor::running, plctag::cip_type::BOOL, 8, plctag::endian::tag, 0));
+ *     };
+ *
+ * decode_udt() and encode_udt() expand the field list into one straight
+ * pass over the buffer, and the layout is checked at compile time against
+ * the member types and the size.  tag::get_udt()/set_udt() do the same on
+ * a tag.  check_udt_layout() compares a layout with the definition the PLC
+ * returns for @udt/<id> so that an offset that drifted is caught at start
+ * up instead of showing up as bad data.
+ */
+
+#ifndef PLCTAG_UDT_HPP
+#define PLCTAG_UDT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "plctag.hpp"
+
+
+namespace plctag {
+
+/* the atomic CIP types that can be mapped onto a member. */
+enum class cip_type : std::uint16_t {
+    BOOL = 0xC1,
+    SINT = 0xC2,
+    INT = 0xC3,
+    DINT = 0xC4,
+    LINT = 0xC5,
+    USINT = 0xC6,
+    UINT = 0xC7,
+    UDINT = 0xC8,
+    ULINT = 0xC9,
+    REAL = 0xCA,
+    LREAL = 0xCB
+};
+
+/* tag uses the tag's byte order, little and big override it for one field. */
+enum class endian {
+    tag,
+    little,
+    big
+};
+
+
+constexpr std::size_t cip_type_size(cip_type type) noexcept
+{
+    switch(type) {
+        case cip_type::BOOL: return 1;
+        case cip_type::SINT: return 1;
+        case cip_type::USINT: return 1;
+        case cip_type::INT: return 2;
+        case cip_type::UINT: return 2;
+        case cip_type::DINT: return 4;
+        case cip_type::UDINT: return 4;
+        case cip_type::REAL: return 4;
+        case cip_type::LINT: return 8;
+        case cip_type::ULINT: return 8;
+        case cip_type::LREAL: return 8;
+    }
+
+    return 0;
+}
+
+
+template <typename S, typename M>
+struct field_desc {
+    using struct_type = S;
+    using member_type = M;
+
+    const char *name;
+    M S::*member;
+    cip_type type;
+    std::size_t offset;
+    endian order;
+    std::uint8_t bit;
+};
+
+/* bit is only used for BOOL, which is one bit of the byte at offset. */
+template <typename S, typename M>
+constexpr field_desc<S, M> field(const char *name, M S::*member, cip_type type, std::size_t offset, endian order = endian::tag, std::uint8_t bit = 0)
+{
+    return field_desc<S, M>{name, member, type, offset, order, bit};
+}
+
+
+/* specialize this for each struct, see above. */
+template <typename S>
+struct udt_layout;
+
+
+namespace detail {
+
+template <typename S, typename M>
+constexpr bool field_is_valid(const field_desc<S, M> &f)
+{
+    if(f.offset + cip_type_size(f.type) > udt_layout<S>::size) {
+        return false;
+    }
+
+    if(f.type == cip_type::BOOL) {
+        return std::is_same_v<M, bool> && f.bit < 8;
+    }
+
+    if(f.type == cip_type::REAL || f.type == cip_type::LREAL) {
+        return std::is_floating_point_v<M> && sizeof(M) == cip_type_size(f.type);
+    }
+
+    return std::is_integral_v<M> && !std::is_same_v<M, bool> && sizeof(M) == cip_type_size(f.type);
+}
+
+template <typename S>
+constexpr bool layout_is_valid()
+{
+    return std::apply([](const auto &... f) { return (field_is_valid(f) && ...); }, udt_layout<S>::fields);
+}
+
+/* the byte order map for one field. */
+inline byte_order field_order(endian order, const byte_order &tag_order)
+{
+    byte_order result = tag_order;
+
+    if(order == endian::little) {
+        result = byte_order();
+    } else if(order == endian::big) {
+        for(std::uint8_t i = 0; i < 2; i++) { result.int16[i] = static_cast<std::uint8_t>(1 - i); }
+        for(std::uint8_t i = 0; i < 4; i++) { result.int32[i] = result.float32[i] = static_cast<std::uint8_t>(3 - i); }
+        for(std::uint8_t i = 0; i < 8; i++) { result.int64[i] = result.float64[i] = static_cast<std::uint8_t>(7 - i); }
+    }
+
+    return result;
+}
+
+template <typename S, typename M>
+void decode_field(const field_desc<S, M> &f, span<const std::uint8_t> data, std::size_t base, const byte_order &order, S &out)
+{
+    if constexpr (std::is_same_v<M, bool>) {
+        out.*(f.member) = ((decode<std::uint8_t>(data, base + f.offset, order) >> f.bit) & 1) != 0;
+    } else if(f.order == endian::tag) {
+        out.*(f.member) = decode<M>(data, base + f.offset, order);
+    } else {
+        out.*(f.member) = decode<M>(data, base + f.offset, field_order(f.order, order));
+    }
+}
+
+template <typename S, typename M>
+void encode_field(const field_desc<S, M> &f, span<std::uint8_t> data, std::size_t base, const byte_order &order, const S &in)
+{
+    if constexpr (std::is_same_v<M, bool>) {
+        std::uint8_t byte = decode<std::uint8_t>(span<const std::uint8_t>(data.data(), data.size()), base + f.offset, order);
+        std::uint8_t mask = static_cast<std::uint8_t>(1u << f.bit);
+
+        byte = static_cast<std::uint8_t>(in.*(f.member) ? (byte | mask) : (byte & ~mask));
+
+        encode<std::uint8_t>(data, base + f.offset, order, byte);
+    } else if(f.order == endian::tag) {
+        encode<M>(data, base + f.offset, order, in.*(f.member));
+    } else {
+        encode<M>(data, base + f.offset, field_order(f.order, order), in.*(f.member));
+    }
+}
+
+}
+
+
+/* fill a struct from the UDT at base in data. */
+template <typename S>
+S decode_udt(span<const std::uint8_t> data, std::size_t base, const byte_order &order)
+{
+    static_assert(detail::layout_is_valid<S>(), "A field does not match its member type or does not fit in the UDT size!");
+
+    S out{};
+
+    detail::check_bounds(data.size(), base, udt_layout<S>::size);
+
+    std::apply([&](const auto &... f) { (detail::decode_field(f, data, base, order, out), ...); }, udt_layout<S>::fields);
+
+    return out;
+}
+
+
+/* write a struct into the UDT at base in data.  Bytes not in the layout are left alone. */
+template <typename S>
+void encode_udt(span<std::uint8_t> data, std::size_t base, const byte_order &order, const S &in)
+{
+    static_assert(detail::layout_is_valid<S>(), "A field does not match its member type or does not fit in the UDT size!");
+
+    detail::check_bounds(data.size(), base, udt_layout<S>::size);
+
+    std::apply([&](const auto &... f) { (detail::encode_field(f, data, base, order, in), ...); }, udt_layout<S>::fields);
+}
+
+
+template <typename S>
+S tag::get_udt(int offset) const
+{
+    data_view v = view();
+
+    return decode_udt<S>(v.data(), static_cast<std::size_t>(offset), v.order());
+}
+
+
+template <typename S>
+void tag::set_udt(int offset, const S &val)
+{
+    std::array<std::uint8_t, udt_layout<S>::size> buf;
+    const byte_order &tag_order = order();
+
+    /* keep the bytes and bits that are not in the layout. */
+    detail::check(plc_tag_get_raw_bytes(id(), offset, buf.data(), static_cast<int>(buf.size())), "plc_tag_get_raw_bytes");
+
+    encode_udt<S>(span<std::uint8_t>(buf.data(), buf.size()), 0, tag_order, val);
+
+    detail::check(plc_tag_set_raw_bytes(id(), offset, buf.data(), static_cast<int>(buf.size())), "plc_tag_set_raw_bytes");
+}
+
+
+
+/* one field of a UDT definition from @udt/<id>. */
+struct udt_field_info {
+    std::string name;
+    std::uint16_t type = 0;
+    std::uint16_t metadata = 0;    /* the bit number for BOOL, the element count for arrays. */
+    std::uint32_t offset = 0;
+};
+
+struct udt_definition {
+    std::uint16_t id = 0;
+    std::string name;
+    std::uint32_t instance_size = 0;
+    std::vector<udt_field_info> fields;
+};
+
+
+namespace detail {
+
+inline std::uint32_t get_le(span<const std::uint8_t> data, std::size_t offset, std::size_t size)
+{
+    std::uint32_t val = 0;
+
+    check_bounds(data.size(), offset, size);
+
+    for(std::size_t i = 0; i < size; i++) {
+        val |= static_cast<std::uint32_t>(data[offset + i]) << (i * 8);
+    }
+
+    return val;
+}
+
+inline std::string get_cstr(span<const std::uint8_t> data, std::size_t &offset)
+{
+    std::string str;
+
+    while(offset < data.size() && data[offset] != 0) {
+        str.push_back(static_cast<char>(data[offset]));
+        offset++;
+    }
+
+    if(offset >= data.size()) {
+        throw error(PLCTAG_ERR_BAD_DATA, "plctag::parse_udt_definition");
+    }
+
+    offset++;
+
+    return str;
+}
+
+inline bool same_name(std::string_view a, std::string_view b)
+{
+    if(a.size() != b.size()) {
+        return false;
+    }
+
+    for(std::size_t i = 0; i < a.size(); i++) {
+        char ca = (a[i] >= 'A' && a[i] <= 'Z') ? static_cast<char>(a[i] - 'A' + 'a') : a[i];
+        char cb = (b[i] >= 'A' && b[i] <= 'Z') ? static_cast<char>(b[i] - 'A' + 'a') : b[i];
+
+        if(ca != cb) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+
+/*
+ * Parse the data of an @udt/<id> tag.  The library lays it out as a 14 byte
+ * header (ID, member description size, instance size, member count and
+ * handle), one 8 byte entry per field (metadata, type, offset), the UDT
+ * name and then the field names, all zero terminated.
+ */
+inline udt_definition parse_udt_definition(span<const std::uint8_t> data)
+{
+    udt_definition def;
+    std::size_t num_fields = 0;
+    std::size_t offset = 14;
+
+    def.id = static_cast<std::uint16_t>(detail::get_le(data, 0, 2));
+    def.instance_size = detail::get_le(data, 6, 4);
+    num_fields = detail::get_le(data, 10, 2);
+
+    def.fields.resize(num_fields);
+
+    for(udt_field_info &f : def.fields) {
+        f.metadata = static_cast<std::uint16_t>(detail::get_le(data, offset, 2));
+        f.type = static_cast<std::uint16_t>(detail::get_le(data, offset + 2, 2));
+        f.offset = detail::get_le(data, offset + 4, 4);
+        offset += 8;
+    }
+
+    /* the name ends at the first semicolon. */
+    def.name = detail::get_cstr(data, offset);
+    def.name = def.name.substr(0, def.name.find(';'));
+
+    for(udt_field_info &f : def.fields) {
+        f.name = detail::get_cstr(data, offset);
+    }
+
+    return def;
+}
+
+
+/* read @udt/<id> through a PLC attribute string without a name. */
+inline udt_definition fetch_udt_definition(const std::string &plc_attribs, std::uint16_t udt_id, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+{
+    tag udt_tag(plc_attribs + "&name=@udt/" + std::to_string(udt_id), timeout);
+
+    udt_tag.read(timeout);
+
+    data_view v = udt_tag.view();
+
+    return parse_udt_definition(v.data());
+}
+
+
+/*
+ * Check a layout against the PLC's definition of the UDT.  Every field must
+ * exist by name (case does not matter, as in Logix) with the same type,
+ * offset and, for BOOL, bit.  Throws PLCTAG_ERR_BAD_CONFIG naming the first
+ * field that does not match.
+ */
+template <typename S>
+void check_udt_layout(const udt_definition &def)
+{
+    static_assert(detail::layout_is_valid<S>(), "A field does not match its member type or does not fit in the UDT size!");
+
+    if(def.instance_size != udt_layout<S>::size) {
+        throw error(PLCTAG_ERR_BAD_CONFIG, "UDT " + def.name + " is " + std::to_string(def.instance_size) + " bytes, the layout has " + std::to_string(udt_layout<S>::size));
+    }
+
+    auto check_field = [&def](const auto &f) {
+        for(const udt_field_info &info : def.fields) {
+            if(!detail::same_name(info.name, f.name)) {
+                continue;
+            }
+
+            if((info.type & 0xFF) != static_cast<std::uint16_t>(f.type) || (info.type & 0x2000) || info.offset != f.offset) {
+                throw error(PLCTAG_ERR_BAD_CONFIG, "UDT " + def.name + " field " + f.name + " is type " + std::to_string(info.type) + " at offset " + std::to_string(info.offset) + ", the layout does not match");
+            }
+
+            if(f.type == cip_type::BOOL && info.metadata != f.bit) {
+                throw error(PLCTAG_ERR_BAD_CONFIG, "UDT " + def.name + " field " + f.name + " is bit " + std::to_string(info.metadata) + ", the layout does not match");
+            }
+
+            return;
+        }
+
+        throw error(PLCTAG_ERR_BAD_CONFIG, "UDT " + def.name + " has no field " + f.name);
+    };
+
+    std::apply([&](const auto &... f) { (check_field(f), ...); }, udt_layout<S>::fields);
+}
+
+}
+
+#endif
@@ -1,74 +1,150 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Example and check of the C++ wrapper.  By default it talks to ab_server:
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ *
+ * Pass a different attribute string for a DINT array of at least ten
+ * elements as the only argument to use a real PLC.
+ */
+
+#include <cstdio>
+#include <future>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "../include/plctag.hpp"
 
-#include <boost/move/unique_ptr.hpp>
+#define DEFAULT_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=10&name=TestBigArray"
+#define ELEM_COUNT (10)
+#define ELEM_SIZE (4)
+
+using namespace std::chrono_literals;
 
-// Notes ---------------------------------------------------------------------------
-// Boost libraries are required: apt install libboost-all-dev
-// mkdir log obj
-// make clean && ccache -C
-// make
 
-int main (void)
+int main(int argc, char **argv)
 {
-	INFO << "Program Started";
-
-	struct {
-		bool debug = false;
-		int ab_prot = plctag::PLC_PROT::PROT_AB_MLGX;
-		std::string ip_address = "192.168.2.50";
-	} plc_config;
-
-	try
-	{
-		std::vector <float> fvec;
-		std::vector <std::string> svec;
-
-		boost::movelib::unique_ptr<plctag> _plctag;
-
-		_plctag.reset(new plctag(plc_config.ab_prot, plc_config.ip_address, plc_config.debug));
-
-		// string
-
-		/// write
-		svec.push_back("Hello World");
-		_plctag->write_tag_str(2, 5000, plctag::ELE_STRING, svec);
-
-		/// read
-		svec = _plctag->read_tag_str(1, 5000, plctag::ELE_STRING, 5);
-		for (size_t i = 0; i < svec.size(); i++)
-		{
-			INFO << "svec.at(" << i << ") = " << svec.at(i);
-		}
-
-		// float
-
-		/// write
-		fvec.push_back(123456);
-		fvec.push_back(1);
-		fvec.push_back(7890);
-		fvec.push_back(7777.77);
-		fvec.push_back(100000);
-		_plctag->write_tag(3, 5000, plctag::ELE_FLOAT, fvec);
-		
-		/// read
-		fvec = _plctag->read_tag(3, 5000, plctag::ELE_FLOAT, 5);
-		for (size_t i = 0; i < fvec.size(); i++)
-		{
-			INFO << "fvec.at(" << i << ") = " << fvec.at(i);
-		}
-	}
-	catch (const std::exception &e)
-	{
-		ERROR << "e.what() = " << e.what();
-		return -1;
-	}
-	catch (int error)
-	{
-		ERROR << "error >> " << error;
-		return -2;
-	}
-
-	INFO << "Program Ended";
-
-	return 0;
+    std::string attribs = (argc > 1 ? argv[1] : DEFAULT_ATTRIBS);
+
+    try {
+        plctag::check_lib_version(2, 6, 0);
+
+        plctag::tag tag(attribs, 5000ms);
+
+        /* the handle can move, the callback state goes with it. */
+        plctag::tag moved = std::move(tag);
+
+        if(tag || !moved) {
+            std::fprintf(stderr, "ERROR: Moving the tag handle did not move the tag!\n");
+            return 1;
+        }
+
+        /* write through the typed setters and an async write. */
+        for(int i = 0; i < ELEM_COUNT; i++) {
+            moved.set<std::int32_t>(i * ELEM_SIZE, 1000 + i);
+        }
+
+        moved.write_async().get();
+
+        /* clear the local copy and read it back asynchronously. */
+        for(int i = 0; i < ELEM_COUNT; i++) {
+            moved.set<std::int32_t>(i * ELEM_SIZE, 0);
+        }
+
+        std::future<void> read_done = moved.read_async();
+
+        /* only one read at a time. */
+        try {
+            moved.read_async().get();
+        } catch(const plctag::error &e) {
+            if(e.status() != PLCTAG_ERR_BUSY && e.status() != PLCTAG_STATUS_OK) {
+                throw;
+            }
+        }
+
+        read_done.get();
+
+        for(int i = 0; i < ELEM_COUNT; i++) {
+            std::int32_t val = moved.get<std::int32_t>(i * ELEM_SIZE);
+
+            if(val != 1000 + i) {
+                std::fprintf(stderr, "ERROR: Element %d is %d, expected %d!\n", i, val, 1000 + i);
+                return 1;
+            }
+        }
+
+        /* the view decodes the same way without a call per element. */
+        {
+            plctag::data_view view = moved.view();
+
+            if(view.size() != ELEM_COUNT * ELEM_SIZE || view.get<std::int32_t>((ELEM_COUNT - 1) * ELEM_SIZE) != 1000 + ELEM_COUNT - 1) {
+                std::fprintf(stderr, "ERROR: Bad view of the tag data!\n");
+                return 1;
+            }
+
+            std::fprintf(stderr, "View of %zu bytes at sequence %u.\n", view.size(), view.seq());
+        }
+
+        /* errors come back as exceptions with the library status. */
+        try {
+            (void)moved.get<std::int64_t>(ELEM_COUNT * ELEM_SIZE);
+
+            std::fprintf(stderr, "ERROR: Reading past the end of the tag did not fail!\n");
+            return 1;
+        } catch(const plctag::error &e) {
+            if(e.status() != PLCTAG_ERR_OUT_OF_BOUNDS) {
+                throw;
+            }
+        }
+
+        /* a floating point value round trips through the byte order. */
+        moved.set<float>(0, 3.25f);
+
+        if(moved.get<float>(0) != 3.25f) {
+            std::fprintf(stderr, "ERROR: Float did not round trip!\n");
+            return 1;
+        }
+    } catch(const plctag::error &e) {
+        std::fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    std::fprintf(stderr, "Done.\n");
+
+    plctag::shutdown();
+
+    return 0;
 }
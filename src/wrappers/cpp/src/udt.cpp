@@ -0,0 +1,193 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Kyle Hayes                                      *
+ *   Author Kyle Hayes  kyle.hayes@gmail.com                               *
+ *                                                                         *
+ * This software is available under either the Mozilla Public License      *
+ * version 2.0 or the GNU LGPL version 2 (or later) license, whichever     *
+ * you choose.                                                             *
+ *                                                                         *
+ * MPL 2.0:                                                                *
+ *                                                                         *
+ *   This Source Code Form is subject to the terms of the Mozilla Public   *
+ *   License, v. 2.0. If a copy of the MPL was not distributed with this   *
+ *   file, You can obtain one at http://mozilla.org/MPL/2.0/.              *
+ *                                                                         *
+ *                                                                         *
+ * LGPL 2:                                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+/*
+ * Example and check of the compile-time UDT layouts.  ab_server has no UDTs,
+ * so a struct is laid over the first 32 bytes of a DINT array for the round
+ * trip, and the @udt check runs against a definition built here in the
+ * format the library returns.
+ *
+ *     ab_server --plc=ControlLogix --path=1,0 --tag=TestBigArray:DINT[2000]
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../include/plctag_udt.hpp"
+
+#define DEFAULT_ATTRIBS "protocol=ab-eip&gateway=127.0.0.1&path=1,0&plc=ControlLogix&elem_count=10&name=TestBigArray"
+
+using namespace std::chrono_literals;
+
+
+struct sample {
+    std::int32_t count;
+    float level;
+    std::int16_t mode;
+    bool running;
+    std::int8_t code;
+    std::int64_t total;
+    double average;
+    std::uint32_t serial;
+};
+
+template <>
+struct plctag::udt_layout<sample> {
+    static constexpr std::size_t size = 32;
+    static constexpr auto fields = std::make_tuple(
+        plctag::field("Count", &sample::count, plctag::cip_type::DINT, 0),
+        plctag::field("Level", &sample::level, plctag::cip_type::REAL, 4),
+        plctag::field("Mode", &sample::mode, plctag::cip_type::INT, 8),
+        plctag::field("Running", &sample::running, plctag::cip_type::BOOL, 10, plctag::endian::tag, 3),
+        plctag::field("Code", &sample::code, plctag::cip_type::SINT, 11),
+        plctag::field("Total", &sample::total, plctag::cip_type::LINT, 12),
+        plctag::field("Average", &sample::average, plctag::cip_type::LREAL, 20),
+        plctag::field("Serial", &sample::serial, plctag::cip_type::UDINT, 28, plctag::endian::big));
+};
+
+
+/* the @udt/<id> data the library would return for the layout above. */
+static std::vector<std::uint8_t> make_definition(std::uint32_t serial_offset, const char *serial_name)
+{
+    struct info { std::uint16_t metadata; std::uint16_t type; std::uint32_t offset; const char *name; };
+    const info fields[] = {
+        {0, 0xC4, 0, "Count"}, {0, 0xCA, 4, "Level"}, {0, 0xC3, 8, "Mode"}, {0, 0xC2, 10, "ZZZZZZZZZZsample0"},
+        {3, 0xC1, 10, "Running"}, {0, 0xC2, 11, "Code"}, {0, 0xC5, 12, "Total"}, {0, 0xCB, 20, "Average"},
+        {0, 0xC8, serial_offset, serial_name}
+    };
+    std::vector<std::uint8_t> buf;
+    auto put = [&buf](std::uint32_t val, int size) {
+        for(int i = 0; i < size; i++) {
+            buf.push_back(static_cast<std::uint8_t>(val >> (i * 8)));
+        }
+    };
+    auto put_str = [&buf](const char *str) {
+        buf.insert(buf.end(), str, str + std::char_traits<char>::length(str) + 1);
+    };
+
+    put(0x123, 2);
+    put(0, 4);
+    put(32, 4);
+    put(sizeof(fields) / sizeof(fields[0]), 2);
+    put(0, 2);
+
+    for(const info &f : fields) {
+        put(f.metadata, 2);
+        put(f.type, 2);
+        put(f.offset, 4);
+    }
+
+    put_str("Sample;n");
+
+    for(const info &f : fields) {
+        put_str(f.name);
+    }
+
+    return buf;
+}
+
+
+static bool layout_matches(std::uint32_t serial_offset, const char *serial_name)
+{
+    std::vector<std::uint8_t> buf = make_definition(serial_offset, serial_name);
+    plctag::udt_definition def = plctag::parse_udt_definition(plctag::span<const std::uint8_t>(buf.data(), buf.size()));
+
+    try {
+        plctag::check_udt_layout<sample>(def);
+    } catch(const plctag::error &e) {
+        std::fprintf(stderr, "Layout check: %s\n", e.what());
+
+        if(e.status() != PLCTAG_ERR_BAD_CONFIG) {
+            throw;
+        }
+
+        return false;
+    }
+
+    return def.name == "Sample" && def.fields.size() == 9;
+}
+
+
+int main(int argc, char **argv)
+{
+    std::string attribs = (argc > 1 ? argv[1] : DEFAULT_ATTRIBS);
+
+    try {
+        /* the layout must match the definition and catch drifted or renamed fields. */
+        if(!layout_matches(28, "Serial") || layout_matches(24, "Serial") || layout_matches(28, "SerialNo")) {
+            std::fprintf(stderr, "ERROR: The layout check gave the wrong answer!\n");
+            return 1;
+        }
+
+        plctag::tag tag(attribs, 5000ms);
+        sample out = {-123456, 2.5f, 77, true, -5, 1234567890123LL, 0.125, 0x01020304u};
+
+        /* other bits in the BOOL host byte must survive a write. */
+        tag.set<std::uint8_t>(10, 0x81);
+        tag.set_udt(0, out);
+
+        if(tag.get<std::uint8_t>(10) != 0x89) {
+            std::fprintf(stderr, "ERROR: BOOL host byte is %x, expected 89!\n", tag.get<std::uint8_t>(10));
+            return 1;
+        }
+
+        /* the big endian field is stored byte swapped. */
+        if(tag.get<std::uint32_t>(28) != 0x04030201u) {
+            std::fprintf(stderr, "ERROR: Big endian field is %x!\n", tag.get<std::uint32_t>(28));
+            return 1;
+        }
+
+        tag.write(5000ms);
+
+        tag.set_udt(0, sample{});
+        tag.read(5000ms);
+
+        sample in = tag.get_udt<sample>(0);
+
+        if(in.count != out.count || in.level != out.level || in.mode != out.mode || in.running != out.running ||
+           in.code != out.code || in.total != out.total || in.average != out.average || in.serial != out.serial) {
+            std::fprintf(stderr, "ERROR: The struct did not round trip through the PLC!\n");
+            return 1;
+        }
+    } catch(const plctag::error &e) {
+        std::fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    std::fprintf(stderr, "Done.\n");
+
+    plctag::shutdown();
+
+    return 0;
+}